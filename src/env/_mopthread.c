@@ -3,6 +3,9 @@
 // Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
 
 #include "_mopthread.h"
+#include "_park.h"
+#include "tls.h"
+#include "address_wait.h"
 #include "mutex.h"
 #include "avl_tree.h"
 #include "mcfwin.h"
@@ -19,14 +22,13 @@
 #undef GetCurrentThread
 #define GetCurrentThread()   ((HANDLE)-2)
 
+__attribute__((__dllimport__, __stdcall__))
+extern NTSTATUS NtTerminateThread(HANDLE hThread, NTSTATUS lExitStatus);
 __attribute__((__dllimport__, __stdcall__))
 extern NTSTATUS NtDuplicateObject(HANDLE hSourceProcess, HANDLE hSource, HANDLE hTargetProcess, HANDLE *pTarget, ACCESS_MASK dwDesiredAccess, ULONG dwAttributes, DWORD dwOptions);
 
 static const _MCFCRT_ThreadHandle g_hPseudoSelfHandle = (_MCFCRT_ThreadHandle)GetCurrentThread();
 
-static _MCFCRT_Mutex   g_mtxControl    = { 0 };
-static _MCFCRT_AvlRoot g_avlControlMap = _MCFCRT_NULLPTR;
-
 static intptr_t TerminationUnlockCallback(intptr_t nContext){
 	_MCFCRT_Mutex *const pMutex = (void *)nContext;
 
@@ -46,23 +48,44 @@ typedef enum tagMopthreadState {
 	kStateJoining,
 	kStateJoined,
 	kStateDetached,
+	kStateEnd,
 } MopthreadState;
 
+// Each control block has its own state and reference count, which are updated atomically, so threads that don't look up each other don't contend.
+// The mutex and the condition variable are only used by a joining thread and the thread it is joining.
 typedef struct tagMopthreadControl {
 	_MCFCRT_AvlNodeHeader avlhTidIndex;
 
-	MopthreadState eState;
-	size_t uRefCount;
+	volatile MopthreadState eState;
+	volatile size_t uRefCount;
+	_MCFCRT_Mutex mtxTermination;
 	_MCFCRT_ConditionVariable condTermination;
 
 	uintptr_t uTid;
 	_MCFCRT_ThreadHandle hThread;
+	bool bCacheable;
+	bool bRecycled;
+	// This is set to tell a cached thread to exit.
+	volatile bool bRetired;
+	struct tagMopthreadControl *pNextCached;
+	struct tagMopthreadSlab *pSlab;
+	// These are only used by a thread that is joining this thread along with others. See `ReallyJoinMopthreads()`.
+	volatile uintptr_t *puJoinCounter;
+	struct tagMopthreadControl *pNextJoining;
+	size_t uJoinIndex;
 
 	void (*pfnProc)(void *);
 	size_t uSizeOfParams;
+	size_t uCapacityOfParams;
 	unsigned char abyParams[];
 } MopthreadControl;
 
+// Control blocks of threads that are created by `__MCFCRT_MopthreadCreateMany()` are allocated in slabs.
+// A slab is freed after all control blocks in it have been freed.
+typedef struct tagMopthreadSlab {
+	volatile size_t uControlCount;
+} MopthreadSlab;
+
 static inline int MopthreadControlComparatorNodeOther(const _MCFCRT_AvlNodeHeader *pNodeSelf, intptr_t nTidOther){
 	const uintptr_t uTidSelf = (uintptr_t)(((const MopthreadControl *)pNodeSelf)->uTid);
 	const uintptr_t uTidOther = (uintptr_t)nTidOther;
@@ -75,21 +98,122 @@ static inline int MopthreadControlComparatorNodes(const _MCFCRT_AvlNodeHeader *p
 	return MopthreadControlComparatorNodeOther(pNodeSelf, (intptr_t)(((const MopthreadControl *)pNodeOther)->uTid));
 }
 
+// Control blocks are indexed by thread IDs in a number of shards, each of which has its own mutex and map.
+// Thread IDs are multiples of four, hence the shift.
+#define SHARD_COUNT             64u
+
+typedef struct tagControlShard {
+	__attribute__((__aligned__(64))) _MCFCRT_Mutex mtxControl;
+	_MCFCRT_AvlRoot avlControlMap;
+} ControlShard;
+
+static ControlShard g_aShards[SHARD_COUNT];
+
+static inline ControlShard *GetControlShard(uintptr_t uTid){
+	return g_aShards + (uTid >> 2) % SHARD_COUNT;
+}
+
 static unsigned char g_abyInitialControlStorage[sizeof(MopthreadControl) + sizeof(void *) * 3]; // XXX: This should suffice for both gthread and c11thread.
-static_assert(sizeof(g_abyInitialControlStorage) == sizeof(void *) * 17, "??");
+static_assert(sizeof(g_abyInitialControlStorage) == sizeof(void *) * 25, "??");
+
+static void AttachControl(MopthreadControl *restrict pControl){
+	ControlShard *const pShard = GetControlShard(pControl->uTid);
+	_MCFCRT_WaitForMutexForever(&(pShard->mtxControl), _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	{
+		_MCFCRT_AvlAttach(&(pShard->avlControlMap), (_MCFCRT_AvlNodeHeader *)pControl, &MopthreadControlComparatorNodes);
+	}
+	_MCFCRT_SignalMutex(&(pShard->mtxControl));
+}
+// This function returns a control block with its reference count incremented, which must be dropped by the caller.
+// A control block whose reference count has dropped to zero may remain in the map until it is detached, so it is skipped.
+static MopthreadControl *LockControl(uintptr_t uTid){
+	MopthreadControl *restrict pControl;
+
+	ControlShard *const pShard = GetControlShard(uTid);
+	_MCFCRT_WaitForMutexForever(&(pShard->mtxControl), _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	{
+		pControl = (MopthreadControl *)_MCFCRT_AvlFind(&(pShard->avlControlMap), (intptr_t)uTid, &MopthreadControlComparatorNodeOther);
+		if(pControl){
+			size_t uOld = __atomic_load_n(&(pControl->uRefCount), __ATOMIC_RELAXED);
+			do {
+				if(uOld == 0){
+					pControl = _MCFCRT_NULLPTR;
+					break;
+				}
+			} while(!__atomic_compare_exchange_n(&(pControl->uRefCount), &uOld, uOld + 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+		}
+	}
+	_MCFCRT_SignalMutex(&(pShard->mtxControl));
+
+	return pControl;
+}
+static void DropControlRef(MopthreadControl *restrict pControl){
+	const size_t uOld = __atomic_fetch_sub(&(pControl->uRefCount), 1, __ATOMIC_ACQ_REL);
+	_MCFCRT_ASSERT(uOld > 0);
+	if(uOld != 1){
+		return;
+	}
+	_MCFCRT_ASSERT(__atomic_load_n(&(pControl->eState), __ATOMIC_RELAXED) == kStateJoined);
 
-// The caller must have the global mutex locked!
-static inline void DropControlRefUnsafe(MopthreadControl *restrict pControl){
-	_MCFCRT_ASSERT(pControl->uRefCount > 0);
-	if(--(pControl->uRefCount) == 0){
-		_MCFCRT_ASSERT(pControl->eState == kStateJoined);
+	ControlShard *const pShard = GetControlShard(pControl->uTid);
+	_MCFCRT_WaitForMutexForever(&(pShard->mtxControl), _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	{
 		_MCFCRT_AvlDetach((_MCFCRT_AvlNodeHeader *)pControl);
-		_MCFCRT_CloseThread(pControl->hThread);
+	}
+	_MCFCRT_SignalMutex(&(pShard->mtxControl));
+
+	_MCFCRT_CloseThread(pControl->hThread);
 #ifndef NDEBUG
-		pControl->hThread = (HANDLE)0xDEADBEEF;
+	pControl->hThread = (HANDLE)0xDEADBEEF;
 #endif
-		if(pControl != (void *)g_abyInitialControlStorage){
-			_MCFCRT_free(pControl);
+	if(pControl == (void *)g_abyInitialControlStorage){
+		return;
+	}
+	MopthreadSlab *const pSlab = pControl->pSlab;
+	if(!pSlab){
+		_MCFCRT_free(pControl);
+		return;
+	}
+	if(__atomic_sub_fetch(&(pSlab->uControlCount), 1, __ATOMIC_ACQ_REL) == 0){
+		_MCFCRT_free(pSlab);
+	}
+}
+
+// Each transition table maps an old state to a new one. If a state maps to itself, it is left alone.
+static const MopthreadState g_aeTransitionsOnExit[kStateEnd] = {
+	[kStateJoinable] = kStateZombie,
+	[kStateZombie]   = kStateEnd,
+	[kStateJoining]  = kStateJoined,
+	[kStateJoined]   = kStateEnd,
+	[kStateDetached] = kStateJoined,
+};
+static const MopthreadState g_aeTransitionsOnJoin[kStateEnd] = {
+	[kStateJoinable] = kStateJoining,
+	[kStateZombie]   = kStateJoined,
+	[kStateJoining]  = kStateJoining,
+	[kStateJoined]   = kStateJoined,
+	[kStateDetached] = kStateDetached,
+};
+static const MopthreadState g_aeTransitionsOnDetach[kStateEnd] = {
+	[kStateJoinable] = kStateDetached,
+	[kStateZombie]   = kStateJoined,
+	[kStateJoining]  = kStateJoining,
+	[kStateJoined]   = kStateJoined,
+	[kStateDetached] = kStateDetached,
+};
+
+// This function returns the old state.
+static MopthreadState TransitState(MopthreadControl *restrict pControl, const MopthreadState *paeTransitions){
+	MopthreadState eOld = __atomic_load_n(&(pControl->eState), __ATOMIC_ACQUIRE);
+	for(;;){
+		_MCFCRT_ASSERT((unsigned)eOld < kStateEnd);
+		const MopthreadState eNew = paeTransitions[eOld];
+		_MCFCRT_ASSERT_MSG(eNew != kStateEnd, L"The state of this thread is corrupted.");
+		if(eNew == eOld){
+			return eOld;
+		}
+		if(_MCFCRT_EXPECT(__atomic_compare_exchange_n(&(pControl->eState), &eOld, eNew, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))){
+			return eOld;
 		}
 	}
 }
@@ -100,9 +224,16 @@ static void AttachInitialThread(void){
 
 	pControl->pfnProc       = _MCFCRT_NULLPTR;
 	pControl->uSizeOfParams = sizeof(g_abyInitialControlStorage) - sizeof(MopthreadControl);
+	pControl->uCapacityOfParams = pControl->uSizeOfParams;
 	_MCFCRT_inline_mempset_fwd(pControl->abyParams, 0, pControl->uSizeOfParams);
 	pControl->eState        = kStateJoinable;
 	pControl->uRefCount     = 2;
+	pControl->bCacheable    = false;
+	pControl->bRecycled     = false;
+	pControl->bRetired      = false;
+	pControl->pSlab         = _MCFCRT_NULLPTR;
+	pControl->puJoinCounter = _MCFCRT_NULLPTR;
+	_MCFCRT_InitializeMutex(&(pControl->mtxTermination));
 	_MCFCRT_InitializeConditionVariable(&(pControl->condTermination));
 
 	HANDLE hThread;
@@ -113,64 +244,135 @@ static void AttachInitialThread(void){
 	pControl->uTid    = (uintptr_t)GetCurrentThreadId();
 	pControl->hThread = (HANDLE)hThread;
 
-	_MCFCRT_AvlAttach(&g_avlControlMap, (_MCFCRT_AvlNodeHeader *)pControl, &MopthreadControlComparatorNodes);
+	AttachControl(pControl);
 }
 static void DetachInitialThread(void){
 	MopthreadControl *const restrict pControl = (void *)g_abyInitialControlStorage;
 
-	switch(pControl->eState){
+	switch(TransitState(pControl, g_aeTransitionsOnDetach)){
 	case kStateJoinable:
-		pControl->eState = kStateDetached;
-		goto jJoinSuccess;
 	case kStateZombie:
-		pControl->eState = kStateJoined;
-		goto jJoinSuccess;
+		DropControlRef(pControl);
+		// bSuccess = true;
+		break;
 	case kStateJoining:
 	case kStateJoined:
 	case kStateDetached:
 		break;
 	default:
 		_MCFCRT_ASSERT(false);
-	jJoinSuccess:
-		DropControlRefUnsafe(pControl);
-		// bSuccess = true;
-		break;
 	}
 }
 
-__attribute__((__noreturn__))
-static inline void SignalMutexAndExitThread(_MCFCRT_Mutex *restrict pMutex, MopthreadControl *restrict pControl, void (*pfnModifier)(void *, size_t, intptr_t), intptr_t nContext){
-	switch(pControl->eState){
-	case kStateJoinable:
-		if(pfnModifier){
-			(*pfnModifier)(pControl->abyParams, pControl->uSizeOfParams, nContext);
-		}
-		pControl->eState = kStateZombie;
-		break;
-	case kStateZombie:
-		_MCFCRT_ASSERT(false);
-	case kStateJoining:
-		if(pfnModifier){
-			(*pfnModifier)(pControl->abyParams, pControl->uSizeOfParams, nContext);
+static inline void SignalTermination(MopthreadControl *restrict pControl, void (*pfnModifier)(void *, size_t, intptr_t), intptr_t nContext){
+	// No other thread reads the parameters until the state is changed below, which releases the modifications.
+	if(pfnModifier){
+		(*pfnModifier)(pControl->abyParams, pControl->uSizeOfParams, nContext);
+	}
+	if(TransitState(pControl, g_aeTransitionsOnExit) == kStateJoining){
+		// The joining thread checks the state with this mutex locked, so it can't miss the broadcast.
+		_MCFCRT_WaitForMutexForever(&(pControl->mtxTermination), _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+		{
+			_MCFCRT_BroadcastConditionVariable(&(pControl->condTermination));
+			// The joining thread clears the counter with this mutex locked before it returns, so the counter is still valid here.
+			volatile uintptr_t *const puJoinCounter = pControl->puJoinCounter;
+			if(puJoinCounter){
+				__atomic_fetch_add(puJoinCounter, 1, __ATOMIC_RELEASE);
+				_MCFCRT_WakeAddress(puJoinCounter, SIZE_MAX);
+			}
 		}
-		pControl->eState = kStateJoined;
-		_MCFCRT_BroadcastConditionVariable(&(pControl->condTermination));
-		break;
-	case kStateJoined:
-		_MCFCRT_ASSERT(false);
-	case kStateDetached:
-		pControl->eState = kStateJoined;
-		break;
-	default:
-		_MCFCRT_ASSERT(false);
+		_MCFCRT_SignalMutex(&(pControl->mtxTermination));
 	}
-	DropControlRefUnsafe(pControl);
-	_MCFCRT_SignalMutex(pMutex);
+}
+__attribute__((__noreturn__))
+static inline void DropControlRefAndExitThread(MopthreadControl *restrict pControl){
+	DropControlRef(pControl);
 
 	ExitThread(0);
 	__builtin_unreachable();
 }
 
+// Threads whose procedures have returned may be kept in this cache and reused, up to the capacity, which is zero by default.
+// A cached thread keeps the reference to its own control block, which remains in the map, as the thread ID doesn't change.
+// It can be reused only if that is the only reference left, i.e. it has been joined or detached and no handle is locked.
+static _MCFCRT_Mutex       g_mtxCache        = { 0 };
+static size_t              g_uCacheCapacity  = 0;
+static size_t              g_uCacheReserved  = 0; // This includes threads that are about to be pushed.
+static MopthreadControl *  g_pFirstCached    = _MCFCRT_NULLPTR;
+
+static bool ReserveCacheSlot(void){
+	if(_MCFCRT_EXPECT(__atomic_load_n(&g_uCacheCapacity, __ATOMIC_RELAXED) == 0)){
+		return false;
+	}
+	bool bReserved = false;
+
+	_MCFCRT_WaitForMutexForever(&g_mtxCache, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	{
+		if(g_uCacheReserved < g_uCacheCapacity){
+			++g_uCacheReserved;
+			bReserved = true;
+		}
+	}
+	_MCFCRT_SignalMutex(&g_mtxCache);
+
+	return bReserved;
+}
+static void ReleaseCacheSlot(void){
+	_MCFCRT_WaitForMutexForever(&g_mtxCache, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	{
+		_MCFCRT_ASSERT(g_uCacheReserved > 0);
+		--g_uCacheReserved;
+	}
+	_MCFCRT_SignalMutex(&g_mtxCache);
+}
+// If the capacity has been reduced since the slot was reserved, the slot is released and `false` is returned.
+static bool PushCachedControl(MopthreadControl *restrict pControl){
+	bool bPushed = false;
+
+	_MCFCRT_WaitForMutexForever(&g_mtxCache, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	{
+		_MCFCRT_ASSERT(g_uCacheReserved > 0);
+		if(g_uCacheReserved > g_uCacheCapacity){
+			--g_uCacheReserved;
+		} else {
+			pControl->pNextCached = g_pFirstCached;
+			g_pFirstCached = pControl;
+			bPushed = true;
+		}
+	}
+	_MCFCRT_SignalMutex(&g_mtxCache);
+
+	return bPushed;
+}
+// This function returns a control block whose reference count is zero, which hides it from lookups until it is initialized again.
+static MopthreadControl *ClaimCachedControl(size_t uSizeOfParams){
+	if(_MCFCRT_EXPECT(__atomic_load_n(&g_pFirstCached, __ATOMIC_RELAXED) == _MCFCRT_NULLPTR)){
+		return _MCFCRT_NULLPTR;
+	}
+	MopthreadControl *restrict pControl;
+
+	_MCFCRT_WaitForMutexForever(&g_mtxCache, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	{
+		MopthreadControl **ppControl = &g_pFirstCached;
+		for(;;){
+			pControl = *ppControl;
+			if(!pControl){
+				break;
+			}
+			size_t uOld = 1;
+			if((pControl->uCapacityOfParams >= uSizeOfParams) && __atomic_compare_exchange_n(&(pControl->uRefCount), &uOld, 0, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+				*ppControl = pControl->pNextCached;
+				--g_uCacheReserved;
+				break;
+			}
+			ppControl = &(pControl->pNextCached);
+		}
+	}
+	_MCFCRT_SignalMutex(&g_mtxCache);
+
+	return pControl;
+}
+
 bool __MCFCRT_MopthreadInit(void){
 	AttachInitialThread();
 	return true;
@@ -179,6 +381,40 @@ void __MCFCRT_MopthreadUninit(void){
 	DetachInitialThread();
 }
 
+// A reused thread must look like a fresh one to the next procedure, so these attributes, which the previous procedure might have changed,
+// are saved when a cacheable thread starts and restored before it is cached.
+typedef struct tagSchedulingAttributes {
+	GROUP_AFFINITY vAffinity;
+	PROCESSOR_NUMBER vIdealProcessor;
+	int nPriority;
+} SchedulingAttributes;
+
+static bool SaveSchedulingAttributes(SchedulingAttributes *restrict pAttributes){
+	if(!GetThreadGroupAffinity(GetCurrentThread(), &(pAttributes->vAffinity))){
+		return false;
+	}
+	if(!GetThreadIdealProcessorEx(GetCurrentThread(), &(pAttributes->vIdealProcessor))){
+		return false;
+	}
+	pAttributes->nPriority = GetThreadPriority(GetCurrentThread());
+	if(pAttributes->nPriority == THREAD_PRIORITY_ERROR_RETURN){
+		return false;
+	}
+	return true;
+}
+static bool RestoreSchedulingAttributes(SchedulingAttributes *restrict pAttributes){
+	if(!SetThreadGroupAffinity(GetCurrentThread(), &(pAttributes->vAffinity), _MCFCRT_NULLPTR)){
+		return false;
+	}
+	if(!SetThreadIdealProcessorEx(GetCurrentThread(), &(pAttributes->vIdealProcessor), _MCFCRT_NULLPTR)){
+		return false;
+	}
+	if(!SetThreadPriority(GetCurrentThread(), pAttributes->nPriority)){
+		return false;
+	}
+	return true;
+}
+
 static unsigned long MopthreadProc(void *pParam){
 	MopthreadControl *const restrict pControl = pParam;
 	_MCFCRT_DEBUG_CHECK(pControl);
@@ -189,38 +425,96 @@ __MCFCRT_C_STDCALL __attribute__((__noreturn__))
 static unsigned long NativeMopthreadProc(void *pParam){
 	MopthreadControl *const restrict pControl = pParam;
 	_MCFCRT_DEBUG_CHECK(pControl);
-	_MCFCRT_WrapThreadProcWithSehTop(&MopthreadProc, pControl);
-	_MCFCRT_WaitForMutexForever(&g_mtxControl, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
-	SignalMutexAndExitThread(&g_mtxControl, pControl, _MCFCRT_NULLPTR, 0);
+	SchedulingAttributes vSchedulingAttributes;
+	const bool bCacheable = pControl->bCacheable && SaveSchedulingAttributes(&vSchedulingAttributes);
+	for(;;){
+		_MCFCRT_WrapThreadProcWithSehTop(&MopthreadProc, pControl);
+		if(!bCacheable || !ReserveCacheSlot()){
+			break;
+		}
+		if(!RestoreSchedulingAttributes(&vSchedulingAttributes)){
+			ReleaseCacheSlot();
+			break;
+		}
+		// Destroy thread-local storage as if the thread had exited. This has to be done before it can be joined.
+		// Note that the `DLL_THREAD_DETACH` notification is not sent to other modules until the thread exits eventually.
+		__MCFCRT_TlsCleanup();
+		pControl->bRecycled = true;
+		SignalTermination(pControl, _MCFCRT_NULLPTR, 0);
+		// The procedure is set again when the thread is claimed, which is how it tells a wakeup meant for it from a stale one.
+		__atomic_store_n(&(pControl->pfnProc), _MCFCRT_NULLPTR, __ATOMIC_RELAXED);
+		if(!PushCachedControl(pControl)){
+			DropControlRefAndExitThread(pControl);
+		}
+		for(;;){
+			const NTSTATUS lStatus = __MCFCRT_ParkThread((void *)pControl, _MCFCRT_NULLPTR);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+			if(__atomic_load_n(&(pControl->bRetired), __ATOMIC_ACQUIRE)){
+				DropControlRefAndExitThread(pControl);
+			}
+			if(__atomic_load_n(&(pControl->pfnProc), __ATOMIC_ACQUIRE)){
+				break;
+			}
+		}
+	}
+	SignalTermination(pControl, _MCFCRT_NULLPTR, 0);
+	DropControlRefAndExitThread(pControl);
 }
 
-static inline uintptr_t ReallyCreateMopthread(void (*pfnProc)(void *), const void *pParams, size_t uSizeOfParams, bool bJoinable){
-	const size_t uSizeToAlloc = sizeof(MopthreadControl) + uSizeOfParams;
-	if(uSizeToAlloc < sizeof(MopthreadControl)){
-		return 0;
-	}
-	MopthreadControl *const restrict pControl = _MCFCRT_malloc(uSizeToAlloc);
-	if(!pControl){
-		return 0;
-	}
-	pControl->pfnProc       = pfnProc;
+static inline void InitializeControl(MopthreadControl *restrict pControl, void (*pfnProc)(void *), const void *pParams, size_t uSizeOfParams, bool bJoinable){
 	pControl->uSizeOfParams = uSizeOfParams;
 	if(pParams){
 		_MCFCRT_inline_mempcpy_fwd(pControl->abyParams, pParams, uSizeOfParams);
 	} else {
 		_MCFCRT_inline_mempset_fwd(pControl->abyParams, 0, uSizeOfParams);
 	}
+	pControl->bRecycled     = false;
+	pControl->puJoinCounter = _MCFCRT_NULLPTR;
 	if(bJoinable){
 		pControl->eState    = kStateJoinable;
-		pControl->uRefCount = 2;
+		__atomic_store_n(&(pControl->uRefCount), 2, __ATOMIC_RELEASE);
 	} else {
 		pControl->eState    = kStateDetached;
-		pControl->uRefCount = 1;
+		__atomic_store_n(&(pControl->uRefCount), 1, __ATOMIC_RELEASE);
 	}
+	pControl->bRetired      = false;
+	// A cached thread checks this after it is woken up, so it is set last.
+	__atomic_store_n(&(pControl->pfnProc), pfnProc, __ATOMIC_RELEASE);
+}
+
+static inline uintptr_t ReallyCreateMopthread(void (*pfnProc)(void *), const void *pParams, size_t uSizeOfParams, bool bJoinable, const _MCFCRT_ThreadAttributes *pAttributes){
+	MopthreadControl *restrict pControl;
+	// Cached threads have the attributes they were created with, which are the defaults, so threads with other attributes are never cached or reused.
+	if(!pAttributes){
+		pControl = ClaimCachedControl(uSizeOfParams);
+	} else {
+		pControl = _MCFCRT_NULLPTR;
+	}
+	if(pControl){
+		// Reuse a cached thread, which is still attached.
+		InitializeControl(pControl, pfnProc, pParams, uSizeOfParams, bJoinable);
+		const NTSTATUS lStatus = __MCFCRT_UnparkThread((void *)pControl);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThread() failed.");
+		return pControl->uTid;
+	}
+
+	const size_t uSizeToAlloc = sizeof(MopthreadControl) + uSizeOfParams;
+	if(uSizeToAlloc < sizeof(MopthreadControl)){
+		return 0;
+	}
+	pControl = _MCFCRT_malloc(uSizeToAlloc);
+	if(!pControl){
+		return 0;
+	}
+	pControl->uCapacityOfParams = uSizeOfParams;
+	pControl->bCacheable = !pAttributes;
+	pControl->pSlab = _MCFCRT_NULLPTR;
+	InitializeControl(pControl, pfnProc, pParams, uSizeOfParams, bJoinable);
+	_MCFCRT_InitializeMutex(&(pControl->mtxTermination));
 	_MCFCRT_InitializeConditionVariable(&(pControl->condTermination));
 
 	uintptr_t uTid;
-	const _MCFCRT_ThreadHandle hThread = _MCFCRT_CreateNativeThread(&NativeMopthreadProc, pControl, true, &uTid);
+	const _MCFCRT_ThreadHandle hThread = _MCFCRT_CreateNativeThreadWithAttributes(&NativeMopthreadProc, pControl, true, pAttributes, &uTid);
 	if(!hThread){
 		_MCFCRT_free(pControl);
 		return 0;
@@ -229,101 +523,370 @@ static inline uintptr_t ReallyCreateMopthread(void (*pfnProc)(void *), const voi
 	pControl->hThread = hThread;
 	// XXX: Note that at the moment you must attach the control block unconditionally, because the thread could call
 	//      `__MCFCRT_MopthreadExit()` which must be able to get a valid pointer to it by thread ID.
-	_MCFCRT_WaitForMutexForever(&g_mtxControl, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
-	{
-		_MCFCRT_AvlAttach(&g_avlControlMap, (_MCFCRT_AvlNodeHeader *)pControl, &MopthreadControlComparatorNodes);
-	}
-	_MCFCRT_SignalMutex(&g_mtxControl);
+	AttachControl(pControl);
 
 	_MCFCRT_ResumeThread(hThread);
 	return uTid;
 }
 
 uintptr_t __MCFCRT_MopthreadCreate(void (*pfnProc)(void *), const void *pParams, size_t uSizeOfParams){
-	return ReallyCreateMopthread(pfnProc, pParams, uSizeOfParams, true);
+	return ReallyCreateMopthread(pfnProc, pParams, uSizeOfParams, true, _MCFCRT_NULLPTR);
 }
 uintptr_t __MCFCRT_MopthreadCreateDetached(void (*pfnProc)(void *), const void *pParams, size_t uSizeOfParams){
-	return ReallyCreateMopthread(pfnProc, pParams, uSizeOfParams, false);
+	return ReallyCreateMopthread(pfnProc, pParams, uSizeOfParams, false, _MCFCRT_NULLPTR);
+}
+uintptr_t __MCFCRT_MopthreadCreateWithAttributes(void (*pfnProc)(void *), const void *pParams, size_t uSizeOfParams, const _MCFCRT_ThreadAttributes *pAttributes){
+	return ReallyCreateMopthread(pfnProc, pParams, uSizeOfParams, true, pAttributes);
+}
+bool __MCFCRT_MopthreadCreateMany(uintptr_t *restrict puTids, size_t uCount, void (*pfnProc)(void *), const void *pParams, size_t uSizeOfParams, const _MCFCRT_ThreadAttributes *pAttributes){
+	if(uCount == 0){
+		return true;
+	}
+	// Control blocks are padded to cache lines, so threads don't contend on the states of their neighbors.
+	// The heap doesn't align blocks to cache lines, so the first control block is aligned explicitly, for which some more bytes are allocated.
+	const size_t uHeaderSize = sizeof(MopthreadSlab) + 63;
+	const size_t uStride = (sizeof(MopthreadControl) + uSizeOfParams + 63) & (size_t)-64;
+	if(uStride < sizeof(MopthreadControl)){
+		return false;
+	}
+	if(uCount > (SIZE_MAX - uHeaderSize) / uStride){
+		return false;
+	}
+	MopthreadSlab *const restrict pSlab = _MCFCRT_malloc(uHeaderSize + uStride * uCount);
+	if(!pSlab){
+		return false;
+	}
+	pSlab->uControlCount = uCount;
+	unsigned char *const pbyFirstControl = (unsigned char *)(((uintptr_t)pSlab + uHeaderSize) & (uintptr_t)-64);
+
+	// Create all threads suspended. If any of them can't be created, terminate the others, none of which has run any code.
+	size_t uCreated = 0;
+	while(uCreated < uCount){
+		MopthreadControl *const restrict pControl = (void *)(pbyFirstControl + uStride * uCreated);
+		pControl->uCapacityOfParams = uSizeOfParams;
+		pControl->bCacheable = !pAttributes;
+		pControl->pSlab = pSlab;
+		InitializeControl(pControl, pfnProc, pParams ? (const unsigned char *)pParams + uSizeOfParams * uCreated : _MCFCRT_NULLPTR, uSizeOfParams, true);
+		_MCFCRT_InitializeMutex(&(pControl->mtxTermination));
+		_MCFCRT_InitializeConditionVariable(&(pControl->condTermination));
+
+		uintptr_t uTid;
+		const _MCFCRT_ThreadHandle hThread = _MCFCRT_CreateNativeThreadWithAttributes(&NativeMopthreadProc, pControl, true, pAttributes, &uTid);
+		if(!hThread){
+			break;
+		}
+		pControl->uTid    = uTid;
+		pControl->hThread = hThread;
+		++uCreated;
+	}
+	if(uCreated < uCount){
+		for(size_t uIndex = 0; uIndex < uCreated; ++uIndex){
+			MopthreadControl *const restrict pControl = (void *)(pbyFirstControl + uStride * uIndex);
+			const NTSTATUS lStatus = NtTerminateThread((HANDLE)pControl->hThread, 0);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtTerminateThread() failed.");
+			_MCFCRT_CloseThread(pControl->hThread);
+		}
+		_MCFCRT_free(pSlab);
+		return false;
+	}
+
+	// Sort control blocks into shards, then attach them with each shard locked only once.
+	MopthreadControl *apShardLists[SHARD_COUNT] = { 0 };
+	for(size_t uIndex = 0; uIndex < uCount; ++uIndex){
+		MopthreadControl *const restrict pControl = (void *)(pbyFirstControl + uStride * uIndex);
+		const size_t uShardIndex = (size_t)(GetControlShard(pControl->uTid) - g_aShards);
+		pControl->pNextCached = apShardLists[uShardIndex];
+		apShardLists[uShardIndex] = pControl;
+		puTids[uIndex] = pControl->uTid;
+	}
+	for(size_t uShardIndex = 0; uShardIndex < SHARD_COUNT; ++uShardIndex){
+		MopthreadControl *restrict pControl = apShardLists[uShardIndex];
+		if(!pControl){
+			continue;
+		}
+		ControlShard *const pShard = g_aShards + uShardIndex;
+		_MCFCRT_WaitForMutexForever(&(pShard->mtxControl), _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+		do {
+			MopthreadControl *const restrict pNext = pControl->pNextCached;
+			pControl->pNextCached = _MCFCRT_NULLPTR;
+			_MCFCRT_AvlAttach(&(pShard->avlControlMap), (_MCFCRT_AvlNodeHeader *)pControl, &MopthreadControlComparatorNodes);
+			pControl = pNext;
+		} while(pControl);
+		_MCFCRT_SignalMutex(&(pShard->mtxControl));
+	}
+
+	for(size_t uIndex = 0; uIndex < uCount; ++uIndex){
+		MopthreadControl *const restrict pControl = (void *)(pbyFirstControl + uStride * uIndex);
+		_MCFCRT_ResumeThread(pControl->hThread);
+	}
+	return true;
 }
 __attribute__((__noreturn__))
 void __MCFCRT_MopthreadExit(void (*pfnModifier)(void *, size_t, intptr_t), intptr_t nContext){
 	const uintptr_t uTid = _MCFCRT_GetCurrentThreadId();
 
-	_MCFCRT_WaitForMutexForever(&g_mtxControl, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
-	MopthreadControl *const restrict pControl = (MopthreadControl *)_MCFCRT_AvlFind(&g_avlControlMap, (intptr_t)uTid, &MopthreadControlComparatorNodeOther);
+	MopthreadControl *const restrict pControl = LockControl(uTid);
 	if(!pControl){
 		_MCFCRT_Bail(L"Calling thread of __MCFCRT_MopthreadExit() was not created using __MCFCRT_MopthreadCreate().");
 	}
-	SignalMutexAndExitThread(&g_mtxControl, pControl, pfnModifier, nContext);
+	// The calling thread holds another reference to its own control block, so this will not free it.
+	DropControlRef(pControl);
+	SignalTermination(pControl, pfnModifier, nContext);
+	DropControlRefAndExitThread(pControl);
 }
-bool __MCFCRT_MopthreadJoin(uintptr_t uTid, void *restrict pParams, size_t *restrict puSizeOfParams){
-	bool bSuccess = false;
+size_t __MCFCRT_MopthreadSetCacheCapacity(size_t uCapacity){
+	size_t uOldCapacity;
+	MopthreadControl *restrict pRetired = _MCFCRT_NULLPTR;
 
-	_MCFCRT_WaitForMutexForever(&g_mtxControl, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	_MCFCRT_WaitForMutexForever(&g_mtxCache, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
 	{
-		MopthreadControl *const restrict pControl = (MopthreadControl *)_MCFCRT_AvlFind(&g_avlControlMap, (intptr_t)uTid, &MopthreadControlComparatorNodeOther);
-		if(pControl){
-			switch(pControl->eState){
-			case kStateJoinable:
-				pControl->eState = kStateJoining;
-				do {
-					_MCFCRT_WaitForConditionVariableForever(&(pControl->condTermination), &TerminationUnlockCallback, &TerminationRelockCallback, (intptr_t)&g_mtxControl, 0);
-				} while(pControl->eState != kStateJoined);
-				goto jJoinSuccess;
-			case kStateZombie:
-				pControl->eState = kStateJoined;
-				goto jJoinSuccess;
-			case kStateJoining:
-			case kStateJoined:
-			case kStateDetached:
-				break;
-			default:
-				_MCFCRT_ASSERT(false);
-			jJoinSuccess:
-				_MCFCRT_WaitForThreadForever(pControl->hThread);
-				if(pParams){
-					const size_t uSizeCopied = (pControl->uSizeOfParams < *puSizeOfParams) ? pControl->uSizeOfParams : *puSizeOfParams;
-					_MCFCRT_inline_mempcpy_fwd(pParams, pControl->abyParams, uSizeCopied);
-					*puSizeOfParams = uSizeCopied;
+		uOldCapacity = g_uCacheCapacity;
+		__atomic_store_n(&g_uCacheCapacity, uCapacity, __ATOMIC_RELAXED);
+		while((g_uCacheReserved > uCapacity) && g_pFirstCached){
+			MopthreadControl *const restrict pControl = g_pFirstCached;
+			g_pFirstCached = pControl->pNextCached;
+			--g_uCacheReserved;
+			pControl->pNextCached = pRetired;
+			pRetired = pControl;
+		}
+	}
+	_MCFCRT_SignalMutex(&g_mtxCache);
+
+	while(pRetired){
+		MopthreadControl *const restrict pControl = pRetired;
+		pRetired = pControl->pNextCached;
+		__atomic_store_n(&(pControl->bRetired), true, __ATOMIC_RELEASE);
+		const NTSTATUS lStatus = __MCFCRT_UnparkThread((void *)pControl);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThread() failed.");
+	}
+	return uOldCapacity;
+}
+
+// This function returns `true` if the thread has terminated, and `false` if a stop has been requested, in which case the thread is joinable again.
+static bool WaitForTermination(MopthreadControl *restrict pControl, _MCFCRT_StopToken *pStopToken){
+	bool bTerminated = true;
+
+	_MCFCRT_WaitForMutexForever(&(pControl->mtxTermination), _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	{
+		while(__atomic_load_n(&(pControl->eState), __ATOMIC_ACQUIRE) != kStateJoined){
+			if(pStopToken){
+				if(!_MCFCRT_WaitForConditionVariableOrStop(&(pControl->condTermination), &TerminationUnlockCallback, &TerminationRelockCallback, (intptr_t)&(pControl->mtxTermination), 0, UINT64_MAX, pStopToken)){
+					// Leave the thread joinable, as if we had never tried. This fails if it has terminated in the meantime.
+					MopthreadState eOld = kStateJoining;
+					if(__atomic_compare_exchange_n(&(pControl->eState), &eOld, kStateJoinable, false, __ATOMIC_RELAXED, __ATOMIC_ACQUIRE)){
+						bTerminated = false;
+						break;
+					}
+					_MCFCRT_ASSERT(eOld == kStateJoined);
 				}
-				DropControlRefUnsafe(pControl);
-				bSuccess = true;
-				break;
+			} else {
+				_MCFCRT_WaitForConditionVariableForever(&(pControl->condTermination), &TerminationUnlockCallback, &TerminationRelockCallback, (intptr_t)&(pControl->mtxTermination), 0);
 			}
 		}
 	}
-	_MCFCRT_SignalMutex(&g_mtxControl);
+	_MCFCRT_SignalMutex(&(pControl->mtxTermination));
 
-	return bSuccess;
+	return bTerminated;
 }
-bool __MCFCRT_MopthreadDetach(uintptr_t uTid){
+static inline bool ReallyJoinMopthread(uintptr_t uTid, void *restrict pParams, size_t *restrict puSizeOfParams, _MCFCRT_StopToken *pStopToken){
 	bool bSuccess = false;
 
-	_MCFCRT_WaitForMutexForever(&g_mtxControl, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	MopthreadControl *const restrict pControl = LockControl(uTid);
+	if(pControl){
+		switch(TransitState(pControl, g_aeTransitionsOnJoin)){
+		case kStateJoinable:
+			if(!WaitForTermination(pControl, pStopToken)){
+				break;
+			}
+			goto jJoinSuccess;
+		case kStateZombie:
+			goto jJoinSuccess;
+		case kStateJoining:
+		case kStateJoined:
+		case kStateDetached:
+			break;
+		default:
+			_MCFCRT_ASSERT(false);
+		jJoinSuccess:
+			// A recycled thread doesn't exit, but its thread-local storage has been destroyed before it was terminated.
+			if(!pControl->bRecycled){
+				_MCFCRT_WaitForThreadForever(pControl->hThread);
+			}
+			if(pParams){
+				const size_t uSizeCopied = (pControl->uSizeOfParams < *puSizeOfParams) ? pControl->uSizeOfParams : *puSizeOfParams;
+				_MCFCRT_inline_mempcpy_fwd(pParams, pControl->abyParams, uSizeCopied);
+				*puSizeOfParams = uSizeCopied;
+			}
+			DropControlRef(pControl);
+			bSuccess = true;
+			break;
+		}
+		DropControlRef(pControl);
+	}
+
+	return bSuccess;
+}
+bool __MCFCRT_MopthreadJoin(uintptr_t uTid, void *restrict pParams, size_t *restrict puSizeOfParams){
+	return ReallyJoinMopthread(uTid, pParams, puSizeOfParams, _MCFCRT_NULLPTR);
+}
+bool __MCFCRT_MopthreadJoinOrStop(uintptr_t uTid, void *restrict pParams, size_t *restrict puSizeOfParams, _MCFCRT_StopToken *pStopToken){
+	return ReallyJoinMopthread(uTid, pParams, puSizeOfParams, pStopToken);
+}
+// After this function returns, the thread will no longer touch the counter, which may then go out of scope.
+static void ClearJoinCounter(MopthreadControl *restrict pControl){
+	_MCFCRT_WaitForMutexForever(&(pControl->mtxTermination), _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
 	{
-		MopthreadControl *const restrict pControl = (MopthreadControl *)_MCFCRT_AvlFind(&g_avlControlMap, (intptr_t)uTid, &MopthreadControlComparatorNodeOther);
-		if(pControl){
-			switch(pControl->eState){
-			case kStateJoinable:
-				pControl->eState = kStateDetached;
-				goto jJoinSuccess;
-			case kStateZombie:
-				pControl->eState = kStateJoined;
-				goto jJoinSuccess;
-			case kStateJoining:
-			case kStateJoined:
-			case kStateDetached:
+		pControl->puJoinCounter = _MCFCRT_NULLPTR;
+	}
+	_MCFCRT_SignalMutex(&(pControl->mtxTermination));
+}
+// This function joins the threads in `puTids`, or any one of them if `bAny` is `true`, then sets the IDs of threads that have been joined to zero.
+// All terminating threads that are being joined increment a counter on the stack of the joining thread, which it waits on.
+// It returns `false` if it has timed out, and `*puIndexJoined` is set to the index of the thread that has been joined last, or `SIZE_MAX` if there is none.
+// Threads are pushed onto `pJoined` in the order they are found, so that is the first one that has been found.
+static bool ReallyJoinMopthreads(uintptr_t *restrict puTids, size_t uCount, size_t *restrict puIndexJoined, bool bAny, __MCFCRT_MopthreadJoinCallback pfnCallback, intptr_t nContext, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	volatile uintptr_t uJoinCounter = 0;
+	// These are linked lists of threads that we have moved into `kStateJoining` and `kStateJoined` respectively.
+	// As these states are exclusive, no other thread will touch `pNextJoining` of them.
+	MopthreadControl *pWaiting = _MCFCRT_NULLPTR;
+	MopthreadControl *pJoined = _MCFCRT_NULLPTR;
+
+	const uintptr_t uSelfTid = _MCFCRT_GetCurrentThreadId();
+	for(size_t uIndex = 0; uIndex < uCount; ++uIndex){
+		const uintptr_t uTid = puTids[uIndex];
+		if((uTid == 0) || (uTid == uSelfTid)){
+			continue;
+		}
+		MopthreadControl *const restrict pControl = LockControl(uTid);
+		if(!pControl){
+			continue;
+		}
+		switch(TransitState(pControl, g_aeTransitionsOnJoin)){
+		case kStateJoinable:
+			pControl->uJoinIndex = uIndex;
+			_MCFCRT_WaitForMutexForever(&(pControl->mtxTermination), _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+			{
+				pControl->puJoinCounter = &uJoinCounter;
+			}
+			_MCFCRT_SignalMutex(&(pControl->mtxTermination));
+			pControl->pNextJoining = pWaiting;
+			pWaiting = pControl;
+			break;
+		case kStateZombie:
+			pControl->uJoinIndex = uIndex;
+			pControl->pNextJoining = pJoined;
+			pJoined = pControl;
+			break;
+		case kStateJoining:
+		case kStateJoined:
+		case kStateDetached:
+			DropControlRef(pControl);
+			break;
+		default:
+			_MCFCRT_ASSERT(false);
+		}
+		if(bAny && pJoined){
+			break;
+		}
+	}
+
+	for(;;){
+		// If a thread terminates after we load the counter, the counter will have changed, so we will not sleep.
+		const uintptr_t uCounter = __atomic_load_n(&uJoinCounter, __ATOMIC_ACQUIRE);
+		MopthreadControl **ppWaiting = &pWaiting;
+		// For join-any, stop at the first thread that has terminated. The others are given up below.
+		while(!(bAny && pJoined)){
+			MopthreadControl *const restrict pControl = *ppWaiting;
+			if(!pControl){
 				break;
-			default:
-				_MCFCRT_ASSERT(false);
-			jJoinSuccess:
-				DropControlRefUnsafe(pControl);
-				bSuccess = true;
+			}
+			if(__atomic_load_n(&(pControl->eState), __ATOMIC_ACQUIRE) != kStateJoined){
+				ppWaiting = &(pControl->pNextJoining);
+				continue;
+			}
+			*ppWaiting = pControl->pNextJoining;
+			pControl->pNextJoining = pJoined;
+			pJoined = pControl;
+		}
+		if(!pWaiting || (bAny && pJoined)){
+			break;
+		}
+		if(bMayTimeOut){
+			if(!_MCFCRT_WaitOnAddress(&uJoinCounter, &uCounter, sizeof(uCounter), u64UntilFastMonoClock)){
 				break;
 			}
+		} else {
+			_MCFCRT_WaitOnAddressForever(&uJoinCounter, &uCounter, sizeof(uCounter));
+		}
+	}
+
+	// Give up threads that are still running, which are left joinable, as if we had never tried.
+	bool bGivenUp = false;
+	while(pWaiting){
+		MopthreadControl *const restrict pControl = pWaiting;
+		pWaiting = pControl->pNextJoining;
+		ClearJoinCounter(pControl);
+		MopthreadState eOld = kStateJoining;
+		if(__atomic_compare_exchange_n(&(pControl->eState), &eOld, kStateJoinable, false, __ATOMIC_RELAXED, __ATOMIC_ACQUIRE)){
+			DropControlRef(pControl);
+			bGivenUp = true;
+			continue;
 		}
+		// It has terminated in the meantime, so it can't be left joinable. It is joined even for join-any.
+		_MCFCRT_ASSERT(eOld == kStateJoined);
+		pControl->pNextJoining = pJoined;
+		pJoined = pControl;
+	}
+
+	size_t uIndexJoined = SIZE_MAX;
+	while(pJoined){
+		MopthreadControl *const restrict pControl = pJoined;
+		pJoined = pControl->pNextJoining;
+		// A recycled thread may still be about to increment the counter after its state has been changed.
+		ClearJoinCounter(pControl);
+		// A recycled thread doesn't exit, but its thread-local storage has been destroyed before it was terminated.
+		if(!pControl->bRecycled){
+			_MCFCRT_WaitForThreadForever(pControl->hThread);
+		}
+		if(pfnCallback){
+			(*pfnCallback)(nContext, pControl->uJoinIndex, pControl->abyParams, pControl->uSizeOfParams);
+		}
+		puTids[pControl->uJoinIndex] = 0;
+		uIndexJoined = pControl->uJoinIndex;
+		DropControlRef(pControl);
+		DropControlRef(pControl);
+	}
+	if(puIndexJoined){
+		*puIndexJoined = uIndexJoined;
+	}
+	return !bGivenUp || (bAny && (uIndexJoined != SIZE_MAX));
+}
+bool __MCFCRT_MopthreadJoinAll(uintptr_t *restrict puTids, size_t uCount, __MCFCRT_MopthreadJoinCallback pfnCallback, intptr_t nContext, uint64_t u64UntilFastMonoClock){
+	return ReallyJoinMopthreads(puTids, uCount, _MCFCRT_NULLPTR, false, pfnCallback, nContext, u64UntilFastMonoClock != UINT64_MAX, u64UntilFastMonoClock);
+}
+bool __MCFCRT_MopthreadJoinAny(uintptr_t *restrict puTids, size_t uCount, size_t *restrict puIndexJoined, __MCFCRT_MopthreadJoinCallback pfnCallback, intptr_t nContext, uint64_t u64UntilFastMonoClock){
+	return ReallyJoinMopthreads(puTids, uCount, puIndexJoined, true, pfnCallback, nContext, u64UntilFastMonoClock != UINT64_MAX, u64UntilFastMonoClock);
+}
+bool __MCFCRT_MopthreadDetach(uintptr_t uTid){
+	bool bSuccess = false;
+
+	MopthreadControl *const restrict pControl = LockControl(uTid);
+	if(pControl){
+		switch(TransitState(pControl, g_aeTransitionsOnDetach)){
+		case kStateJoinable:
+		case kStateZombie:
+			DropControlRef(pControl);
+			bSuccess = true;
+			break;
+		case kStateJoining:
+		case kStateJoined:
+		case kStateDetached:
+			break;
+		default:
+			_MCFCRT_ASSERT(false);
+		}
+		DropControlRef(pControl);
 	}
-	_MCFCRT_SignalMutex(&g_mtxControl);
 
 	return bSuccess;
 }
@@ -339,31 +902,23 @@ const _MCFCRT_ThreadHandle *__MCFCRT_MopthreadLockHandle(uintptr_t uTid){
 	}
 
 	// Increment the reference count and return a real handle.
-	const _MCFCRT_ThreadHandle *phThread = _MCFCRT_NULLPTR;
-
-	_MCFCRT_WaitForMutexForever(&g_mtxControl, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
-	{
-		MopthreadControl *const restrict pControl = (MopthreadControl *)_MCFCRT_AvlFind(&g_avlControlMap, (intptr_t)uTid, &MopthreadControlComparatorNodeOther);
-		if(pControl){
-			switch(pControl->eState){
-			case kStateJoinable:
-			case kStateZombie:
-			case kStateJoining:
-				_MCFCRT_ASSERT(pControl->uRefCount > 0);
-				++(pControl->uRefCount);
-				phThread = &(pControl->hThread);
-				break;
-			case kStateJoined:
-			case kStateDetached:
-				break;
-			default:
-				_MCFCRT_ASSERT(false);
-			}
-		}
+	MopthreadControl *const restrict pControl = LockControl(uTid);
+	if(!pControl){
+		return _MCFCRT_NULLPTR;
 	}
-	_MCFCRT_SignalMutex(&g_mtxControl);
-
-	return phThread;
+	switch(__atomic_load_n(&(pControl->eState), __ATOMIC_RELAXED)){
+	case kStateJoinable:
+	case kStateZombie:
+	case kStateJoining:
+		return &(pControl->hThread);
+	case kStateJoined:
+	case kStateDetached:
+		break;
+	default:
+		_MCFCRT_ASSERT(false);
+	}
+	DropControlRef(pControl);
+	return _MCFCRT_NULLPTR;
 }
 void __MCFCRT_MopthreadUnlockHandle(const _MCFCRT_ThreadHandle *phThread){
 	if(!phThread){
@@ -375,11 +930,7 @@ void __MCFCRT_MopthreadUnlockHandle(const _MCFCRT_ThreadHandle *phThread){
 		return;
 	}
 
-	_MCFCRT_WaitForMutexForever(&g_mtxControl, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
-	{
-		MopthreadControl *const restrict pControl = (void *)((char *)phThread - __builtin_offsetof(MopthreadControl, hThread));
-		_MCFCRT_ASSERT(pControl);
-		DropControlRefUnsafe(pControl);
-	}
-	_MCFCRT_SignalMutex(&g_mtxControl);
+	MopthreadControl *const restrict pControl = (void *)((char *)phThread - __builtin_offsetof(MopthreadControl, hThread));
+	_MCFCRT_ASSERT(pControl);
+	DropControlRef(pControl);
 }
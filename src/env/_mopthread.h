@@ -7,6 +7,7 @@
 
 #include "_crtdef.h"
 #include "thread.h"
+#include "stop_token.h"
 
 _MCFCRT_EXTERN_C_BEGIN
 
@@ -18,11 +19,41 @@ extern void __MCFCRT_MopthreadUninit(void) _MCFCRT_NOEXCEPT;
 // The parameter of the thread procedure will point to a copy of the memory block that __pParams and __uSize define.
 extern _MCFCRT_STD uintptr_t __MCFCRT_MopthreadCreate(void (*__pfnProc)(void *), const void *__pParams, _MCFCRT_STD size_t __uSizeOfParams) _MCFCRT_NOEXCEPT;
 extern _MCFCRT_STD uintptr_t __MCFCRT_MopthreadCreateDetached(void (*__pfnProc)(void *), const void *__pParams, _MCFCRT_STD size_t __uSizeOfParams) _MCFCRT_NOEXCEPT;
+// If `__pAttributes` is a null pointer, this function is the same as `__MCFCRT_MopthreadCreate()`. Otherwise, the attributes are applied before the thread is resumed.
+extern _MCFCRT_STD uintptr_t __MCFCRT_MopthreadCreateWithAttributes(void (*__pfnProc)(void *), const void *__pParams, _MCFCRT_STD size_t __uSizeOfParams, const _MCFCRT_ThreadAttributes *__pAttributes) _MCFCRT_NOEXCEPT;
+// This function creates `__uCount` joinable threads, all of which run `__pfnProc`, with one allocation for all their control blocks.
+// `__pParams` points to an array of `__uCount` blocks of `__uSizeOfParams` bytes, one for each thread, or is a null pointer, in which case all parameters are zeroed.
+// `__pAttributes` may be a null pointer. All threads are created suspended and resumed after all of them have been created.
+// On success, their thread IDs are stored into `__puTids` and `true` is returned. Otherwise, no thread is created and `false` is returned.
+extern bool __MCFCRT_MopthreadCreateMany(_MCFCRT_STD uintptr_t *_MCFCRT_RESTRICT __puTids, _MCFCRT_STD size_t __uCount, void (*__pfnProc)(void *), const void *__pParams, _MCFCRT_STD size_t __uSizeOfParams, const _MCFCRT_ThreadAttributes *__pAttributes) _MCFCRT_NOEXCEPT;
 __attribute__((__noreturn__))
 extern void __MCFCRT_MopthreadExit(void (*__pfnModifier)(void *, _MCFCRT_STD size_t, _MCFCRT_STD intptr_t), _MCFCRT_STD intptr_t __nContext) _MCFCRT_NOEXCEPT;
 extern bool __MCFCRT_MopthreadJoin(_MCFCRT_STD uintptr_t __uTid, void *_MCFCRT_RESTRICT __pParams, _MCFCRT_STD size_t *_MCFCRT_RESTRICT __puSizeOfParams) _MCFCRT_NOEXCEPT;
+// This function is the same as `__MCFCRT_MopthreadJoin()`, except that it also fails if a stop is requested on `__pStopToken` before the thread terminates,
+// in which case the thread remains joinable. Call `_MCFCRT_IsStopRequested()` to tell that from other failures.
+extern bool __MCFCRT_MopthreadJoinOrStop(_MCFCRT_STD uintptr_t __uTid, void *_MCFCRT_RESTRICT __pParams, _MCFCRT_STD size_t *_MCFCRT_RESTRICT __puSizeOfParams, _MCFCRT_StopToken *__pStopToken) _MCFCRT_NOEXCEPT;
 extern bool __MCFCRT_MopthreadDetach(_MCFCRT_STD uintptr_t __uTid) _MCFCRT_NOEXCEPT;
 
+// These functions join threads in `__puTids` at once. Zero IDs and the ID of the calling thread are ignored. IDs of threads that have been joined are set to zero,
+// and IDs of threads that can't be joined are left intact. `__pfnCallback` may be a null pointer. Otherwise, it is called for each thread that has been joined,
+// with its index in `__puTids` and its parameters, which are only valid during the call. Pass `UINT64_MAX` as `__u64UntilFastMonoClock` to wait forever.
+// `__MCFCRT_MopthreadJoinAll()` waits for all threads, and returns `false` if it has timed out, in which case threads that are still running remain joinable.
+// `__MCFCRT_MopthreadJoinAny()` waits for any one of them, sets `*__puIndexJoined` to its index, or `SIZE_MAX` if none of them can be joined,
+// and returns `false` if it has timed out. Other threads that terminate while it is giving them up are joined as well, in which case
+// the callback is called for each of them, but `*__puIndexJoined` is set to the index of the first one.
+typedef void (*__MCFCRT_MopthreadJoinCallback)(_MCFCRT_STD intptr_t __nContext, _MCFCRT_STD size_t __uIndex, const void *__pParams, _MCFCRT_STD size_t __uSizeOfParams);
+
+extern bool __MCFCRT_MopthreadJoinAll(_MCFCRT_STD uintptr_t *_MCFCRT_RESTRICT __puTids, _MCFCRT_STD size_t __uCount, __MCFCRT_MopthreadJoinCallback __pfnCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern bool __MCFCRT_MopthreadJoinAny(_MCFCRT_STD uintptr_t *_MCFCRT_RESTRICT __puTids, _MCFCRT_STD size_t __uCount, _MCFCRT_STD size_t *_MCFCRT_RESTRICT __puIndexJoined, __MCFCRT_MopthreadJoinCallback __pfnCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+
+// Threads whose procedures return may be kept for reuse by later calls to `__MCFCRT_MopthreadCreate()` and `__MCFCRT_MopthreadCreateDetached()`, up to the capacity of the cache.
+// Threads created with attributes are never cached. The priority, the group affinity and the ideal processor of a thread are restored to those
+// it had when it started before it is cached, and a thread whose attributes can't be restored exits instead.
+// A reused thread keeps its thread ID. Thread-local storage is destroyed before a cached thread can be joined, like a thread that has exited,
+// but `DLL_THREAD_DETACH` and `DLL_THREAD_ATTACH` notifications are not sent to other modules in between, so it is disabled (zero) by default.
+// Threads that call `__MCFCRT_MopthreadExit()` are never cached. This function returns the old capacity.
+extern _MCFCRT_STD size_t __MCFCRT_MopthreadSetCacheCapacity(_MCFCRT_STD size_t __uCapacity) _MCFCRT_NOEXCEPT;
+
 // Returns a pointer to a HANDLE, which is a pseudo handle if __uTid refers the calling thread, or NULL on failure.
 // The returned pointer must be unlocked.
 extern const _MCFCRT_ThreadHandle *__MCFCRT_MopthreadLockHandle(_MCFCRT_STD uintptr_t __uTid) _MCFCRT_NOEXCEPT;
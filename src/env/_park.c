@@ -0,0 +1,682 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#include "_park.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__))
+extern NTSTATUS NtWaitForKeyedEvent(HANDLE hKeyedEvent, void *pKey, BOOLEAN bAlertable, const LARGE_INTEGER *pliTimeout);
+__attribute__((__dllimport__, __stdcall__))
+extern NTSTATUS NtReleaseKeyedEvent(HANDLE hKeyedEvent, void *pKey, BOOLEAN bAlertable, const LARGE_INTEGER *pliTimeout);
+
+__attribute__((__dllimport__, __stdcall__))
+extern NTSTATUS NtQuerySystemTime(LARGE_INTEGER *pliTime);
+
+// These are not available on Windows 7, hence looked up at runtime.
+typedef NTSTATUS (__attribute__((__stdcall__)) *RtlWaitOnAddressProc)(volatile void *pAddress, void *pCompare, size_t uSize, const LARGE_INTEGER *pliTimeout);
+typedef void (__attribute__((__stdcall__)) *RtlWakeAddressSingleProc)(void *pAddress);
+
+static RtlWaitOnAddressProc g_pfnRtlWaitOnAddress = _MCFCRT_NULLPTR;
+static RtlWakeAddressSingleProc g_pfnRtlWakeAddressSingle = _MCFCRT_NULLPTR;
+
+static __MCFCRT_ParkBackend g_eBackend = __MCFCRT_kParkBackendKeyedEvent;
+
+// Keys are hashed into buckets, each of which holds a queue of parked threads.
+// If a thread is unparked before it parks, the wakeup is saved in its bucket and consumed by the next thread that parks on the same key.
+// Each bucket has a fixed number of records for saved wakeups, which are reused once they are vacant. See `__MCFCRT_UnparkThreads()` for what happens if all of them are in use.
+// A thread that has been dequeued is woken up with the backend only if it has committed to sleeping, which is decided by a handshake on its node.
+// With keyed events, the wakeup is released with a zero timeout, so it is dropped rather than waited for if the thread has been preempted before it started waiting.
+// Such a thread will find its node woken at the end of its current slice of sleep. See `SleepOnNode()`.
+// When multiple threads are unparked at once, only the first one is woken up by the caller, then each woken thread wakes up the next one,
+// so the cost of waking them up is paid by the threads themselves.
+#define BUCKET_COUNT                256u
+#define PENDING_WAKEUPS_PER_BUCKET  4u
+// With keyed events, contention on a bucket is resolved by spinning and then sleeping on the keyed event.
+#define BUCKET_SPIN_COUNT           100u
+#define BUCKET_LOCKED               ((LONG)1)
+#define BUCKET_SLEEPER_ONE          ((LONG)2)
+// With keyed events, threads sleep in slices, starting with the shorter one and doubling up to the longer one, so a dropped wakeup delays them for at most one slice.
+#define SLEEP_SLICE_MIN_MS          1u
+#define SLEEP_SLICE_MAX_MS          256u
+// This is the maximum number of threads that `__MCFCRT_UnparkTaggedThreads()` dequeues before it unlocks the bucket to wake them up.
+#define UNPARK_BATCH_SIZE           32u
+
+typedef enum tagNodeState {
+	kNodeQueued   = 0,
+	kNodeWoken    = 1,
+	// The thread is sleeping or is about to sleep on the keyed event, so it has to be released explicitly.
+	kNodeSleeping = 2,
+} NodeState;
+
+typedef struct tagParkNode {
+	struct tagParkNode *pNext;
+	void *pKey;
+	volatile LONG lState;
+	// This is the number of threads that this thread has to unpark after it is woken up.
+	size_t uCascade;
+	// If the callback returns `true`, this thread is moved to the other key instead of being woken up.
+	void *pRequeueKey;
+	__MCFCRT_ParkRequeueCallback pfnRequeueCallback;
+	// This is set if the node has been dequeued by `__MCFCRT_InterruptParkedThread()` rather than unparked.
+	bool bInterrupted;
+	// This is only used by the parking lot.
+	intptr_t nTag;
+} ParkNode;
+
+// A record is vacant if its key is a null pointer.
+typedef struct tagPendingWakeup {
+	void *pKey;
+	size_t uCount;
+} PendingWakeup;
+
+// If all records of a bucket are in use, the unparking thread carries its wakeups in a donor on its own stack, and sleeps on the node of the donor until they have been consumed.
+typedef struct tagWakeupDonor {
+	struct tagWakeupDonor *pNext;
+	PendingWakeup vPending;
+	ParkNode vNode;
+} WakeupDonor;
+
+typedef struct tagParkBucket {
+	// With keyed events: the lowest bit is the lock bit, and the others are the number of threads sleeping on the keyed event.
+	// With `RtlWaitOnAddress()`: 0: unlocked; 1: locked; 2: locked with threads waiting for it on the address.
+	__attribute__((__aligned__(64))) volatile LONG lLock;
+	ParkNode *pFirst;
+	ParkNode *pLast;
+	PendingWakeup aPending[PENDING_WAKEUPS_PER_BUCKET];
+	WakeupDonor *pFirstDonor;
+} ParkBucket;
+
+static ParkBucket g_aBuckets[BUCKET_COUNT];
+
+static inline ParkBucket *GetBucket(void *pKey){
+	const size_t uHash = (size_t)((uintptr_t)pKey / 2 * 0x9E3779B9u);
+	return g_aBuckets + (uHash >> 8) % BUCKET_COUNT;
+}
+
+static inline void LockBucket(ParkBucket *pBucket){
+	LONG lOld = 0;
+	if(_MCFCRT_EXPECT(__atomic_compare_exchange_n(&(pBucket->lLock), &lOld, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))){
+		return;
+	}
+	if(g_eBackend == __MCFCRT_kParkBackendKeyedEvent){
+		size_t uSpinCount = 0;
+		for(;;){
+			if(!(lOld & BUCKET_LOCKED)){
+				if(__atomic_compare_exchange_n(&(pBucket->lLock), &lOld, lOld | BUCKET_LOCKED, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+					return;
+				}
+				continue;
+			}
+			if(uSpinCount < BUCKET_SPIN_COUNT){
+				++uSpinCount;
+				__builtin_ia32_pause();
+				lOld = __atomic_load_n(&(pBucket->lLock), __ATOMIC_RELAXED);
+				continue;
+			}
+			// Sleep, so a preempted owner can run even if it has a lower priority.
+			if(!__atomic_compare_exchange_n(&(pBucket->lLock), &lOld, lOld + BUCKET_SLEEPER_ONE, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+				continue;
+			}
+			// The wakeup is dropped if it is released before we start waiting, so sleep for only one slice before trying again.
+			LARGE_INTEGER liSlice;
+			liSlice.QuadPart = -(LONGLONG)SLEEP_SLICE_MIN_MS * 10000;
+			NTSTATUS lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, (void *)&(pBucket->lLock), false, &liSlice);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+			lOld = __atomic_sub_fetch(&(pBucket->lLock), BUCKET_SLEEPER_ONE, __ATOMIC_RELAXED);
+			uSpinCount = 0;
+		}
+	}
+	if(lOld != 2){
+		lOld = __atomic_exchange_n(&(pBucket->lLock), 2, __ATOMIC_ACQUIRE);
+	}
+	while(lOld != 0){
+		LONG lCompare = 2;
+		NTSTATUS lStatus = (*g_pfnRtlWaitOnAddress)(&(pBucket->lLock), &lCompare, sizeof(lCompare), _MCFCRT_NULLPTR);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"RtlWaitOnAddress() failed.");
+		lOld = __atomic_exchange_n(&(pBucket->lLock), 2, __ATOMIC_ACQUIRE);
+	}
+}
+static inline void UnlockBucket(ParkBucket *pBucket){
+	if(g_eBackend == __MCFCRT_kParkBackendKeyedEvent){
+		const LONG lOld = __atomic_fetch_and(&(pBucket->lLock), ~BUCKET_LOCKED, __ATOMIC_RELEASE);
+		if(_MCFCRT_EXPECT_NOT(lOld >= BUCKET_SLEEPER_ONE)){
+			// This never waits. If no thread is waiting on the keyed event yet, the wakeup is dropped, and the sleeping thread tries again after its slice.
+			LARGE_INTEGER liTimeout;
+			liTimeout.QuadPart = 0;
+			NTSTATUS lStatus = NtReleaseKeyedEvent(_MCFCRT_NULLPTR, (void *)&(pBucket->lLock), false, &liTimeout);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtReleaseKeyedEvent() failed.");
+		}
+		return;
+	}
+	const LONG lOld = __atomic_exchange_n(&(pBucket->lLock), 0, __ATOMIC_RELEASE);
+	if(_MCFCRT_EXPECT_NOT(lOld == 2)){
+		(*g_pfnRtlWakeAddressSingle)((void *)&(pBucket->lLock));
+	}
+}
+
+// Pass a null pointer as `pKey` to find a vacant record. Donors are never vacant.
+static inline PendingWakeup *FindPendingWakeup(ParkBucket *pBucket, void *pKey, WakeupDonor **ppDonor){
+	for(size_t uIndex = 0; uIndex < PENDING_WAKEUPS_PER_BUCKET; ++uIndex){
+		PendingWakeup *const pPending = pBucket->aPending + uIndex;
+		if(pPending->pKey == pKey){
+			*ppDonor = _MCFCRT_NULLPTR;
+			return pPending;
+		}
+	}
+	for(WakeupDonor *pDonor = pBucket->pFirstDonor; pDonor; pDonor = pDonor->pNext){
+		if(pDonor->vPending.pKey == pKey){
+			*ppDonor = pDonor;
+			return &(pDonor->vPending);
+		}
+	}
+	return _MCFCRT_NULLPTR;
+}
+// If the last wakeup of a donor is consumed, the donor is removed from the bucket, and its node is returned in `*ppDonorNode`.
+// It must be woken up with `WakeDonor()` after the bucket is unlocked.
+static inline bool ConsumePendingWakeup(ParkBucket *pBucket, void *pKey, ParkNode **ppDonorNode){
+	*ppDonorNode = _MCFCRT_NULLPTR;
+	WakeupDonor *pDonor;
+	PendingWakeup *const pPending = FindPendingWakeup(pBucket, pKey, &pDonor);
+	if(!pPending){
+		return false;
+	}
+	if(--(pPending->uCount) == 0){
+		pPending->pKey = _MCFCRT_NULLPTR;
+		if(pDonor){
+			WakeupDonor **ppPrev = &(pBucket->pFirstDonor);
+			while(*ppPrev != pDonor){
+				ppPrev = &((*ppPrev)->pNext);
+			}
+			*ppPrev = pDonor->pNext;
+			*ppDonorNode = &(pDonor->vNode);
+		}
+	}
+	return true;
+}
+// Returns `false` if all records are in use by other keys.
+static inline bool SavePendingWakeups(ParkBucket *pBucket, void *pKey, size_t uCount){
+	WakeupDonor *pDonor;
+	PendingWakeup *pPending = FindPendingWakeup(pBucket, pKey, &pDonor);
+	if(pPending){
+		pPending->uCount += uCount;
+		return true;
+	}
+	pPending = FindPendingWakeup(pBucket, _MCFCRT_NULLPTR, &pDonor);
+	if(!pPending){
+		return false;
+	}
+	pPending->pKey = pKey;
+	pPending->uCount = uCount;
+	return true;
+}
+
+static inline void PushNode(ParkBucket *pBucket, ParkNode *pNode){
+	pNode->pNext = _MCFCRT_NULLPTR;
+	if(pBucket->pLast){
+		pBucket->pLast->pNext = pNode;
+	} else {
+		pBucket->pFirst = pNode;
+	}
+	pBucket->pLast = pNode;
+}
+static inline ParkNode *PopNode(ParkBucket *pBucket, void *pKey, ParkNode *pNodeToRemove){
+	ParkNode *pPrev = _MCFCRT_NULLPTR;
+	for(ParkNode *pNode = pBucket->pFirst; pNode; pNode = pNode->pNext){
+		if(pNodeToRemove ? (pNode == pNodeToRemove) : (pNode->pKey == pKey)){
+			if(pPrev){
+				pPrev->pNext = pNode->pNext;
+			} else {
+				pBucket->pFirst = pNode->pNext;
+			}
+			if(pBucket->pLast == pNode){
+				pBucket->pLast = pPrev;
+			}
+			return pNode;
+		}
+		pPrev = pNode;
+	}
+	return _MCFCRT_NULLPTR;
+}
+
+// Returns `false` if the operation has timed out, in which case the node may or may not have been woken up.
+static inline bool SleepOnNode(ParkNode *pNode, const LARGE_INTEGER *pliTimeout){
+	// Both backends may return spuriously, so relative timeouts are converted to absolute ones, which are not affected by restarts.
+	LARGE_INTEGER liDeadline;
+	const LARGE_INTEGER *pliDeadline = _MCFCRT_NULLPTR;
+	if(pliTimeout){
+		if(pliTimeout->QuadPart < 0){
+			NtQuerySystemTime(&liDeadline);
+			liDeadline.QuadPart -= pliTimeout->QuadPart;
+		} else {
+			liDeadline.QuadPart = pliTimeout->QuadPart;
+		}
+		pliDeadline = &liDeadline;
+	}
+	if(g_eBackend == __MCFCRT_kParkBackendKeyedEvent){
+		LONG lOld = kNodeQueued;
+		if(!__atomic_compare_exchange_n(&(pNode->lState), &lOld, kNodeSleeping, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)){
+			// We have been woken up before going to sleep.
+			return true;
+		}
+		// A wakeup that is released before we start waiting is dropped, but the node is marked woken anyway, so sleep in slices and check it after each one.
+		// Wakeups that are released too late for a previous node at the same address are absorbed here as well.
+		LONGLONG llSliceMs = SLEEP_SLICE_MIN_MS;
+		for(;;){
+			LARGE_INTEGER liSlice;
+			liSlice.QuadPart = -llSliceMs * 10000;
+			bool bLastSlice = false;
+			if(pliDeadline){
+				LARGE_INTEGER liNow;
+				NtQuerySystemTime(&liNow);
+				if(pliDeadline->QuadPart - liNow.QuadPart <= -liSlice.QuadPart){
+					liSlice = *pliDeadline;
+					bLastSlice = true;
+				}
+			}
+			NTSTATUS lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, pNode, false, &liSlice);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+			if(__atomic_load_n(&(pNode->lState), __ATOMIC_ACQUIRE) == kNodeWoken){
+				return true;
+			}
+			if((lStatus == STATUS_TIMEOUT) && bLastSlice){
+				return false;
+			}
+			if(llSliceMs < SLEEP_SLICE_MAX_MS){
+				llSliceMs *= 2;
+			}
+		}
+	}
+	for(;;){
+		if(__atomic_load_n(&(pNode->lState), __ATOMIC_ACQUIRE) == kNodeWoken){
+			return true;
+		}
+		LONG lCompare = kNodeQueued;
+		NTSTATUS lStatus = (*g_pfnRtlWaitOnAddress)(&(pNode->lState), &lCompare, sizeof(lCompare), pliDeadline);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"RtlWaitOnAddress() failed.");
+		if(lStatus == STATUS_TIMEOUT){
+			return false;
+		}
+	}
+}
+// The node may go out of scope once it is marked woken, so this function takes the value returned by `MarkNodeWoken()`.
+static inline LONG MarkNodeWoken(ParkNode *pNode){
+	return __atomic_exchange_n(&(pNode->lState), kNodeWoken, __ATOMIC_RELEASE);
+}
+static inline void WakeNode(ParkNode *pNode, LONG lOldState){
+	if(g_eBackend == __MCFCRT_kParkBackendKeyedEvent){
+		if(lOldState != kNodeSleeping){
+			// The thread will see the node woken and will not sleep.
+			return;
+		}
+		// This never waits. If the thread has not started waiting yet, the wakeup is dropped, and the thread will see the node woken at the end of its slice.
+		LARGE_INTEGER liTimeout;
+		liTimeout.QuadPart = 0;
+		NTSTATUS lStatus = NtReleaseKeyedEvent(_MCFCRT_NULLPTR, pNode, false, &liTimeout);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtReleaseKeyedEvent() failed.");
+		return;
+	}
+	// Waking an address that is no longer waited for is harmless.
+	(*g_pfnRtlWakeAddressSingle)((void *)&(pNode->lState));
+}
+// A donor has been removed from its bucket, so nothing else refers to it.
+static inline void WakeDonor(ParkNode *pDonorNode){
+	if(pDonorNode){
+		WakeNode(pDonorNode, MarkNodeWoken(pDonorNode));
+	}
+}
+
+// This is called after a node has been popped from the queue of its old key.
+static inline void RequeueNode(ParkNode *pNode){
+	void *const pKey = pNode->pRequeueKey;
+	pNode->pKey = pKey;
+	pNode->pRequeueKey = _MCFCRT_NULLPTR;
+	pNode->pfnRequeueCallback = _MCFCRT_NULLPTR;
+	ParkBucket *const pBucket = GetBucket(pKey);
+	LockBucket(pBucket);
+	ParkNode *pDonorNode;
+	if(ConsumePendingWakeup(pBucket, pKey, &pDonorNode)){
+		const LONG lOldState = MarkNodeWoken(pNode);
+		UnlockBucket(pBucket);
+		WakeNode(pNode, lOldState);
+		WakeDonor(pDonorNode);
+		return;
+	}
+	PushNode(pBucket, pNode);
+	UnlockBucket(pBucket);
+}
+
+static bool IsKeyedEventForced(void){
+	static const wchar_t kForced[] = L"KeyedEvent";
+	wchar_t awcValue[32];
+	const DWORD dwLength = GetEnvironmentVariableW(L"MCFGTHREAD_PARK_BACKEND", awcValue, sizeof(awcValue) / sizeof(awcValue[0]));
+	if(dwLength != sizeof(kForced) / sizeof(kForced[0]) - 1){
+		return false;
+	}
+	for(size_t uIndex = 0; uIndex < dwLength; ++uIndex){
+		if(awcValue[uIndex] != kForced[uIndex]){
+			return false;
+		}
+	}
+	return true;
+}
+
+bool __MCFCRT_ParkInit(void){
+	if(IsKeyedEventForced()){
+		return true;
+	}
+	const HMODULE hNtdll = GetModuleHandleW(L"NTDLL.DLL");
+	if(!hNtdll){
+		return true;
+	}
+	const RtlWaitOnAddressProc pfnRtlWaitOnAddress = (RtlWaitOnAddressProc)(void (*)(void))GetProcAddress(hNtdll, "RtlWaitOnAddress");
+	const RtlWakeAddressSingleProc pfnRtlWakeAddressSingle = (RtlWakeAddressSingleProc)(void (*)(void))GetProcAddress(hNtdll, "RtlWakeAddressSingle");
+	if(!pfnRtlWaitOnAddress || !pfnRtlWakeAddressSingle){
+		// Fall back to keyed events on Windows 7.
+		return true;
+	}
+	// No thread can be parked before the library has been initialized, so it is safe to switch now.
+	g_pfnRtlWaitOnAddress = pfnRtlWaitOnAddress;
+	g_pfnRtlWakeAddressSingle = pfnRtlWakeAddressSingle;
+	g_eBackend = __MCFCRT_kParkBackendWaitOnAddress;
+	return true;
+}
+void __MCFCRT_ParkUninit(void){
+}
+
+__MCFCRT_ParkBackend __MCFCRT_GetParkBackend(void){
+	return g_eBackend;
+}
+
+// The interrupt is detached from the node with the bucket locked, after which the node may go out of scope.
+static inline void DetachInterrupt(ParkBucket *pBucket, __MCFCRT_ParkInterrupt *pInterrupt){
+	if(!pInterrupt){
+		return;
+	}
+	LockBucket(pBucket);
+	pInterrupt->__pNode = _MCFCRT_NULLPTR;
+	__atomic_store_n(&(pInterrupt->__pKey), _MCFCRT_NULLPTR, __ATOMIC_RELAXED);
+	UnlockBucket(pBucket);
+}
+
+__attribute__((__always_inline__))
+static inline NTSTATUS ReallyParkThread(void *pKey, const LARGE_INTEGER *pliTimeout, void *pRequeueKey, __MCFCRT_ParkRequeueCallback pfnRequeueCallback, __MCFCRT_ParkInterrupt *pInterrupt){
+	_MCFCRT_ASSERT(((uintptr_t)pKey & 1) == 0);
+
+	ParkBucket *const pBucket = GetBucket(pKey);
+	if(pInterrupt){
+		// This store and the load of `__bInterrupted` below are ordered against their counterparts in `__MCFCRT_InterruptParkedThread()`,
+		// so either we see the interrupt here, or the interrupting thread sees our key and finds our node in the bucket.
+		__atomic_store_n(&(pInterrupt->__pKey), pKey, __ATOMIC_SEQ_CST);
+	}
+	LockBucket(pBucket);
+	ParkNode *pDonorNode;
+	if(ConsumePendingWakeup(pBucket, pKey, &pDonorNode)){
+		UnlockBucket(pBucket);
+		WakeDonor(pDonorNode);
+		return STATUS_WAIT_0;
+	}
+	if((pliTimeout && (pliTimeout->QuadPart == 0)) || (pInterrupt && __atomic_load_n(&(pInterrupt->__bInterrupted), __ATOMIC_SEQ_CST))){
+		UnlockBucket(pBucket);
+		return STATUS_TIMEOUT;
+	}
+	ParkNode vNode;
+	vNode.pKey = pKey;
+	vNode.lState = kNodeQueued;
+	vNode.uCascade = 0;
+	vNode.pRequeueKey = pRequeueKey;
+	vNode.pfnRequeueCallback = pfnRequeueCallback;
+	vNode.bInterrupted = false;
+	PushNode(pBucket, &vNode);
+	if(pInterrupt){
+		pInterrupt->__pNode = &vNode;
+	}
+	UnlockBucket(pBucket);
+
+	if(_MCFCRT_EXPECT_NOT(!SleepOnNode(&vNode, pliTimeout))){
+		// Threads that may be requeued can't time out, since we wouldn't know which bucket to lock.
+		_MCFCRT_ASSERT(!pfnRequeueCallback);
+		LockBucket(pBucket);
+		if(__atomic_load_n(&(vNode.lState), __ATOMIC_RELAXED) != kNodeWoken){
+			PopNode(pBucket, pKey, &vNode);
+			if(pInterrupt){
+				pInterrupt->__pNode = _MCFCRT_NULLPTR;
+			}
+			UnlockBucket(pBucket);
+			return STATUS_TIMEOUT;
+		}
+		// We have been dequeued by another thread, so this is not a timeout.
+		UnlockBucket(pBucket);
+	}
+	_MCFCRT_ASSERT(__atomic_load_n(&(vNode.lState), __ATOMIC_ACQUIRE) == kNodeWoken);
+	DetachInterrupt(pBucket, pInterrupt);
+	if(vNode.bInterrupted){
+		// No wakeup has been consumed, so this is reported as a timeout.
+		return STATUS_TIMEOUT;
+	}
+	// Pass on wakeups that have been handed over to us.
+	if(vNode.uCascade != 0){
+		__MCFCRT_UnparkThreads(vNode.pKey, vNode.uCascade);
+	}
+	return STATUS_WAIT_0;
+}
+
+static inline bool HasNode(ParkBucket *pBucket, void *pKey){
+	for(ParkNode *pNode = pBucket->pFirst; pNode; pNode = pNode->pNext){
+		if(pNode->pKey == pKey){
+			return true;
+		}
+	}
+	return false;
+}
+
+NTSTATUS __MCFCRT_ParkThread(void *pKey, const LARGE_INTEGER *pliTimeout){
+	return ReallyParkThread(pKey, pliTimeout, _MCFCRT_NULLPTR, _MCFCRT_NULLPTR, _MCFCRT_NULLPTR);
+}
+void __MCFCRT_ParkThreadRequeueable(void *pKey, void *pRequeueKey, __MCFCRT_ParkRequeueCallback pfnRequeueCallback){
+	_MCFCRT_ASSERT(((uintptr_t)pRequeueKey & 1) == 0);
+
+	const NTSTATUS lStatus = ReallyParkThread(pKey, _MCFCRT_NULLPTR, pRequeueKey, pfnRequeueCallback, _MCFCRT_NULLPTR);
+	_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+}
+
+void __MCFCRT_InitializeParkInterrupt(__MCFCRT_ParkInterrupt *pInterrupt){
+	pInterrupt->__pKey = _MCFCRT_NULLPTR;
+	pInterrupt->__pNode = _MCFCRT_NULLPTR;
+	pInterrupt->__bInterrupted = false;
+}
+NTSTATUS __MCFCRT_ParkThreadInterruptible(void *pKey, const LARGE_INTEGER *pliTimeout, __MCFCRT_ParkInterrupt *pInterrupt){
+	return ReallyParkThread(pKey, pliTimeout, _MCFCRT_NULLPTR, _MCFCRT_NULLPTR, pInterrupt);
+}
+void __MCFCRT_InterruptParkedThread(__MCFCRT_ParkInterrupt *pInterrupt){
+	__atomic_store_n(&(pInterrupt->__bInterrupted), true, __ATOMIC_SEQ_CST);
+	void *const pKey = __atomic_load_n(&(pInterrupt->__pKey), __ATOMIC_SEQ_CST);
+	if(!pKey){
+		return;
+	}
+	ParkBucket *const pBucket = GetBucket(pKey);
+	LockBucket(pBucket);
+	// The thread might have moved on to another key, in which case it will see the interrupt when it parks there.
+	// Otherwise, its node is only attached and detached with this bucket locked.
+	if(__atomic_load_n(&(pInterrupt->__pKey), __ATOMIC_RELAXED) != pKey){
+		UnlockBucket(pBucket);
+		return;
+	}
+	ParkNode *const pNode = pInterrupt->__pNode;
+	if(!pNode || (__atomic_load_n(&(pNode->lState), __ATOMIC_RELAXED) == kNodeWoken)){
+		UnlockBucket(pBucket);
+		return;
+	}
+	PopNode(pBucket, pKey, pNode);
+	pNode->bInterrupted = true;
+	const LONG lOldState = MarkNodeWoken(pNode);
+	UnlockBucket(pBucket);
+	WakeNode(pNode, lOldState);
+}
+void __MCFCRT_InterruptParkedThreadOnStop(intptr_t nContext){
+	__MCFCRT_InterruptParkedThread((__MCFCRT_ParkInterrupt *)nContext);
+}
+NTSTATUS __MCFCRT_UnparkThread(void *pKey){
+	return __MCFCRT_UnparkThreads(pKey, 1);
+}
+NTSTATUS __MCFCRT_UnparkThreads(void *pKey, size_t uCount){
+	_MCFCRT_ASSERT(((uintptr_t)pKey & 1) == 0);
+
+	if(uCount == 0){
+		return STATUS_WAIT_0;
+	}
+	ParkBucket *const pBucket = GetBucket(pKey);
+	for(;;){
+		LockBucket(pBucket);
+		ParkNode *const pNode = PopNode(pBucket, pKey, _MCFCRT_NULLPTR);
+		if(pNode){
+			if(pNode->pfnRequeueCallback && (*(pNode->pfnRequeueCallback))(pNode->pRequeueKey)){
+				// The thread would block again as soon as it was woken up, so move it without waking it up.
+				UnlockBucket(pBucket);
+				RequeueNode(pNode);
+				if(--uCount == 0){
+					break;
+				}
+				continue;
+			}
+			pNode->uCascade = uCount - 1;
+			const LONG lOldState = MarkNodeWoken(pNode);
+			UnlockBucket(pBucket);
+			WakeNode(pNode, lOldState);
+			break;
+		}
+		if(SavePendingWakeups(pBucket, pKey, uCount)){
+			UnlockBucket(pBucket);
+			break;
+		}
+		// More keys in this bucket have been unparked ahead of their waiters than there are records. This requires as many threads to have been
+		// preempted between deciding to park and parking, so it is rare. Carry the wakeups on our own stack, which can't fail,
+		// and wait for the threads that are about to park to consume them, which they are committed to do.
+		WakeupDonor vDonor;
+		vDonor.vPending.pKey = pKey;
+		vDonor.vPending.uCount = uCount;
+		vDonor.vNode.lState = kNodeQueued;
+		vDonor.pNext = pBucket->pFirstDonor;
+		pBucket->pFirstDonor = &vDonor;
+		UnlockBucket(pBucket);
+		const bool bWoken = SleepOnNode(&(vDonor.vNode), _MCFCRT_NULLPTR);
+		_MCFCRT_ASSERT(bWoken);
+		break;
+	}
+	return STATUS_WAIT_0;
+}
+
+__attribute__((__always_inline__))
+static inline __MCFCRT_ParkResult ReallyParkThreadIf(void *pKey, intptr_t nTag, __MCFCRT_ParkValidateCallback pfnValidate, intptr_t nContext, const LARGE_INTEGER *pliTimeout){
+	ParkBucket *const pBucket = GetBucket(pKey);
+	LockBucket(pBucket);
+	if(!(*pfnValidate)(nContext)){
+		UnlockBucket(pBucket);
+		return __MCFCRT_kParkResultInvalid;
+	}
+	if(pliTimeout && (pliTimeout->QuadPart == 0)){
+		UnlockBucket(pBucket);
+		return __MCFCRT_kParkResultTimedOut;
+	}
+	ParkNode vNode;
+	vNode.pKey = pKey;
+	vNode.lState = kNodeQueued;
+	vNode.uCascade = 0;
+	vNode.pRequeueKey = _MCFCRT_NULLPTR;
+	vNode.pfnRequeueCallback = _MCFCRT_NULLPTR;
+	vNode.bInterrupted = false;
+	vNode.nTag = nTag;
+	PushNode(pBucket, &vNode);
+	UnlockBucket(pBucket);
+
+	if(_MCFCRT_EXPECT_NOT(!SleepOnNode(&vNode, pliTimeout))){
+		LockBucket(pBucket);
+		if(__atomic_load_n(&(vNode.lState), __ATOMIC_RELAXED) != kNodeWoken){
+			PopNode(pBucket, pKey, &vNode);
+			UnlockBucket(pBucket);
+			return __MCFCRT_kParkResultTimedOut;
+		}
+		// We have been dequeued by another thread, so this is not a timeout.
+		UnlockBucket(pBucket);
+	}
+	_MCFCRT_ASSERT(__atomic_load_n(&(vNode.lState), __ATOMIC_ACQUIRE) == kNodeWoken);
+	return __MCFCRT_kParkResultWoken;
+}
+
+__MCFCRT_ParkResult __MCFCRT_ParkThreadIf(void *pKey, __MCFCRT_ParkValidateCallback pfnValidate, intptr_t nContext, const LARGE_INTEGER *pliTimeout){
+	return ReallyParkThreadIf(pKey, 0, pfnValidate, nContext, pliTimeout);
+}
+bool __MCFCRT_UnparkOneThread(void *pKey, __MCFCRT_UnparkCallback pfnCallback, intptr_t nContext){
+	ParkBucket *const pBucket = GetBucket(pKey);
+	LockBucket(pBucket);
+	ParkNode *const pNode = PopNode(pBucket, pKey, _MCFCRT_NULLPTR);
+	if(pfnCallback){
+		(*pfnCallback)(nContext, !!pNode, pNode && HasNode(pBucket, pKey));
+	}
+	if(!pNode){
+		UnlockBucket(pBucket);
+		return false;
+	}
+	const LONG lOldState = MarkNodeWoken(pNode);
+	UnlockBucket(pBucket);
+	WakeNode(pNode, lOldState);
+	return true;
+}
+size_t __MCFCRT_UnparkAllThreads(void *pKey){
+	// Only threads that have parked before this call are counted, so threads that park again after being woken up can't keep us here.
+	ParkBucket *const pBucket = GetBucket(pKey);
+	size_t uCountToSignal = 0;
+	LockBucket(pBucket);
+	for(ParkNode *pNode = pBucket->pFirst; pNode; pNode = pNode->pNext){
+		uCountToSignal += pNode->pKey == pKey;
+	}
+	UnlockBucket(pBucket);
+	size_t uCount = 0;
+	while((uCount < uCountToSignal) && __MCFCRT_UnparkOneThread(pKey, _MCFCRT_NULLPTR, 0)){
+		++uCount;
+	}
+	return uCount;
+}
+
+__MCFCRT_ParkResult __MCFCRT_ParkTaggedThreadIf(void *pKey, intptr_t nTag, __MCFCRT_ParkValidateCallback pfnValidate, intptr_t nContext, const LARGE_INTEGER *pliTimeout){
+	return ReallyParkThreadIf(pKey, nTag, pfnValidate, nContext, pliTimeout);
+}
+size_t __MCFCRT_UnparkTaggedThreads(void *pKey, __MCFCRT_UnparkFilterCallback pfnFilter, intptr_t nContext, size_t uMaxCount){
+	ParkBucket *const pBucket = GetBucket(pKey);
+	// Only as many threads as have been accepted by the filter initially are unparked, so threads that park again after being woken up can't keep us here.
+	size_t uCountToSignal = 0;
+	LockBucket(pBucket);
+	for(ParkNode *pNode = pBucket->pFirst; pNode && (uCountToSignal < uMaxCount); pNode = pNode->pNext){
+		uCountToSignal += (pNode->pKey == pKey) && (*pfnFilter)(nContext, pNode->nTag);
+	}
+	// Nodes are marked woken with the bucket locked, after which they may go out of scope, so only their old states are kept for waking them up.
+	ParkNode *apNodes[UNPARK_BATCH_SIZE];
+	LONG alOldStates[UNPARK_BATCH_SIZE];
+	size_t uCount = 0;
+	for(;;){
+		size_t uBatchCount = 0;
+		ParkNode *pNext;
+		for(ParkNode *pNode = pBucket->pFirst; pNode && (uCount + uBatchCount < uCountToSignal) && (uBatchCount < UNPARK_BATCH_SIZE); pNode = pNext){
+			pNext = pNode->pNext;
+			if((pNode->pKey != pKey) || !(*pfnFilter)(nContext, pNode->nTag)){
+				continue;
+			}
+			PopNode(pBucket, pKey, pNode);
+			apNodes[uBatchCount] = pNode;
+			alOldStates[uBatchCount] = MarkNodeWoken(pNode);
+			++uBatchCount;
+		}
+		UnlockBucket(pBucket);
+		for(size_t uIndex = 0; uIndex < uBatchCount; ++uIndex){
+			WakeNode(apNodes[uIndex], alOldStates[uIndex]);
+		}
+		uCount += uBatchCount;
+		if((uBatchCount < UNPARK_BATCH_SIZE) || (uCount >= uCountToSignal)){
+			break;
+		}
+		LockBucket(pBucket);
+	}
+	return uCount;
+}
@@ -0,0 +1,91 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_PARK_H_
+#define __MCFCRT_ENV_PARK_H_
+
+#include "_crtdef.h"
+#include "mcfwin.h"
+
+_MCFCRT_EXTERN_C_BEGIN
+
+typedef enum __MCFCRT_tagParkBackend {
+	__MCFCRT_kParkBackendKeyedEvent    = 1,
+	__MCFCRT_kParkBackendWaitOnAddress = 2,
+} __MCFCRT_ParkBackend;
+
+// The backend is selected once at startup. `RtlWaitOnAddress()` is preferred if it is available (Windows 8 and later),
+// unless the environment variable `MCFGTHREAD_PARK_BACKEND` is set to `KeyedEvent`.
+extern bool __MCFCRT_ParkInit(void) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ParkUninit(void) _MCFCRT_NOEXCEPT;
+
+extern __MCFCRT_ParkBackend __MCFCRT_GetParkBackend(void) _MCFCRT_NOEXCEPT;
+
+// These functions replace `NtWaitForKeyedEvent()` and `NtReleaseKeyedEvent()` on the global keyed event, and keys must be even likewise.
+// Each call to `__MCFCRT_UnparkThread()` wakes exactly one thread that has parked or will park on the same key.
+// Unlike `NtReleaseKeyedEvent()`, it doesn't wait for a thread that has not parked yet, unless so many keys sharing a bucket have been unparked ahead of their waiters
+// that the bucket has run out of records for saved wakeups, in which case it waits until one of those threads has parked.
+// `__MCFCRT_ParkThread()` returns `STATUS_TIMEOUT` if it has timed out, and `STATUS_WAIT_0` if it has been woken up.
+// `pliTimeout` has the same meaning as it does for `NtWaitForKeyedEvent()`, which is usually set up by `__MCFCRT_InitializeNtTimeout()`.
+extern NTSTATUS __MCFCRT_ParkThread(void *__pKey, const LARGE_INTEGER *__pliTimeout) _MCFCRT_NOEXCEPT;
+
+// This callback is called with the bucket of the old key locked, so it must not park or unpark threads.
+typedef bool (*__MCFCRT_ParkRequeueCallback)(void *__pRequeueKey);
+
+// This function parks the calling thread without a timeout.
+// When it is about to be unparked, if `(*__pfnRequeueCallback)(__pRequeueKey)` returns `true`, it is moved to `__pRequeueKey` without being woken up,
+// as if it had parked there instead, which still counts as one thread unparked. This happens at most once.
+extern void __MCFCRT_ParkThreadRequeueable(void *__pKey, void *__pRequeueKey, __MCFCRT_ParkRequeueCallback __pfnRequeueCallback) _MCFCRT_NOEXCEPT;
+extern NTSTATUS __MCFCRT_UnparkThread(void *__pKey) _MCFCRT_NOEXCEPT;
+// This function is equivalent to calling `__MCFCRT_UnparkThread()` `__uCount` times, but it wakes up only one thread.
+// The rest are woken up in a cascade, each by the thread that was woken up before it, before it returns from `__MCFCRT_ParkThread()`.
+extern NTSTATUS __MCFCRT_UnparkThreads(void *__pKey, _MCFCRT_STD size_t __uCount) _MCFCRT_NOEXCEPT;
+
+// A thread that parks with an interrupt can be woken up by `__MCFCRT_InterruptParkedThread()` from another thread, in which case `STATUS_TIMEOUT` is returned,
+// so callers that can handle timeouts can be interrupted as well. An interrupt is sticky: once it has been interrupted, parking with it times out immediately.
+// It belongs to a single thread, which may park with it multiple times (on different keys), and it must outlive all calls to `__MCFCRT_InterruptParkedThread()` on it.
+typedef struct __MCFCRT_tagParkInterrupt {
+	void *volatile __pKey;
+	void *__pNode;
+	volatile bool __bInterrupted;
+} __MCFCRT_ParkInterrupt;
+
+extern void __MCFCRT_InitializeParkInterrupt(__MCFCRT_ParkInterrupt *__pInterrupt) _MCFCRT_NOEXCEPT;
+extern NTSTATUS __MCFCRT_ParkThreadInterruptible(void *__pKey, const LARGE_INTEGER *__pliTimeout, __MCFCRT_ParkInterrupt *__pInterrupt) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_InterruptParkedThread(__MCFCRT_ParkInterrupt *__pInterrupt) _MCFCRT_NOEXCEPT;
+// This is a stop callback whose context is a pointer to an interrupt, so a stop request interrupts the parked thread, which then behaves as if it had timed out.
+extern void __MCFCRT_InterruptParkedThreadOnStop(_MCFCRT_STD intptr_t __nContext) _MCFCRT_NOEXCEPT;
+
+// These functions implement a parking lot, where the queue of threads parked on an address is kept in the hashed buckets above,
+// so a synchronization primitive need not count its waiters and may be as small as one byte. Keys need not be even here.
+// They don't save wakeups for threads that have not parked yet. The validation callback serves that purpose instead,
+// and keys that are used with these functions must not be used with the functions above.
+typedef enum __MCFCRT_tagParkResult {
+	__MCFCRT_kParkResultWoken    = 1,
+	__MCFCRT_kParkResultTimedOut = 2,
+	__MCFCRT_kParkResultInvalid  = 3,
+} __MCFCRT_ParkResult;
+
+// These callbacks are called with the bucket of the key locked, so they must not park or unpark threads.
+typedef bool (*__MCFCRT_ParkValidateCallback)(_MCFCRT_STD intptr_t __nContext);
+typedef void (*__MCFCRT_UnparkCallback)(_MCFCRT_STD intptr_t __nContext, bool __bUnparked, bool __bMayHaveMoreThreads);
+
+// The calling thread is parked only if `(*__pfnValidate)(__nContext)` returns `true`. Otherwise `__MCFCRT_kParkResultInvalid` is returned.
+extern __MCFCRT_ParkResult __MCFCRT_ParkThreadIf(void *__pKey, __MCFCRT_ParkValidateCallback __pfnValidate, _MCFCRT_STD intptr_t __nContext, const LARGE_INTEGER *__pliTimeout) _MCFCRT_NOEXCEPT;
+// `__pfnCallback` may be a null pointer. Otherwise, it is told whether a thread has been unparked and whether there may be more threads parked on the same key.
+extern bool __MCFCRT_UnparkOneThread(void *__pKey, __MCFCRT_UnparkCallback __pfnCallback, _MCFCRT_STD intptr_t __nContext) _MCFCRT_NOEXCEPT;
+extern _MCFCRT_STD size_t __MCFCRT_UnparkAllThreads(void *__pKey) _MCFCRT_NOEXCEPT;
+
+// A thread may be parked with a tag, which is passed to the filter callback of `__MCFCRT_UnparkTaggedThreads()`. Threads parked by `__MCFCRT_ParkThreadIf()` have a tag of zero.
+// The filter callback is called with the bucket of the key locked, so it must not park or unpark threads, either.
+typedef bool (*__MCFCRT_UnparkFilterCallback)(_MCFCRT_STD intptr_t __nContext, _MCFCRT_STD intptr_t __nTag);
+
+extern __MCFCRT_ParkResult __MCFCRT_ParkTaggedThreadIf(void *__pKey, _MCFCRT_STD intptr_t __nTag, __MCFCRT_ParkValidateCallback __pfnValidate, _MCFCRT_STD intptr_t __nContext, const LARGE_INTEGER *__pliTimeout) _MCFCRT_NOEXCEPT;
+// Unparks at most `__uMaxCount` threads parked on `__pKey` for which `(*__pfnFilter)(__nContext, tag)` returns `true`, in the order they were parked.
+// No more threads are unparked than the filter accepts when this function is called. The filter may be called more than once for each thread, so it should have no side effects.
+extern _MCFCRT_STD size_t __MCFCRT_UnparkTaggedThreads(void *__pKey, __MCFCRT_UnparkFilterCallback __pfnFilter, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD size_t __uMaxCount) _MCFCRT_NOEXCEPT;
+
+_MCFCRT_EXTERN_C_END
+
+#endif
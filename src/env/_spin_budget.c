@@ -0,0 +1,50 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_SPIN_BUDGET_INLINE_OR_EXTERN     extern inline
+#include "_spin_budget.h"
+#include "clocks.h"
+#include "mcfwin.h"
+
+// This is used until the time stamp counter has been calibrated. It corresponds to 2 GHz.
+#define DEFAULT_TSC_TICKS_PER_MICROSECOND   2000u
+// How long the calibration takes, in microseconds.
+#define CALIBRATION_DURATION                100u
+
+static uint32_t g_u32TscTicksPerMicrosecond = DEFAULT_TSC_TICKS_PER_MICROSECOND;
+
+bool __MCFCRT_SpinBudgetInit(void){
+	LARGE_INTEGER liFrequency, liBegin, liEnd;
+	if(!QueryPerformanceFrequency(&liFrequency)){
+		// Keep the default value, which should be fine for most hosts.
+		return true;
+	}
+	const int64_t n64CountsToWait = liFrequency.QuadPart * CALIBRATION_DURATION / 1000000;
+	QueryPerformanceCounter(&liBegin);
+	const uint64_t u64TscBegin = _MCFCRT_ReadTimeStampCounter64();
+	do {
+		__builtin_ia32_pause();
+		QueryPerformanceCounter(&liEnd);
+	} while(liEnd.QuadPart - liBegin.QuadPart < n64CountsToWait);
+	const uint64_t u64TscEnd = _MCFCRT_ReadTimeStampCounter64();
+
+	const double dMicroseconds = (double)(liEnd.QuadPart - liBegin.QuadPart) * 1.0e6 / (double)liFrequency.QuadPart;
+	const double dTicksPerMicrosecond = (double)(int64_t)(u64TscEnd - u64TscBegin) / dMicroseconds;
+	uint32_t u32TicksPerMicrosecond;
+	if(!(dTicksPerMicrosecond >= 1)){
+		u32TicksPerMicrosecond = 1;
+	} else if(dTicksPerMicrosecond >= (double)UINT32_MAX){
+		u32TicksPerMicrosecond = UINT32_MAX;
+	} else {
+		u32TicksPerMicrosecond = (uint32_t)dTicksPerMicrosecond;
+	}
+	__atomic_store_n(&g_u32TscTicksPerMicrosecond, u32TicksPerMicrosecond, __ATOMIC_RELAXED);
+	return true;
+}
+void __MCFCRT_SpinBudgetUninit(void){
+}
+
+uint32_t __MCFCRT_GetTscTicksPerMicrosecond(void){
+	return __atomic_load_n(&g_u32TscTicksPerMicrosecond, __ATOMIC_RELAXED);
+}
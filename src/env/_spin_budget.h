@@ -0,0 +1,72 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_SPIN_BUDGET_H_
+#define __MCFCRT_ENV_SPIN_BUDGET_H_
+
+#include "_crtdef.h"
+
+#ifndef __MCFCRT_SPIN_BUDGET_INLINE_OR_EXTERN
+#  define __MCFCRT_SPIN_BUDGET_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// Spinning is measured with the time stamp counter rather than `PAUSE` iterations, whose latency varies by an order of magnitude among microarchitectures.
+// The frequency of the time stamp counter is calibrated against the performance counter at startup.
+extern bool __MCFCRT_SpinBudgetInit(void) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_SpinBudgetUninit(void) _MCFCRT_NOEXCEPT;
+
+extern _MCFCRT_STD uint32_t __MCFCRT_GetTscTicksPerMicrosecond(void) _MCFCRT_NOEXCEPT;
+
+// The estimated cost of parking a thread and waking it up again. If a lock is expected to be held longer than this, don't spin.
+#define __MCFCRT_SPIN_BUDGET_PARKING_COST_NS    8000u
+// Each unit of the spin count passed to wait functions allows this much time of spinning.
+#define __MCFCRT_SPIN_BUDGET_NS_PER_SPIN_COUNT  100u
+// The minimum time of spinning if spinning is allowed at all.
+#define __MCFCRT_SPIN_BUDGET_MIN_NS             500u
+// The hold time of a lock is estimated as `__MCFCRT_SPIN_BUDGET_HOLD_TIME_UNIT_NS << uHoldTimeLog`, where `uHoldTimeLog` takes 4 bits.
+#define __MCFCRT_SPIN_BUDGET_HOLD_TIME_UNIT_NS  16u
+#define __MCFCRT_SPIN_BUDGET_HOLD_TIME_LOG_MAX  15u
+
+// Returns the number of TSC ticks to spin for, or zero if the calling thread should be parked without spinning.
+__MCFCRT_SPIN_BUDGET_INLINE_OR_EXTERN _MCFCRT_STD uint64_t __MCFCRT_SpinBudgetGetTicks(_MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD size_t __uHoldTimeLog) _MCFCRT_NOEXCEPT {
+	if(__uMaxSpinCount == 0){
+		return 0;
+	}
+	const _MCFCRT_STD uint64_t __u64ExpectedNs = (_MCFCRT_STD uint64_t)__MCFCRT_SPIN_BUDGET_HOLD_TIME_UNIT_NS << __uHoldTimeLog;
+	if(__u64ExpectedNs >= __MCFCRT_SPIN_BUDGET_PARKING_COST_NS){
+		return 0;
+	}
+	// Spin for twice the expected hold time, which tolerates some jitter.
+	_MCFCRT_STD uint64_t __u64BudgetNs = __u64ExpectedNs * 2;
+	if(__u64BudgetNs < __MCFCRT_SPIN_BUDGET_MIN_NS){
+		__u64BudgetNs = __MCFCRT_SPIN_BUDGET_MIN_NS;
+	}
+	const _MCFCRT_STD uint64_t __u64CapNs = (_MCFCRT_STD uint64_t)__uMaxSpinCount * __MCFCRT_SPIN_BUDGET_NS_PER_SPIN_COUNT;
+	if(__u64BudgetNs > __u64CapNs){
+		__u64BudgetNs = __u64CapNs;
+	}
+	return __u64BudgetNs * __MCFCRT_GetTscTicksPerMicrosecond() / 1000;
+}
+// Returns the number of TSC ticks that `__uMaxSpinCount` allows, for primitives that don't estimate hold times.
+__MCFCRT_SPIN_BUDGET_INLINE_OR_EXTERN _MCFCRT_STD uint64_t __MCFCRT_SpinBudgetGetTicksForCount(_MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	if(__uMaxSpinCount == 0){
+		return 0;
+	}
+	return (_MCFCRT_STD uint64_t)__uMaxSpinCount * __MCFCRT_SPIN_BUDGET_NS_PER_SPIN_COUNT * __MCFCRT_GetTscTicksPerMicrosecond() / 1000;
+}
+// Moves the hold time estimate halfway towards the time that a spinning thread has actually waited for, in the logarithmic domain.
+__MCFCRT_SPIN_BUDGET_INLINE_OR_EXTERN _MCFCRT_STD size_t __MCFCRT_SpinBudgetUpdateHoldTimeLog(_MCFCRT_STD size_t __uHoldTimeLog, _MCFCRT_STD uint64_t __u64TicksSpun) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __u64Units = __u64TicksSpun * 1000 / __MCFCRT_GetTscTicksPerMicrosecond() / __MCFCRT_SPIN_BUDGET_HOLD_TIME_UNIT_NS;
+	_MCFCRT_STD size_t __uTargetLog = (_MCFCRT_STD size_t)(63 - __builtin_clzll(__u64Units | 1));
+	if(__uTargetLog > __MCFCRT_SPIN_BUDGET_HOLD_TIME_LOG_MAX){
+		__uTargetLog = __MCFCRT_SPIN_BUDGET_HOLD_TIME_LOG_MAX;
+	}
+	return (__uHoldTimeLog + __uTargetLog + 1) / 2;
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
@@ -0,0 +1,104 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#include "_topology.h"
+#include "mcfwin.h"
+#include "heap.h"
+
+// Processors in groups beyond this are considered to be on the first node.
+#define MAX_GROUP_COUNT             32u
+#define MAX_PROCESSORS_PER_GROUP    64u
+
+static size_t g_uNodeCount = 1;
+static unsigned char g_aabyNodeIndices[MAX_GROUP_COUNT][MAX_PROCESSORS_PER_GROUP];
+
+// `RelationNumaNodeEx` was introduced in Windows Server 2022. Without it, only the primary group of each node is reported.
+#define RELATION_NUMA_NODE_EX       ((LOGICAL_PROCESSOR_RELATIONSHIP)6)
+
+// This is `NUMA_NODE_RELATIONSHIP` from newer SDKs. `wGroupCount` is in the reserved bytes of older ones, which are zero on older systems.
+typedef struct tagNumaNodeRelationship {
+	DWORD dwNodeNumber;
+	BYTE abyReserved[18];
+	WORD wGroupCount;
+	GROUP_AFFINITY aGroupMasks[];
+} NumaNodeRelationship;
+
+static_assert(__builtin_offsetof(NumaNodeRelationship, aGroupMasks) == __builtin_offsetof(NUMA_NODE_RELATIONSHIP, GroupMask), "NumaNodeRelationship does not match NUMA_NODE_RELATIONSHIP.");
+
+static unsigned char *QueryNumaNodes(LOGICAL_PROCESSOR_RELATIONSHIP eRelationship, DWORD *pdwSize){
+	DWORD dwSize = 0;
+	GetLogicalProcessorInformationEx(eRelationship, _MCFCRT_NULLPTR, &dwSize);
+	if(dwSize == 0){
+		return _MCFCRT_NULLPTR;
+	}
+	unsigned char *const pbyBuffer = __MCFCRT_HeapAlloc(dwSize, false, __builtin_return_address(0));
+	if(!pbyBuffer){
+		return _MCFCRT_NULLPTR;
+	}
+	if(!GetLogicalProcessorInformationEx(eRelationship, (void *)pbyBuffer, &dwSize)){
+		__MCFCRT_HeapFree(pbyBuffer, __builtin_return_address(0));
+		return _MCFCRT_NULLPTR;
+	}
+	*pdwSize = dwSize;
+	return pbyBuffer;
+}
+
+bool __MCFCRT_TopologyInit(void){
+	DWORD dwSize;
+	unsigned char *pbyBuffer = QueryNumaNodes(RELATION_NUMA_NODE_EX, &dwSize);
+	if(!pbyBuffer){
+		pbyBuffer = QueryNumaNodes(RelationNumaNode, &dwSize);
+	}
+	if(!pbyBuffer){
+		// Assume there is only one node.
+		return true;
+	}
+	size_t uNodeCount = 0;
+	DWORD dwOffset = 0;
+	while(dwOffset < dwSize){
+		const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *const pInfo = (const void *)(pbyBuffer + dwOffset);
+		if((pInfo->Relationship == RelationNumaNode) || (pInfo->Relationship == RELATION_NUMA_NODE_EX)){
+			// A node may span multiple processor groups, each of which has its own mask.
+			const NumaNodeRelationship *const pNode = (const void *)&(pInfo->NumaNode);
+			size_t uGroupCount = pNode->wGroupCount;
+			if(uGroupCount == 0){
+				uGroupCount = 1;
+			}
+			for(size_t uGroupIndex = 0; uGroupIndex < uGroupCount; ++uGroupIndex){
+				const size_t uGroup = pNode->aGroupMasks[uGroupIndex].Group;
+				const KAFFINITY uMask = pNode->aGroupMasks[uGroupIndex].Mask;
+				if(uGroup < MAX_GROUP_COUNT){
+					for(size_t uIndex = 0; uIndex < sizeof(uMask) * CHAR_BIT; ++uIndex){
+						if((uMask >> uIndex) & 1){
+							g_aabyNodeIndices[uGroup][uIndex] = (unsigned char)uNodeCount;
+						}
+					}
+				}
+			}
+			if(uNodeCount < UCHAR_MAX){
+				++uNodeCount;
+			}
+		}
+		dwOffset += pInfo->Size;
+	}
+	__MCFCRT_HeapFree(pbyBuffer, __builtin_return_address(0));
+	if(uNodeCount != 0){
+		g_uNodeCount = uNodeCount;
+	}
+	return true;
+}
+void __MCFCRT_TopologyUninit(void){
+}
+
+size_t __MCFCRT_GetNumaNodeCount(void){
+	return g_uNodeCount;
+}
+size_t __MCFCRT_GetCurrentNumaNodeIndex(void){
+	PROCESSOR_NUMBER vNumber;
+	GetCurrentProcessorNumberEx(&vNumber);
+	if((vNumber.Group >= MAX_GROUP_COUNT) || (vNumber.Number >= MAX_PROCESSORS_PER_GROUP)){
+		return 0;
+	}
+	return g_aabyNodeIndices[vNumber.Group][vNumber.Number];
+}
@@ -0,0 +1,21 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_TOPOLOGY_H_
+#define __MCFCRT_ENV_TOPOLOGY_H_
+
+#include "_crtdef.h"
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// The NUMA topology is queried once at startup. NUMA nodes are numbered contiguously from zero in the order they are reported by the system.
+extern bool __MCFCRT_TopologyInit(void) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_TopologyUninit(void) _MCFCRT_NOEXCEPT;
+
+extern _MCFCRT_STD size_t __MCFCRT_GetNumaNodeCount(void) _MCFCRT_NOEXCEPT;
+extern _MCFCRT_STD size_t __MCFCRT_GetCurrentNumaNodeIndex(void) _MCFCRT_NOEXCEPT;
+
+_MCFCRT_EXTERN_C_END
+
+#endif
@@ -0,0 +1,81 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#include "address_wait.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+typedef struct tagWaitContext {
+	volatile void *pAddress;
+	const void *pExpected;
+	size_t uSize;
+} WaitContext;
+
+static inline bool IsValueExpected(const WaitContext *pContext){
+	switch(pContext->uSize){
+	case 1:
+		return __atomic_load_n((volatile uint8_t *)pContext->pAddress, __ATOMIC_SEQ_CST) == *(const uint8_t *)pContext->pExpected;
+	case 2:
+		return __atomic_load_n((volatile uint16_t *)pContext->pAddress, __ATOMIC_SEQ_CST) == *(const uint16_t *)pContext->pExpected;
+	case 4:
+		return __atomic_load_n((volatile uint32_t *)pContext->pAddress, __ATOMIC_SEQ_CST) == *(const uint32_t *)pContext->pExpected;
+	case 8:
+		return __atomic_load_n((volatile uint64_t *)pContext->pAddress, __ATOMIC_SEQ_CST) == *(const uint64_t *)pContext->pExpected;
+	default:
+		_MCFCRT_ASSERT_MSG(false, L"The size of the value must be 1, 2, 4 or 8.");
+		__builtin_unreachable();
+	}
+}
+// This callback is called with the bucket locked, which serializes it with `_MCFCRT_WakeAddress()`.
+static bool ValidateParking(intptr_t nContext){
+	return IsValueExpected((const WaitContext *)nContext);
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitOnAddress(volatile void *pAddress, const void *pExpected, size_t uSize, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	_MCFCRT_ASSERT_MSG(((uintptr_t)pAddress & (uSize - 1)) == 0, L"The address is not aligned.");
+
+	const WaitContext vContext = { pAddress, pExpected, uSize };
+	if(!IsValueExpected(&vContext)){
+		return true;
+	}
+	__MCFCRT_ParkResult eResult;
+	if(bMayTimeOut){
+		LARGE_INTEGER liTimeout;
+		__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+		eResult = __MCFCRT_ParkThreadIf((void *)pAddress, &ValidateParking, (intptr_t)&vContext, &liTimeout);
+	} else {
+		eResult = __MCFCRT_ParkThreadIf((void *)pAddress, &ValidateParking, (intptr_t)&vContext, _MCFCRT_NULLPTR);
+	}
+	return eResult != __MCFCRT_kParkResultTimedOut;
+}
+
+bool _MCFCRT_WaitOnAddress(volatile void *pAddress, const void *pExpected, size_t uSize, uint64_t u64UntilFastMonoClock){
+	const bool bWoken = ReallyWaitOnAddress(pAddress, pExpected, uSize, true, u64UntilFastMonoClock);
+	return bWoken;
+}
+void _MCFCRT_WaitOnAddressForever(volatile void *pAddress, const void *pExpected, size_t uSize){
+	const bool bWoken = ReallyWaitOnAddress(pAddress, pExpected, uSize, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bWoken);
+}
+size_t _MCFCRT_WakeAddress(volatile void *pAddress, size_t uCount){
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	if(_MCFCRT_EXPECT_NOT(RtlDllShutdownInProgress())){
+		return 0;
+	}
+	if(uCount == SIZE_MAX){
+		return __MCFCRT_UnparkAllThreads((void *)pAddress);
+	}
+	size_t uCountWoken = 0;
+	while((uCountWoken < uCount) && __MCFCRT_UnparkOneThread((void *)pAddress, _MCFCRT_NULLPTR, 0)){
+		++uCountWoken;
+	}
+	return uCountWoken;
+}
@@ -0,0 +1,34 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_ADDRESS_WAIT_H_
+#define __MCFCRT_ENV_ADDRESS_WAIT_H_
+
+#include "_crtdef.h"
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// These functions provide futex-like waiting on arbitrary addresses, which is what C++20 `std::atomic<T>::wait()` and `notify_*()` need.
+// Parked threads are kept in the parking lot, so no memory is allocated and any number of addresses can be waited on.
+//
+// `_MCFCRT_WaitOnAddress()` parks the calling thread on `__pAddress` if the `__uSize` bytes there compare equal to those at `__pExpected`.
+// The comparison is made atomically with respect to `_MCFCRT_WakeAddress()`, so a thread that changes the value and then wakes the address
+// never misses a thread that has seen the old value. `__uSize` must be 1, 2, 4 or 8, and `__pAddress` must be aligned to it.
+// It returns `false` if the operation has timed out, and `true` otherwise, including when the value was different from the expected one.
+// Like the futex, it may also return `true` spuriously, so the caller has to check the value again in a loop.
+//
+// `_MCFCRT_WakeAddress()` wakes up at most `__uCount` threads waiting on `__pAddress` and returns the number of threads woken up.
+// Pass `SIZE_MAX` to wake up all of them.
+//
+// libstdc++ can use these as its platform wait, in place of the proxy pool of mutexes and condition variables:
+//   `__platform_wait(__addr, __old)`     -> `_MCFCRT_WaitOnAddressForever(__addr, &__old, sizeof(__old))`
+//   `__platform_notify(__addr, __all)`   -> `_MCFCRT_WakeAddress(__addr, __all ? SIZE_MAX : 1)`
+// with `__platform_wait_t` defined as `int` or `long long`, then `__atomic_wait_address()` waits on the atomic object directly.
+extern bool _MCFCRT_WaitOnAddress(volatile void *__pAddress, const void *__pExpected, _MCFCRT_STD size_t __uSize, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void _MCFCRT_WaitOnAddressForever(volatile void *__pAddress, const void *__pExpected, _MCFCRT_STD size_t __uSize) _MCFCRT_NOEXCEPT;
+extern _MCFCRT_STD size_t _MCFCRT_WakeAddress(volatile void *__pAddress, _MCFCRT_STD size_t __uCount) _MCFCRT_NOEXCEPT;
+
+_MCFCRT_EXTERN_C_END
+
+#endif
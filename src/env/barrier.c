@@ -0,0 +1,228 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_BARRIER_INLINE_OR_EXTERN     extern inline
+#include "barrier.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "clocks.h"
+#include "thread.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+// The control word consists of the current phase and the counter of trapped threads.
+#define MASK_THREADS_TRAPPED    ((uint64_t)0x00000000FFFFFFFF)
+#define MASK_PHASE              ((uint64_t)0xFFFFFFFF00000000)
+
+#define THREADS_TRAPPED_ONE     ((uint64_t)(MASK_THREADS_TRAPPED & -MASK_THREADS_TRAPPED))
+#define PHASE_ONE               ((uint64_t)(MASK_PHASE & -MASK_PHASE))
+
+// Each leaf consists of the phase it is counting arrivals for, the number of arrivals and the number of arrivals expected.
+#define MASK_LEAF_QUOTA         ((uint64_t)0x000000000000FFFF)
+#define MASK_LEAF_ARRIVED       ((uint64_t)0x00000000FFFF0000)
+#define MASK_LEAF_PHASE         ((uint64_t)0xFFFFFFFF00000000)
+
+#define LEAF_QUOTA_ONE          ((uint64_t)(MASK_LEAF_QUOTA & -MASK_LEAF_QUOTA))
+#define LEAF_QUOTA_MAX          ((uint64_t)(MASK_LEAF_QUOTA / LEAF_QUOTA_ONE))
+#define LEAF_ARRIVED_ONE        ((uint64_t)(MASK_LEAF_ARRIVED & -MASK_LEAF_ARRIVED))
+#define LEAF_PHASE_ONE          ((uint64_t)(MASK_LEAF_PHASE & -MASK_LEAF_PHASE))
+
+static_assert(_MCFCRT_BARRIER_EXPECTED_MAX == _MCFCRT_BARRIER_MAX_LEAVES * LEAF_QUOTA_MAX, "The limit of expected arrivals is wrong.");
+
+// Phases wrap around, so they are compared by their difference.
+static inline bool HasPhaseCompleted(uint64_t uControl, _MCFCRT_BarrierToken uToken){
+	return (int32_t)((uint32_t)((uControl & MASK_PHASE) / PHASE_ONE) - uToken) > 0;
+}
+
+static void ResetLeaves(_MCFCRT_Barrier *pBarrier, uint32_t u32Phase, uint32_t u32Expected){
+	_MCFCRT_ASSERT_MSG(u32Expected <= _MCFCRT_BARRIER_EXPECTED_MAX, L"Too many threads are participating in this barrier.");
+	size_t uLeafCount = (u32Expected + _MCFCRT_BARRIER_LEAF_FAN_IN - 1) / _MCFCRT_BARRIER_LEAF_FAN_IN;
+	if(uLeafCount < 1){
+		uLeafCount = 1;
+	} else if(uLeafCount > _MCFCRT_BARRIER_MAX_LEAVES){
+		uLeafCount = _MCFCRT_BARRIER_MAX_LEAVES;
+	}
+	__atomic_store_n(&(pBarrier->__uLeafCount), uLeafCount, __ATOMIC_RELAXED);
+	__atomic_store_n(&(pBarrier->__uLeavesFilled), 0, __ATOMIC_RELAXED);
+	// Leaves beyond `uLeafCount` get a quota of zero, so no thread may arrive there.
+	// Arrivals in the new phase become possible as soon as a leaf is reset, so this has to be done last.
+	for(size_t uIndex = 0; uIndex < _MCFCRT_BARRIER_MAX_LEAVES; ++uIndex){
+		size_t uQuota = 0;
+		if(uIndex < uLeafCount){
+			uQuota = u32Expected / uLeafCount + (uIndex < u32Expected % uLeafCount);
+		}
+		__atomic_store_n(&(pBarrier->__aLeaves[uIndex].__u), u32Phase * LEAF_PHASE_ONE + uQuota * LEAF_QUOTA_ONE, __ATOMIC_RELEASE);
+	}
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForBarrier(volatile uint64_t *puControl, _MCFCRT_BarrierToken uToken, size_t uMaxSpinCount, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicksForCount(uMaxSpinCount);
+	const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+	while(_MCFCRT_EXPECT(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks)){
+		__builtin_ia32_pause();
+		// Only perform a read here, which doesn't bounce the cache line.
+		const uint64_t uOld = __atomic_load_n(puControl, __ATOMIC_ACQUIRE);
+		if(HasPhaseCompleted(uOld, uToken)){
+			return true;
+		}
+	}
+	for(;;){
+		bool bTaken;
+		{
+			uint64_t uOld, uNew;
+			uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+			do {
+				bTaken = HasPhaseCompleted(uOld, uToken);
+				if(bTaken){
+					break;
+				}
+				_MCFCRT_ASSERT_MSG((uOld & MASK_THREADS_TRAPPED) != MASK_THREADS_TRAPPED, L"Too many threads are waiting for this barrier.");
+				uNew = uOld + THREADS_TRAPPED_ONE;
+			} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
+		}
+		if(_MCFCRT_EXPECT(bTaken)){
+			return true;
+		}
+		// All trapped threads are woken up whenever a phase completes, which may not be the phase that this thread is waiting for.
+		if(bMayTimeOut){
+			LARGE_INTEGER liTimeout;
+			__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+			NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, &liTimeout);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+			while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
+				bool bDecremented;
+				{
+					uint64_t uOld, uNew;
+					uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+					do {
+						const uint64_t u64ThreadsTrapped = (uOld & MASK_THREADS_TRAPPED) / THREADS_TRAPPED_ONE;
+						bDecremented = u64ThreadsTrapped != 0;
+						if(!bDecremented){
+							break;
+						}
+						uNew = uOld - THREADS_TRAPPED_ONE;
+					} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
+				}
+				if(bDecremented){
+					return HasPhaseCompleted(__atomic_load_n(puControl, __ATOMIC_ACQUIRE), uToken);
+				}
+				liTimeout.QuadPart = 0;
+				lStatus = __MCFCRT_ParkThread((void *)puControl, &liTimeout);
+				_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+			}
+		} else {
+			NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, _MCFCRT_NULLPTR);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+			_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+		}
+	}
+}
+
+static void CompletePhase(_MCFCRT_Barrier *pBarrier, uint32_t u32Phase){
+	const _MCFCRT_BarrierCompletionCallback pfnCompletion = pBarrier->__pfnCompletion;
+	if(pfnCompletion){
+		(*pfnCompletion)(pBarrier->__nContext);
+	}
+	// Threads that have dropped out are not expected in the new phase.
+	const uint32_t u32Expected = (uint32_t)__atomic_load_n(&(pBarrier->__uExpected), __ATOMIC_RELAXED);
+	ResetLeaves(pBarrier, u32Phase + 1, u32Expected);
+
+	volatile uint64_t *const puControl = &(pBarrier->__u);
+	uint64_t u64CountToSignal;
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			u64CountToSignal = (uOld & MASK_THREADS_TRAPPED) / THREADS_TRAPPED_ONE;
+			uNew = (uOld & MASK_PHASE) + PHASE_ONE;
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)));
+	}
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	// Unparking threads that will never park leaves stale wakeups behind. Don't do that.
+	if(_MCFCRT_EXPECT_NOT((u64CountToSignal > 0) && !RtlDllShutdownInProgress())){
+		// Only one thread is woken up here. The others are woken up in a cascade.
+		NTSTATUS lStatus = __MCFCRT_UnparkThreads((void *)puControl, (size_t)u64CountToSignal);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThreads() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+}
+
+static _MCFCRT_BarrierToken ArriveOnce(_MCFCRT_Barrier *pBarrier){
+	// Thread IDs are multiples of four on Windows.
+	const size_t uLeafCount = __atomic_load_n(&(pBarrier->__uLeafCount), __ATOMIC_RELAXED);
+	const size_t uFirstIndex = (_MCFCRT_GetCurrentThreadId() / 4) % uLeafCount;
+	for(;;){
+		uint64_t uLastLeaf = 0;
+		for(size_t uProbe = 0; uProbe < _MCFCRT_BARRIER_MAX_LEAVES; ++uProbe){
+			volatile uint64_t *const puLeaf = &(pBarrier->__aLeaves[(uFirstIndex + uProbe) % _MCFCRT_BARRIER_MAX_LEAVES].__u);
+			bool bArrived, bFilled;
+			uint64_t uOld, uNew;
+			uOld = __atomic_load_n(puLeaf, __ATOMIC_ACQUIRE);
+			do {
+				const uint64_t u64Quota = (uOld & MASK_LEAF_QUOTA) / LEAF_QUOTA_ONE;
+				const uint64_t u64Arrived = (uOld & MASK_LEAF_ARRIVED) / LEAF_ARRIVED_ONE;
+				bArrived = u64Arrived < u64Quota;
+				if(!bArrived){
+					break;
+				}
+				bFilled = u64Arrived + 1 == u64Quota;
+				uNew = uOld + LEAF_ARRIVED_ONE;
+			} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puLeaf, &uOld, uNew, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)));
+			if(!bArrived){
+				uLastLeaf = uOld;
+				continue;
+			}
+			const uint32_t u32Phase = (uint32_t)((uNew & MASK_LEAF_PHASE) / LEAF_PHASE_ONE);
+			if(bFilled){
+				// The number of leaves is read after the root, so it is the one of the phase that this thread has arrived at.
+				const size_t uLeavesFilled = __atomic_add_fetch(&(pBarrier->__uLeavesFilled), 1, __ATOMIC_ACQ_REL);
+				if(uLeavesFilled == __atomic_load_n(&(pBarrier->__uLeafCount), __ATOMIC_RELAXED)){
+					CompletePhase(pBarrier, u32Phase);
+				}
+			}
+			return u32Phase;
+		}
+		// All leaves are full, so the last thread of the phase is completing it. Wait for it before arriving at the next phase.
+		ReallyWaitForBarrier(&(pBarrier->__u), (uint32_t)((uLastLeaf & MASK_LEAF_PHASE) / LEAF_PHASE_ONE), _MCFCRT_BARRIER_SUGGESTED_SPIN_COUNT, false, UINT64_MAX);
+	}
+}
+
+void _MCFCRT_InitializeBarrier(_MCFCRT_Barrier *pBarrier, uint32_t u32Expected, _MCFCRT_BarrierCompletionCallback pfnCompletion, intptr_t nContext){
+	_MCFCRT_ASSERT_MSG(u32Expected != 0, L"A barrier must have at least one participating thread.");
+	pBarrier->__uExpected = u32Expected;
+	pBarrier->__pfnCompletion = pfnCompletion;
+	pBarrier->__nContext = nContext;
+	ResetLeaves(pBarrier, 0, u32Expected);
+	__atomic_store_n(&(pBarrier->__u), 0, __ATOMIC_RELEASE);
+}
+
+_MCFCRT_BarrierToken __MCFCRT_ReallyArriveAtBarrier(_MCFCRT_Barrier *pBarrier, uint32_t u32Count){
+	_MCFCRT_ASSERT_MSG(u32Count != 0, L"At least one arrival must be counted.");
+	_MCFCRT_BarrierToken uToken;
+	for(uint32_t u32Index = 0; u32Index < u32Count; ++u32Index){
+		uToken = ArriveOnce(pBarrier);
+	}
+	return uToken;
+}
+_MCFCRT_BarrierToken __MCFCRT_ReallyArriveAtBarrierAndDrop(_MCFCRT_Barrier *pBarrier){
+	// This has to be done before arriving, otherwise the phase might be completed without this.
+	const size_t uOldExpected = __atomic_fetch_sub(&(pBarrier->__uExpected), 1, __ATOMIC_RELAXED);
+	_MCFCRT_ASSERT_MSG(uOldExpected != 0, L"No thread is participating in this barrier.");
+	const _MCFCRT_BarrierToken uToken = ArriveOnce(pBarrier);
+	return uToken;
+}
+bool __MCFCRT_ReallyWaitForBarrier(_MCFCRT_Barrier *pBarrier, _MCFCRT_BarrierToken uToken, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+	const bool bTaken = ReallyWaitForBarrier(&(pBarrier->__u), uToken, uMaxSpinCount, true, u64UntilFastMonoClock);
+	return bTaken;
+}
+void __MCFCRT_ReallyWaitForBarrierForever(_MCFCRT_Barrier *pBarrier, _MCFCRT_BarrierToken uToken, size_t uMaxSpinCount){
+	const bool bTaken = ReallyWaitForBarrier(&(pBarrier->__u), uToken, uMaxSpinCount, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bTaken);
+}
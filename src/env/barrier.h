@@ -0,0 +1,75 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_BARRIER_H_
+#define __MCFCRT_ENV_BARRIER_H_
+
+#include "_crtdef.h"
+
+#ifndef __MCFCRT_BARRIER_INLINE_OR_EXTERN
+#  define __MCFCRT_BARRIER_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// Arrivals are combined in a two-level tree. Each phase, the expected number of arrivals is split among up to `_MCFCRT_BARRIER_MAX_LEAVES` leaves,
+// one for every `_MCFCRT_BARRIER_LEAF_FAN_IN` participating threads. A thread arrives at the leaf selected by its thread ID, or the next one that is not full.
+// The thread that fills a leaf arrives at the root, and the thread that fills the root completes the phase.
+// Every leaf lives in its own cache line, so threads arriving at different leaves don't contend.
+#define _MCFCRT_BARRIER_MAX_LEAVES       16u
+#define _MCFCRT_BARRIER_LEAF_FAN_IN      8u
+#define _MCFCRT_BARRIER_EXPECTED_MAX     (_MCFCRT_BARRIER_MAX_LEAVES * 0xFFFFu)
+
+typedef void (*_MCFCRT_BarrierCompletionCallback)(_MCFCRT_STD intptr_t __nContext);
+
+// A token identifies the phase that a thread has arrived at.
+typedef _MCFCRT_STD uint32_t _MCFCRT_BarrierToken;
+
+typedef struct __MCFCRT_tagBarrierLeaf {
+	__attribute__((__aligned__(64))) _MCFCRT_STD uint64_t __u;
+} __MCFCRT_BarrierLeaf;
+
+typedef struct __MCFCRT_tagBarrier {
+	__attribute__((__aligned__(64))) _MCFCRT_STD uint64_t __u;
+	_MCFCRT_STD uintptr_t __uExpected;
+	_MCFCRT_STD uintptr_t __uLeafCount;
+	_MCFCRT_BarrierCompletionCallback __pfnCompletion;
+	_MCFCRT_STD intptr_t __nContext;
+	__attribute__((__aligned__(64))) _MCFCRT_STD uintptr_t __uLeavesFilled;
+	__MCFCRT_BarrierLeaf __aLeaves[_MCFCRT_BARRIER_MAX_LEAVES];
+} _MCFCRT_Barrier;
+
+#define _MCFCRT_BARRIER_SUGGESTED_SPIN_COUNT   100u
+
+// `__pfnCompletion` may be a null pointer. Otherwise, it is called by the last thread arriving in each phase, before any thread waiting for that phase is woken up.
+extern void _MCFCRT_InitializeBarrier(_MCFCRT_Barrier *__pBarrier, _MCFCRT_STD uint32_t __u32Expected, _MCFCRT_BarrierCompletionCallback __pfnCompletion, _MCFCRT_STD intptr_t __nContext) _MCFCRT_NOEXCEPT;
+
+extern _MCFCRT_BarrierToken __MCFCRT_ReallyArriveAtBarrier(_MCFCRT_Barrier *__pBarrier, _MCFCRT_STD uint32_t __u32Count) _MCFCRT_NOEXCEPT;
+extern _MCFCRT_BarrierToken __MCFCRT_ReallyArriveAtBarrierAndDrop(_MCFCRT_Barrier *__pBarrier) _MCFCRT_NOEXCEPT;
+extern bool __MCFCRT_ReallyWaitForBarrier(_MCFCRT_Barrier *__pBarrier, _MCFCRT_BarrierToken __uToken, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForBarrierForever(_MCFCRT_Barrier *__pBarrier, _MCFCRT_BarrierToken __uToken, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+
+// Counts `__u32Count` arrivals in the current phase without blocking, unless the completion step of the previous phase is still in progress.
+__MCFCRT_BARRIER_INLINE_OR_EXTERN _MCFCRT_BarrierToken _MCFCRT_ArriveAtBarrier(_MCFCRT_Barrier *__pBarrier, _MCFCRT_STD uint32_t __u32Count) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallyArriveAtBarrier(__pBarrier, __u32Count);
+}
+// Counts one arrival in the current phase and decrements the expected number of arrivals of all subsequent phases.
+__MCFCRT_BARRIER_INLINE_OR_EXTERN _MCFCRT_BarrierToken _MCFCRT_ArriveAtBarrierAndDrop(_MCFCRT_Barrier *__pBarrier) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallyArriveAtBarrierAndDrop(__pBarrier);
+}
+// These functions return after the phase identified by `__uToken` has completed.
+__MCFCRT_BARRIER_INLINE_OR_EXTERN bool _MCFCRT_WaitForBarrier(_MCFCRT_Barrier *__pBarrier, _MCFCRT_BarrierToken __uToken, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallyWaitForBarrier(__pBarrier, __uToken, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_BARRIER_INLINE_OR_EXTERN void _MCFCRT_WaitForBarrierForever(_MCFCRT_Barrier *__pBarrier, _MCFCRT_BarrierToken __uToken, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallyWaitForBarrierForever(__pBarrier, __uToken, __uMaxSpinCount);
+}
+__MCFCRT_BARRIER_INLINE_OR_EXTERN void _MCFCRT_ArriveAtBarrierAndWaitForever(_MCFCRT_Barrier *__pBarrier, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_BarrierToken __uToken = __MCFCRT_ReallyArriveAtBarrier(__pBarrier, 1);
+	__MCFCRT_ReallyWaitForBarrierForever(__pBarrier, __uToken, __uMaxSpinCount);
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
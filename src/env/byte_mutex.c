@@ -0,0 +1,104 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_BYTE_MUTEX_INLINE_OR_EXTERN     extern inline
+#include "byte_mutex.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "clocks.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+#define MASK_LOCKED             ((unsigned char)0x01)
+#define MASK_PARKED             ((unsigned char)0x02)
+
+static_assert(MASK_LOCKED == __MCFCRT_BYTE_MUTEX_MASK_LOCKED, "The inline functions in the header rely on this.");
+
+// Both callbacks are called with the bucket locked, which serializes them.
+static bool ValidateParking(intptr_t nContext){
+	volatile unsigned char *const pbyControl = (volatile unsigned char *)nContext;
+	return __atomic_load_n(pbyControl, __ATOMIC_RELAXED) == (MASK_LOCKED | MASK_PARKED);
+}
+static void UnlockAfterUnparking(intptr_t nContext, bool bUnparked, bool bMayHaveMoreThreads){
+	(void)bUnparked;
+
+	volatile unsigned char *const pbyControl = (volatile unsigned char *)nContext;
+	__atomic_store_n(pbyControl, (unsigned char)(bMayHaveMoreThreads ? MASK_PARKED : 0), __ATOMIC_RELEASE);
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForByteMutex(volatile unsigned char *pbyControl, size_t uMaxSpinCount, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicksForCount(uMaxSpinCount);
+	const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+	for(;;){
+		unsigned char byOld = __atomic_load_n(pbyControl, __ATOMIC_RELAXED);
+		if(!(byOld & MASK_LOCKED)){
+			// Woken threads compete with new ones, and the parked bit is left as is.
+			if(_MCFCRT_EXPECT(__atomic_compare_exchange_n(pbyControl, &byOld, (unsigned char)(byOld | MASK_LOCKED), false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))){
+				return true;
+			}
+			continue;
+		}
+		if(!(byOld & MASK_PARKED)){
+			// Don't spin if other threads have been parked already, otherwise we would be stealing the lock from them.
+			if(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks){
+				__builtin_ia32_pause();
+				continue;
+			}
+			if(!__atomic_compare_exchange_n(pbyControl, &byOld, (unsigned char)(byOld | MASK_PARKED), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+				continue;
+			}
+		}
+		__MCFCRT_ParkResult eResult;
+		if(bMayTimeOut){
+			LARGE_INTEGER liTimeout;
+			__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+			eResult = __MCFCRT_ParkThreadIf((void *)pbyControl, &ValidateParking, (intptr_t)pbyControl, &liTimeout);
+		} else {
+			eResult = __MCFCRT_ParkThreadIf((void *)pbyControl, &ValidateParking, (intptr_t)pbyControl, _MCFCRT_NULLPTR);
+		}
+		if(eResult == __MCFCRT_kParkResultTimedOut){
+			// The parked bit might be left set, which costs the next unlocking thread a trip to the parking lot, but is otherwise harmless.
+			return false;
+		}
+	}
+}
+__attribute__((__always_inline__))
+static inline void ReallySignalByteMutex(volatile unsigned char *pbyControl){
+	unsigned char byOld = __atomic_load_n(pbyControl, __ATOMIC_RELAXED);
+	for(;;){
+		_MCFCRT_ASSERT_MSG(byOld & MASK_LOCKED, L"This byte mutex isn't locked by any thread.");
+		if(!(byOld & MASK_PARKED)){
+			if(_MCFCRT_EXPECT(__atomic_compare_exchange_n(pbyControl, &byOld, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))){
+				return;
+			}
+			continue;
+		}
+		// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+		if(_MCFCRT_EXPECT_NOT(RtlDllShutdownInProgress())){
+			__atomic_store_n(pbyControl, 0, __ATOMIC_RELEASE);
+			return;
+		}
+		// The mutex is unlocked by the callback, so no thread can park after the last one has been unparked.
+		__MCFCRT_UnparkOneThread((void *)pbyControl, &UnlockAfterUnparking, (intptr_t)pbyControl);
+		return;
+	}
+}
+
+bool __MCFCRT_ReallyWaitForByteMutex(_MCFCRT_ByteMutex *pByteMutex, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+	const bool bTaken = ReallyWaitForByteMutex(&(pByteMutex->__by), uMaxSpinCount, true, u64UntilFastMonoClock);
+	return bTaken;
+}
+void __MCFCRT_ReallyWaitForByteMutexForever(_MCFCRT_ByteMutex *pByteMutex, size_t uMaxSpinCount){
+	const bool bTaken = ReallyWaitForByteMutex(&(pByteMutex->__by), uMaxSpinCount, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bTaken);
+}
+void __MCFCRT_ReallySignalByteMutex(_MCFCRT_ByteMutex *pByteMutex){
+	ReallySignalByteMutex(&(pByteMutex->__by));
+}
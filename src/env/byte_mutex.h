@@ -0,0 +1,62 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_BYTE_MUTEX_H_
+#define __MCFCRT_ENV_BYTE_MUTEX_H_
+
+#include "_crtdef.h"
+
+#ifndef __MCFCRT_BYTE_MUTEX_INLINE_OR_EXTERN
+#  define __MCFCRT_BYTE_MUTEX_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// A byte mutex takes only one byte, which consists of the lock bit and a bit indicating that threads may have been parked on it.
+// Parked threads are kept in the parking lot rather than counted in the mutex itself, so it is suitable for embedding in large numbers of small objects.
+// In the case of static initialization, please initialize it with { 0 }.
+typedef struct __MCFCRT_tagByteMutex {
+	unsigned char __by;
+} _MCFCRT_ByteMutex;
+
+#define _MCFCRT_BYTE_MUTEX_SUGGESTED_SPIN_COUNT   100u
+
+#define __MCFCRT_BYTE_MUTEX_MASK_LOCKED           ((unsigned char)0x01)
+
+__MCFCRT_BYTE_MUTEX_INLINE_OR_EXTERN void _MCFCRT_InitializeByteMutex(_MCFCRT_ByteMutex *__pByteMutex) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pByteMutex->__by), 0, __ATOMIC_RELEASE);
+}
+
+extern bool __MCFCRT_ReallyWaitForByteMutex(_MCFCRT_ByteMutex *__pByteMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForByteMutexForever(_MCFCRT_ByteMutex *__pByteMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallySignalByteMutex(_MCFCRT_ByteMutex *__pByteMutex) _MCFCRT_NOEXCEPT;
+
+// The fast paths are identical to those of `_MCFCRT_Mutex`, so byte mutexes are as fast as it when there is no contention.
+__MCFCRT_BYTE_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_TryWaitForByteMutex(_MCFCRT_ByteMutex *__pByteMutex) _MCFCRT_NOEXCEPT {
+	unsigned char __byOld = 0;
+	return __builtin_expect(__atomic_compare_exchange_n(&(__pByteMutex->__by), &__byOld, __MCFCRT_BYTE_MUTEX_MASK_LOCKED, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED), true);
+}
+__MCFCRT_BYTE_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_WaitForByteMutex(_MCFCRT_ByteMutex *__pByteMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	if(__builtin_expect(_MCFCRT_TryWaitForByteMutex(__pByteMutex), true)){
+		return true;
+	}
+	return __MCFCRT_ReallyWaitForByteMutex(__pByteMutex, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_BYTE_MUTEX_INLINE_OR_EXTERN void _MCFCRT_WaitForByteMutexForever(_MCFCRT_ByteMutex *__pByteMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	if(__builtin_expect(_MCFCRT_TryWaitForByteMutex(__pByteMutex), true)){
+		return;
+	}
+	__MCFCRT_ReallyWaitForByteMutexForever(__pByteMutex, __uMaxSpinCount);
+}
+__MCFCRT_BYTE_MUTEX_INLINE_OR_EXTERN void _MCFCRT_SignalByteMutex(_MCFCRT_ByteMutex *__pByteMutex) _MCFCRT_NOEXCEPT {
+	unsigned char __byOld = __MCFCRT_BYTE_MUTEX_MASK_LOCKED;
+	if(__builtin_expect(__atomic_compare_exchange_n(&(__pByteMutex->__by), &__byOld, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED), true)){
+		return;
+	}
+	__MCFCRT_ReallySignalByteMutex(__pByteMutex);
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
@@ -0,0 +1,85 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_BYTE_ONCE_INLINE_OR_EXTERN     extern inline
+#include "byte_once.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+#define MASK_LOCKED             ((unsigned char)0x01)
+#define MASK_PARKED             ((unsigned char)0x02)
+#define MASK_FINISHED           ((unsigned char)0x04)
+
+static_assert(MASK_FINISHED == __MCFCRT_BYTE_ONCE_MASK_FINISHED, "The inline functions in the header rely on this.");
+
+// This callback is called with the bucket locked, which serializes it with `__MCFCRT_UnparkAllThreads()`.
+static bool ValidateParking(intptr_t nContext){
+	volatile unsigned char *const pbyControl = (volatile unsigned char *)nContext;
+	return __atomic_load_n(pbyControl, __ATOMIC_RELAXED) == (MASK_LOCKED | MASK_PARKED);
+}
+
+__attribute__((__always_inline__))
+static inline _MCFCRT_OnceResult ReallyWaitForByteOnce(volatile unsigned char *pbyControl, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	for(;;){
+		unsigned char byOld = __atomic_load_n(pbyControl, __ATOMIC_ACQUIRE);
+		if(byOld & MASK_FINISHED){
+			return _MCFCRT_kOnceResultFinished;
+		}
+		if(!(byOld & MASK_LOCKED)){
+			if(_MCFCRT_EXPECT(__atomic_compare_exchange_n(pbyControl, &byOld, (unsigned char)(byOld | MASK_LOCKED), false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))){
+				return _MCFCRT_kOnceResultInitial;
+			}
+			continue;
+		}
+		if(!(byOld & MASK_PARKED)){
+			if(!__atomic_compare_exchange_n(pbyControl, &byOld, (unsigned char)(byOld | MASK_PARKED), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+				continue;
+			}
+		}
+		__MCFCRT_ParkResult eResult;
+		if(bMayTimeOut){
+			LARGE_INTEGER liTimeout;
+			__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+			eResult = __MCFCRT_ParkThreadIf((void *)pbyControl, &ValidateParking, (intptr_t)pbyControl, &liTimeout);
+		} else {
+			eResult = __MCFCRT_ParkThreadIf((void *)pbyControl, &ValidateParking, (intptr_t)pbyControl, _MCFCRT_NULLPTR);
+		}
+		if(eResult == __MCFCRT_kParkResultTimedOut){
+			return _MCFCRT_kOnceResultTimedOut;
+		}
+	}
+}
+__attribute__((__always_inline__))
+static inline void ReallySignalByteOnce(volatile unsigned char *pbyControl, bool bFinished){
+	const unsigned char byOld = __atomic_exchange_n(pbyControl, (unsigned char)(bFinished ? MASK_FINISHED : 0), __ATOMIC_RELEASE);
+	_MCFCRT_ASSERT_MSG(byOld & MASK_LOCKED, L"This byte once flag isn't locked by any thread.");
+	_MCFCRT_ASSERT_MSG(!(byOld & MASK_FINISHED), L"This byte once flag has been disposed.");
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	if(_MCFCRT_EXPECT_NOT((byOld & MASK_PARKED) && !RtlDllShutdownInProgress())){
+		// If the initialization has been aborted, all threads are woken up and compete for it again.
+		__MCFCRT_UnparkAllThreads((void *)pbyControl);
+	}
+}
+
+_MCFCRT_OnceResult __MCFCRT_ReallyWaitForByteOnce(_MCFCRT_ByteOnce *pByteOnce, uint64_t u64UntilFastMonoClock){
+	const _MCFCRT_OnceResult eResult = ReallyWaitForByteOnce(&(pByteOnce->__by), true, u64UntilFastMonoClock);
+	return eResult;
+}
+_MCFCRT_OnceResult __MCFCRT_ReallyWaitForByteOnceForever(_MCFCRT_ByteOnce *pByteOnce){
+	const _MCFCRT_OnceResult eResult = ReallyWaitForByteOnce(&(pByteOnce->__by), false, UINT64_MAX);
+	_MCFCRT_ASSERT(eResult != _MCFCRT_kOnceResultTimedOut);
+	return eResult;
+}
+void __MCFCRT_ReallySignalByteOnceAsFinished(_MCFCRT_ByteOnce *pByteOnce){
+	ReallySignalByteOnce(&(pByteOnce->__by), true);
+}
+void __MCFCRT_ReallySignalByteOnceAsAborted(_MCFCRT_ByteOnce *pByteOnce){
+	ReallySignalByteOnce(&(pByteOnce->__by), false);
+}
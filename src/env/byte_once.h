@@ -0,0 +1,57 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_BYTE_ONCE_H_
+#define __MCFCRT_ENV_BYTE_ONCE_H_
+
+#include "_crtdef.h"
+#include "once_flag.h"
+
+#ifndef __MCFCRT_BYTE_ONCE_INLINE_OR_EXTERN
+#  define __MCFCRT_BYTE_ONCE_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// A byte once flag takes only one byte, which consists of the finished bit, the lock bit and a bit indicating that threads may have been parked on it.
+// Parked threads are kept in the parking lot rather than counted in the flag itself, so it is suitable for embedding in large numbers of small objects.
+// In the case of static initialization, please initialize it with { 0 }.
+typedef struct __MCFCRT_tagByteOnce {
+	unsigned char __by;
+} _MCFCRT_ByteOnce;
+
+#define __MCFCRT_BYTE_ONCE_MASK_FINISHED          ((unsigned char)0x04)
+
+__MCFCRT_BYTE_ONCE_INLINE_OR_EXTERN void _MCFCRT_InitializeByteOnce(_MCFCRT_ByteOnce *__pByteOnce) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pByteOnce->__by), 0, __ATOMIC_RELEASE);
+}
+
+extern _MCFCRT_OnceResult __MCFCRT_ReallyWaitForByteOnce(_MCFCRT_ByteOnce *__pByteOnce, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern _MCFCRT_OnceResult __MCFCRT_ReallyWaitForByteOnceForever(_MCFCRT_ByteOnce *__pByteOnce) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallySignalByteOnceAsFinished(_MCFCRT_ByteOnce *__pByteOnce) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallySignalByteOnceAsAborted(_MCFCRT_ByteOnce *__pByteOnce) _MCFCRT_NOEXCEPT;
+
+// These functions have the same semantics as their counterparts for `_MCFCRT_OnceFlag`.
+__MCFCRT_BYTE_ONCE_INLINE_OR_EXTERN _MCFCRT_OnceResult _MCFCRT_WaitForByteOnce(_MCFCRT_ByteOnce *__pByteOnce, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	if(__builtin_expect(!!(__atomic_load_n(&(__pByteOnce->__by), __ATOMIC_ACQUIRE) & __MCFCRT_BYTE_ONCE_MASK_FINISHED), true)){
+		return _MCFCRT_kOnceResultFinished;
+	}
+	return __MCFCRT_ReallyWaitForByteOnce(__pByteOnce, __u64UntilFastMonoClock);
+}
+__MCFCRT_BYTE_ONCE_INLINE_OR_EXTERN _MCFCRT_OnceResult _MCFCRT_WaitForByteOnceForever(_MCFCRT_ByteOnce *__pByteOnce) _MCFCRT_NOEXCEPT {
+	if(__builtin_expect(!!(__atomic_load_n(&(__pByteOnce->__by), __ATOMIC_ACQUIRE) & __MCFCRT_BYTE_ONCE_MASK_FINISHED), true)){
+		return _MCFCRT_kOnceResultFinished;
+	}
+	return __MCFCRT_ReallyWaitForByteOnceForever(__pByteOnce);
+}
+__MCFCRT_BYTE_ONCE_INLINE_OR_EXTERN void _MCFCRT_SignalByteOnceAsFinished(_MCFCRT_ByteOnce *__pByteOnce) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallySignalByteOnceAsFinished(__pByteOnce);
+}
+__MCFCRT_BYTE_ONCE_INLINE_OR_EXTERN void _MCFCRT_SignalByteOnceAsAborted(_MCFCRT_ByteOnce *__pByteOnce) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallySignalByteOnceAsAborted(__pByteOnce);
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
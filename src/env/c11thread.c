@@ -64,6 +64,23 @@ void __MCFCRT_c11thread_mopthread_wrapper(void *params){
 
 	control->__exit_code = exit_code;
 }
+void __MCFCRT_c11thread_join_all_callback(intptr_t context, size_t index, const void *params, size_t size_of_params){
+	_MCFCRT_ASSERT(size_of_params >= sizeof(__MCFCRT_c11thread_control_t));
+
+	int *const exit_codes_ret = (int *)context;
+	const __MCFCRT_c11thread_control_t *const control = params;
+
+	exit_codes_ret[index] = control->__exit_code;
+}
+void __MCFCRT_c11thread_join_any_callback(intptr_t context, size_t index, const void *params, size_t size_of_params){
+	_MCFCRT_ASSERT(size_of_params >= sizeof(__MCFCRT_c11thread_control_t));
+
+	int *const exit_code_ret = (int *)context;
+	const __MCFCRT_c11thread_control_t *const control = params;
+
+	(void)index;
+	*exit_code_ret = control->__exit_code;
+}
 void __MCFCRT_c11thread_mopthread_exit_modifier(void *params, size_t size_of_params, intptr_t context){
 	_MCFCRT_ASSERT(size_of_params >= sizeof(__MCFCRT_c11thread_control_t));
 
@@ -12,6 +12,7 @@
 #include "tls.h"
 #include "once_flag.h"
 #include "mutex.h"
+#include "shared_mutex.h"
 #include "condition_variable.h"
 #include "clocks.h"
 #include "xassert.h"
@@ -54,6 +55,11 @@ typedef struct __MCFCRT_c11thread_mtx {
 	_MCFCRT_STD uintptr_t __reserved[3];
 } mtx_t;
 
+// Shared mutex (extension)
+typedef struct __MCFCRT_c11thread_mtx_shared {
+	_MCFCRT_SharedMutex __shared_mutex;
+} mtx_shared_t;
+
 // Thread specific storage
 typedef _MCFCRT_TlsKeyHandle tss_t; // typedef void *tss_t;
 typedef void (*tss_dtor_t)(void *);
@@ -134,7 +140,7 @@ __MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_cnd_timedwait(cnd_t *_MCFCRT_RE
 }
 
 __MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_cnd_wait(cnd_t *_MCFCRT_RESTRICT __cond, mtx_t *_MCFCRT_RESTRICT __mutex) _MCFCRT_NOEXCEPT {
-	_MCFCRT_WaitForConditionVariableForever(&(__cond->__cond), &__MCFCRT_c11thread_unlock_callback_mutex, &__MCFCRT_c11thread_relock_callback_mutex, (_MCFCRT_STD intptr_t)__mutex, _MCFCRT_CONDITION_VARIABLE_SUGGESTED_SPIN_COUNT);
+	_MCFCRT_WaitForConditionVariableOnMutexForever(&(__cond->__cond), &__MCFCRT_c11thread_unlock_callback_mutex, &__MCFCRT_c11thread_relock_callback_mutex, (_MCFCRT_STD intptr_t)__mutex, _MCFCRT_CONDITION_VARIABLE_SUGGESTED_SPIN_COUNT, &(__mutex->__mutex));
 	return thrd_success;
 }
 __MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_cnd_signal(cnd_t *__cond) _MCFCRT_NOEXCEPT {
@@ -248,6 +254,85 @@ __MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_mtx_unlock(mtx_t *__mutex) _MCF
 #define mtx_trylock   __MCFCRT_mtx_trylock
 #define mtx_unlock    __MCFCRT_mtx_unlock
 
+//-----------------------------------------------------------------------------
+// Extension: Shared mutex functions
+//-----------------------------------------------------------------------------
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_mtx_shared_init(mtx_shared_t *__mutex) _MCFCRT_NOEXCEPT {
+	_MCFCRT_InitializeSharedMutex(&(__mutex->__shared_mutex));
+	return thrd_success;
+}
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN void __MCFCRT_mtx_shared_destroy(mtx_shared_t *__mutex) _MCFCRT_NOEXCEPT {
+	(void)__mutex;
+}
+
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_mtx_shared_lock(mtx_shared_t *__mutex) _MCFCRT_NOEXCEPT {
+	_MCFCRT_WaitForSharedMutexExclusiveForever(&(__mutex->__shared_mutex), _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT);
+	return thrd_success;
+}
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_mtx_shared_timedlock(mtx_shared_t *_MCFCRT_RESTRICT __mutex, const struct timespec *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_c11thread_translate_timeout(__timeout);
+	if(!_MCFCRT_WaitForSharedMutexExclusive(&(__mutex->__shared_mutex), _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT, __mono_timeout_ms)){
+		return thrd_timedout;
+	}
+	return thrd_success;
+}
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_mtx_shared_trylock(mtx_shared_t *__mutex) _MCFCRT_NOEXCEPT {
+	if(_MCFCRT_EXPECT_NOT(!_MCFCRT_WaitForSharedMutexExclusive(&(__mutex->__shared_mutex), _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT, 0))){
+		return thrd_busy;
+	}
+	return thrd_success;
+}
+
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_mtx_shared_lock_shared(mtx_shared_t *__mutex) _MCFCRT_NOEXCEPT {
+	_MCFCRT_WaitForSharedMutexSharedForever(&(__mutex->__shared_mutex), _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT);
+	return thrd_success;
+}
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_mtx_shared_timedlock_shared(mtx_shared_t *_MCFCRT_RESTRICT __mutex, const struct timespec *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_c11thread_translate_timeout(__timeout);
+	if(!_MCFCRT_WaitForSharedMutexShared(&(__mutex->__shared_mutex), _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT, __mono_timeout_ms)){
+		return thrd_timedout;
+	}
+	return thrd_success;
+}
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_mtx_shared_trylock_shared(mtx_shared_t *__mutex) _MCFCRT_NOEXCEPT {
+	if(_MCFCRT_EXPECT_NOT(!_MCFCRT_WaitForSharedMutexShared(&(__mutex->__shared_mutex), _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT, 0))){
+		return thrd_busy;
+	}
+	return thrd_success;
+}
+
+// If `__timeout` is a null pointer, this function waits indefinitely.
+// It returns `thrd_busy` if another thread is also upgrading, in which case the calling thread still shares the mutex.
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_mtx_shared_upgrade(mtx_shared_t *_MCFCRT_RESTRICT __mutex, const struct timespec *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	if(!__timeout){
+		if(!_MCFCRT_WaitForSharedMutexUpgradeForever(&(__mutex->__shared_mutex), _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT)){
+			return thrd_busy;
+		}
+	} else {
+		const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_c11thread_translate_timeout(__timeout);
+		if(!_MCFCRT_WaitForSharedMutexUpgrade(&(__mutex->__shared_mutex), _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT, __mono_timeout_ms)){
+			return thrd_timedout; // XXX: This could also have been `thrd_busy`.
+		}
+	}
+	return thrd_success;
+}
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_mtx_shared_unlock(mtx_shared_t *__mutex) _MCFCRT_NOEXCEPT {
+	_MCFCRT_SignalSharedMutex(&(__mutex->__shared_mutex));
+	return thrd_success;
+}
+
+#define mtx_shared_init             __MCFCRT_mtx_shared_init
+#define mtx_shared_destroy          __MCFCRT_mtx_shared_destroy
+
+#define mtx_shared_lock             __MCFCRT_mtx_shared_lock
+#define mtx_shared_timedlock        __MCFCRT_mtx_shared_timedlock
+#define mtx_shared_trylock          __MCFCRT_mtx_shared_trylock
+#define mtx_shared_lock_shared      __MCFCRT_mtx_shared_lock_shared
+#define mtx_shared_timedlock_shared __MCFCRT_mtx_shared_timedlock_shared
+#define mtx_shared_trylock_shared   __MCFCRT_mtx_shared_trylock_shared
+#define mtx_shared_upgrade          __MCFCRT_mtx_shared_upgrade
+#define mtx_shared_unlock           __MCFCRT_mtx_shared_unlock
+
 //-----------------------------------------------------------------------------
 // 7.26.5 Thread functions
 //-----------------------------------------------------------------------------
@@ -259,6 +344,8 @@ typedef struct __MCFCRT_c11thread_control {
 
 extern void __MCFCRT_c11thread_mopthread_wrapper(void *__params) _MCFCRT_NOEXCEPT;
 extern void __MCFCRT_c11thread_mopthread_exit_modifier(void *__params, _MCFCRT_STD size_t __size_of_params, _MCFCRT_STD intptr_t __context) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_c11thread_join_all_callback(_MCFCRT_STD intptr_t __context, _MCFCRT_STD size_t __index, const void *__params, _MCFCRT_STD size_t __size_of_params) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_c11thread_join_any_callback(_MCFCRT_STD intptr_t __context, _MCFCRT_STD size_t __index, const void *__params, _MCFCRT_STD size_t __size_of_params) _MCFCRT_NOEXCEPT;
 
 __MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_thrd_create(thrd_t *__tid_ret, thrd_start_t __proc, void *__param) _MCFCRT_NOEXCEPT {
 	__MCFCRT_c11thread_control_t __control = { __proc, __param, (int)0xDEADBEEF };
@@ -269,6 +356,19 @@ __MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_thrd_create(thrd_t *__tid_ret,
 	*__tid_ret = __tid;
 	return thrd_success;
 }
+// This function is an extension. If `__attr` is a null pointer, it is the same as `thrd_create()`.
+// Otherwise, the stack size, the affinity, the ideal processor and the priority in `*__attr` are applied before the thread starts running.
+typedef _MCFCRT_ThreadAttributes thrd_attr_t;
+
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_thrd_create_with_attributes(thrd_t *__tid_ret, thrd_start_t __proc, void *__param, const thrd_attr_t *__attr) _MCFCRT_NOEXCEPT {
+	__MCFCRT_c11thread_control_t __control = { __proc, __param, (int)0xDEADBEEF };
+	const _MCFCRT_STD uintptr_t __tid = __MCFCRT_MopthreadCreateWithAttributes(&__MCFCRT_c11thread_mopthread_wrapper, &__control, sizeof(__control), __attr);
+	if(__tid == 0){
+		return thrd_nomem;
+	}
+	*__tid_ret = __tid;
+	return thrd_success;
+}
 __attribute__((__noreturn__))
 __MCFCRT_C11THREAD_INLINE_OR_EXTERN void __MCFCRT_thrd_exit(int __exit_code) _MCFCRT_NOEXCEPT {
 	__MCFCRT_MopthreadExit(&__MCFCRT_c11thread_mopthread_exit_modifier, __exit_code);
@@ -292,6 +392,44 @@ __MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_thrd_join(thrd_t __tid, int *__
 	}
 	return thrd_success;
 }
+// These functions are extensions. They join threads in `__tids` at once, skipping zero IDs, and set the IDs of threads that have been joined to zero.
+// If `__timeout` is a null pointer, they wait indefinitely. Otherwise, they return `thrd_timedout` on timeout, in which case threads that are still running remain joinable.
+// `__MCFCRT_thrd_join_all()` waits for all threads, storing the exit code of `__tids[i]` into `__exit_codes_ret[i]` unless `__exit_codes_ret` is a null pointer,
+// and returns `thrd_error` if any of them can't be joined, whose ID is left intact.
+// `__MCFCRT_thrd_join_any()` waits for any one of them, stores its index into `*__index_ret`, and returns `thrd_error` if none of them can be joined.
+// Other threads that terminate at the same time may be joined as well, whose IDs are set to zero and whose exit codes are discarded.
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_thrd_join_all(thrd_t *_MCFCRT_RESTRICT __tids, _MCFCRT_STD size_t __count, int *_MCFCRT_RESTRICT __exit_codes_ret, const struct timespec *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD uint64_t __mono_timeout_ms = UINT64_MAX;
+	if(__timeout){
+		__mono_timeout_ms = __MCFCRT_c11thread_translate_timeout(__timeout);
+	}
+	if(!__MCFCRT_MopthreadJoinAll(__tids, __count, __exit_codes_ret ? &__MCFCRT_c11thread_join_all_callback : _MCFCRT_NULLPTR, (_MCFCRT_STD intptr_t)__exit_codes_ret, __mono_timeout_ms)){
+		return thrd_timedout;
+	}
+	for(_MCFCRT_STD size_t __i = 0; __i < __count; ++__i){
+		if(__tids[__i] != 0){
+			return thrd_error; // XXX: ESRCH or EDEADLK
+		}
+	}
+	return thrd_success;
+}
+__MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_thrd_join_any(thrd_t *_MCFCRT_RESTRICT __tids, _MCFCRT_STD size_t __count, _MCFCRT_STD size_t *_MCFCRT_RESTRICT __index_ret, int *_MCFCRT_RESTRICT __exit_code_ret, const struct timespec *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD uint64_t __mono_timeout_ms = UINT64_MAX;
+	if(__timeout){
+		__mono_timeout_ms = __MCFCRT_c11thread_translate_timeout(__timeout);
+	}
+	_MCFCRT_STD size_t __index;
+	if(!__MCFCRT_MopthreadJoinAny(__tids, __count, &__index, __exit_code_ret ? &__MCFCRT_c11thread_join_any_callback : _MCFCRT_NULLPTR, (_MCFCRT_STD intptr_t)__exit_code_ret, __mono_timeout_ms)){
+		return thrd_timedout;
+	}
+	if(__index == SIZE_MAX){
+		return thrd_error; // XXX: ESRCH
+	}
+	if(__index_ret){
+		*__index_ret = __index;
+	}
+	return thrd_success;
+}
 __MCFCRT_C11THREAD_INLINE_OR_EXTERN int __MCFCRT_thrd_detach(thrd_t __tid) _MCFCRT_NOEXCEPT {
 	if(__tid == _MCFCRT_GetCurrentThreadId()){
 		return thrd_error; // XXX: EDEADLK
@@ -343,8 +481,11 @@ __MCFCRT_C11THREAD_INLINE_OR_EXTERN void __MCFCRT_thrd_yield(void) _MCFCRT_NOEXC
 }
 
 #define thrd_create   __MCFCRT_thrd_create
+#define thrd_create_with_attributes   __MCFCRT_thrd_create_with_attributes
 #define thrd_exit     __MCFCRT_thrd_exit
 #define thrd_join     __MCFCRT_thrd_join
+#define thrd_join_all __MCFCRT_thrd_join_all
+#define thrd_join_any __MCFCRT_thrd_join_any
 #define thrd_detach   __MCFCRT_thrd_detach
 
 #define thrd_current  __MCFCRT_thrd_current
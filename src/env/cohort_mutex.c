@@ -0,0 +1,67 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_COHORT_MUTEX_INLINE_OR_EXTERN     extern inline
+#include "cohort_mutex.h"
+#include "_topology.h"
+#include "xassert.h"
+#include "expect.h"
+
+// This is the maximum number of times that the global mutex can be passed between threads on the same node consecutively.
+#define MAX_LOCAL_HAND_OFFS     ((uintptr_t)64)
+
+void _MCFCRT_InitializeCohortMutex(_MCFCRT_CohortMutex *pCohortMutex){
+	_MCFCRT_InitializeMutex(&(pCohortMutex->__vGlobal));
+	__atomic_store_n(&(pCohortMutex->__uOwnerNode), 0, __ATOMIC_RELAXED);
+	for(size_t uIndex = 0; uIndex < _MCFCRT_COHORT_MUTEX_MAX_NODES; ++uIndex){
+		__MCFCRT_CohortMutexNode *const pNode = pCohortMutex->__aNodes + uIndex;
+		_MCFCRT_InitializeMutex(&(pNode->__vLocal));
+		__atomic_store_n(&(pNode->__uWaiting), 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&(pNode->__uHandOffs), 0, __ATOMIC_RELAXED);
+	}
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+bool __MCFCRT_ReallyTryWaitForCohortMutex(_MCFCRT_CohortMutex *pCohortMutex){
+	const size_t uNodeIndex = __MCFCRT_GetCurrentNumaNodeIndex() % _MCFCRT_COHORT_MUTEX_MAX_NODES;
+	__MCFCRT_CohortMutexNode *const pNode = pCohortMutex->__aNodes + uNodeIndex;
+	if(!_MCFCRT_WaitForMutex(&(pNode->__vLocal), 0, 0)){
+		return false;
+	}
+	// `__uHandOffs` is protected by the local mutex. If it is non-zero, the global mutex has been passed to this node.
+	if(__atomic_load_n(&(pNode->__uHandOffs), __ATOMIC_RELAXED) == 0){
+		if(!_MCFCRT_WaitForMutex(&(pCohortMutex->__vGlobal), 0, 0)){
+			_MCFCRT_SignalMutex(&(pNode->__vLocal));
+			return false;
+		}
+	}
+	__atomic_store_n(&(pCohortMutex->__uOwnerNode), uNodeIndex, __ATOMIC_RELAXED);
+	return true;
+}
+void __MCFCRT_ReallyWaitForCohortMutexForever(_MCFCRT_CohortMutex *pCohortMutex, size_t uMaxSpinCount){
+	const size_t uNodeIndex = __MCFCRT_GetCurrentNumaNodeIndex() % _MCFCRT_COHORT_MUTEX_MAX_NODES;
+	__MCFCRT_CohortMutexNode *const pNode = pCohortMutex->__aNodes + uNodeIndex;
+	// Once this counter is incremented, this thread is committed to lock the local mutex. Otherwise the global mutex could be passed to nobody.
+	__atomic_fetch_add(&(pNode->__uWaiting), 1, __ATOMIC_RELAXED);
+	_MCFCRT_WaitForMutexForever(&(pNode->__vLocal), uMaxSpinCount);
+	__atomic_fetch_sub(&(pNode->__uWaiting), 1, __ATOMIC_RELAXED);
+	if(__atomic_load_n(&(pNode->__uHandOffs), __ATOMIC_RELAXED) == 0){
+		_MCFCRT_WaitForMutexForever(&(pCohortMutex->__vGlobal), uMaxSpinCount);
+	}
+	__atomic_store_n(&(pCohortMutex->__uOwnerNode), uNodeIndex, __ATOMIC_RELAXED);
+}
+void __MCFCRT_ReallySignalCohortMutex(_MCFCRT_CohortMutex *pCohortMutex){
+	// The calling thread may have been migrated to another node since it locked the cohort mutex, so don't query the current node again.
+	const size_t uNodeIndex = __atomic_load_n(&(pCohortMutex->__uOwnerNode), __ATOMIC_RELAXED);
+	__MCFCRT_CohortMutexNode *const pNode = pCohortMutex->__aNodes + uNodeIndex;
+	const uintptr_t uHandOffs = __atomic_load_n(&(pNode->__uHandOffs), __ATOMIC_RELAXED);
+	if((__atomic_load_n(&(pNode->__uWaiting), __ATOMIC_RELAXED) != 0) && (uHandOffs < MAX_LOCAL_HAND_OFFS)){
+		// Keep the global mutex locked and pass it to the next thread on this node.
+		__atomic_store_n(&(pNode->__uHandOffs), uHandOffs + 1, __ATOMIC_RELAXED);
+	} else {
+		__atomic_store_n(&(pNode->__uHandOffs), 0, __ATOMIC_RELAXED);
+		_MCFCRT_SignalMutex(&(pCohortMutex->__vGlobal));
+	}
+	_MCFCRT_SignalMutex(&(pNode->__vLocal));
+}
@@ -0,0 +1,59 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_COHORT_MUTEX_H_
+#define __MCFCRT_ENV_COHORT_MUTEX_H_
+
+#include "_crtdef.h"
+#include "mutex.h"
+
+#ifndef __MCFCRT_COHORT_MUTEX_INLINE_OR_EXTERN
+#  define __MCFCRT_COHORT_MUTEX_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// A cohort mutex consists of a global mutex and one local mutex for each NUMA node.
+// A thread locks the local mutex of the node it is running on, then the global mutex. When it unlocks the cohort mutex while other threads
+// are waiting for the same local mutex, it passes the global mutex to them without unlocking it, so ownership stays on the same node.
+// This is done for a bounded number of times before the global mutex is released to other nodes.
+// Hosts with more NUMA nodes than `_MCFCRT_COHORT_MUTEX_MAX_NODES` have multiple nodes share a local mutex.
+// Threads waiting for a local mutex can't give up, hence there are no timed wait functions.
+#define _MCFCRT_COHORT_MUTEX_MAX_NODES   8u
+
+typedef struct __MCFCRT_tagCohortMutexNode {
+	__attribute__((__aligned__(64))) _MCFCRT_Mutex __vLocal;
+	_MCFCRT_STD uintptr_t __uWaiting;
+	_MCFCRT_STD uintptr_t __uHandOffs;
+} __MCFCRT_CohortMutexNode;
+
+typedef struct __MCFCRT_tagCohortMutex {
+	__attribute__((__aligned__(64))) _MCFCRT_Mutex __vGlobal;
+	_MCFCRT_STD uintptr_t __uOwnerNode;
+	__MCFCRT_CohortMutexNode __aNodes[_MCFCRT_COHORT_MUTEX_MAX_NODES];
+} _MCFCRT_CohortMutex;
+
+#define _MCFCRT_COHORT_MUTEX_INIT             { { 0 }, 0, { { { 0 }, 0, 0 } } }
+
+#define _MCFCRT_COHORT_MUTEX_SUGGESTED_SPIN_COUNT   100u
+
+extern void _MCFCRT_InitializeCohortMutex(_MCFCRT_CohortMutex *__pCohortMutex) _MCFCRT_NOEXCEPT;
+
+extern bool __MCFCRT_ReallyTryWaitForCohortMutex(_MCFCRT_CohortMutex *__pCohortMutex) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForCohortMutexForever(_MCFCRT_CohortMutex *__pCohortMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallySignalCohortMutex(_MCFCRT_CohortMutex *__pCohortMutex) _MCFCRT_NOEXCEPT;
+
+__MCFCRT_COHORT_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_TryWaitForCohortMutex(_MCFCRT_CohortMutex *__pCohortMutex) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallyTryWaitForCohortMutex(__pCohortMutex);
+}
+__MCFCRT_COHORT_MUTEX_INLINE_OR_EXTERN void _MCFCRT_WaitForCohortMutexForever(_MCFCRT_CohortMutex *__pCohortMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallyWaitForCohortMutexForever(__pCohortMutex, __uMaxSpinCount);
+}
+__MCFCRT_COHORT_MUTEX_INLINE_OR_EXTERN void _MCFCRT_SignalCohortMutex(_MCFCRT_CohortMutex *__pCohortMutex) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallySignalCohortMutex(__pCohortMutex);
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
@@ -5,15 +5,14 @@
 #define __MCFCRT_CONDITION_VARIABLE_INLINE_OR_EXTERN     extern inline
 #include "condition_variable.h"
 #include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "lock_stats.h"
+#include "clocks.h"
 #include "xassert.h"
 #include "expect.h"
 #include <ntdef.h>
 
-__attribute__((__dllimport__, __stdcall__))
-extern NTSTATUS NtWaitForKeyedEvent(HANDLE hKeyedEvent, void *pKey, BOOLEAN bAlertable, const LARGE_INTEGER *pliTimeout);
-__attribute__((__dllimport__, __stdcall__))
-extern NTSTATUS NtReleaseKeyedEvent(HANDLE hKeyedEvent, void *pKey, BOOLEAN bAlertable, const LARGE_INTEGER *pliTimeout);
-
 __attribute__((__dllimport__, __stdcall__, __const__))
 extern BOOLEAN RtlDllShutdownInProgress(void);
 
@@ -48,15 +47,21 @@ extern BOOLEAN RtlDllShutdownInProgress(void);
 
 static_assert(__builtin_popcountll(MASK_THREADS_RELEASED) == __builtin_popcountll(MASK_THREADS_SPINNING), "MASK_THREADS_RELEASED must have the same number of bits set as MASK_THREADS_SPINNING.");
 
-#define MIN_SPIN_COUNT          ((uintptr_t)64)
+// The spin count shrinks as spinning keeps failing, but no further than this. It is a power of two, so it can be or'd in.
+#define MIN_SPIN_COUNT          ((uintptr_t)4)
+// This many `PAUSE` instructions are executed between checks, which also shrinks as spinning keeps failing.
 #define MAX_SPIN_MULTIPLIER     ((uintptr_t)32)
 
 static inline size_t Min(size_t uSelf, size_t uOther){
 	return (uSelf <= uOther) ? uSelf : uOther;
 }
 
+static bool RequeueOntoMutex(void *pRequeueKey){
+	return __MCFCRT_TrapRequeuedThreadOnMutex((_MCFCRT_Mutex *)pRequeueKey);
+}
+
 __attribute__((__always_inline__))
-static inline bool ReallyWaitForConditionVariable(volatile uintptr_t *puControl, _MCFCRT_ConditionVariableUnlockCallback pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback pfnRelockCallback, intptr_t nContext, size_t uMaxSpinCountInitial, bool bMayTimeOut, uint64_t u64UntilFastMonoClock, bool bRelockIfTimeOut){
+static inline bool ReallyWaitForConditionVariable(volatile uintptr_t *puControl, _MCFCRT_ConditionVariableUnlockCallback pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback pfnRelockCallback, intptr_t nContext, size_t uMaxSpinCountInitial, bool bMayTimeOut, uint64_t u64UntilFastMonoClock, bool bRelockIfTimeOut, _MCFCRT_Mutex *pMutex, __MCFCRT_ParkInterrupt *pInterrupt){
 	size_t uMaxSpinCount, uSpinMultiplier;
 	bool bSignaled, bSpinnable;
 	{
@@ -91,10 +96,15 @@ static inline bool ReallyWaitForConditionVariable(volatile uintptr_t *puControl,
 	if(_MCFCRT_EXPECT(bSignaled)){
 		return true;
 	}
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount((const void *)puControl, _MCFCRT_kLockStatsKindConditionVariable, _MCFCRT_kLockStatsContentions);
+#endif
 	intptr_t nUnlocked;
 	if(_MCFCRT_EXPECT(bSpinnable)){
 		nUnlocked = (*pfnUnlockCallback)(nContext);
-		for(size_t uSpinIndex = 0; _MCFCRT_EXPECT(uSpinIndex < uMaxSpinCount); ++uSpinIndex){
+		const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicksForCount(uMaxSpinCount);
+		const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+		while(_MCFCRT_EXPECT(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks)){
 			register size_t uMultiplierIndex = uSpinMultiplier + 1;
 			__atomic_thread_fence(__ATOMIC_SEQ_CST);
 			do {
@@ -115,6 +125,9 @@ static inline bool ReallyWaitForConditionVariable(volatile uintptr_t *puControl,
 				} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)));
 			}
 			if(_MCFCRT_EXPECT_NOT(bSignaled)){
+#ifdef __MCFCRT_LOCK_STATS
+				__MCFCRT_LockStatsAddCount((const void *)puControl, _MCFCRT_kLockStatsKindConditionVariable, _MCFCRT_kLockStatsSpinSuccesses);
+#endif
 				(*pfnRelockCallback)(nContext, nUnlocked);
 				return true;
 			}
@@ -135,9 +148,15 @@ static inline bool ReallyWaitForConditionVariable(volatile uintptr_t *puControl,
 			} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)));
 		}
 		if(_MCFCRT_EXPECT(bSignaled)){
+#ifdef __MCFCRT_LOCK_STATS
+			__MCFCRT_LockStatsAddCount((const void *)puControl, _MCFCRT_kLockStatsKindConditionVariable, _MCFCRT_kLockStatsSpinSuccesses);
+#endif
 			(*pfnRelockCallback)(nContext, nUnlocked);
 			return true;
 		}
+#ifdef __MCFCRT_LOCK_STATS
+		__MCFCRT_LockStatsAddCount((const void *)puControl, _MCFCRT_kLockStatsKindConditionVariable, _MCFCRT_kLockStatsSpinFailures);
+#endif
 	} else {
 		{
 			uintptr_t uOld, uNew;
@@ -156,11 +175,14 @@ static inline bool ReallyWaitForConditionVariable(volatile uintptr_t *puControl,
 		}
 		nUnlocked = (*pfnUnlockCallback)(nContext);
 	}
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount((const void *)puControl, _MCFCRT_kLockStatsKindConditionVariable, _MCFCRT_kLockStatsSleeps);
+#endif
 	if(bMayTimeOut){
 		LARGE_INTEGER liTimeout;
 		__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
-		NTSTATUS lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, &liTimeout);
-		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+		NTSTATUS lStatus = __MCFCRT_ParkThreadInterruptible((void *)puControl, &liTimeout, pInterrupt);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThreadInterruptible() failed.");
 		while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
 			bool bDecremented;
 			{
@@ -182,12 +204,16 @@ static inline bool ReallyWaitForConditionVariable(volatile uintptr_t *puControl,
 				return false;
 			}
 			liTimeout.QuadPart = 0;
-			lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, &liTimeout);
-			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+			lStatus = __MCFCRT_ParkThreadInterruptible((void *)puControl, &liTimeout, pInterrupt);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThreadInterruptible() failed.");
 		}
+	} else if(pMutex){
+		// If the mutex is still locked when we are signaled, we would block on it as soon as we were woken up.
+		// In that case we are moved onto the mutex and will not be woken up until it is unlocked.
+		__MCFCRT_ParkThreadRequeueable((void *)puControl, (void *)&(pMutex->__u), &RequeueOntoMutex);
 	} else {
-		NTSTATUS lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, _MCFCRT_NULLPTR);
-		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+		NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, _MCFCRT_NULLPTR);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
 		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
 	}
 	(*pfnRelockCallback)(nContext, nUnlocked);
@@ -213,28 +239,78 @@ static inline size_t ReallySignalConditionVariable(volatile uintptr_t *puControl
 		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)));
 	}
 	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
-	// Calling `NtReleaseKeyedEvent()` when no thread is waiting results in deadlocks. Don't do that.
+	// Unparking threads that will never park leaves stale wakeups behind. Don't do that.
 	if(_MCFCRT_EXPECT_NOT((uCountToSignal > 0) && !RtlDllShutdownInProgress())){
-		for(size_t uIndex = 0; uIndex < uCountToSignal; ++uIndex){
-			NTSTATUS lStatus = NtReleaseKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, _MCFCRT_NULLPTR);
-			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtReleaseKeyedEvent() failed.");
-			_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
-		}
+		// Only one thread is woken up here. The others are woken up in a cascade.
+		NTSTATUS lStatus = __MCFCRT_UnparkThreads((void *)puControl, uCountToSignal);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThreads() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
 	}
 	return uCountToRelease + uCountToSignal;
 }
 
 bool __MCFCRT_ReallyWaitForConditionVariable(_MCFCRT_ConditionVariable *pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback pfnRelockCallback, intptr_t nContext, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
-	const bool bSignaled = ReallyWaitForConditionVariable(&(pConditionVariable->__u), pfnUnlockCallback, pfnRelockCallback, nContext, uMaxSpinCount, true, u64UntilFastMonoClock, true);
+#ifdef __MCFCRT_LOCK_STATS
+	const uint64_t u64BeginTsc = _MCFCRT_ReadTimeStampCounter64();
+#endif
+	const bool bSignaled = ReallyWaitForConditionVariable(&(pConditionVariable->__u), pfnUnlockCallback, pfnRelockCallback, nContext, uMaxSpinCount, true, u64UntilFastMonoClock, true, _MCFCRT_NULLPTR, _MCFCRT_NULLPTR);
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount(pConditionVariable, _MCFCRT_kLockStatsKindConditionVariable, bSignaled ? _MCFCRT_kLockStatsAcquisitions : _MCFCRT_kLockStatsTimeouts);
+	__MCFCRT_LockStatsAddWaitTime(pConditionVariable, _MCFCRT_kLockStatsKindConditionVariable, u64BeginTsc);
+#endif
 	return bSignaled;
 }
 bool __MCFCRT_ReallyWaitForConditionVariableOrAbandon(_MCFCRT_ConditionVariable *pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback pfnRelockCallback, intptr_t nContext, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
-	const bool bSignaled = ReallyWaitForConditionVariable(&(pConditionVariable->__u), pfnUnlockCallback, pfnRelockCallback, nContext, uMaxSpinCount, true, u64UntilFastMonoClock, false);
+#ifdef __MCFCRT_LOCK_STATS
+	const uint64_t u64BeginTsc = _MCFCRT_ReadTimeStampCounter64();
+#endif
+	const bool bSignaled = ReallyWaitForConditionVariable(&(pConditionVariable->__u), pfnUnlockCallback, pfnRelockCallback, nContext, uMaxSpinCount, true, u64UntilFastMonoClock, false, _MCFCRT_NULLPTR, _MCFCRT_NULLPTR);
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount(pConditionVariable, _MCFCRT_kLockStatsKindConditionVariable, bSignaled ? _MCFCRT_kLockStatsAcquisitions : _MCFCRT_kLockStatsTimeouts);
+	__MCFCRT_LockStatsAddWaitTime(pConditionVariable, _MCFCRT_kLockStatsKindConditionVariable, u64BeginTsc);
+#endif
 	return bSignaled;
 }
 void __MCFCRT_ReallyWaitForConditionVariableForever(_MCFCRT_ConditionVariable *pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback pfnRelockCallback, intptr_t nContext, size_t uMaxSpinCount){
-	const bool bSignaled = ReallyWaitForConditionVariable(&(pConditionVariable->__u), pfnUnlockCallback, pfnRelockCallback, nContext, uMaxSpinCount, false, UINT64_MAX, true);
+#ifdef __MCFCRT_LOCK_STATS
+	const uint64_t u64BeginTsc = _MCFCRT_ReadTimeStampCounter64();
+#endif
+	const bool bSignaled = ReallyWaitForConditionVariable(&(pConditionVariable->__u), pfnUnlockCallback, pfnRelockCallback, nContext, uMaxSpinCount, false, UINT64_MAX, true, _MCFCRT_NULLPTR, _MCFCRT_NULLPTR);
+	_MCFCRT_ASSERT(bSignaled);
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount(pConditionVariable, _MCFCRT_kLockStatsKindConditionVariable, _MCFCRT_kLockStatsAcquisitions);
+	__MCFCRT_LockStatsAddWaitTime(pConditionVariable, _MCFCRT_kLockStatsKindConditionVariable, u64BeginTsc);
+#endif
+}
+void __MCFCRT_ReallyWaitForConditionVariableOnMutexForever(_MCFCRT_ConditionVariable *pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback pfnRelockCallback, intptr_t nContext, size_t uMaxSpinCount, _MCFCRT_Mutex *pMutex){
+#ifdef __MCFCRT_LOCK_STATS
+	const uint64_t u64BeginTsc = _MCFCRT_ReadTimeStampCounter64();
+#endif
+	const bool bSignaled = ReallyWaitForConditionVariable(&(pConditionVariable->__u), pfnUnlockCallback, pfnRelockCallback, nContext, uMaxSpinCount, false, UINT64_MAX, true, pMutex, _MCFCRT_NULLPTR);
 	_MCFCRT_ASSERT(bSignaled);
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount(pConditionVariable, _MCFCRT_kLockStatsKindConditionVariable, _MCFCRT_kLockStatsAcquisitions);
+	__MCFCRT_LockStatsAddWaitTime(pConditionVariable, _MCFCRT_kLockStatsKindConditionVariable, u64BeginTsc);
+#endif
+}
+bool __MCFCRT_ReallyWaitForConditionVariableOrStop(_MCFCRT_ConditionVariable *pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback pfnRelockCallback, intptr_t nContext, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock, _MCFCRT_StopToken *pStopToken){
+	__MCFCRT_ParkInterrupt vInterrupt;
+	__MCFCRT_InitializeParkInterrupt(&vInterrupt);
+	_MCFCRT_StopCallback vCallback;
+	if(!_MCFCRT_RegisterStopCallback(pStopToken, &vCallback, &__MCFCRT_InterruptParkedThreadOnStop, (intptr_t)&vInterrupt)){
+		// The lock has not been released, so there is nothing to relock.
+		return false;
+	}
+#ifdef __MCFCRT_LOCK_STATS
+	const uint64_t u64BeginTsc = _MCFCRT_ReadTimeStampCounter64();
+#endif
+	const bool bSignaled = ReallyWaitForConditionVariable(&(pConditionVariable->__u), pfnUnlockCallback, pfnRelockCallback, nContext, uMaxSpinCount, true, u64UntilFastMonoClock, true, _MCFCRT_NULLPTR, &vInterrupt);
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount(pConditionVariable, _MCFCRT_kLockStatsKindConditionVariable, bSignaled ? _MCFCRT_kLockStatsAcquisitions : _MCFCRT_kLockStatsTimeouts);
+	__MCFCRT_LockStatsAddWaitTime(pConditionVariable, _MCFCRT_kLockStatsKindConditionVariable, u64BeginTsc);
+#endif
+	_MCFCRT_UnregisterStopCallback(pStopToken, &vCallback);
+	return bSignaled;
 }
 size_t __MCFCRT_ReallySignalConditionVariable(_MCFCRT_ConditionVariable *pConditionVariable, size_t uMaxCountToSignal){
 	return ReallySignalConditionVariable(&(pConditionVariable->__u), uMaxCountToSignal);
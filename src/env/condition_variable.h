@@ -6,6 +6,7 @@
 #define __MCFCRT_ENV_CONDITION_VARIABLE_H_
 
 #include "_crtdef.h"
+#include "mutex.h"
 
 #ifndef __MCFCRT_CONDITION_VARIABLE_INLINE_OR_EXTERN
 #  define __MCFCRT_CONDITION_VARIABLE_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
@@ -30,6 +31,8 @@ __MCFCRT_CONDITION_VARIABLE_INLINE_OR_EXTERN void _MCFCRT_InitializeConditionVar
 extern bool __MCFCRT_ReallyWaitForConditionVariable(_MCFCRT_ConditionVariable *__pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
 extern bool __MCFCRT_ReallyWaitForConditionVariableOrAbandon(_MCFCRT_ConditionVariable *__pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
 extern void __MCFCRT_ReallyWaitForConditionVariableForever(_MCFCRT_ConditionVariable *__pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForConditionVariableOnMutexForever(_MCFCRT_ConditionVariable *__pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_Mutex *__pMutex) _MCFCRT_NOEXCEPT;
+extern bool __MCFCRT_ReallyWaitForConditionVariableOrStop(_MCFCRT_ConditionVariable *__pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock, _MCFCRT_StopToken *__pStopToken) _MCFCRT_NOEXCEPT;
 extern _MCFCRT_STD size_t __MCFCRT_ReallySignalConditionVariable(_MCFCRT_ConditionVariable *__pConditionVariable, _MCFCRT_STD size_t __uMaxCountToSignal) _MCFCRT_NOEXCEPT;
 extern _MCFCRT_STD size_t __MCFCRT_ReallyBroadcastConditionVariable(_MCFCRT_ConditionVariable *__pConditionVariable) _MCFCRT_NOEXCEPT;
 
@@ -42,6 +45,19 @@ __MCFCRT_CONDITION_VARIABLE_INLINE_OR_EXTERN bool _MCFCRT_WaitForConditionVariab
 __MCFCRT_CONDITION_VARIABLE_INLINE_OR_EXTERN void _MCFCRT_WaitForConditionVariableForever(_MCFCRT_ConditionVariable *__pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
 	__MCFCRT_ReallyWaitForConditionVariableForever(__pConditionVariable, __pfnUnlockCallback, __pfnRelockCallback, __nContext, __uMaxSpinCount);
 }
+// This function is the same as `_MCFCRT_WaitForConditionVariableForever()`, except that `__pfnRelockCallback` must lock `__pMutex` (and it may do other things).
+// If `__pMutex` is still locked when the calling thread is signaled, the thread is moved onto it and will not be woken up until it is unlocked,
+// which saves a context switch that would be wasted on blocking on the mutex again.
+__MCFCRT_CONDITION_VARIABLE_INLINE_OR_EXTERN void _MCFCRT_WaitForConditionVariableOnMutexForever(_MCFCRT_ConditionVariable *__pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_Mutex *__pMutex) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallyWaitForConditionVariableOnMutexForever(__pConditionVariable, __pfnUnlockCallback, __pfnRelockCallback, __nContext, __uMaxSpinCount, __pMutex);
+}
+// This function is the same as `_MCFCRT_WaitForConditionVariable()`, except that it also fails if a stop is requested on `__pStopToken`,
+// which wakes up only the calling thread, rather than all threads waiting on the condition variable.
+// If a stop has been requested before the call, `false` is returned without unlocking anything. Otherwise the lock is always relocked.
+// Pass `UINT64_MAX` as `__u64UntilFastMonoClock` to wait without a timeout. Call `_MCFCRT_IsStopRequested()` to tell a stop from a timeout.
+__MCFCRT_CONDITION_VARIABLE_INLINE_OR_EXTERN bool _MCFCRT_WaitForConditionVariableOrStop(_MCFCRT_ConditionVariable *__pConditionVariable, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock, _MCFCRT_StopToken *__pStopToken) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallyWaitForConditionVariableOrStop(__pConditionVariable, __pfnUnlockCallback, __pfnRelockCallback, __nContext, __uMaxSpinCount, __u64UntilFastMonoClock, __pStopToken);
+}
 __MCFCRT_CONDITION_VARIABLE_INLINE_OR_EXTERN _MCFCRT_STD size_t _MCFCRT_SignalConditionVariable(_MCFCRT_ConditionVariable *__pConditionVariable, _MCFCRT_STD size_t __uMaxCountToSignal) _MCFCRT_NOEXCEPT {
 	return __MCFCRT_ReallySignalConditionVariable(__pConditionVariable, __uMaxCountToSignal);
 }
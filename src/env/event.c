@@ -0,0 +1,142 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_EVENT_INLINE_OR_EXTERN     extern inline
+#include "event.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "clocks.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+#define MASK_SET                ((uintptr_t)0x01)
+#define MASK_MANUAL_RESET       ((uintptr_t)0x02)
+#define MASK_THREADS_TRAPPED    ((uintptr_t)~(uintptr_t)0x03)
+
+#define THREADS_TRAPPED_ONE     ((uintptr_t)(MASK_THREADS_TRAPPED & -MASK_THREADS_TRAPPED))
+#define THREADS_TRAPPED_MAX     ((uintptr_t)(MASK_THREADS_TRAPPED / THREADS_TRAPPED_ONE))
+
+static_assert(MASK_SET == __MCFCRT_EVENT_MASK_SET, "The inline functions in the header rely on this.");
+static_assert(MASK_MANUAL_RESET == __MCFCRT_EVENT_MASK_MANUAL_RESET, "The inline functions in the header rely on this.");
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForEvent(volatile uintptr_t *puControl, size_t uMaxSpinCount, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicksForCount(uMaxSpinCount);
+	const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+	while(_MCFCRT_EXPECT(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks)){
+		__builtin_ia32_pause();
+		// Only perform a read here, which doesn't bounce the cache line.
+		uintptr_t uOld = __atomic_load_n(puControl, __ATOMIC_ACQUIRE);
+		if(!(uOld & MASK_SET)){
+			continue;
+		}
+		if(uOld & MASK_MANUAL_RESET){
+			return true;
+		}
+		if(_MCFCRT_EXPECT(__atomic_compare_exchange_n(puControl, &uOld, uOld & ~MASK_SET, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))){
+			return true;
+		}
+	}
+	bool bTaken;
+	{
+		uintptr_t uOld, uNew;
+		// If a manual-reset event has been set, we break out of the loop without a successful exchange, so this has to acquire on its own.
+		uOld = __atomic_load_n(puControl, __ATOMIC_ACQUIRE);
+		do {
+			bTaken = !!(uOld & MASK_SET);
+			if(!bTaken){
+				_MCFCRT_ASSERT_MSG((uOld & MASK_THREADS_TRAPPED) != MASK_THREADS_TRAPPED, L"Too many threads are waiting for this event.");
+				uNew = uOld + THREADS_TRAPPED_ONE;
+			} else if(!(uOld & MASK_MANUAL_RESET)){
+				uNew = uOld & ~MASK_SET;
+			} else {
+				break;
+			}
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
+	}
+	if(_MCFCRT_EXPECT(bTaken)){
+		return true;
+	}
+	// Trapped threads are woken up only when the event is set for them. See `ReallySetEvent()`.
+	if(bMayTimeOut){
+		LARGE_INTEGER liTimeout;
+		__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+		NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, &liTimeout);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
+			bool bDecremented;
+			{
+				uintptr_t uOld, uNew;
+				uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+				do {
+					const size_t uThreadsTrapped = (uOld & MASK_THREADS_TRAPPED) / THREADS_TRAPPED_ONE;
+					bDecremented = uThreadsTrapped != 0;
+					if(!bDecremented){
+						break;
+					}
+					uNew = uOld - THREADS_TRAPPED_ONE;
+				} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+			}
+			if(bDecremented){
+				return false;
+			}
+			liTimeout.QuadPart = 0;
+			lStatus = __MCFCRT_ParkThread((void *)puControl, &liTimeout);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		}
+	} else {
+		NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, _MCFCRT_NULLPTR);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+	return true;
+}
+__attribute__((__always_inline__))
+static inline void ReallySetEvent(volatile uintptr_t *puControl){
+	uintptr_t uCountToSignal;
+	{
+		uintptr_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			const size_t uThreadsTrapped = (uOld & MASK_THREADS_TRAPPED) / THREADS_TRAPPED_ONE;
+			if(uOld & MASK_MANUAL_RESET){
+				// Wake up all trapped threads and leave the event set for new ones.
+				uCountToSignal = uThreadsTrapped;
+				uNew = MASK_MANUAL_RESET | MASK_SET;
+			} else if(uThreadsTrapped != 0){
+				// The event is reset by the thread that is woken up implicitly.
+				uCountToSignal = 1;
+				uNew = uOld - THREADS_TRAPPED_ONE;
+			} else {
+				uCountToSignal = 0;
+				uNew = uOld | MASK_SET;
+			}
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)));
+	}
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	// Unparking threads that will never park leaves stale wakeups behind. Don't do that.
+	if(_MCFCRT_EXPECT_NOT((uCountToSignal > 0) && !RtlDllShutdownInProgress())){
+		// Only one thread is woken up here. The others are woken up in a cascade.
+		NTSTATUS lStatus = __MCFCRT_UnparkThreads((void *)puControl, uCountToSignal);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThreads() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+}
+
+bool __MCFCRT_ReallyWaitForEvent(_MCFCRT_Event *pEvent, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+	const bool bTaken = ReallyWaitForEvent(&(pEvent->__u), uMaxSpinCount, true, u64UntilFastMonoClock);
+	return bTaken;
+}
+void __MCFCRT_ReallyWaitForEventForever(_MCFCRT_Event *pEvent, size_t uMaxSpinCount){
+	const bool bTaken = ReallyWaitForEvent(&(pEvent->__u), uMaxSpinCount, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bTaken);
+}
+void __MCFCRT_ReallySetEvent(_MCFCRT_Event *pEvent){
+	ReallySetEvent(&(pEvent->__u));
+}
@@ -0,0 +1,81 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_EVENT_H_
+#define __MCFCRT_ENV_EVENT_H_
+
+#include "_crtdef.h"
+
+#ifndef __MCFCRT_EVENT_INLINE_OR_EXTERN
+#  define __MCFCRT_EVENT_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// In the case of static initialization, please initialize it with `_MCFCRT_EVENT_INITIALIZER(manual_reset, initially_set)`,
+// or { 0 } for an auto-reset event that is initially not set.
+typedef struct __MCFCRT_tagEvent {
+	_MCFCRT_STD uintptr_t __u;
+} _MCFCRT_Event;
+
+#define _MCFCRT_EVENT_SUGGESTED_SPIN_COUNT   100u
+
+// The lowest two bits of the control word are the set bit and the mode bit. The rest is the counter of trapped threads.
+#define __MCFCRT_EVENT_MASK_SET              ((_MCFCRT_STD uintptr_t)0x01)
+#define __MCFCRT_EVENT_MASK_MANUAL_RESET     ((_MCFCRT_STD uintptr_t)0x02)
+
+#define _MCFCRT_EVENT_INITIALIZER(__manual_reset_, __initially_set_)	\
+	{ ((__manual_reset_) ? __MCFCRT_EVENT_MASK_MANUAL_RESET : 0) | ((__initially_set_) ? __MCFCRT_EVENT_MASK_SET : 0) }
+
+__MCFCRT_EVENT_INLINE_OR_EXTERN void _MCFCRT_InitializeEvent(_MCFCRT_Event *__pEvent, bool __bManualReset, bool __bInitiallySet) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pEvent->__u), (__bManualReset ? __MCFCRT_EVENT_MASK_MANUAL_RESET : 0) | (__bInitiallySet ? __MCFCRT_EVENT_MASK_SET : 0), __ATOMIC_RELEASE);
+}
+
+extern bool __MCFCRT_ReallyWaitForEvent(_MCFCRT_Event *__pEvent, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForEventForever(_MCFCRT_Event *__pEvent, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallySetEvent(_MCFCRT_Event *__pEvent) _MCFCRT_NOEXCEPT;
+
+// Returns `true` if the event is set and resets it if it is an auto-reset event. This function never blocks.
+__MCFCRT_EVENT_INLINE_OR_EXTERN bool _MCFCRT_TryWaitForEvent(_MCFCRT_Event *__pEvent) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD uintptr_t __uOld = __atomic_load_n(&(__pEvent->__u), __ATOMIC_ACQUIRE);
+	do {
+		if(!(__uOld & __MCFCRT_EVENT_MASK_SET)){
+			return false;
+		}
+		if(__uOld & __MCFCRT_EVENT_MASK_MANUAL_RESET){
+			return true;
+		}
+	} while(__builtin_expect(!__atomic_compare_exchange_n(&(__pEvent->__u), &__uOld, __uOld & ~__MCFCRT_EVENT_MASK_SET, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE), false));
+	return true;
+}
+__MCFCRT_EVENT_INLINE_OR_EXTERN bool _MCFCRT_WaitForEvent(_MCFCRT_Event *__pEvent, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	if(__builtin_expect(_MCFCRT_TryWaitForEvent(__pEvent), true)){
+		return true;
+	}
+	return __MCFCRT_ReallyWaitForEvent(__pEvent, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_EVENT_INLINE_OR_EXTERN void _MCFCRT_WaitForEventForever(_MCFCRT_Event *__pEvent, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	if(__builtin_expect(_MCFCRT_TryWaitForEvent(__pEvent), true)){
+		return;
+	}
+	__MCFCRT_ReallyWaitForEventForever(__pEvent, __uMaxSpinCount);
+}
+// If no thread is waiting, this function only sets the set bit, which takes no kernel transition.
+// Otherwise, an auto-reset event wakes up one waiting thread and remains not set, and a manual-reset event wakes up all of them and becomes set.
+__MCFCRT_EVENT_INLINE_OR_EXTERN void _MCFCRT_SetEvent(_MCFCRT_Event *__pEvent) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD uintptr_t __uOld = __atomic_load_n(&(__pEvent->__u), __ATOMIC_RELAXED);
+	do {
+		if(__uOld > (__MCFCRT_EVENT_MASK_SET | __MCFCRT_EVENT_MASK_MANUAL_RESET)){
+			__MCFCRT_ReallySetEvent(__pEvent);
+			return;
+		}
+	} while(__builtin_expect(!__atomic_compare_exchange_n(&(__pEvent->__u), &__uOld, __uOld | __MCFCRT_EVENT_MASK_SET, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED), false));
+}
+__MCFCRT_EVENT_INLINE_OR_EXTERN void _MCFCRT_ResetEvent(_MCFCRT_Event *__pEvent) _MCFCRT_NOEXCEPT {
+	__atomic_fetch_and(&(__pEvent->__u), ~__MCFCRT_EVENT_MASK_SET, __ATOMIC_RELAXED);
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
@@ -0,0 +1,105 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_EVENT_COUNT_INLINE_OR_EXTERN     extern inline
+#include "event_count.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "clocks.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+#define MASK_WAITERS            ((uint64_t)0x00000000FFFFFFFF)
+#define MASK_EPOCH              ((uint64_t)0xFFFFFFFF00000000)
+
+#define WAITERS_ONE             ((uint64_t)(MASK_WAITERS & -MASK_WAITERS))
+#define EPOCH_ONE               ((uint64_t)(MASK_EPOCH & -MASK_EPOCH))
+
+static_assert(MASK_WAITERS == __MCFCRT_EVENT_COUNT_MASK_WAITERS, "The inline functions in the header rely on this.");
+static_assert(EPOCH_ONE == __MCFCRT_EVENT_COUNT_EPOCH_ONE, "The inline functions in the header rely on this.");
+static_assert(WAITERS_ONE == 1, "The inline functions in the header rely on this.");
+
+typedef struct tagWaitContext {
+	volatile uint64_t *puControl;
+	_MCFCRT_EventCountKey uKey;
+} WaitContext;
+
+static inline bool HasEpochChanged(uint64_t uControl, _MCFCRT_EventCountKey uKey){
+	return (_MCFCRT_EventCountKey)((uControl & MASK_EPOCH) / EPOCH_ONE) != uKey;
+}
+// This callback is called with the bucket locked, which serializes it with the notifying thread.
+static bool ValidateParking(intptr_t nContext){
+	const WaitContext *const pContext = (const WaitContext *)nContext;
+	return !HasEpochChanged(__atomic_load_n(pContext->puControl, __ATOMIC_ACQUIRE), pContext->uKey);
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyCommitWaitForEventCount(volatile uint64_t *puControl, _MCFCRT_EventCountKey uKey, size_t uMaxSpinCount, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	bool bNotified = false;
+	const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicksForCount(uMaxSpinCount);
+	const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+	while(_MCFCRT_EXPECT(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks)){
+		__builtin_ia32_pause();
+		// Only perform a read here, which doesn't bounce the cache line.
+		if(HasEpochChanged(__atomic_load_n(puControl, __ATOMIC_ACQUIRE), uKey)){
+			bNotified = true;
+			break;
+		}
+	}
+	if(!bNotified){
+		const WaitContext vContext = { puControl, uKey };
+		for(;;){
+			__MCFCRT_ParkResult eResult;
+			if(bMayTimeOut){
+				LARGE_INTEGER liTimeout;
+				__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+				eResult = __MCFCRT_ParkThreadIf((void *)puControl, &ValidateParking, (intptr_t)&vContext, &liTimeout);
+			} else {
+				eResult = __MCFCRT_ParkThreadIf((void *)puControl, &ValidateParking, (intptr_t)&vContext, _MCFCRT_NULLPTR);
+			}
+			bNotified = HasEpochChanged(__atomic_load_n(puControl, __ATOMIC_ACQUIRE), uKey);
+			if(bNotified || (eResult == __MCFCRT_kParkResultTimedOut)){
+				break;
+			}
+		}
+	}
+	// This thread is no longer waiting, no matter whether it has been notified.
+	const uint64_t uOld = __atomic_fetch_sub(puControl, WAITERS_ONE, __ATOMIC_RELAXED);
+	_MCFCRT_ASSERT_MSG(uOld & MASK_WAITERS, L"No thread is waiting for this event count.");
+	return bNotified;
+}
+__attribute__((__always_inline__))
+static inline void ReallyNotifyEventCount(volatile uint64_t *puControl, bool bBroadcast){
+	// Threads that have prepared but not committed see the new epoch and will not park.
+	__atomic_fetch_add(puControl, EPOCH_ONE, __ATOMIC_SEQ_CST);
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	if(_MCFCRT_EXPECT_NOT(RtlDllShutdownInProgress())){
+		return;
+	}
+	if(bBroadcast){
+		__MCFCRT_UnparkAllThreads((void *)puControl);
+	} else {
+		__MCFCRT_UnparkOneThread((void *)puControl, _MCFCRT_NULLPTR, 0);
+	}
+}
+
+bool __MCFCRT_ReallyCommitWaitForEventCount(_MCFCRT_EventCount *pEventCount, _MCFCRT_EventCountKey uKey, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+	const bool bNotified = ReallyCommitWaitForEventCount(&(pEventCount->__u), uKey, uMaxSpinCount, true, u64UntilFastMonoClock);
+	return bNotified;
+}
+void __MCFCRT_ReallyCommitWaitForEventCountForever(_MCFCRT_EventCount *pEventCount, _MCFCRT_EventCountKey uKey, size_t uMaxSpinCount){
+	const bool bNotified = ReallyCommitWaitForEventCount(&(pEventCount->__u), uKey, uMaxSpinCount, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bNotified);
+}
+void __MCFCRT_ReallySignalEventCount(_MCFCRT_EventCount *pEventCount){
+	ReallyNotifyEventCount(&(pEventCount->__u), false);
+}
+void __MCFCRT_ReallyBroadcastEventCount(_MCFCRT_EventCount *pEventCount){
+	ReallyNotifyEventCount(&(pEventCount->__u), true);
+}
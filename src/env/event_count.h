@@ -0,0 +1,83 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_EVENT_COUNT_H_
+#define __MCFCRT_ENV_EVENT_COUNT_H_
+
+#include "_crtdef.h"
+
+#ifndef __MCFCRT_EVENT_COUNT_INLINE_OR_EXTERN
+#  define __MCFCRT_EVENT_COUNT_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// An event count lets threads block on a condition of a lock-free data structure without adding a lock to it. A consumer does this:
+//   for(;;){
+//     if(try_pop(&item)) break;
+//     key = _MCFCRT_PrepareWaitForEventCount(&ec);
+//     if(try_pop(&item)){ _MCFCRT_CancelWaitForEventCount(&ec); break; }
+//     _MCFCRT_CommitWaitForEventCountForever(&ec, key, spin);
+//   }
+// and a producer calls `_MCFCRT_SignalEventCount()` or `_MCFCRT_BroadcastEventCount()` after pushing an item.
+// The control word consists of the epoch, which is incremented by each notification that finds waiting threads, and the number of waiting threads.
+// In the case of static initialization, please initialize it with { 0 }.
+typedef struct __MCFCRT_tagEventCount {
+	__attribute__((__aligned__(8))) _MCFCRT_STD uint64_t __u;
+} _MCFCRT_EventCount;
+
+typedef _MCFCRT_STD uint32_t _MCFCRT_EventCountKey;
+
+#define _MCFCRT_EVENT_COUNT_SUGGESTED_SPIN_COUNT   100u
+
+// The lower half of the control word is the number of waiting threads. The upper half is the epoch.
+#define __MCFCRT_EVENT_COUNT_MASK_WAITERS          ((_MCFCRT_STD uint64_t)0x00000000FFFFFFFF)
+#define __MCFCRT_EVENT_COUNT_EPOCH_ONE             ((_MCFCRT_STD uint64_t)1 << 32)
+
+__MCFCRT_EVENT_COUNT_INLINE_OR_EXTERN void _MCFCRT_InitializeEventCount(_MCFCRT_EventCount *__pEventCount) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pEventCount->__u), 0, __ATOMIC_RELEASE);
+}
+
+extern bool __MCFCRT_ReallyCommitWaitForEventCount(_MCFCRT_EventCount *__pEventCount, _MCFCRT_EventCountKey __uKey, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyCommitWaitForEventCountForever(_MCFCRT_EventCount *__pEventCount, _MCFCRT_EventCountKey __uKey, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallySignalEventCount(_MCFCRT_EventCount *__pEventCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyBroadcastEventCount(_MCFCRT_EventCount *__pEventCount) _MCFCRT_NOEXCEPT;
+
+// Registers the calling thread as a waiting thread. It must be followed by exactly one call to either `_MCFCRT_CancelWaitForEventCount()`
+// or one of the commit functions, after the condition has been checked again.
+__MCFCRT_EVENT_COUNT_INLINE_OR_EXTERN _MCFCRT_EventCountKey _MCFCRT_PrepareWaitForEventCount(_MCFCRT_EventCount *__pEventCount) _MCFCRT_NOEXCEPT {
+	// This has to be sequentially consistent, so either the condition is checked after the notification, or the notification sees this thread.
+	const _MCFCRT_STD uint64_t __uOld = __atomic_fetch_add(&(__pEventCount->__u), 1, __ATOMIC_SEQ_CST);
+	return (_MCFCRT_EventCountKey)(__uOld / __MCFCRT_EVENT_COUNT_EPOCH_ONE);
+}
+__MCFCRT_EVENT_COUNT_INLINE_OR_EXTERN void _MCFCRT_CancelWaitForEventCount(_MCFCRT_EventCount *__pEventCount) _MCFCRT_NOEXCEPT {
+	__atomic_fetch_sub(&(__pEventCount->__u), 1, __ATOMIC_RELAXED);
+}
+// These functions return when a notification has been made after `__uKey` was obtained. The timed one returns `false` if the operation has timed out.
+__MCFCRT_EVENT_COUNT_INLINE_OR_EXTERN bool _MCFCRT_CommitWaitForEventCount(_MCFCRT_EventCount *__pEventCount, _MCFCRT_EventCountKey __uKey, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallyCommitWaitForEventCount(__pEventCount, __uKey, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_EVENT_COUNT_INLINE_OR_EXTERN void _MCFCRT_CommitWaitForEventCountForever(_MCFCRT_EventCount *__pEventCount, _MCFCRT_EventCountKey __uKey, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallyCommitWaitForEventCountForever(__pEventCount, __uKey, __uMaxSpinCount);
+}
+// If no thread is waiting, these functions only perform a fence and a load, which doesn't bounce the cache line.
+// The fence orders the preceding update of the data structure before the load, without which a thread that is about to wait could be missed.
+__MCFCRT_EVENT_COUNT_INLINE_OR_EXTERN void _MCFCRT_SignalEventCount(_MCFCRT_EventCount *__pEventCount) _MCFCRT_NOEXCEPT {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__builtin_expect(!(__atomic_load_n(&(__pEventCount->__u), __ATOMIC_RELAXED) & __MCFCRT_EVENT_COUNT_MASK_WAITERS), true)){
+		return;
+	}
+	__MCFCRT_ReallySignalEventCount(__pEventCount);
+}
+__MCFCRT_EVENT_COUNT_INLINE_OR_EXTERN void _MCFCRT_BroadcastEventCount(_MCFCRT_EventCount *__pEventCount) _MCFCRT_NOEXCEPT {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__builtin_expect(!(__atomic_load_n(&(__pEventCount->__u), __ATOMIC_RELAXED) & __MCFCRT_EVENT_COUNT_MASK_WAITERS), true)){
+		return;
+	}
+	__MCFCRT_ReallyBroadcastEventCount(__pEventCount);
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
@@ -5,6 +5,7 @@
 #define __MCFCRT_GTHREAD_INLINE_OR_EXTERN     extern inline
 #include "gthread.h"
 #include "_seh_top.h"
+#include "heap.h"
 
 void __MCFCRT_gthread_tls_destructor(intptr_t context, void *storage){
 	void (*const destructor)(void *) = (void (*)(void *))context;
@@ -66,3 +67,40 @@ void __MCFCRT_gthread_mopthread_wrapper(void *params){
 
 	control->__exit_code = exit_code;
 }
+void __MCFCRT_gthread_join_all_callback(intptr_t context, size_t index, const void *params, size_t size_of_params){
+	_MCFCRT_ASSERT(size_of_params >= sizeof(__MCFCRT_gthread_control_t));
+
+	void **const exit_codes_ret = (void **)context;
+	const __MCFCRT_gthread_control_t *const control = params;
+
+	exit_codes_ret[index] = control->__exit_code;
+}
+void __MCFCRT_gthread_join_any_callback(intptr_t context, size_t index, const void *params, size_t size_of_params){
+	_MCFCRT_ASSERT(size_of_params >= sizeof(__MCFCRT_gthread_control_t));
+
+	void **const exit_code_ret = (void **)context;
+	const __MCFCRT_gthread_control_t *const control = params;
+
+	(void)index;
+	*exit_code_ret = control->__exit_code;
+}
+int __MCFCRT_gthread_create_many(__gthread_t *tids_ret, size_t count, void *(*proc)(void *), void *const *params, const __gthread_attr_t *attr){
+	if(count > SIZE_MAX / sizeof(__MCFCRT_gthread_control_t)){
+		return EAGAIN;
+	}
+	__MCFCRT_gthread_control_t *const controls = _MCFCRT_malloc(count * sizeof(__MCFCRT_gthread_control_t));
+	if(!controls && (count != 0)){
+		return EAGAIN;
+	}
+	for(size_t i = 0; i < count; ++i){
+		controls[i].__proc      = proc;
+		controls[i].__param     = params ? params[i] : _MCFCRT_NULLPTR;
+		controls[i].__exit_code = (void *)0xDEADBEEF;
+	}
+	const bool succeeded = __MCFCRT_MopthreadCreateMany(tids_ret, count, &__MCFCRT_gthread_mopthread_wrapper, controls, sizeof(__MCFCRT_gthread_control_t), attr);
+	_MCFCRT_free(controls);
+	if(!succeeded){
+		return EAGAIN;
+	}
+	return 0;
+}
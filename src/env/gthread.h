@@ -12,7 +12,11 @@
 #include "tls.h"
 #include "once_flag.h"
 #include "mutex.h"
+#include "shared_mutex.h"
+#include "semaphore.h"
+#include "seq_lock.h"
 #include "condition_variable.h"
+#include "stop_token.h"
 #include "clocks.h"
 #include "xassert.h"
 #include "expect.h"
@@ -207,6 +211,164 @@ __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_recursive_mutex_unlock(__
 #define __gthread_recursive_mutex_lock            __MCFCRT_gthread_recursive_mutex_lock
 #define __gthread_recursive_mutex_unlock          __MCFCRT_gthread_recursive_mutex_unlock
 
+//-----------------------------------------------------------------------------
+// Reader-writer lock (extension)
+//-----------------------------------------------------------------------------
+#define __GTHREAD_HAS_RWLOCK 1
+
+typedef _MCFCRT_SharedMutex __gthread_rwlock_t;
+
+#define __GTHREAD_RWLOCK_INIT            { 0 }
+#define __GTHREAD_RWLOCK_INIT_FUNCTION   __gthread_rwlock_init_function
+
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN void __MCFCRT_gthread_rwlock_init_function(__gthread_rwlock_t *__rwlock) _MCFCRT_NOEXCEPT {
+	_MCFCRT_InitializeSharedMutex(__rwlock);
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_rwlock_destroy(__gthread_rwlock_t *__rwlock) _MCFCRT_NOEXCEPT {
+	(void)__rwlock;
+	return 0;
+}
+
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_rwlock_tryrdlock(__gthread_rwlock_t *__rwlock) _MCFCRT_NOEXCEPT {
+	if(_MCFCRT_EXPECT_NOT(!_MCFCRT_WaitForSharedMutexShared(__rwlock, _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT, 0))){
+		return EBUSY;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_rwlock_rdlock(__gthread_rwlock_t *__rwlock) _MCFCRT_NOEXCEPT {
+	_MCFCRT_WaitForSharedMutexSharedForever(__rwlock, _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT);
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_rwlock_trywrlock(__gthread_rwlock_t *__rwlock) _MCFCRT_NOEXCEPT {
+	if(_MCFCRT_EXPECT_NOT(!_MCFCRT_WaitForSharedMutexExclusive(__rwlock, _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT, 0))){
+		return EBUSY;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_rwlock_wrlock(__gthread_rwlock_t *__rwlock) _MCFCRT_NOEXCEPT {
+	_MCFCRT_WaitForSharedMutexExclusiveForever(__rwlock, _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT);
+	return 0;
+}
+// This function fails with `EDEADLK` if another thread is also upgrading its read lock, in which case the read lock is kept.
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_rwlock_upgrade(__gthread_rwlock_t *__rwlock) _MCFCRT_NOEXCEPT {
+	if(_MCFCRT_EXPECT_NOT(!_MCFCRT_WaitForSharedMutexUpgradeForever(__rwlock, _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT))){
+		return EDEADLK;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_rwlock_unlock(__gthread_rwlock_t *__rwlock) _MCFCRT_NOEXCEPT {
+	_MCFCRT_SignalSharedMutex(__rwlock);
+	return 0;
+}
+
+#define __gthread_rwlock_init_function   __MCFCRT_gthread_rwlock_init_function
+#define __gthread_rwlock_destroy         __MCFCRT_gthread_rwlock_destroy
+
+#define __gthread_rwlock_tryrdlock       __MCFCRT_gthread_rwlock_tryrdlock
+#define __gthread_rwlock_rdlock          __MCFCRT_gthread_rwlock_rdlock
+#define __gthread_rwlock_trywrlock       __MCFCRT_gthread_rwlock_trywrlock
+#define __gthread_rwlock_wrlock          __MCFCRT_gthread_rwlock_wrlock
+#define __gthread_rwlock_upgrade         __MCFCRT_gthread_rwlock_upgrade
+#define __gthread_rwlock_unlock          __MCFCRT_gthread_rwlock_unlock
+
+//-----------------------------------------------------------------------------
+// Counting semaphore (extension)
+//-----------------------------------------------------------------------------
+// These functions are meant to back `std::counting_semaphore` and `std::binary_semaphore`.
+#define __GTHREAD_HAS_SEMAPHORE 1
+
+typedef _MCFCRT_Semaphore __gthread_sem_t;
+
+#define __GTHREAD_SEM_INIT(__count_)     _MCFCRT_SEMAPHORE_INITIALIZER(__count_)
+#define __GTHREAD_SEM_VALUE_MAX          _MCFCRT_SEMAPHORE_COUNT_MAX
+
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_sem_init(__gthread_sem_t *__sem, unsigned __count) _MCFCRT_NOEXCEPT {
+	_MCFCRT_InitializeSemaphore(__sem, __count);
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_sem_destroy(__gthread_sem_t *__sem) _MCFCRT_NOEXCEPT {
+	(void)__sem;
+	return 0;
+}
+
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_sem_trywait(__gthread_sem_t *__sem) _MCFCRT_NOEXCEPT {
+	if(_MCFCRT_EXPECT_NOT(!_MCFCRT_TryWaitForSemaphore(__sem))){
+		return EAGAIN;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_sem_wait(__gthread_sem_t *__sem) _MCFCRT_NOEXCEPT {
+	_MCFCRT_WaitForSemaphoreForever(__sem, _MCFCRT_SEMAPHORE_SUGGESTED_SPIN_COUNT);
+	return 0;
+}
+// Unlike `sem_post()`, this function may add more than one to the count at a time, which `std::counting_semaphore::release()` needs.
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_sem_post(__gthread_sem_t *__sem, unsigned __count) _MCFCRT_NOEXCEPT {
+	_MCFCRT_SignalSemaphore(__sem, __count);
+	return 0;
+}
+
+#define __gthread_sem_init               __MCFCRT_gthread_sem_init
+#define __gthread_sem_destroy            __MCFCRT_gthread_sem_destroy
+
+#define __gthread_sem_trywait            __MCFCRT_gthread_sem_trywait
+#define __gthread_sem_wait               __MCFCRT_gthread_sem_wait
+#define __gthread_sem_post               __MCFCRT_gthread_sem_post
+
+//-----------------------------------------------------------------------------
+// Sequence lock (extension)
+//-----------------------------------------------------------------------------
+// A reader calls `__gthread_seqlock_read_begin()`, reads the protected data using atomic operations, then calls `__gthread_seqlock_read_validate()`.
+// If the latter fails with `EAGAIN`, the data might have been modified meanwhile, and the reader has to start over.
+#define __GTHREAD_HAS_SEQLOCK 1
+
+typedef _MCFCRT_SeqLock __gthread_seqlock_t;
+typedef _MCFCRT_SeqLockToken __gthread_seqlock_token_t;
+
+#define __GTHREAD_SEQLOCK_INIT            { 0 }
+#define __GTHREAD_SEQLOCK_INIT_FUNCTION   __gthread_seqlock_init_function
+
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN void __MCFCRT_gthread_seqlock_init_function(__gthread_seqlock_t *__seqlock) _MCFCRT_NOEXCEPT {
+	_MCFCRT_InitializeSeqLock(__seqlock);
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_seqlock_destroy(__gthread_seqlock_t *__seqlock) _MCFCRT_NOEXCEPT {
+	(void)__seqlock;
+	return 0;
+}
+
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_seqlock_read_begin(__gthread_seqlock_t *_MCFCRT_RESTRICT __seqlock, __gthread_seqlock_token_t *_MCFCRT_RESTRICT __token) _MCFCRT_NOEXCEPT {
+	*__token = _MCFCRT_BeginReadingSeqLock(__seqlock, _MCFCRT_SEQ_LOCK_SUGGESTED_SPIN_COUNT);
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_seqlock_read_validate(__gthread_seqlock_t *__seqlock, __gthread_seqlock_token_t __token) _MCFCRT_NOEXCEPT {
+	if(_MCFCRT_EXPECT_NOT(!_MCFCRT_ValidateReadingSeqLock(__seqlock, __token))){
+		return EAGAIN;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_seqlock_trywrlock(__gthread_seqlock_t *__seqlock) _MCFCRT_NOEXCEPT {
+	if(_MCFCRT_EXPECT_NOT(!_MCFCRT_WaitForSeqLock(__seqlock, _MCFCRT_SEQ_LOCK_SUGGESTED_SPIN_COUNT, 0))){
+		return EBUSY;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_seqlock_wrlock(__gthread_seqlock_t *__seqlock) _MCFCRT_NOEXCEPT {
+	_MCFCRT_WaitForSeqLockForever(__seqlock, _MCFCRT_SEQ_LOCK_SUGGESTED_SPIN_COUNT);
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_seqlock_wrunlock(__gthread_seqlock_t *__seqlock) _MCFCRT_NOEXCEPT {
+	_MCFCRT_SignalSeqLock(__seqlock);
+	return 0;
+}
+
+#define __gthread_seqlock_init_function   __MCFCRT_gthread_seqlock_init_function
+#define __gthread_seqlock_destroy         __MCFCRT_gthread_seqlock_destroy
+
+#define __gthread_seqlock_read_begin      __MCFCRT_gthread_seqlock_read_begin
+#define __gthread_seqlock_read_validate   __MCFCRT_gthread_seqlock_read_validate
+#define __gthread_seqlock_trywrlock       __MCFCRT_gthread_seqlock_trywrlock
+#define __gthread_seqlock_wrlock          __MCFCRT_gthread_seqlock_wrlock
+#define __gthread_seqlock_wrunlock        __MCFCRT_gthread_seqlock_wrunlock
+
 //-----------------------------------------------------------------------------
 // Condition variable
 //-----------------------------------------------------------------------------
@@ -232,11 +394,11 @@ __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_cond_destroy(__gthread_co
 }
 
 __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_cond_wait(__gthread_cond_t *__cond, __gthread_mutex_t *__mutex) _MCFCRT_NOEXCEPT {
-	_MCFCRT_WaitForConditionVariableForever(__cond, &__MCFCRT_gthread_unlock_callback_mutex, &__MCFCRT_gthread_relock_callback_mutex, (_MCFCRT_STD intptr_t)__mutex, _MCFCRT_CONDITION_VARIABLE_SUGGESTED_SPIN_COUNT);
+	_MCFCRT_WaitForConditionVariableOnMutexForever(__cond, &__MCFCRT_gthread_unlock_callback_mutex, &__MCFCRT_gthread_relock_callback_mutex, (_MCFCRT_STD intptr_t)__mutex, _MCFCRT_CONDITION_VARIABLE_SUGGESTED_SPIN_COUNT, __mutex);
 	return 0;
 }
 __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_cond_wait_recursive(__gthread_cond_t *__cond, __gthread_recursive_mutex_t *__recur_mutex) _MCFCRT_NOEXCEPT {
-	_MCFCRT_WaitForConditionVariableForever(__cond, &__MCFCRT_gthread_unlock_callback_recursive_mutex, &__MCFCRT_gthread_relock_callback_recursive_mutex, (_MCFCRT_STD intptr_t)__recur_mutex, _MCFCRT_CONDITION_VARIABLE_SUGGESTED_SPIN_COUNT);
+	_MCFCRT_WaitForConditionVariableOnMutexForever(__cond, &__MCFCRT_gthread_unlock_callback_recursive_mutex, &__MCFCRT_gthread_relock_callback_recursive_mutex, (_MCFCRT_STD intptr_t)__recur_mutex, _MCFCRT_CONDITION_VARIABLE_SUGGESTED_SPIN_COUNT, &(__recur_mutex->__mutex));
 	return 0;
 }
 __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_cond_signal(__gthread_cond_t *__cond) _MCFCRT_NOEXCEPT {
@@ -280,6 +442,23 @@ __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_create(__gthread_t *__tid
 	*__tid_ret = __tid;
 	return 0;
 }
+// This function is an extension. If `__attr` is a null pointer, it is the same as `__gthread_create()`.
+// Otherwise, the stack size, the affinity, the ideal processor and the priority in `*__attr` are applied before the thread starts running.
+typedef _MCFCRT_ThreadAttributes __gthread_attr_t;
+
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_create_with_attributes(__gthread_t *__tid_ret, void *(*__proc)(void *), void *__param, const __gthread_attr_t *__attr) _MCFCRT_NOEXCEPT {
+	__MCFCRT_gthread_control_t __control = { __proc, __param, (void *)0xDEADBEEF };
+	const _MCFCRT_STD uintptr_t __tid = __MCFCRT_MopthreadCreateWithAttributes(&__MCFCRT_gthread_mopthread_wrapper, &__control, sizeof(__control), __attr);
+	if(__tid == 0){
+		return EAGAIN;
+	}
+	*__tid_ret = __tid;
+	return 0;
+}
+// This function is an extension. It creates `__count` threads running `__proc`, the i-th of which gets `__params[i]`, or a null pointer if `__params` is a null pointer.
+// Either all threads are created and their IDs are stored into `__tids_ret`, or none is. `__attr` may be a null pointer.
+extern int __MCFCRT_gthread_create_many(__gthread_t *__tids_ret, _MCFCRT_STD size_t __count, void *(*__proc)(void *), void *const *__params, const __gthread_attr_t *__attr) _MCFCRT_NOEXCEPT;
+
 __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_join(__gthread_t __tid, void **_MCFCRT_RESTRICT __exit_code_ret) _MCFCRT_NOEXCEPT {
 	if(__tid == _MCFCRT_GetCurrentThreadId()){
 		return EDEADLK;
@@ -299,6 +478,40 @@ __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_join(__gthread_t __tid, v
 	}
 	return 0;
 }
+// These functions are extensions. They join threads in `__tids` at once, skipping zero IDs, and set the IDs of threads that have been joined to zero.
+// `__MCFCRT_gthread_join_all()` waits for all threads, storing the exit code of `__tids[i]` into `__exit_codes_ret[i]` unless `__exit_codes_ret` is a null pointer,
+// and fails with `ESRCH` if any of them can't be joined, whose ID is left intact.
+// `__MCFCRT_gthread_join_any()` waits for any one of them, stores its index into `*__index_ret`, and fails with `ESRCH` if none of them can be joined.
+// Other threads that terminate at the same time may be joined as well, whose IDs are set to zero and whose exit codes are discarded.
+extern void __MCFCRT_gthread_join_all_callback(_MCFCRT_STD intptr_t __context, _MCFCRT_STD size_t __index, const void *__params, _MCFCRT_STD size_t __size_of_params) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_gthread_join_any_callback(_MCFCRT_STD intptr_t __context, _MCFCRT_STD size_t __index, const void *__params, _MCFCRT_STD size_t __size_of_params) _MCFCRT_NOEXCEPT;
+
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_check_joined_all(const __gthread_t *__tids, _MCFCRT_STD size_t __count) _MCFCRT_NOEXCEPT {
+	for(_MCFCRT_STD size_t __i = 0; __i < __count; ++__i){
+		if(__tids[__i] == 0){
+			continue;
+		}
+		return (__tids[__i] == _MCFCRT_GetCurrentThreadId()) ? EDEADLK : ESRCH;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_join_all(__gthread_t *_MCFCRT_RESTRICT __tids, _MCFCRT_STD size_t __count, void **_MCFCRT_RESTRICT __exit_codes_ret) _MCFCRT_NOEXCEPT {
+	const bool __joined = __MCFCRT_MopthreadJoinAll(__tids, __count, __exit_codes_ret ? &__MCFCRT_gthread_join_all_callback : _MCFCRT_NULLPTR, (_MCFCRT_STD intptr_t)__exit_codes_ret, UINT64_MAX);
+	_MCFCRT_ASSERT(__joined);
+	return __MCFCRT_gthread_check_joined_all(__tids, __count);
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_join_any(__gthread_t *_MCFCRT_RESTRICT __tids, _MCFCRT_STD size_t __count, _MCFCRT_STD size_t *_MCFCRT_RESTRICT __index_ret, void **_MCFCRT_RESTRICT __exit_code_ret) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD size_t __index;
+	const bool __joined = __MCFCRT_MopthreadJoinAny(__tids, __count, &__index, __exit_code_ret ? &__MCFCRT_gthread_join_any_callback : _MCFCRT_NULLPTR, (_MCFCRT_STD intptr_t)__exit_code_ret, UINT64_MAX);
+	_MCFCRT_ASSERT(__joined);
+	if(__index == SIZE_MAX){
+		return ESRCH;
+	}
+	if(__index_ret){
+		*__index_ret = __index;
+	}
+	return 0;
+}
 __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_detach(__gthread_t __tid) _MCFCRT_NOEXCEPT {
 	if(__tid == _MCFCRT_GetCurrentThreadId()){
 		return EDEADLK;
@@ -320,15 +533,108 @@ __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_yield(void) _MCFCRT_NOEXC
 	_MCFCRT_YieldThread();
 	return 0;
 }
+// This function is an extension. It sets the maximum number of threads that are kept for reuse after their procedures return, and returns the old one.
+// See `__MCFCRT_MopthreadSetCacheCapacity()` for caveats.
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN _MCFCRT_STD size_t __MCFCRT_gthread_set_thread_cache_capacity(_MCFCRT_STD size_t __capacity) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_MopthreadSetCacheCapacity(__capacity);
+}
 
 #define __gthread_create   __MCFCRT_gthread_create
+#define __gthread_create_with_attributes   __MCFCRT_gthread_create_with_attributes
+#define __gthread_create_many              __MCFCRT_gthread_create_many
 #define __gthread_join     __MCFCRT_gthread_join
+#define __gthread_join_all   __MCFCRT_gthread_join_all
+#define __gthread_join_any   __MCFCRT_gthread_join_any
 #define __gthread_detach   __MCFCRT_gthread_detach
 
 #define __gthread_equal    __MCFCRT_gthread_equal
 #define __gthread_self     __MCFCRT_gthread_self
 #define __gthread_yield    __MCFCRT_gthread_yield
 
+#define __gthread_set_thread_cache_capacity   __MCFCRT_gthread_set_thread_cache_capacity
+
+//-----------------------------------------------------------------------------
+// Stop token (extension)
+//-----------------------------------------------------------------------------
+// These functions are meant to back `std::stop_token`, `std::stop_callback` and the overloads of `std::condition_variable_any::wait()` taking a stop token.
+// A function that waits fails with `ECANCELED` if a stop is requested before it returns otherwise. Only the threads waiting with that stop token are woken up.
+#define __GTHREAD_HAS_STOP_TOKEN 1
+
+typedef _MCFCRT_StopToken __gthread_stop_token_t;
+typedef _MCFCRT_StopCallback __gthread_stop_callback_t;
+
+#define __GTHREAD_STOP_TOKEN_INIT            { 0 }
+#define __GTHREAD_STOP_TOKEN_INIT_FUNCTION   __gthread_stop_token_init_function
+
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN void __MCFCRT_gthread_stop_token_init_function(__gthread_stop_token_t *__stop) _MCFCRT_NOEXCEPT {
+	_MCFCRT_InitializeStopToken(__stop);
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_stop_token_destroy(__gthread_stop_token_t *__stop) _MCFCRT_NOEXCEPT {
+	(void)__stop;
+	return 0;
+}
+
+// This function returns non-zero if it has requested the stop, and zero if a stop had been requested before.
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_stop_token_request_stop(__gthread_stop_token_t *__stop) _MCFCRT_NOEXCEPT {
+	return _MCFCRT_RequestStop(__stop);
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_stop_token_stop_requested(const __gthread_stop_token_t *__stop) _MCFCRT_NOEXCEPT {
+	return _MCFCRT_IsStopRequested(__stop);
+}
+// If a stop has been requested, this function fails with `ECANCELED` and the callback is not registered, in which case the caller shall call it.
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_stop_callback_register(__gthread_stop_token_t *_MCFCRT_RESTRICT __stop, __gthread_stop_callback_t *_MCFCRT_RESTRICT __callback, void (*__proc)(_MCFCRT_STD intptr_t), _MCFCRT_STD intptr_t __context) _MCFCRT_NOEXCEPT {
+	if(!_MCFCRT_RegisterStopCallback(__stop, __callback, __proc, __context)){
+		return ECANCELED;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_stop_callback_unregister(__gthread_stop_token_t *_MCFCRT_RESTRICT __stop, __gthread_stop_callback_t *_MCFCRT_RESTRICT __callback) _MCFCRT_NOEXCEPT {
+	_MCFCRT_UnregisterStopCallback(__stop, __callback);
+	return 0;
+}
+
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_mutex_lock_or_stop(__gthread_mutex_t *_MCFCRT_RESTRICT __mutex, __gthread_stop_token_t *_MCFCRT_RESTRICT __stop) _MCFCRT_NOEXCEPT {
+	if(!_MCFCRT_WaitForMutexOrStop(__mutex, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT, UINT64_MAX, __stop)){
+		return ECANCELED;
+	}
+	return 0;
+}
+// The mutex is locked when this function returns, even if it fails.
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_cond_wait_or_stop(__gthread_cond_t *_MCFCRT_RESTRICT __cond, __gthread_mutex_t *_MCFCRT_RESTRICT __mutex, __gthread_stop_token_t *_MCFCRT_RESTRICT __stop) _MCFCRT_NOEXCEPT {
+	if(!_MCFCRT_WaitForConditionVariableOrStop(__cond, &__MCFCRT_gthread_unlock_callback_mutex, &__MCFCRT_gthread_relock_callback_mutex, (_MCFCRT_STD intptr_t)__mutex, _MCFCRT_CONDITION_VARIABLE_SUGGESTED_SPIN_COUNT, UINT64_MAX, __stop)){
+		return ECANCELED;
+	}
+	return 0;
+}
+// If this function fails with `ECANCELED`, the thread remains joinable.
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_join_or_stop(__gthread_t __tid, void **_MCFCRT_RESTRICT __exit_code_ret, __gthread_stop_token_t *_MCFCRT_RESTRICT __stop) _MCFCRT_NOEXCEPT {
+	if(__tid == _MCFCRT_GetCurrentThreadId()){
+		return EDEADLK;
+	}
+	__MCFCRT_gthread_control_t __control;
+	__builtin_memset(&__control, 0, sizeof(__control));
+	_MCFCRT_STD size_t __size_copied = sizeof(__control);
+	if(!__MCFCRT_MopthreadJoinOrStop(__tid, &__control, &__size_copied, __stop)){
+		return _MCFCRT_IsStopRequested(__stop) ? ECANCELED : ESRCH;
+	}
+	if(__exit_code_ret){
+		*__exit_code_ret = __control.__exit_code;
+	}
+	return 0;
+}
+
+#define __gthread_stop_token_init_function   __MCFCRT_gthread_stop_token_init_function
+#define __gthread_stop_token_destroy         __MCFCRT_gthread_stop_token_destroy
+
+#define __gthread_stop_token_request_stop    __MCFCRT_gthread_stop_token_request_stop
+#define __gthread_stop_token_stop_requested  __MCFCRT_gthread_stop_token_stop_requested
+#define __gthread_stop_callback_register     __MCFCRT_gthread_stop_callback_register
+#define __gthread_stop_callback_unregister   __MCFCRT_gthread_stop_callback_unregister
+
+#define __gthread_mutex_lock_or_stop         __MCFCRT_gthread_mutex_lock_or_stop
+#define __gthread_cond_wait_or_stop          __MCFCRT_gthread_cond_wait_or_stop
+#define __gthread_join_or_stop               __MCFCRT_gthread_join_or_stop
+
 //-----------------------------------------------------------------------------
 // Timed functions
 //-----------------------------------------------------------------------------
@@ -381,9 +687,84 @@ __MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_cond_timedwait(__gthread_
 	return 0;
 }
 
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_rwlock_timedrdlock(__gthread_rwlock_t *_MCFCRT_RESTRICT __rwlock, const __gthread_time_t *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_gthread_translate_timeout(__timeout);
+	if(!_MCFCRT_WaitForSharedMutexShared(__rwlock, _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT, __mono_timeout_ms)){
+		return ETIMEDOUT;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_rwlock_timedwrlock(__gthread_rwlock_t *_MCFCRT_RESTRICT __rwlock, const __gthread_time_t *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_gthread_translate_timeout(__timeout);
+	if(!_MCFCRT_WaitForSharedMutexExclusive(__rwlock, _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT, __mono_timeout_ms)){
+		return ETIMEDOUT;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_rwlock_timedupgrade(__gthread_rwlock_t *_MCFCRT_RESTRICT __rwlock, const __gthread_time_t *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_gthread_translate_timeout(__timeout);
+	if(!_MCFCRT_WaitForSharedMutexUpgrade(__rwlock, _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT, __mono_timeout_ms)){
+		return ETIMEDOUT;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_sem_timedwait(__gthread_sem_t *_MCFCRT_RESTRICT __sem, const __gthread_time_t *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_gthread_translate_timeout(__timeout);
+	if(!_MCFCRT_WaitForSemaphore(__sem, _MCFCRT_SEMAPHORE_SUGGESTED_SPIN_COUNT, __mono_timeout_ms)){
+		return ETIMEDOUT;
+	}
+	return 0;
+}
+// This function fails with `ECANCELED` if a stop is requested, and with `ETIMEDOUT` if it times out. The mutex is locked when it returns in either case.
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_cond_timedwait_or_stop(__gthread_cond_t *_MCFCRT_RESTRICT __cond, __gthread_mutex_t *_MCFCRT_RESTRICT __mutex, const __gthread_time_t *_MCFCRT_RESTRICT __timeout, __gthread_stop_token_t *_MCFCRT_RESTRICT __stop) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_gthread_translate_timeout(__timeout);
+	if(!_MCFCRT_WaitForConditionVariableOrStop(__cond, &__MCFCRT_gthread_unlock_callback_mutex, &__MCFCRT_gthread_relock_callback_mutex, (_MCFCRT_STD intptr_t)__mutex, _MCFCRT_CONDITION_VARIABLE_SUGGESTED_SPIN_COUNT, __mono_timeout_ms, __stop)){
+		return _MCFCRT_IsStopRequested(__stop) ? ECANCELED : ETIMEDOUT;
+	}
+	return 0;
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_seqlock_timedwrlock(__gthread_seqlock_t *_MCFCRT_RESTRICT __seqlock, const __gthread_time_t *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_gthread_translate_timeout(__timeout);
+	if(!_MCFCRT_WaitForSeqLock(__seqlock, _MCFCRT_SEQ_LOCK_SUGGESTED_SPIN_COUNT, __mono_timeout_ms)){
+		return ETIMEDOUT;
+	}
+	return 0;
+}
+// These functions are extensions. They are the same as `__MCFCRT_gthread_join_all()` and `__MCFCRT_gthread_join_any()`, except that they fail with `ETIMEDOUT` on timeout,
+// in which case threads that are still running remain joinable. `__MCFCRT_gthread_timedjoin_all()` may have joined some of them even if it fails.
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_timedjoin_all(__gthread_t *_MCFCRT_RESTRICT __tids, _MCFCRT_STD size_t __count, void **_MCFCRT_RESTRICT __exit_codes_ret, const __gthread_time_t *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_gthread_translate_timeout(__timeout);
+	if(!__MCFCRT_MopthreadJoinAll(__tids, __count, __exit_codes_ret ? &__MCFCRT_gthread_join_all_callback : _MCFCRT_NULLPTR, (_MCFCRT_STD intptr_t)__exit_codes_ret, __mono_timeout_ms)){
+		return ETIMEDOUT;
+	}
+	return __MCFCRT_gthread_check_joined_all(__tids, __count);
+}
+__MCFCRT_GTHREAD_INLINE_OR_EXTERN int __MCFCRT_gthread_timedjoin_any(__gthread_t *_MCFCRT_RESTRICT __tids, _MCFCRT_STD size_t __count, _MCFCRT_STD size_t *_MCFCRT_RESTRICT __index_ret, void **_MCFCRT_RESTRICT __exit_code_ret, const __gthread_time_t *_MCFCRT_RESTRICT __timeout) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uint64_t __mono_timeout_ms = __MCFCRT_gthread_translate_timeout(__timeout);
+	_MCFCRT_STD size_t __index;
+	if(!__MCFCRT_MopthreadJoinAny(__tids, __count, &__index, __exit_code_ret ? &__MCFCRT_gthread_join_any_callback : _MCFCRT_NULLPTR, (_MCFCRT_STD intptr_t)__exit_code_ret, __mono_timeout_ms)){
+		return ETIMEDOUT;
+	}
+	if(__index == SIZE_MAX){
+		return ESRCH;
+	}
+	if(__index_ret){
+		*__index_ret = __index;
+	}
+	return 0;
+}
+
 #define __gthread_mutex_timedlock            __MCFCRT_gthread_mutex_timedlock
 #define __gthread_recursive_mutex_timedlock  __MCFCRT_gthread_recursive_mutex_timedlock
 #define __gthread_cond_timedwait             __MCFCRT_gthread_cond_timedwait
+#define __gthread_rwlock_timedrdlock         __MCFCRT_gthread_rwlock_timedrdlock
+#define __gthread_rwlock_timedwrlock         __MCFCRT_gthread_rwlock_timedwrlock
+#define __gthread_rwlock_timedupgrade        __MCFCRT_gthread_rwlock_timedupgrade
+#define __gthread_sem_timedwait              __MCFCRT_gthread_sem_timedwait
+#define __gthread_cond_timedwait_or_stop     __MCFCRT_gthread_cond_timedwait_or_stop
+#define __gthread_seqlock_timedwrlock        __MCFCRT_gthread_seqlock_timedwrlock
+#define __gthread_timedjoin_all              __MCFCRT_gthread_timedjoin_all
+#define __gthread_timedjoin_any              __MCFCRT_gthread_timedjoin_any
 
 _MCFCRT_EXTERN_C_END
 
@@ -0,0 +1,130 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_LATCH_INLINE_OR_EXTERN     extern inline
+#include "latch.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "clocks.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+#define MASK_THREADS_TRAPPED    ((uint64_t)0x00000000FFFFFFFF)
+#define MASK_COUNT              ((uint64_t)0xFFFFFFFF00000000)
+
+#define THREADS_TRAPPED_ONE     ((uint64_t)(MASK_THREADS_TRAPPED & -MASK_THREADS_TRAPPED))
+#define THREADS_TRAPPED_MAX     ((uint64_t)(MASK_THREADS_TRAPPED / THREADS_TRAPPED_ONE))
+
+#define COUNT_ONE               ((uint64_t)(MASK_COUNT & -MASK_COUNT))
+#define COUNT_MAX               ((uint64_t)(MASK_COUNT / COUNT_ONE))
+
+static_assert(COUNT_ONE == __MCFCRT_LATCH_COUNT_ONE, "The inline functions in the header rely on this.");
+static_assert(COUNT_MAX == _MCFCRT_LATCH_COUNT_MAX, "The count limit is wrong.");
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForLatch(volatile uint64_t *puControl, size_t uMaxSpinCount, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicksForCount(uMaxSpinCount);
+	const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+	while(_MCFCRT_EXPECT(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks)){
+		__builtin_ia32_pause();
+		// Only perform a read here, which doesn't bounce the cache line.
+		const uint64_t uOld = __atomic_load_n(puControl, __ATOMIC_ACQUIRE);
+		if(!(uOld & MASK_COUNT)){
+			return true;
+		}
+	}
+	bool bTaken;
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			bTaken = !(uOld & MASK_COUNT);
+			if(bTaken){
+				break;
+			}
+			_MCFCRT_ASSERT_MSG((uOld & MASK_THREADS_TRAPPED) != MASK_THREADS_TRAPPED, L"Too many threads are waiting for this latch.");
+			uNew = uOld + THREADS_TRAPPED_ONE;
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
+	}
+	if(_MCFCRT_EXPECT(bTaken)){
+		return true;
+	}
+	// Trapped threads are woken up only when the count has reached zero, which never changes afterwards.
+	if(bMayTimeOut){
+		LARGE_INTEGER liTimeout;
+		__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+		NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, &liTimeout);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
+			bool bDecremented;
+			{
+				uint64_t uOld, uNew;
+				uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+				do {
+					const uint64_t u64ThreadsTrapped = (uOld & MASK_THREADS_TRAPPED) / THREADS_TRAPPED_ONE;
+					bDecremented = u64ThreadsTrapped != 0;
+					if(!bDecremented){
+						break;
+					}
+					uNew = uOld - THREADS_TRAPPED_ONE;
+				} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
+			}
+			if(bDecremented){
+				return false;
+			}
+			liTimeout.QuadPart = 0;
+			lStatus = __MCFCRT_ParkThread((void *)puControl, &liTimeout);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		}
+	} else {
+		NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, _MCFCRT_NULLPTR);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+	return true;
+}
+__attribute__((__always_inline__))
+static inline void ReallyCountDownLatch(volatile uint64_t *puControl, uint32_t u32CountToSubtract){
+	uint64_t u64CountToSignal;
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			const uint64_t u64Count = (uOld & MASK_COUNT) / COUNT_ONE;
+			_MCFCRT_ASSERT_MSG(u64Count >= u32CountToSubtract, L"The count of this latch would drop below zero.");
+			uNew = uOld - u32CountToSubtract * COUNT_ONE;
+			// Wake up all trapped threads when the count reaches zero.
+			u64CountToSignal = 0;
+			if(!(uNew & MASK_COUNT)){
+				u64CountToSignal = (uNew & MASK_THREADS_TRAPPED) / THREADS_TRAPPED_ONE;
+				uNew -= u64CountToSignal * THREADS_TRAPPED_ONE;
+			}
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)));
+	}
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	// Unparking threads that will never park leaves stale wakeups behind. Don't do that.
+	if(_MCFCRT_EXPECT_NOT((u64CountToSignal > 0) && !RtlDllShutdownInProgress())){
+		// Only one thread is woken up here. The others are woken up in a cascade.
+		NTSTATUS lStatus = __MCFCRT_UnparkThreads((void *)puControl, (size_t)u64CountToSignal);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThreads() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+}
+
+bool __MCFCRT_ReallyWaitForLatch(_MCFCRT_Latch *pLatch, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+	const bool bTaken = ReallyWaitForLatch(&(pLatch->__u), uMaxSpinCount, true, u64UntilFastMonoClock);
+	return bTaken;
+}
+void __MCFCRT_ReallyWaitForLatchForever(_MCFCRT_Latch *pLatch, size_t uMaxSpinCount){
+	const bool bTaken = ReallyWaitForLatch(&(pLatch->__u), uMaxSpinCount, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bTaken);
+}
+void __MCFCRT_ReallyCountDownLatch(_MCFCRT_Latch *pLatch, uint32_t u32CountToSubtract){
+	ReallyCountDownLatch(&(pLatch->__u), u32CountToSubtract);
+}
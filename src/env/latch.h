@@ -0,0 +1,65 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_LATCH_H_
+#define __MCFCRT_ENV_LATCH_H_
+
+#include "_crtdef.h"
+
+#ifndef __MCFCRT_LATCH_INLINE_OR_EXTERN
+#  define __MCFCRT_LATCH_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// In the case of static initialization, please initialize it with `_MCFCRT_LATCH_INITIALIZER(count)`.
+// The control word is 64-bit wide even on x86, otherwise there wouldn't be enough room for the count.
+typedef struct __MCFCRT_tagLatch {
+	__attribute__((__aligned__(8))) _MCFCRT_STD uint64_t __u;
+} _MCFCRT_Latch;
+
+#define _MCFCRT_LATCH_SUGGESTED_SPIN_COUNT   100u
+#define _MCFCRT_LATCH_COUNT_MAX              0xFFFFFFFFu
+
+// The count takes the upper half of the control word. The lower half is the counter of trapped threads.
+#define __MCFCRT_LATCH_COUNT_ONE             ((_MCFCRT_STD uint64_t)1 << 32)
+
+#define _MCFCRT_LATCH_INITIALIZER(__count_)  { (_MCFCRT_STD uint64_t)(__count_) * __MCFCRT_LATCH_COUNT_ONE }
+
+__MCFCRT_LATCH_INLINE_OR_EXTERN void _MCFCRT_InitializeLatch(_MCFCRT_Latch *__pLatch, _MCFCRT_STD uint32_t __u32InitialCount) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pLatch->__u), __u32InitialCount * __MCFCRT_LATCH_COUNT_ONE, __ATOMIC_RELEASE);
+}
+
+extern bool __MCFCRT_ReallyWaitForLatch(_MCFCRT_Latch *__pLatch, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForLatchForever(_MCFCRT_Latch *__pLatch, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyCountDownLatch(_MCFCRT_Latch *__pLatch, _MCFCRT_STD uint32_t __u32CountToSubtract) _MCFCRT_NOEXCEPT;
+
+// Returns `true` if the count has reached zero. This function never blocks.
+__MCFCRT_LATCH_INLINE_OR_EXTERN bool _MCFCRT_TryWaitForLatch(_MCFCRT_Latch *__pLatch) _MCFCRT_NOEXCEPT {
+	return __atomic_load_n(&(__pLatch->__u), __ATOMIC_ACQUIRE) < __MCFCRT_LATCH_COUNT_ONE;
+}
+__MCFCRT_LATCH_INLINE_OR_EXTERN bool _MCFCRT_WaitForLatch(_MCFCRT_Latch *__pLatch, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	if(__builtin_expect(_MCFCRT_TryWaitForLatch(__pLatch), false)){
+		return true;
+	}
+	return __MCFCRT_ReallyWaitForLatch(__pLatch, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_LATCH_INLINE_OR_EXTERN void _MCFCRT_WaitForLatchForever(_MCFCRT_Latch *__pLatch, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	if(__builtin_expect(_MCFCRT_TryWaitForLatch(__pLatch), false)){
+		return;
+	}
+	__MCFCRT_ReallyWaitForLatchForever(__pLatch, __uMaxSpinCount);
+}
+// The count must not be decremented below zero. When it reaches zero, all waiting threads are woken up.
+__MCFCRT_LATCH_INLINE_OR_EXTERN void _MCFCRT_CountDownLatch(_MCFCRT_Latch *__pLatch, _MCFCRT_STD uint32_t __u32CountToSubtract) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallyCountDownLatch(__pLatch, __u32CountToSubtract);
+}
+__MCFCRT_LATCH_INLINE_OR_EXTERN void _MCFCRT_ArriveAtLatchAndWaitForever(_MCFCRT_Latch *__pLatch, _MCFCRT_STD uint32_t __u32CountToSubtract, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	_MCFCRT_CountDownLatch(__pLatch, __u32CountToSubtract);
+	_MCFCRT_WaitForLatchForever(__pLatch, __uMaxSpinCount);
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
@@ -0,0 +1,129 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#include "lock_stats.h"
+#include "_spin_budget.h"
+#include "clocks.h"
+
+#ifdef __MCFCRT_LOCK_STATS
+
+// Primitives have no room for statistics, so they are kept in an open addressing hash table indexed by their addresses.
+// Entries are never removed except by `_MCFCRT_ResetLockStats()`. Once the table is full, statistics of new primitives are discarded and counted.
+#define TABLE_SIZE              1024u
+
+typedef struct tagStatsEntry {
+	const void *pPrimitive;
+	_MCFCRT_LockStatsKind eKind;
+	uint64_t au64Counters[_MCFCRT_kLockStatsCounterCount];
+	uint64_t au64WaitTimeHistogram[_MCFCRT_LOCK_STATS_HISTOGRAM_SIZE];
+} StatsEntry;
+
+static StatsEntry g_aEntries[TABLE_SIZE];
+static uint64_t g_u64Dropped;
+
+static StatsEntry *GetEntry(const void *pPrimitive, _MCFCRT_LockStatsKind eKind){
+	const size_t uHash = (size_t)((uintptr_t)pPrimitive / sizeof(uintptr_t) * 0x9E3779B9u);
+	for(size_t uProbe = 0; uProbe < TABLE_SIZE; ++uProbe){
+		StatsEntry *const pEntry = g_aEntries + (uHash + uProbe) % TABLE_SIZE;
+		const void *pOld = __atomic_load_n(&(pEntry->pPrimitive), __ATOMIC_ACQUIRE);
+		if(!pOld){
+			if(__atomic_compare_exchange_n(&(pEntry->pPrimitive), &pOld, pPrimitive, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+				__atomic_store_n(&(pEntry->eKind), eKind, __ATOMIC_RELAXED);
+				return pEntry;
+			}
+		}
+		if(pOld == pPrimitive){
+			return pEntry;
+		}
+	}
+	__atomic_fetch_add(&g_u64Dropped, 1, __ATOMIC_RELAXED);
+	return _MCFCRT_NULLPTR;
+}
+
+size_t _MCFCRT_EnumerateLockStats(_MCFCRT_LockStatsCallback pfnCallback, intptr_t nContext, uint64_t *pu64Dropped){
+	if(pu64Dropped){
+		*pu64Dropped = __atomic_load_n(&g_u64Dropped, __ATOMIC_RELAXED);
+	}
+	size_t uCount = 0;
+	for(size_t uIndex = 0; uIndex < TABLE_SIZE; ++uIndex){
+		StatsEntry *const pEntry = g_aEntries + uIndex;
+		_MCFCRT_LockStats vStats;
+		vStats.__pPrimitive = __atomic_load_n(&(pEntry->pPrimitive), __ATOMIC_ACQUIRE);
+		if(!vStats.__pPrimitive){
+			continue;
+		}
+		vStats.__eKind = __atomic_load_n(&(pEntry->eKind), __ATOMIC_RELAXED);
+		for(size_t uCounter = 0; uCounter < _MCFCRT_kLockStatsCounterCount; ++uCounter){
+			vStats.__au64Counters[uCounter] = __atomic_load_n(pEntry->au64Counters + uCounter, __ATOMIC_RELAXED);
+		}
+		for(size_t uBucket = 0; uBucket < _MCFCRT_LOCK_STATS_HISTOGRAM_SIZE; ++uBucket){
+			vStats.__au64WaitTimeHistogram[uBucket] = __atomic_load_n(pEntry->au64WaitTimeHistogram + uBucket, __ATOMIC_RELAXED);
+		}
+		++uCount;
+		if(!(*pfnCallback)(nContext, &vStats)){
+			break;
+		}
+	}
+	return uCount;
+}
+void _MCFCRT_ResetLockStats(void){
+	for(size_t uIndex = 0; uIndex < TABLE_SIZE; ++uIndex){
+		StatsEntry *const pEntry = g_aEntries + uIndex;
+		for(size_t uCounter = 0; uCounter < _MCFCRT_kLockStatsCounterCount; ++uCounter){
+			__atomic_store_n(pEntry->au64Counters + uCounter, 0, __ATOMIC_RELAXED);
+		}
+		for(size_t uBucket = 0; uBucket < _MCFCRT_LOCK_STATS_HISTOGRAM_SIZE; ++uBucket){
+			__atomic_store_n(pEntry->au64WaitTimeHistogram + uBucket, 0, __ATOMIC_RELAXED);
+		}
+		__atomic_store_n(&(pEntry->pPrimitive), _MCFCRT_NULLPTR, __ATOMIC_RELEASE);
+	}
+	__atomic_store_n(&g_u64Dropped, 0, __ATOMIC_RELAXED);
+}
+
+void __MCFCRT_LockStatsAddCount(const void *pPrimitive, _MCFCRT_LockStatsKind eKind, _MCFCRT_LockStatsCounter eCounter){
+	StatsEntry *const pEntry = GetEntry(pPrimitive, eKind);
+	if(!pEntry){
+		return;
+	}
+	__atomic_fetch_add(pEntry->au64Counters + eCounter, 1, __ATOMIC_RELAXED);
+}
+void __MCFCRT_LockStatsAddWaitTime(const void *pPrimitive, _MCFCRT_LockStatsKind eKind, uint64_t u64BeginTsc){
+	const uint64_t u64Nanoseconds = (_MCFCRT_ReadTimeStampCounter64() - u64BeginTsc) * 1000 / __MCFCRT_GetTscTicksPerMicrosecond();
+	StatsEntry *const pEntry = GetEntry(pPrimitive, eKind);
+	if(!pEntry){
+		return;
+	}
+	size_t uBucket = (size_t)(63 - __builtin_clzll(u64Nanoseconds | 1));
+	if(uBucket >= _MCFCRT_LOCK_STATS_HISTOGRAM_SIZE){
+		uBucket = _MCFCRT_LOCK_STATS_HISTOGRAM_SIZE - 1;
+	}
+	__atomic_fetch_add(pEntry->au64WaitTimeHistogram + uBucket, 1, __ATOMIC_RELAXED);
+}
+
+#else
+
+size_t _MCFCRT_EnumerateLockStats(_MCFCRT_LockStatsCallback pfnCallback, intptr_t nContext, uint64_t *pu64Dropped){
+	(void)pfnCallback;
+	(void)nContext;
+
+	if(pu64Dropped){
+		*pu64Dropped = 0;
+	}
+	return 0;
+}
+void _MCFCRT_ResetLockStats(void){
+}
+
+void __MCFCRT_LockStatsAddCount(const void *pPrimitive, _MCFCRT_LockStatsKind eKind, _MCFCRT_LockStatsCounter eCounter){
+	(void)pPrimitive;
+	(void)eKind;
+	(void)eCounter;
+}
+void __MCFCRT_LockStatsAddWaitTime(const void *pPrimitive, _MCFCRT_LockStatsKind eKind, uint64_t u64BeginTsc){
+	(void)pPrimitive;
+	(void)eKind;
+	(void)u64BeginTsc;
+}
+
+#endif
@@ -0,0 +1,60 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_LOCK_STATS_H_
+#define __MCFCRT_ENV_LOCK_STATS_H_
+
+#include "_crtdef.h"
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// Statistics are only collected if the library has been built with `__MCFCRT_LOCK_STATS` defined, which is what `./configure --enable-lock-stats` does.
+// Otherwise `_MCFCRT_EnumerateLockStats()` enumerates nothing.
+// Mutex acquisitions that succeed on the inline fast path are only counted if the calling code is also compiled with `__MCFCRT_LOCK_STATS` defined.
+
+typedef enum __MCFCRT_tagLockStatsKind {
+	_MCFCRT_kLockStatsKindMutex             = 1,
+	_MCFCRT_kLockStatsKindConditionVariable = 2,
+} _MCFCRT_LockStatsKind;
+
+typedef enum __MCFCRT_tagLockStatsCounter {
+	// For mutexes, this is the number of successful locks. For condition variables, this is the number of waits that have been signaled.
+	_MCFCRT_kLockStatsAcquisitions  = 0,
+	// For mutexes, this is the number of locks that could not take the mutex at once. For condition variables, this is the number of waits that had to spin or sleep.
+	_MCFCRT_kLockStatsContentions   = 1,
+	_MCFCRT_kLockStatsSpinSuccesses = 2,
+	_MCFCRT_kLockStatsSpinFailures  = 3,
+	// This is the number of times that threads have been parked.
+	_MCFCRT_kLockStatsSleeps        = 4,
+	_MCFCRT_kLockStatsTimeouts      = 5,
+	_MCFCRT_kLockStatsCounterCount  = 6,
+} _MCFCRT_LockStatsCounter;
+
+// `__au64WaitTimeHistogram[i]` is the number of contended waits that took [2^i, 2^(i+1)) nanoseconds.
+// The first bucket also counts shorter waits and the last one also counts longer ones.
+#define _MCFCRT_LOCK_STATS_HISTOGRAM_SIZE   32u
+
+typedef struct __MCFCRT_tagLockStats {
+	const void *__pPrimitive;
+	_MCFCRT_LockStatsKind __eKind;
+	_MCFCRT_STD uint64_t __au64Counters[_MCFCRT_kLockStatsCounterCount];
+	_MCFCRT_STD uint64_t __au64WaitTimeHistogram[_MCFCRT_LOCK_STATS_HISTOGRAM_SIZE];
+} _MCFCRT_LockStats;
+
+// Return `false` to stop the enumeration.
+typedef bool (*_MCFCRT_LockStatsCallback)(_MCFCRT_STD intptr_t __nContext, const _MCFCRT_LockStats *__pStats);
+
+// Statistics are updated without synchronization with these functions, so the results are approximate if other threads are using any locks.
+// This function returns the number of primitives that have been enumerated. Statistics are kept for a limited number of primitives.
+// If `__pu64Dropped` is not a null pointer, the number of updates that have been discarded because there was no room for their primitives is stored into it.
+extern _MCFCRT_STD size_t _MCFCRT_EnumerateLockStats(_MCFCRT_LockStatsCallback __pfnCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD uint64_t *__pu64Dropped) _MCFCRT_NOEXCEPT;
+extern void _MCFCRT_ResetLockStats(void) _MCFCRT_NOEXCEPT;
+
+// These are called by the primitives themselves and do nothing if `__MCFCRT_LOCK_STATS` was not defined when the library was built.
+extern void __MCFCRT_LockStatsAddCount(const void *__pPrimitive, _MCFCRT_LockStatsKind __eKind, _MCFCRT_LockStatsCounter __eCounter) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_LockStatsAddWaitTime(const void *__pPrimitive, _MCFCRT_LockStatsKind __eKind, _MCFCRT_STD uint64_t __u64BeginTsc) _MCFCRT_NOEXCEPT;
+
+_MCFCRT_EXTERN_C_END
+
+#endif
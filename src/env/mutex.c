@@ -5,15 +5,14 @@
 #define __MCFCRT_MUTEX_INLINE_OR_EXTERN     extern inline
 #include "mutex.h"
 #include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "lock_stats.h"
+#include "clocks.h"
 #include "xassert.h"
 #include "expect.h"
 #include <ntdef.h>
 
-__attribute__((__dllimport__, __stdcall__))
-extern NTSTATUS NtWaitForKeyedEvent(HANDLE hKeyedEvent, void *pKey, BOOLEAN bAlertable, const LARGE_INTEGER *pliTimeout);
-__attribute__((__dllimport__, __stdcall__))
-extern NTSTATUS NtReleaseKeyedEvent(HANDLE hKeyedEvent, void *pKey, BOOLEAN bAlertable, const LARGE_INTEGER *pliTimeout);
-
 __attribute__((__dllimport__, __stdcall__, __const__))
 extern BOOLEAN RtlDllShutdownInProgress(void);
 
@@ -31,42 +30,54 @@ extern BOOLEAN RtlDllShutdownInProgress(void);
 
 #define MASK_LOCKED             ((uintptr_t)( BSFB(0x01)))
 #define MASK_THREADS_SPINNING   ((uintptr_t)( BSFB(0x0E)))
-#define MASK_SPIN_FAILURE_COUNT ((uintptr_t)( BSFB(0xF0)))
-#define MASK_THREADS_TRAPPED    ((uintptr_t)(~BSFB(0xFF)))
+#define MASK_HOLD_TIME_LOG      ((uintptr_t)( BSFB(0xF0)))
+#define MASK_HANDOFF_PENDING    ((uintptr_t)( BSUSR(0x01)))
+#define MASK_THREADS_TRAPPED    ((uintptr_t)(~BSUSR(0x01) & ~BSFB(0xFF)))
 
 #define THREADS_SPINNING_ONE    ((uintptr_t)(MASK_THREADS_SPINNING & -MASK_THREADS_SPINNING))
 #define THREADS_SPINNING_MAX    ((uintptr_t)(MASK_THREADS_SPINNING / THREADS_SPINNING_ONE))
 
-#define SPIN_FAILURE_COUNT_ONE  ((uintptr_t)(MASK_SPIN_FAILURE_COUNT & -MASK_SPIN_FAILURE_COUNT))
-#define SPIN_FAILURE_COUNT_MAX  ((uintptr_t)(MASK_SPIN_FAILURE_COUNT / SPIN_FAILURE_COUNT_ONE))
+#define HOLD_TIME_LOG_ONE       ((uintptr_t)(MASK_HOLD_TIME_LOG & -MASK_HOLD_TIME_LOG))
+#define HOLD_TIME_LOG_MAX       ((uintptr_t)(MASK_HOLD_TIME_LOG / HOLD_TIME_LOG_ONE))
 
 #define THREADS_TRAPPED_ONE     ((uintptr_t)(MASK_THREADS_TRAPPED & -MASK_THREADS_TRAPPED))
 #define THREADS_TRAPPED_MAX     ((uintptr_t)(MASK_THREADS_TRAPPED / THREADS_TRAPPED_ONE))
 
-#define MIN_SPIN_COUNT          ((uintptr_t)16)
-#define MAX_SPIN_MULTIPLIER     ((uintptr_t)32)
+// A waiter on a fair mutex that has been waiting for this long, in microseconds, will have the mutex handed over to it directly.
+#define STARVATION_THRESHOLD    ((uint64_t)1000)
 
 __attribute__((__always_inline__))
-static inline bool ReallyWaitForMutex(volatile uintptr_t *puControl, size_t uMaxSpinCountInitial, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+static inline uintptr_t SetHoldTimeLog(uintptr_t uOld, size_t uHoldTimeLog){
+	return (uOld & ~MASK_HOLD_TIME_LOG) | uHoldTimeLog * HOLD_TIME_LOG_ONE;
+}
+// At most one waiter can have the `MASK_HANDOFF_PENDING` bit set. It is not counted in `MASK_THREADS_TRAPPED` and waits on this key instead.
+__attribute__((__always_inline__))
+static inline void *GetHandOffKey(volatile uintptr_t *puControl){
+	return (void *)((volatile char *)puControl + 2);
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForMutex(volatile uintptr_t *puControl, size_t uMaxSpinCount, bool bFair, bool bMayTimeOut, uint64_t u64UntilFastMonoClock, __MCFCRT_ParkInterrupt *pInterrupt){
+	// Barging allows a thread that has just arrived to take the mutex before threads that have been woken up, which may starve the latter.
+	// Fair mutexes bound that by having starving threads request a direct handoff.
+	uint64_t u64StarvingSinceTsc = 0;
+	if(bFair){
+		u64StarvingSinceTsc = _MCFCRT_ReadTimeStampCounter64() + STARVATION_THRESHOLD * __MCFCRT_GetTscTicksPerMicrosecond();
+	}
 	for(;;){
-		size_t uMaxSpinCount, uSpinMultiplier;
-		bool bTaken, bSpinnable;
+		uint64_t u64SpinTicks;
+		bool bTaken, bSpinnable, bHandOffRequested;
 		{
 			uintptr_t uOld, uNew;
 			uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
 			do {
-				const size_t uSpinFailureCount = (uOld & MASK_SPIN_FAILURE_COUNT) / SPIN_FAILURE_COUNT_ONE;
-				if(uMaxSpinCountInitial > MIN_SPIN_COUNT){
-					uMaxSpinCount = (uMaxSpinCountInitial >> uSpinFailureCount) | MIN_SPIN_COUNT;
-					uSpinMultiplier = MAX_SPIN_MULTIPLIER >> uSpinFailureCount;
-				} else {
-					uMaxSpinCount = uMaxSpinCountInitial;
-					uSpinMultiplier = 0;
-				}
+				const size_t uHoldTimeLog = (uOld & MASK_HOLD_TIME_LOG) / HOLD_TIME_LOG_ONE;
 				bTaken = !(uOld & MASK_LOCKED);
 				bSpinnable = false;
 				if(!bTaken){
-					if(uMaxSpinCount != 0){
+					// Spin only if the mutex is expected to be released sooner than a thread could be parked and woken up.
+					u64SpinTicks = __MCFCRT_SpinBudgetGetTicks(uMaxSpinCount, uHoldTimeLog);
+					if(u64SpinTicks != 0){
 						const size_t uThreadsSpinning = (uOld & MASK_THREADS_SPINNING) / THREADS_SPINNING_ONE;
 						bSpinnable = uThreadsSpinning < THREADS_SPINNING_MAX;
 					}
@@ -75,8 +86,9 @@ static inline bool ReallyWaitForMutex(volatile uintptr_t *puControl, size_t uMax
 					}
 					uNew = uOld + THREADS_SPINNING_ONE;
 				} else {
-					const bool bSpinFailureCountDecremented = uSpinFailureCount != 0;
-					uNew = uOld + MASK_LOCKED - bSpinFailureCountDecremented * SPIN_FAILURE_COUNT_ONE;
+					// The mutex was free, so it is probably held for shorter than expected.
+					const bool bHoldTimeLogDecremented = uHoldTimeLog != 0;
+					uNew = uOld + MASK_LOCKED - bHoldTimeLogDecremented * HOLD_TIME_LOG_ONE;
 				}
 			} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
 		}
@@ -84,13 +96,13 @@ static inline bool ReallyWaitForMutex(volatile uintptr_t *puControl, size_t uMax
 			return true;
 		}
 		if(_MCFCRT_EXPECT(bSpinnable)){
-			for(size_t uSpinIndex = 0; _MCFCRT_EXPECT(uSpinIndex < uMaxSpinCount); ++uSpinIndex){
-				register size_t uMultiplierIndex = uSpinMultiplier + 1;
+			const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+			uint64_t u64SpinNow;
+			do {
 				__atomic_thread_fence(__ATOMIC_SEQ_CST);
-				do {
-					__builtin_ia32_pause();
-				} while(--uMultiplierIndex != 0);
+				__builtin_ia32_pause();
 				__atomic_thread_fence(__ATOMIC_SEQ_CST);
+				u64SpinNow = _MCFCRT_ReadTimeStampCounter64();
 				{
 					uintptr_t uOld, uNew;
 					uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
@@ -99,41 +111,56 @@ static inline bool ReallyWaitForMutex(volatile uintptr_t *puControl, size_t uMax
 						if(!bTaken){
 							break;
 						}
-						const size_t uSpinFailureCount = (uOld & MASK_SPIN_FAILURE_COUNT) / SPIN_FAILURE_COUNT_ONE;
-						const bool bSpinFailureCountDecremented = uSpinFailureCount != 0;
-						uNew = uOld - THREADS_SPINNING_ONE + MASK_LOCKED - bSpinFailureCountDecremented * SPIN_FAILURE_COUNT_ONE;
+						// Learn from how long this thread has been waiting for the mutex.
+						const size_t uHoldTimeLog = (uOld & MASK_HOLD_TIME_LOG) / HOLD_TIME_LOG_ONE;
+						uNew = SetHoldTimeLog(uOld, __MCFCRT_SpinBudgetUpdateHoldTimeLog(uHoldTimeLog, u64SpinNow - u64SpinBegin)) - THREADS_SPINNING_ONE + MASK_LOCKED;
 					} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
 				}
 				if(_MCFCRT_EXPECT_NOT(bTaken)){
+#ifdef __MCFCRT_LOCK_STATS
+					__MCFCRT_LockStatsAddCount((const void *)puControl, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsSpinSuccesses);
+#endif
 					return true;
 				}
-			}
+			} while(_MCFCRT_EXPECT(u64SpinNow - u64SpinBegin < u64SpinTicks));
+			const bool bStarving = bFair && (_MCFCRT_ReadTimeStampCounter64() >= u64StarvingSinceTsc);
 			{
 				uintptr_t uOld, uNew;
 				uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
 				do {
-					const size_t uSpinFailureCount = (uOld & MASK_SPIN_FAILURE_COUNT) / SPIN_FAILURE_COUNT_ONE;
+					const size_t uHoldTimeLog = (uOld & MASK_HOLD_TIME_LOG) / HOLD_TIME_LOG_ONE;
 					bTaken = !(uOld & MASK_LOCKED);
+					bHandOffRequested = false;
 					if(!bTaken){
-						const bool bSpinFailureCountIncremented = uSpinFailureCount < SPIN_FAILURE_COUNT_MAX;
-						uNew = uOld - THREADS_SPINNING_ONE + THREADS_TRAPPED_ONE + bSpinFailureCountIncremented * SPIN_FAILURE_COUNT_ONE;
+						bHandOffRequested = bStarving && !(uOld & MASK_HANDOFF_PENDING);
+						// The budget has been exhausted, so the mutex is held for longer than expected.
+						const bool bHoldTimeLogIncremented = uHoldTimeLog < HOLD_TIME_LOG_MAX;
+						uNew = uOld - THREADS_SPINNING_ONE + (bHandOffRequested ? MASK_HANDOFF_PENDING : THREADS_TRAPPED_ONE) + bHoldTimeLogIncremented * HOLD_TIME_LOG_ONE;
 					} else {
-						const bool bSpinFailureCountDecremented = uSpinFailureCount != 0;
-						uNew = uOld - THREADS_SPINNING_ONE + MASK_LOCKED - bSpinFailureCountDecremented * SPIN_FAILURE_COUNT_ONE;
+						uNew = SetHoldTimeLog(uOld, __MCFCRT_SpinBudgetUpdateHoldTimeLog(uHoldTimeLog, u64SpinNow - u64SpinBegin)) - THREADS_SPINNING_ONE + MASK_LOCKED;
 					}
 				} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
 			}
 			if(_MCFCRT_EXPECT(bTaken)){
+#ifdef __MCFCRT_LOCK_STATS
+				__MCFCRT_LockStatsAddCount((const void *)puControl, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsSpinSuccesses);
+#endif
 				return true;
 			}
+#ifdef __MCFCRT_LOCK_STATS
+			__MCFCRT_LockStatsAddCount((const void *)puControl, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsSpinFailures);
+#endif
 		} else {
+			const bool bStarving = bFair && (_MCFCRT_ReadTimeStampCounter64() >= u64StarvingSinceTsc);
 			{
 				uintptr_t uOld, uNew;
 				uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
 				do {
 					bTaken = !(uOld & MASK_LOCKED);
+					bHandOffRequested = false;
 					if(!bTaken){
-						uNew = uOld + THREADS_TRAPPED_ONE;
+						bHandOffRequested = bStarving && !(uOld & MASK_HANDOFF_PENDING);
+						uNew = uOld + (bHandOffRequested ? MASK_HANDOFF_PENDING : THREADS_TRAPPED_ONE);
 					} else {
 						uNew = uOld + MASK_LOCKED;
 					}
@@ -143,11 +170,49 @@ static inline bool ReallyWaitForMutex(volatile uintptr_t *puControl, size_t uMax
 				return true;
 			}
 		}
+#ifdef __MCFCRT_LOCK_STATS
+		__MCFCRT_LockStatsAddCount((const void *)puControl, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsSleeps);
+#endif
+		if(_MCFCRT_EXPECT_NOT(bHandOffRequested)){
+			if(bMayTimeOut){
+				LARGE_INTEGER liTimeout;
+				__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+				NTSTATUS lStatus = __MCFCRT_ParkThreadInterruptible(GetHandOffKey(puControl), &liTimeout, pInterrupt);
+				_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThreadInterruptible() failed.");
+				while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
+					bool bCancelled;
+					{
+						uintptr_t uOld, uNew;
+						uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+						do {
+							bCancelled = (uOld & MASK_HANDOFF_PENDING) != 0;
+							if(!bCancelled){
+								break;
+							}
+							uNew = uOld & ~MASK_HANDOFF_PENDING;
+						} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
+					}
+					if(bCancelled){
+						return false;
+					}
+					liTimeout.QuadPart = 0;
+					lStatus = __MCFCRT_ParkThreadInterruptible(GetHandOffKey(puControl), &liTimeout, pInterrupt);
+					_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThreadInterruptible() failed.");
+				}
+			} else {
+				NTSTATUS lStatus = __MCFCRT_ParkThread(GetHandOffKey(puControl), _MCFCRT_NULLPTR);
+				_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+				_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+			}
+			// The mutex has been handed over to this thread without being unlocked.
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			return true;
+		}
 		if(bMayTimeOut){
 			LARGE_INTEGER liTimeout;
 			__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
-			NTSTATUS lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, &liTimeout);
-			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+			NTSTATUS lStatus = __MCFCRT_ParkThreadInterruptible((void *)puControl, &liTimeout, pInterrupt);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThreadInterruptible() failed.");
 			while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
 				bool bDecremented;
 				{
@@ -166,45 +231,136 @@ static inline bool ReallyWaitForMutex(volatile uintptr_t *puControl, size_t uMax
 					return false;
 				}
 				liTimeout.QuadPart = 0;
-				lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, &liTimeout);
-				_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+				lStatus = __MCFCRT_ParkThreadInterruptible((void *)puControl, &liTimeout, pInterrupt);
+				_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThreadInterruptible() failed.");
 			}
 		} else {
-			NTSTATUS lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, _MCFCRT_NULLPTR);
-			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+			NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, _MCFCRT_NULLPTR);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
 			_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
 		}
 	}
 }
 __attribute__((__always_inline__))
 static inline void ReallySignalMutex(volatile uintptr_t *puControl){
-	bool bSignalOne;
+	bool bHandOff, bSignalOne;
 	{
 		uintptr_t uOld, uNew;
 		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
 		do {
 			_MCFCRT_ASSERT_MSG(uOld & MASK_LOCKED, L"This mutex isn't locked by any thread.");
-			bSignalOne = (uOld & MASK_THREADS_TRAPPED) != 0;
-			uNew = (uOld & ~MASK_LOCKED) - bSignalOne * THREADS_TRAPPED_ONE;
+			bHandOff = (uOld & MASK_HANDOFF_PENDING) != 0;
+			if(bHandOff){
+				// Keep the mutex locked, so no other thread can barge in before the starving thread wakes up.
+				bSignalOne = false;
+				uNew = uOld & ~MASK_HANDOFF_PENDING;
+			} else {
+				bSignalOne = (uOld & MASK_THREADS_TRAPPED) != 0;
+				uNew = (uOld & ~MASK_LOCKED) - bSignalOne * THREADS_TRAPPED_ONE;
+			}
 		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)));
 	}
 	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
-	// Calling `NtReleaseKeyedEvent()` when no thread is waiting results in deadlocks. Don't do that.
+	// Unparking threads that will never park leaves stale wakeups behind. Don't do that.
+	if(_MCFCRT_EXPECT_NOT(bHandOff && !RtlDllShutdownInProgress())){
+		NTSTATUS lStatus = __MCFCRT_UnparkThread(GetHandOffKey(puControl));
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThread() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
 	if(_MCFCRT_EXPECT_NOT(bSignalOne && !RtlDllShutdownInProgress())){
-		NTSTATUS lStatus = NtReleaseKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, _MCFCRT_NULLPTR);
-		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtReleaseKeyedEvent() failed.");
+		NTSTATUS lStatus = __MCFCRT_UnparkThread((void *)puControl);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThread() failed.");
 		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
 	}
 }
 
 bool __MCFCRT_ReallyWaitForMutex(_MCFCRT_Mutex *pMutex, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
-	const bool bLocked = ReallyWaitForMutex(&(pMutex->__u), uMaxSpinCount, true, u64UntilFastMonoClock);
+#ifdef __MCFCRT_LOCK_STATS
+	const uint64_t u64BeginTsc = _MCFCRT_ReadTimeStampCounter64();
+	__MCFCRT_LockStatsAddCount(pMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsContentions);
+#endif
+	const bool bLocked = ReallyWaitForMutex(&(pMutex->__u), uMaxSpinCount, false, true, u64UntilFastMonoClock, _MCFCRT_NULLPTR);
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount(pMutex, _MCFCRT_kLockStatsKindMutex, bLocked ? _MCFCRT_kLockStatsAcquisitions : _MCFCRT_kLockStatsTimeouts);
+	__MCFCRT_LockStatsAddWaitTime(pMutex, _MCFCRT_kLockStatsKindMutex, u64BeginTsc);
+#endif
 	return bLocked;
 }
 void __MCFCRT_ReallyWaitForMutexForever(_MCFCRT_Mutex *pMutex, size_t uMaxSpinCount){
-	const bool bLocked = ReallyWaitForMutex(&(pMutex->__u), uMaxSpinCount, false, UINT64_MAX);
+#ifdef __MCFCRT_LOCK_STATS
+	const uint64_t u64BeginTsc = _MCFCRT_ReadTimeStampCounter64();
+	__MCFCRT_LockStatsAddCount(pMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsContentions);
+#endif
+	const bool bLocked = ReallyWaitForMutex(&(pMutex->__u), uMaxSpinCount, false, false, UINT64_MAX, _MCFCRT_NULLPTR);
 	_MCFCRT_ASSERT(bLocked);
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount(pMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsAcquisitions);
+	__MCFCRT_LockStatsAddWaitTime(pMutex, _MCFCRT_kLockStatsKindMutex, u64BeginTsc);
+#endif
+}
+bool __MCFCRT_ReallyWaitForMutexOrStop(_MCFCRT_Mutex *pMutex, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock, _MCFCRT_StopToken *pStopToken){
+	__MCFCRT_ParkInterrupt vInterrupt;
+	__MCFCRT_InitializeParkInterrupt(&vInterrupt);
+	_MCFCRT_StopCallback vCallback;
+	if(!_MCFCRT_RegisterStopCallback(pStopToken, &vCallback, &__MCFCRT_InterruptParkedThreadOnStop, (intptr_t)&vInterrupt)){
+		return false;
+	}
+#ifdef __MCFCRT_LOCK_STATS
+	const uint64_t u64BeginTsc = _MCFCRT_ReadTimeStampCounter64();
+	__MCFCRT_LockStatsAddCount(pMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsContentions);
+#endif
+	const bool bLocked = ReallyWaitForMutex(&(pMutex->__u), uMaxSpinCount, false, true, u64UntilFastMonoClock, &vInterrupt);
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount(pMutex, _MCFCRT_kLockStatsKindMutex, bLocked ? _MCFCRT_kLockStatsAcquisitions : _MCFCRT_kLockStatsTimeouts);
+	__MCFCRT_LockStatsAddWaitTime(pMutex, _MCFCRT_kLockStatsKindMutex, u64BeginTsc);
+#endif
+	_MCFCRT_UnregisterStopCallback(pStopToken, &vCallback);
+	return bLocked;
 }
 void __MCFCRT_ReallySignalMutex(_MCFCRT_Mutex *pMutex){
 	ReallySignalMutex(&(pMutex->__u));
 }
+bool __MCFCRT_TrapRequeuedThreadOnMutex(_MCFCRT_Mutex *pMutex){
+	volatile uintptr_t *const puControl = &(pMutex->__u);
+	bool bTrapped;
+	{
+		uintptr_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			bTrapped = (uOld & MASK_LOCKED) != 0;
+			if(!bTrapped){
+				break;
+			}
+			uNew = uOld + THREADS_TRAPPED_ONE;
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)));
+	}
+	return bTrapped;
+}
+
+bool __MCFCRT_ReallyWaitForFairMutex(_MCFCRT_FairMutex *pFairMutex, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+#ifdef __MCFCRT_LOCK_STATS
+	const uint64_t u64BeginTsc = _MCFCRT_ReadTimeStampCounter64();
+	__MCFCRT_LockStatsAddCount(pFairMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsContentions);
+#endif
+	const bool bLocked = ReallyWaitForMutex(&(pFairMutex->__u), uMaxSpinCount, true, true, u64UntilFastMonoClock, _MCFCRT_NULLPTR);
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount(pFairMutex, _MCFCRT_kLockStatsKindMutex, bLocked ? _MCFCRT_kLockStatsAcquisitions : _MCFCRT_kLockStatsTimeouts);
+	__MCFCRT_LockStatsAddWaitTime(pFairMutex, _MCFCRT_kLockStatsKindMutex, u64BeginTsc);
+#endif
+	return bLocked;
+}
+void __MCFCRT_ReallyWaitForFairMutexForever(_MCFCRT_FairMutex *pFairMutex, size_t uMaxSpinCount){
+#ifdef __MCFCRT_LOCK_STATS
+	const uint64_t u64BeginTsc = _MCFCRT_ReadTimeStampCounter64();
+	__MCFCRT_LockStatsAddCount(pFairMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsContentions);
+#endif
+	const bool bLocked = ReallyWaitForMutex(&(pFairMutex->__u), uMaxSpinCount, true, false, UINT64_MAX, _MCFCRT_NULLPTR);
+	_MCFCRT_ASSERT(bLocked);
+#ifdef __MCFCRT_LOCK_STATS
+	__MCFCRT_LockStatsAddCount(pFairMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsAcquisitions);
+	__MCFCRT_LockStatsAddWaitTime(pFairMutex, _MCFCRT_kLockStatsKindMutex, u64BeginTsc);
+#endif
+}
+void __MCFCRT_ReallySignalFairMutex(_MCFCRT_FairMutex *pFairMutex){
+	ReallySignalMutex(&(pFairMutex->__u));
+}
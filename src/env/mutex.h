@@ -6,6 +6,8 @@
 #define __MCFCRT_ENV_MUTEX_H_
 
 #include "_crtdef.h"
+#include "lock_stats.h"
+#include "stop_token.h"
 
 #ifndef __MCFCRT_MUTEX_INLINE_OR_EXTERN
 #  define __MCFCRT_MUTEX_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
@@ -18,6 +20,9 @@ typedef struct __MCFCRT_tagMutex {
 	_MCFCRT_STD uintptr_t __u;
 } _MCFCRT_Mutex;
 
+// The spin count is a limit on the time of spinning, in units of 100 nanoseconds. Zero disables spinning.
+// This is the unit of spin counts that are passed to all synchronization primitives here, not only mutexes.
+// Within that limit, how long a thread actually spins on a mutex is decided from how long it has been held recently.
 #define _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT   100u
 
 __MCFCRT_MUTEX_INLINE_OR_EXTERN void _MCFCRT_InitializeMutex(_MCFCRT_Mutex *__pMutex) _MCFCRT_NOEXCEPT {
@@ -26,12 +31,19 @@ __MCFCRT_MUTEX_INLINE_OR_EXTERN void _MCFCRT_InitializeMutex(_MCFCRT_Mutex *__pM
 
 extern bool __MCFCRT_ReallyWaitForMutex(_MCFCRT_Mutex *__pMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
 extern void __MCFCRT_ReallyWaitForMutexForever(_MCFCRT_Mutex *__pMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern bool __MCFCRT_ReallyWaitForMutexOrStop(_MCFCRT_Mutex *__pMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock, _MCFCRT_StopToken *__pStopToken) _MCFCRT_NOEXCEPT;
 extern void __MCFCRT_ReallySignalMutex(_MCFCRT_Mutex *__pMutex) _MCFCRT_NOEXCEPT;
+// This is used by condition variables to move a waiter onto a mutex without waking it up. See `_MCFCRT_WaitForConditionVariableOnMutexForever()`.
+// If the mutex is locked, the waiter is counted as trapped and `true` is returned, after which it must be parked on the mutex.
+extern bool __MCFCRT_TrapRequeuedThreadOnMutex(_MCFCRT_Mutex *__pMutex) _MCFCRT_NOEXCEPT;
 
 __MCFCRT_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_WaitForMutex(_MCFCRT_Mutex *__pMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
 	unsigned char *const __pbyGuard = (unsigned char *)(void *)&(__pMutex->__u);
 	unsigned char __byLockFlag = __atomic_load_n(__pbyGuard, __ATOMIC_RELAXED);
-	if(__builtin_expect((__byLockFlag == 0) && __atomic_compare_exchange_n(__pbyGuard, &__byLockFlag, 1, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE), true)){
+	if(__builtin_expect(!(__byLockFlag & 1) && __atomic_compare_exchange_n(__pbyGuard, &__byLockFlag, (unsigned char)(__byLockFlag | 1), true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE), true)){
+#ifdef __MCFCRT_LOCK_STATS
+		__MCFCRT_LockStatsAddCount(__pMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsAcquisitions);
+#endif
 		return true;
 	}
 	return __MCFCRT_ReallyWaitForMutex(__pMutex, __uMaxSpinCount, __u64UntilFastMonoClock);
@@ -39,15 +51,72 @@ __MCFCRT_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_WaitForMutex(_MCFCRT_Mutex *__pMute
 __MCFCRT_MUTEX_INLINE_OR_EXTERN void _MCFCRT_WaitForMutexForever(_MCFCRT_Mutex *__pMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
 	unsigned char *const __pbyGuard = (unsigned char *)(void *)&(__pMutex->__u);
 	unsigned char __byLockFlag = __atomic_load_n(__pbyGuard, __ATOMIC_RELAXED);
-	if(__builtin_expect((__byLockFlag == 0) && __atomic_compare_exchange_n(__pbyGuard, &__byLockFlag, 1, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE), true)){
+	if(__builtin_expect(!(__byLockFlag & 1) && __atomic_compare_exchange_n(__pbyGuard, &__byLockFlag, (unsigned char)(__byLockFlag | 1), true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE), true)){
+#ifdef __MCFCRT_LOCK_STATS
+		__MCFCRT_LockStatsAddCount(__pMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsAcquisitions);
+#endif
 		return;
 	}
 	__MCFCRT_ReallyWaitForMutexForever(__pMutex, __uMaxSpinCount);
 }
+// This function is the same as `_MCFCRT_WaitForMutex()`, except that it also fails if a stop is requested on `__pStopToken` before the mutex is locked.
+// Pass `UINT64_MAX` as `__u64UntilFastMonoClock` to wait without a timeout. Call `_MCFCRT_IsStopRequested()` to tell a stop from a timeout.
+__MCFCRT_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_WaitForMutexOrStop(_MCFCRT_Mutex *__pMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock, _MCFCRT_StopToken *__pStopToken) _MCFCRT_NOEXCEPT {
+	unsigned char *const __pbyGuard = (unsigned char *)(void *)&(__pMutex->__u);
+	unsigned char __byLockFlag = __atomic_load_n(__pbyGuard, __ATOMIC_RELAXED);
+	if(__builtin_expect(!(__byLockFlag & 1) && __atomic_compare_exchange_n(__pbyGuard, &__byLockFlag, (unsigned char)(__byLockFlag | 1), true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE), true)){
+#ifdef __MCFCRT_LOCK_STATS
+		__MCFCRT_LockStatsAddCount(__pMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsAcquisitions);
+#endif
+		return true;
+	}
+	return __MCFCRT_ReallyWaitForMutexOrStop(__pMutex, __uMaxSpinCount, __u64UntilFastMonoClock, __pStopToken);
+}
 __MCFCRT_MUTEX_INLINE_OR_EXTERN void _MCFCRT_SignalMutex(_MCFCRT_Mutex *__pMutex) _MCFCRT_NOEXCEPT {
 	__MCFCRT_ReallySignalMutex(__pMutex);
 }
 
+// A fair mutex is a mutex that bounds how long a waiter can be overtaken by other threads.
+// Usually a fair mutex behaves like a plain mutex. Once a waiter has waited for about a millisecond, the next unlock hands ownership directly to it instead of releasing the mutex.
+// In the case of static initialization, please initialize it with { 0 }.
+typedef struct __MCFCRT_tagFairMutex {
+	_MCFCRT_STD uintptr_t __u;
+} _MCFCRT_FairMutex;
+
+__MCFCRT_MUTEX_INLINE_OR_EXTERN void _MCFCRT_InitializeFairMutex(_MCFCRT_FairMutex *__pFairMutex) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pFairMutex->__u), 0, __ATOMIC_RELEASE);
+}
+
+extern bool __MCFCRT_ReallyWaitForFairMutex(_MCFCRT_FairMutex *__pFairMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForFairMutexForever(_MCFCRT_FairMutex *__pFairMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallySignalFairMutex(_MCFCRT_FairMutex *__pFairMutex) _MCFCRT_NOEXCEPT;
+
+__MCFCRT_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_WaitForFairMutex(_MCFCRT_FairMutex *__pFairMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	unsigned char *const __pbyGuard = (unsigned char *)(void *)&(__pFairMutex->__u);
+	unsigned char __byLockFlag = __atomic_load_n(__pbyGuard, __ATOMIC_RELAXED);
+	if(__builtin_expect(!(__byLockFlag & 1) && __atomic_compare_exchange_n(__pbyGuard, &__byLockFlag, (unsigned char)(__byLockFlag | 1), true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE), true)){
+#ifdef __MCFCRT_LOCK_STATS
+		__MCFCRT_LockStatsAddCount(__pFairMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsAcquisitions);
+#endif
+		return true;
+	}
+	return __MCFCRT_ReallyWaitForFairMutex(__pFairMutex, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_MUTEX_INLINE_OR_EXTERN void _MCFCRT_WaitForFairMutexForever(_MCFCRT_FairMutex *__pFairMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	unsigned char *const __pbyGuard = (unsigned char *)(void *)&(__pFairMutex->__u);
+	unsigned char __byLockFlag = __atomic_load_n(__pbyGuard, __ATOMIC_RELAXED);
+	if(__builtin_expect(!(__byLockFlag & 1) && __atomic_compare_exchange_n(__pbyGuard, &__byLockFlag, (unsigned char)(__byLockFlag | 1), true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE), true)){
+#ifdef __MCFCRT_LOCK_STATS
+		__MCFCRT_LockStatsAddCount(__pFairMutex, _MCFCRT_kLockStatsKindMutex, _MCFCRT_kLockStatsAcquisitions);
+#endif
+		return;
+	}
+	__MCFCRT_ReallyWaitForFairMutexForever(__pFairMutex, __uMaxSpinCount);
+}
+__MCFCRT_MUTEX_INLINE_OR_EXTERN void _MCFCRT_SignalFairMutex(_MCFCRT_FairMutex *__pFairMutex) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallySignalFairMutex(__pFairMutex);
+}
+
 _MCFCRT_EXTERN_C_END
 
 #endif
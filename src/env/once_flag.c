@@ -5,15 +5,13 @@
 #define __MCFCRT_ONCE_FLAG_INLINE_OR_EXTERN     extern inline
 #include "once_flag.h"
 #include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "clocks.h"
 #include "xassert.h"
 #include "expect.h"
 #include <ntdef.h>
 
-__attribute__((__dllimport__, __stdcall__))
-extern NTSTATUS NtWaitForKeyedEvent(HANDLE hKeyedEvent, void *pKey, BOOLEAN bAlertable, const LARGE_INTEGER *pliTimeout);
-__attribute__((__dllimport__, __stdcall__))
-extern NTSTATUS NtReleaseKeyedEvent(HANDLE hKeyedEvent, void *pKey, BOOLEAN bAlertable, const LARGE_INTEGER *pliTimeout);
-
 __attribute__((__dllimport__, __stdcall__, __const__))
 extern BOOLEAN RtlDllShutdownInProgress(void);
 
@@ -30,16 +28,33 @@ extern BOOLEAN RtlDllShutdownInProgress(void);
 #endif
 
 #define MASK_LOCKED             ((uintptr_t)( BSUSR(0x01)              ))
+#define MASK_THREADS_SPINNING   ((uintptr_t)( BSUSR(0x0E)              ))
+#define MASK_HOLD_TIME_LOG      ((uintptr_t)( BSUSR(0xF0)              ))
 #define MASK_FINISHED           ((uintptr_t)(                BSFB(0x01)))
-#define MASK_THREADS_TRAPPED    ((uintptr_t)(~BSUSR(0x01) & ~BSFB(0xFF)))
+#define MASK_THREADS_TRAPPED    ((uintptr_t)(~BSUSR(0xFF) & ~BSFB(0xFF)))
+
+#define THREADS_SPINNING_ONE    ((uintptr_t)(MASK_THREADS_SPINNING & -MASK_THREADS_SPINNING))
+#define THREADS_SPINNING_MAX    ((uintptr_t)(MASK_THREADS_SPINNING / THREADS_SPINNING_ONE))
+
+#define HOLD_TIME_LOG_ONE       ((uintptr_t)(MASK_HOLD_TIME_LOG & -MASK_HOLD_TIME_LOG))
+#define HOLD_TIME_LOG_MAX       ((uintptr_t)(MASK_HOLD_TIME_LOG / HOLD_TIME_LOG_ONE))
 
 #define THREADS_TRAPPED_ONE     ((uintptr_t)(MASK_THREADS_TRAPPED & -MASK_THREADS_TRAPPED))
 #define THREADS_TRAPPED_MAX     ((uintptr_t)(MASK_THREADS_TRAPPED / THREADS_TRAPPED_ONE))
 
+// Once flags take no spin count, so this one is used. The hold time estimate is how long initialization takes.
+#define MAX_SPIN_COUNT          ((size_t)1000)
+
+__attribute__((__always_inline__))
+static inline uintptr_t SetHoldTimeLog(uintptr_t uOld, size_t uHoldTimeLog){
+	return (uOld & ~MASK_HOLD_TIME_LOG) | uHoldTimeLog * HOLD_TIME_LOG_ONE;
+}
+
 __attribute__((__always_inline__))
 static inline _MCFCRT_OnceResult ReallyWaitForOnceFlag(volatile uintptr_t *puControl, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
 	for(;;){
-		bool bFinished, bTaken = false;
+		uint64_t u64SpinTicks;
+		bool bFinished, bTaken = false, bSpinnable = false;
 		{
 			uintptr_t uOld, uNew;
 			uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
@@ -49,8 +64,20 @@ static inline _MCFCRT_OnceResult ReallyWaitForOnceFlag(volatile uintptr_t *puCon
 					break;
 				}
 				bTaken = !(uOld & MASK_LOCKED);
+				bSpinnable = false;
 				if(!bTaken){
-					uNew = uOld + THREADS_TRAPPED_ONE;
+					// Spin only if the initialization is expected to finish sooner than a thread could be parked and woken up.
+					const size_t uHoldTimeLog = (uOld & MASK_HOLD_TIME_LOG) / HOLD_TIME_LOG_ONE;
+					u64SpinTicks = __MCFCRT_SpinBudgetGetTicks(MAX_SPIN_COUNT, uHoldTimeLog);
+					if(u64SpinTicks != 0){
+						const size_t uThreadsSpinning = (uOld & MASK_THREADS_SPINNING) / THREADS_SPINNING_ONE;
+						bSpinnable = uThreadsSpinning < THREADS_SPINNING_MAX;
+					}
+					if(bSpinnable){
+						uNew = uOld + THREADS_SPINNING_ONE;
+					} else {
+						uNew = uOld + THREADS_TRAPPED_ONE;
+					}
 				} else {
 					uNew = uOld + MASK_LOCKED;
 				}
@@ -62,11 +89,49 @@ static inline _MCFCRT_OnceResult ReallyWaitForOnceFlag(volatile uintptr_t *puCon
 		if(_MCFCRT_EXPECT(bTaken)){
 			return _MCFCRT_kOnceResultInitial;
 		}
+		if(_MCFCRT_EXPECT(bSpinnable)){
+			// Spinning threads are not counted as trapped, so the initializing thread need not wake them up.
+			const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+			uint64_t u64SpinNow;
+			bool bSpinTimedOut;
+			do {
+				__atomic_thread_fence(__ATOMIC_SEQ_CST);
+				__builtin_ia32_pause();
+				__atomic_thread_fence(__ATOMIC_SEQ_CST);
+				u64SpinNow = _MCFCRT_ReadTimeStampCounter64();
+				bSpinTimedOut = u64SpinNow - u64SpinBegin >= u64SpinTicks;
+				{
+					uintptr_t uOld, uNew;
+					uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+					do {
+						const size_t uHoldTimeLog = (uOld & MASK_HOLD_TIME_LOG) / HOLD_TIME_LOG_ONE;
+						bFinished = !!(uOld & MASK_FINISHED);
+						bTaken = !bFinished && !(uOld & MASK_LOCKED);
+						if(bFinished || bTaken){
+							// Learn from how long this thread has been waiting for the initialization.
+							uNew = SetHoldTimeLog(uOld, __MCFCRT_SpinBudgetUpdateHoldTimeLog(uHoldTimeLog, u64SpinNow - u64SpinBegin)) - THREADS_SPINNING_ONE + bTaken * MASK_LOCKED;
+						} else if(bSpinTimedOut){
+							// The budget has been exhausted, so the initialization takes longer than expected.
+							const bool bHoldTimeLogIncremented = uHoldTimeLog < HOLD_TIME_LOG_MAX;
+							uNew = uOld - THREADS_SPINNING_ONE + THREADS_TRAPPED_ONE + bHoldTimeLogIncremented * HOLD_TIME_LOG_ONE;
+						} else {
+							break;
+						}
+					} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
+				}
+				if(_MCFCRT_EXPECT_NOT(bFinished)){
+					return _MCFCRT_kOnceResultFinished;
+				}
+				if(_MCFCRT_EXPECT_NOT(bTaken)){
+					return _MCFCRT_kOnceResultInitial;
+				}
+			} while(_MCFCRT_EXPECT(!bSpinTimedOut));
+		}
 		if(bMayTimeOut){
 			LARGE_INTEGER liTimeout;
 			__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
-			NTSTATUS lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, &liTimeout);
-			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+			NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, &liTimeout);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
 			while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
 				bool bDecremented;
 				{
@@ -85,12 +150,12 @@ static inline _MCFCRT_OnceResult ReallyWaitForOnceFlag(volatile uintptr_t *puCon
 					return _MCFCRT_kOnceResultTimedOut;
 				}
 				liTimeout.QuadPart = 0;
-				lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, &liTimeout);
-				_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+				lStatus = __MCFCRT_ParkThread((void *)puControl, &liTimeout);
+				_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
 			}
 		} else {
-			NTSTATUS lStatus = NtWaitForKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, _MCFCRT_NULLPTR);
-			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtWaitForKeyedEvent() failed.");
+			NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, _MCFCRT_NULLPTR);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
 			_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
 		}
 	}
@@ -111,13 +176,12 @@ static inline void ReallySignalOnceFlag(volatile uintptr_t *puControl, bool bFin
 		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)));
 	}
 	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
-	// Calling `NtReleaseKeyedEvent()` when no thread is waiting results in deadlocks. Don't do that.
+	// Unparking threads that will never park leaves stale wakeups behind. Don't do that.
 	if(_MCFCRT_EXPECT_NOT((uCountToSignal > 0) && !RtlDllShutdownInProgress())){
-		for(size_t uIndex = 0; uIndex < uCountToSignal; ++uIndex){
-			NTSTATUS lStatus = NtReleaseKeyedEvent(_MCFCRT_NULLPTR, (void *)puControl, false, _MCFCRT_NULLPTR);
-			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtReleaseKeyedEvent() failed.");
-			_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
-		}
+		// Only one thread is woken up here. The others are woken up in a cascade.
+		NTSTATUS lStatus = __MCFCRT_UnparkThreads((void *)puControl, uCountToSignal);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThreads() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
 	}
 }
 
@@ -34,7 +34,7 @@ extern void __MCFCRT_ReallySignalOnceFlagAsFinished(_MCFCRT_OnceFlag *__pOnceFla
 extern void __MCFCRT_ReallySignalOnceFlagAsAborted(_MCFCRT_OnceFlag *__pOnceFlag) _MCFCRT_NOEXCEPT;
 
 // See Itanium ABI: <https://itanium-cxx-abi.github.io/cxx-abi/abi.html#guards>
-// Bytes other than the first byte are used as the counter of trapped threads, in native byte order.
+// Bytes other than the first byte are used as the lock bit, the number of spinning threads, the estimate of the time of initialization and the counter of trapped threads, in native byte order.
 __MCFCRT_ONCE_FLAG_INLINE_OR_EXTERN _MCFCRT_OnceResult _MCFCRT_WaitForOnceFlag(_MCFCRT_OnceFlag *__pOnceFlag, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
 	unsigned char *const __pbyGuard = (unsigned char *)(void *)&(__pOnceFlag->__u);
 	unsigned char __byLockFlag = __atomic_load_n(__pbyGuard, __ATOMIC_ACQUIRE);
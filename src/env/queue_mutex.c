@@ -0,0 +1,315 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_QUEUE_MUTEX_INLINE_OR_EXTERN     extern inline
+#include "queue_mutex.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "clocks.h"
+#include "thread.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+// Each thread in the queue has a node on its own stack. Nodes are aligned to cache lines, which leaves the low bits of a node pointer free.
+typedef struct tagQueueNode {
+	__attribute__((__aligned__(64))) struct tagQueueNode *pNext;
+	uintptr_t uState;
+} QueueNode;
+
+typedef enum tagQueueNodeState {
+	kNodeWaiting,
+	kNodeParked,
+	kNodeHead,
+} QueueNodeState;
+
+#define MASK_LOCKED             ((uintptr_t)0x01)
+#define MASK_HEAD_PARKED        ((uintptr_t)0x02)
+#define MASK_HOLD_TIME_LOG      ((uintptr_t)0x3C)
+#define MASK_TAIL               ((uintptr_t)~0x3F)
+
+#define HOLD_TIME_LOG_ONE       ((uintptr_t)(MASK_HOLD_TIME_LOG & -MASK_HOLD_TIME_LOG))
+#define HOLD_TIME_LOG_MAX       ((uintptr_t)(MASK_HOLD_TIME_LOG / HOLD_TIME_LOG_ONE))
+
+static_assert(__alignof__(QueueNode) > (MASK_LOCKED | MASK_HEAD_PARKED | MASK_HOLD_TIME_LOG), "QueueNode is not aligned enough.");
+
+__attribute__((__always_inline__))
+static inline uintptr_t SetHoldTimeLog(uintptr_t uOld, size_t uHoldTimeLog){
+	return (uOld & ~MASK_HOLD_TIME_LOG) | uHoldTimeLog * HOLD_TIME_LOG_ONE;
+}
+
+__attribute__((__always_inline__))
+static inline void WaitForHeadOfQueue(QueueNode *pNode, uint64_t u64SpinTicks){
+	if(u64SpinTicks != 0){
+		const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+		do {
+			if(__atomic_load_n(&(pNode->uState), __ATOMIC_ACQUIRE) == kNodeHead){
+				return;
+			}
+			__builtin_ia32_pause();
+		} while(_MCFCRT_EXPECT(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks));
+	}
+	uintptr_t uState = kNodeWaiting;
+	if(!__atomic_compare_exchange_n(&(pNode->uState), &uState, kNodeParked, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)){
+		_MCFCRT_ASSERT(uState == kNodeHead);
+		return;
+	}
+	NTSTATUS lStatus = __MCFCRT_ParkThread(pNode, _MCFCRT_NULLPTR);
+	_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+	_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+__attribute__((__always_inline__))
+static inline void MakeHeadOfQueue(QueueNode *pNode){
+	// `pNode` may go out of scope as soon as its state has been set, unless the thread has been parked.
+	const uintptr_t uOldState = __atomic_exchange_n(&(pNode->uState), kNodeHead, __ATOMIC_RELEASE);
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	// Unparking threads that will never park leaves stale wakeups behind. Don't do that.
+	if(_MCFCRT_EXPECT_NOT((uOldState == kNodeParked) && !RtlDllShutdownInProgress())){
+		NTSTATUS lStatus = __MCFCRT_UnparkThread(pNode);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThread() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+}
+
+// The spin failure counter saturates at this value, after which contending threads join the queue.
+#define SPIN_FAILURES_MAX       ((size_t)8)
+
+// This callback is called with the bucket locked. Timed waiters are counted before they are parked, so either they see the mutex unlocked here, or the unlocking thread sees them.
+static bool ValidateTimedParking(intptr_t nContext){
+	volatile uintptr_t *const puControl = (volatile uintptr_t *)nContext;
+	return __atomic_load_n(puControl, __ATOMIC_SEQ_CST) & MASK_LOCKED;
+}
+
+__attribute__((__always_inline__))
+static inline bool IncrementSpinFailures(volatile size_t *puSpinFailures){
+	size_t uOld = __atomic_load_n(puSpinFailures, __ATOMIC_RELAXED);
+	do {
+		if(uOld >= SPIN_FAILURES_MAX){
+			return true;
+		}
+	} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puSpinFailures, &uOld, uOld + 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)));
+	return uOld + 1 >= SPIN_FAILURES_MAX;
+}
+__attribute__((__always_inline__))
+static inline void DecrementSpinFailures(volatile size_t *puSpinFailures){
+	size_t uOld = __atomic_load_n(puSpinFailures, __ATOMIC_RELAXED);
+	do {
+		if(uOld == 0){
+			return;
+		}
+	} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puSpinFailures, &uOld, uOld - 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)));
+}
+
+// Spins on the control word like a plain mutex. At least one attempt is made, even if the spin budget is zero.
+// If `bStopIfQueued` is `true`, this function gives up as soon as a thread has queued up, so newcomers line up behind it instead of stealing the mutex.
+__attribute__((__always_inline__))
+static inline bool SpinForQueueMutex(volatile uintptr_t *puControl, size_t uMaxSpinCount, bool bStopIfQueued, bool *pbQueueNonEmpty){
+	const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicks(uMaxSpinCount, (__atomic_load_n(puControl, __ATOMIC_RELAXED) & MASK_HOLD_TIME_LOG) / HOLD_TIME_LOG_ONE);
+	const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+	uint64_t u64SpinNow;
+	bool bQueueNonEmpty;
+	do {
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		__builtin_ia32_pause();
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		u64SpinNow = _MCFCRT_ReadTimeStampCounter64();
+		bool bTaken;
+		{
+			uintptr_t uOld, uNew;
+			uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+			do {
+				bQueueNonEmpty = (uOld & MASK_TAIL) != 0;
+				bTaken = !(bStopIfQueued && bQueueNonEmpty) && !(uOld & MASK_LOCKED);
+				if(!bTaken){
+					break;
+				}
+				const size_t uHoldTimeLog = (uOld & MASK_HOLD_TIME_LOG) / HOLD_TIME_LOG_ONE;
+				uNew = SetHoldTimeLog(uOld, __MCFCRT_SpinBudgetUpdateHoldTimeLog(uHoldTimeLog, u64SpinNow - u64SpinBegin)) | MASK_LOCKED;
+			} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
+		}
+		if(_MCFCRT_EXPECT_NOT(bTaken)){
+			*pbQueueNonEmpty = bQueueNonEmpty;
+			return true;
+		}
+		if(bStopIfQueued && bQueueNonEmpty){
+			*pbQueueNonEmpty = true;
+			return false;
+		}
+	} while(_MCFCRT_EXPECT(u64SpinNow - u64SpinBegin < u64SpinTicks));
+	if(u64SpinTicks != 0){
+		// The budget has been exhausted, so the mutex is held for longer than expected.
+		uintptr_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			const size_t uHoldTimeLog = (uOld & MASK_HOLD_TIME_LOG) / HOLD_TIME_LOG_ONE;
+			if(uHoldTimeLog >= HOLD_TIME_LOG_MAX){
+				break;
+			}
+			uNew = uOld + HOLD_TIME_LOG_ONE;
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)));
+	}
+	*pbQueueNonEmpty = bQueueNonEmpty;
+	return false;
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForQueueMutex(volatile uintptr_t *puControl, volatile size_t *puSpinFailures, volatile size_t *puTimedWaiters, size_t uMaxSpinCount, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	{
+		bool bTaken;
+		uintptr_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			const size_t uHoldTimeLog = (uOld & MASK_HOLD_TIME_LOG) / HOLD_TIME_LOG_ONE;
+			bTaken = !(uOld & MASK_LOCKED);
+			if(!bTaken){
+				break;
+			}
+			// The mutex was free, so it is probably held for shorter than expected.
+			const bool bHoldTimeLogDecremented = uHoldTimeLog != 0;
+			uNew = uOld + MASK_LOCKED - bHoldTimeLogDecremented * HOLD_TIME_LOG_ONE;
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
+		if(_MCFCRT_EXPECT(bTaken)){
+			return true;
+		}
+	}
+	if(bMayTimeOut){
+		// Timed waiters can't join the queue, so they spin and get parked aside, competing with the head of the queue.
+		for(;;){
+			bool bQueueNonEmpty;
+			if(SpinForQueueMutex(puControl, uMaxSpinCount, false, &bQueueNonEmpty)){
+				return true;
+			}
+			__atomic_fetch_add(puTimedWaiters, 1, __ATOMIC_SEQ_CST);
+			LARGE_INTEGER liTimeout;
+			__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+			const __MCFCRT_ParkResult eResult = __MCFCRT_ParkThreadIf((void *)puTimedWaiters, &ValidateTimedParking, (intptr_t)puControl, &liTimeout);
+			__atomic_fetch_sub(puTimedWaiters, 1, __ATOMIC_RELAXED);
+			if(eResult == __MCFCRT_kParkResultTimedOut){
+				// Make a final attempt, as the mutex might have been unlocked after the timeout expired.
+				uintptr_t uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+				do {
+					if(uOld & MASK_LOCKED){
+						return false;
+					}
+				} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uOld | MASK_LOCKED, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+				return true;
+			}
+		}
+	}
+	// Spin on the control word like a plain mutex, but only as long as the queue is empty. Once a thread has queued up, newcomers line up behind it.
+	// Each failed round of spinning bumps the spin failure counter and each successful one decrements it. Contending threads only join the queue once it saturates.
+	for(;;){
+		bool bQueueNonEmpty;
+		if(SpinForQueueMutex(puControl, uMaxSpinCount, true, &bQueueNonEmpty)){
+			DecrementSpinFailures(puSpinFailures);
+			return true;
+		}
+		if(bQueueNonEmpty){
+			break;
+		}
+		if(IncrementSpinFailures(puSpinFailures)){
+			break;
+		}
+		_MCFCRT_YieldThread();
+	}
+	// Join the queue.
+	uint64_t u64SpinTicks;
+	QueueNode vNode;
+	vNode.pNext = _MCFCRT_NULLPTR;
+	vNode.uState = kNodeWaiting;
+	{
+		QueueNode *pPrev;
+		uintptr_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			pPrev = (QueueNode *)(uOld & MASK_TAIL);
+			u64SpinTicks = __MCFCRT_SpinBudgetGetTicks(uMaxSpinCount, (uOld & MASK_HOLD_TIME_LOG) / HOLD_TIME_LOG_ONE);
+			uNew = (uOld & ~MASK_TAIL) | (uintptr_t)&vNode;
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)));
+		if(pPrev){
+			__atomic_store_n(&(pPrev->pNext), &vNode, __ATOMIC_RELEASE);
+			WaitForHeadOfQueue(&vNode, u64SpinTicks);
+		}
+	}
+	// This thread is at the head of the queue now. No other thread waits on the control word, so it is safe to use it as the key.
+	bool bQueueEmptied;
+	for(;;){
+		if(u64SpinTicks != 0){
+			const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+			while(_MCFCRT_EXPECT((__atomic_load_n(puControl, __ATOMIC_RELAXED) & MASK_LOCKED) && (_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks))){
+				__builtin_ia32_pause();
+			}
+		}
+		bool bTaken;
+		{
+			uintptr_t uOld, uNew;
+			uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+			do {
+				bTaken = !(uOld & MASK_LOCKED);
+				if(!bTaken){
+					uNew = uOld | MASK_HEAD_PARKED;
+				} else {
+					bQueueEmptied = (uOld & MASK_TAIL) == (uintptr_t)&vNode;
+					if(bQueueEmptied){
+						uNew = (uOld & ~MASK_TAIL) | MASK_LOCKED;
+					} else {
+						uNew = uOld | MASK_LOCKED;
+					}
+				}
+			} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)));
+		}
+		if(_MCFCRT_EXPECT(bTaken)){
+			break;
+		}
+		NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, _MCFCRT_NULLPTR);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+	if(bQueueEmptied){
+		// Contention has gone, so let the mutex deflate gradually.
+		DecrementSpinFailures(puSpinFailures);
+	} else {
+		// The next thread has swapped itself in as the tail but may not have linked itself to this node yet.
+		QueueNode *pNext;
+		while(_MCFCRT_EXPECT_NOT(!(pNext = __atomic_load_n(&(vNode.pNext), __ATOMIC_ACQUIRE)))){
+			__builtin_ia32_pause();
+		}
+		MakeHeadOfQueue(pNext);
+	}
+	return true;
+}
+__attribute__((__always_inline__))
+static inline void ReallySignalQueueMutex(volatile uintptr_t *puControl, volatile size_t *puTimedWaiters){
+	// This has to be sequentially consistent with the load of the number of timed waiters below. See `ValidateTimedParking()`.
+	const uintptr_t uOld = __atomic_fetch_and(puControl, ~(MASK_LOCKED | MASK_HEAD_PARKED), __ATOMIC_SEQ_CST);
+	_MCFCRT_ASSERT_MSG(uOld & MASK_LOCKED, L"This queue mutex isn't locked by any thread.");
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	// Unparking threads that will never park leaves stale wakeups behind. Don't do that.
+	if(_MCFCRT_EXPECT_NOT((uOld & MASK_HEAD_PARKED) && !RtlDllShutdownInProgress())){
+		NTSTATUS lStatus = __MCFCRT_UnparkThread((void *)puControl);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThread() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+	// Wake one timed waiter up, which competes with the head of the queue. If it loses, it will be parked again.
+	if(_MCFCRT_EXPECT_NOT((__atomic_load_n(puTimedWaiters, __ATOMIC_SEQ_CST) != 0) && !RtlDllShutdownInProgress())){
+		__MCFCRT_UnparkOneThread((void *)puTimedWaiters, _MCFCRT_NULLPTR, 0);
+	}
+}
+
+bool __MCFCRT_ReallyWaitForQueueMutex(_MCFCRT_QueueMutex *pQueueMutex, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+	const bool bTaken = ReallyWaitForQueueMutex(&(pQueueMutex->__u), &(pQueueMutex->__uSpinFailures), &(pQueueMutex->__uTimedWaiters), uMaxSpinCount, true, u64UntilFastMonoClock);
+	return bTaken;
+}
+void __MCFCRT_ReallyWaitForQueueMutexForever(_MCFCRT_QueueMutex *pQueueMutex, size_t uMaxSpinCount){
+	const bool bTaken = ReallyWaitForQueueMutex(&(pQueueMutex->__u), &(pQueueMutex->__uSpinFailures), &(pQueueMutex->__uTimedWaiters), uMaxSpinCount, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bTaken);
+}
+void __MCFCRT_ReallySignalQueueMutex(_MCFCRT_QueueMutex *pQueueMutex){
+	ReallySignalQueueMutex(&(pQueueMutex->__u), &(pQueueMutex->__uTimedWaiters));
+}
@@ -0,0 +1,69 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_QUEUE_MUTEX_H_
+#define __MCFCRT_ENV_QUEUE_MUTEX_H_
+
+#include "_crtdef.h"
+
+#ifndef __MCFCRT_QUEUE_MUTEX_INLINE_OR_EXTERN
+#  define __MCFCRT_QUEUE_MUTEX_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// A queue mutex behaves like a plain mutex while contention is light.
+// Failed rounds of spinning are counted, and once the counter saturates, threads line up in a queue, where each thread spins and sleeps on its own cache line.
+// Only the thread at the head of the queue watches the mutex itself, so heavy contention does not cause cache line bouncing.
+// Threads in the queue can't give up, so timed waits never join the queue. They are parked aside and compete with the head of the queue instead.
+// In the case of static initialization, please initialize it with { 0 }.
+typedef struct __MCFCRT_tagQueueMutex {
+	_MCFCRT_STD uintptr_t __u;
+	_MCFCRT_STD size_t __uSpinFailures;
+	_MCFCRT_STD size_t __uTimedWaiters;
+} _MCFCRT_QueueMutex;
+
+#define _MCFCRT_QUEUE_MUTEX_SUGGESTED_SPIN_COUNT   100u
+
+__MCFCRT_QUEUE_MUTEX_INLINE_OR_EXTERN void _MCFCRT_InitializeQueueMutex(_MCFCRT_QueueMutex *__pQueueMutex) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pQueueMutex->__uSpinFailures), 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&(__pQueueMutex->__uTimedWaiters), 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&(__pQueueMutex->__u), 0, __ATOMIC_RELEASE);
+}
+
+extern bool __MCFCRT_ReallyWaitForQueueMutex(_MCFCRT_QueueMutex *__pQueueMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForQueueMutexForever(_MCFCRT_QueueMutex *__pQueueMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallySignalQueueMutex(_MCFCRT_QueueMutex *__pQueueMutex) _MCFCRT_NOEXCEPT;
+
+// The lowest bit of the control word is the lock bit.
+__MCFCRT_QUEUE_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_TryWaitForQueueMutex(_MCFCRT_QueueMutex *__pQueueMutex) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD uintptr_t __uOld = __atomic_load_n(&(__pQueueMutex->__u), __ATOMIC_RELAXED);
+	do {
+		if(__uOld & 1){
+			return false;
+		}
+	} while(!__atomic_compare_exchange_n(&(__pQueueMutex->__u), &__uOld, __uOld | 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+	return true;
+}
+__MCFCRT_QUEUE_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_WaitForQueueMutex(_MCFCRT_QueueMutex *__pQueueMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD uintptr_t __uOld = 0;
+	if(__builtin_expect(__atomic_compare_exchange_n(&(__pQueueMutex->__u), &__uOld, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED), true)){
+		return true;
+	}
+	return __MCFCRT_ReallyWaitForQueueMutex(__pQueueMutex, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_QUEUE_MUTEX_INLINE_OR_EXTERN void _MCFCRT_WaitForQueueMutexForever(_MCFCRT_QueueMutex *__pQueueMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD uintptr_t __uOld = 0;
+	if(__builtin_expect(__atomic_compare_exchange_n(&(__pQueueMutex->__u), &__uOld, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED), true)){
+		return;
+	}
+	__MCFCRT_ReallyWaitForQueueMutexForever(__pQueueMutex, __uMaxSpinCount);
+}
+__MCFCRT_QUEUE_MUTEX_INLINE_OR_EXTERN void _MCFCRT_SignalQueueMutex(_MCFCRT_QueueMutex *__pQueueMutex) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallySignalQueueMutex(__pQueueMutex);
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
@@ -0,0 +1,181 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_SEMAPHORE_INLINE_OR_EXTERN     extern inline
+#include "semaphore.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "clocks.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+#define MASK_THREADS_SPINNING   ((uint64_t)0x000000000000000F)
+#define MASK_WAIT_TIME_LOG      ((uint64_t)0x00000000000000F0)
+#define MASK_THREADS_TRAPPED    ((uint64_t)0x00000000FFFFFF00)
+#define MASK_COUNT              ((uint64_t)0xFFFFFFFF00000000)
+
+#define THREADS_SPINNING_ONE    ((uint64_t)(MASK_THREADS_SPINNING & -MASK_THREADS_SPINNING))
+#define THREADS_SPINNING_MAX    ((uint64_t)(MASK_THREADS_SPINNING / THREADS_SPINNING_ONE))
+
+#define WAIT_TIME_LOG_ONE       ((uint64_t)(MASK_WAIT_TIME_LOG & -MASK_WAIT_TIME_LOG))
+#define WAIT_TIME_LOG_MAX       ((uint64_t)(MASK_WAIT_TIME_LOG / WAIT_TIME_LOG_ONE))
+
+#define THREADS_TRAPPED_ONE     ((uint64_t)(MASK_THREADS_TRAPPED & -MASK_THREADS_TRAPPED))
+#define THREADS_TRAPPED_MAX     ((uint64_t)(MASK_THREADS_TRAPPED / THREADS_TRAPPED_ONE))
+
+#define COUNT_ONE               ((uint64_t)(MASK_COUNT & -MASK_COUNT))
+#define COUNT_MAX               ((uint64_t)(MASK_COUNT / COUNT_ONE))
+
+static_assert(COUNT_ONE == __MCFCRT_SEMAPHORE_COUNT_ONE, "The inline functions in the header rely on this.");
+static_assert(COUNT_MAX == _MCFCRT_SEMAPHORE_COUNT_MAX, "The count limit is wrong.");
+
+__attribute__((__always_inline__))
+static inline uint64_t SetWaitTimeLog(uint64_t uOld, size_t uWaitTimeLog){
+	return (uOld & ~MASK_WAIT_TIME_LOG) | uWaitTimeLog * WAIT_TIME_LOG_ONE;
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForSemaphore(volatile uint64_t *puControl, size_t uMaxSpinCount, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	uint64_t u64SpinTicks;
+	bool bTaken, bSpinnable = false;
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			bTaken = !!(uOld & MASK_COUNT);
+			bSpinnable = false;
+			if(!bTaken){
+				// Spin only if a unit is expected to become available sooner than a thread could be parked and woken up.
+				const size_t uWaitTimeLog = (uOld & MASK_WAIT_TIME_LOG) / WAIT_TIME_LOG_ONE;
+				u64SpinTicks = __MCFCRT_SpinBudgetGetTicks(uMaxSpinCount, uWaitTimeLog);
+				if(u64SpinTicks != 0){
+					const uint64_t u64ThreadsSpinning = (uOld & MASK_THREADS_SPINNING) / THREADS_SPINNING_ONE;
+					bSpinnable = u64ThreadsSpinning < THREADS_SPINNING_MAX;
+				}
+				if(bSpinnable){
+					uNew = uOld + THREADS_SPINNING_ONE;
+				} else {
+					_MCFCRT_ASSERT_MSG((uOld & MASK_THREADS_TRAPPED) != MASK_THREADS_TRAPPED, L"Too many threads are waiting for this semaphore.");
+					uNew = uOld + THREADS_TRAPPED_ONE;
+				}
+			} else {
+				uNew = uOld - COUNT_ONE;
+			}
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+	}
+	if(_MCFCRT_EXPECT(bTaken)){
+		return true;
+	}
+	if(_MCFCRT_EXPECT(bSpinnable)){
+		// Spinning threads are not counted as trapped, so they are never handed units directly. They compete for the count instead.
+		const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+		uint64_t u64SpinNow;
+		bool bSpinTimedOut;
+		do {
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			__builtin_ia32_pause();
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			u64SpinNow = _MCFCRT_ReadTimeStampCounter64();
+			bSpinTimedOut = u64SpinNow - u64SpinBegin >= u64SpinTicks;
+			{
+				uint64_t uOld, uNew;
+				uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+				do {
+					const size_t uWaitTimeLog = (uOld & MASK_WAIT_TIME_LOG) / WAIT_TIME_LOG_ONE;
+					bTaken = !!(uOld & MASK_COUNT);
+					if(bTaken){
+						// Learn from how long this thread has been waiting for a unit.
+						uNew = SetWaitTimeLog(uOld, __MCFCRT_SpinBudgetUpdateHoldTimeLog(uWaitTimeLog, u64SpinNow - u64SpinBegin)) - THREADS_SPINNING_ONE - COUNT_ONE;
+					} else if(bSpinTimedOut){
+						// The budget has been exhausted, so units are released less frequently than expected.
+						_MCFCRT_ASSERT_MSG((uOld & MASK_THREADS_TRAPPED) != MASK_THREADS_TRAPPED, L"Too many threads are waiting for this semaphore.");
+						const bool bWaitTimeLogIncremented = uWaitTimeLog < WAIT_TIME_LOG_MAX;
+						uNew = uOld - THREADS_SPINNING_ONE + THREADS_TRAPPED_ONE + bWaitTimeLogIncremented * WAIT_TIME_LOG_ONE;
+					} else {
+						break;
+					}
+				} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+			}
+			if(_MCFCRT_EXPECT_NOT(bTaken)){
+				return true;
+			}
+		} while(_MCFCRT_EXPECT(!bSpinTimedOut));
+	}
+	// Trapped threads are always woken up with a unit handed off to them. See `ReallySignalSemaphore()`.
+	if(bMayTimeOut){
+		LARGE_INTEGER liTimeout;
+		__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+		NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, &liTimeout);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
+			bool bDecremented;
+			{
+				uint64_t uOld, uNew;
+				uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+				do {
+					const uint64_t u64ThreadsTrapped = (uOld & MASK_THREADS_TRAPPED) / THREADS_TRAPPED_ONE;
+					bDecremented = u64ThreadsTrapped != 0;
+					if(!bDecremented){
+						break;
+					}
+					uNew = uOld - THREADS_TRAPPED_ONE;
+				} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+			}
+			if(bDecremented){
+				return false;
+			}
+			liTimeout.QuadPart = 0;
+			lStatus = __MCFCRT_ParkThread((void *)puControl, &liTimeout);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		}
+	} else {
+		NTSTATUS lStatus = __MCFCRT_ParkThread((void *)puControl, _MCFCRT_NULLPTR);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+	return true;
+}
+__attribute__((__always_inline__))
+static inline size_t ReallySignalSemaphore(volatile uint64_t *puControl, uint32_t u32CountToAdd){
+	uint64_t u64CountToSignal;
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			// Hand units off to trapped threads first. The rest are added to the count.
+			const uint64_t u64ThreadsTrapped = (uOld & MASK_THREADS_TRAPPED) / THREADS_TRAPPED_ONE;
+			u64CountToSignal = (u64ThreadsTrapped <= u32CountToAdd) ? u64ThreadsTrapped : u32CountToAdd;
+			const uint64_t u64CountAdded = u32CountToAdd - u64CountToSignal;
+			_MCFCRT_ASSERT_MSG(COUNT_MAX - (uOld & MASK_COUNT) / COUNT_ONE >= u64CountAdded, L"The count of this semaphore would overflow.");
+			uNew = uOld - u64CountToSignal * THREADS_TRAPPED_ONE + u64CountAdded * COUNT_ONE;
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)));
+	}
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	// Unparking threads that will never park leaves stale wakeups behind. Don't do that.
+	if(_MCFCRT_EXPECT_NOT((u64CountToSignal > 0) && !RtlDllShutdownInProgress())){
+		// Only one thread is woken up here. The others are woken up in a cascade.
+		NTSTATUS lStatus = __MCFCRT_UnparkThreads((void *)puControl, (size_t)u64CountToSignal);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThreads() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+	return (size_t)u64CountToSignal;
+}
+
+bool __MCFCRT_ReallyWaitForSemaphore(_MCFCRT_Semaphore *pSemaphore, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+	const bool bTaken = ReallyWaitForSemaphore(&(pSemaphore->__u), uMaxSpinCount, true, u64UntilFastMonoClock);
+	return bTaken;
+}
+void __MCFCRT_ReallyWaitForSemaphoreForever(_MCFCRT_Semaphore *pSemaphore, size_t uMaxSpinCount){
+	const bool bTaken = ReallyWaitForSemaphore(&(pSemaphore->__u), uMaxSpinCount, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bTaken);
+}
+size_t __MCFCRT_ReallySignalSemaphore(_MCFCRT_Semaphore *pSemaphore, uint32_t u32CountToAdd){
+	const size_t uCountSignaled = ReallySignalSemaphore(&(pSemaphore->__u), u32CountToAdd);
+	return uCountSignaled;
+}
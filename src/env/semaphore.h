@@ -0,0 +1,69 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_SEMAPHORE_H_
+#define __MCFCRT_ENV_SEMAPHORE_H_
+
+#include "_crtdef.h"
+
+#ifndef __MCFCRT_SEMAPHORE_INLINE_OR_EXTERN
+#  define __MCFCRT_SEMAPHORE_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// In the case of static initialization, please initialize it with `_MCFCRT_SEMAPHORE_INITIALIZER(count)`, or { 0 } if the initial count is zero.
+// The control word is 64-bit wide even on x86, otherwise there wouldn't be enough room for the count.
+typedef struct __MCFCRT_tagSemaphore {
+	__attribute__((__aligned__(8))) _MCFCRT_STD uint64_t __u;
+} _MCFCRT_Semaphore;
+
+#define _MCFCRT_SEMAPHORE_SUGGESTED_SPIN_COUNT   100u
+#define _MCFCRT_SEMAPHORE_COUNT_MAX              0xFFFFFFFFu
+
+// The count takes the upper half of the control word.
+#define __MCFCRT_SEMAPHORE_COUNT_ONE             ((_MCFCRT_STD uint64_t)1 << 32)
+
+#define _MCFCRT_SEMAPHORE_INITIALIZER(__count_)  { (_MCFCRT_STD uint64_t)(__count_) * __MCFCRT_SEMAPHORE_COUNT_ONE }
+
+__MCFCRT_SEMAPHORE_INLINE_OR_EXTERN void _MCFCRT_InitializeSemaphore(_MCFCRT_Semaphore *__pSemaphore, _MCFCRT_STD uint32_t __u32InitialCount) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pSemaphore->__u), __u32InitialCount * __MCFCRT_SEMAPHORE_COUNT_ONE, __ATOMIC_RELEASE);
+}
+
+extern bool __MCFCRT_ReallyWaitForSemaphore(_MCFCRT_Semaphore *__pSemaphore, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForSemaphoreForever(_MCFCRT_Semaphore *__pSemaphore, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern _MCFCRT_STD size_t __MCFCRT_ReallySignalSemaphore(_MCFCRT_Semaphore *__pSemaphore, _MCFCRT_STD uint32_t __u32CountToAdd) _MCFCRT_NOEXCEPT;
+
+// Decrements the count if it is positive. This function never blocks.
+// Waiting threads are handed units directly when the semaphore is signaled, so the count is positive only if there are no waiting threads.
+__MCFCRT_SEMAPHORE_INLINE_OR_EXTERN bool _MCFCRT_TryWaitForSemaphore(_MCFCRT_Semaphore *__pSemaphore) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD uint64_t __uOld = __atomic_load_n(&(__pSemaphore->__u), __ATOMIC_RELAXED);
+	do {
+		if(__uOld < __MCFCRT_SEMAPHORE_COUNT_ONE){
+			return false;
+		}
+	} while(__builtin_expect(!__atomic_compare_exchange_n(&(__pSemaphore->__u), &__uOld, __uOld - __MCFCRT_SEMAPHORE_COUNT_ONE, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED), false));
+	return true;
+}
+__MCFCRT_SEMAPHORE_INLINE_OR_EXTERN bool _MCFCRT_WaitForSemaphore(_MCFCRT_Semaphore *__pSemaphore, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	if(__builtin_expect(_MCFCRT_TryWaitForSemaphore(__pSemaphore), true)){
+		return true;
+	}
+	return __MCFCRT_ReallyWaitForSemaphore(__pSemaphore, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_SEMAPHORE_INLINE_OR_EXTERN void _MCFCRT_WaitForSemaphoreForever(_MCFCRT_Semaphore *__pSemaphore, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	if(__builtin_expect(_MCFCRT_TryWaitForSemaphore(__pSemaphore), true)){
+		return;
+	}
+	__MCFCRT_ReallyWaitForSemaphoreForever(__pSemaphore, __uMaxSpinCount);
+}
+// Adds `__u32CountToAdd` to the count, waking up at most that many waiting threads. The number of threads woken up is returned.
+// The count must not exceed `_MCFCRT_SEMAPHORE_COUNT_MAX` after the addition.
+__MCFCRT_SEMAPHORE_INLINE_OR_EXTERN _MCFCRT_STD size_t _MCFCRT_SignalSemaphore(_MCFCRT_Semaphore *__pSemaphore, _MCFCRT_STD uint32_t __u32CountToAdd) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallySignalSemaphore(__pSemaphore, __u32CountToAdd);
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
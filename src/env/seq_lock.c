@@ -0,0 +1,46 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_SEQ_LOCK_INLINE_OR_EXTERN     extern inline
+#include "seq_lock.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "clocks.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+// This callback is called with the bucket locked, which serializes it with `__MCFCRT_SeqLockWakeReaders()`.
+static bool IsWriteInProgress(intptr_t nContext){
+	const _MCFCRT_SeqLock *const pSeqLock = (const _MCFCRT_SeqLock *)nContext;
+	return __atomic_load_n(&(pSeqLock->__uSequence), __ATOMIC_SEQ_CST) & 1;
+}
+
+_MCFCRT_SeqLockToken __MCFCRT_ReallyBeginReadingSeqLock(_MCFCRT_SeqLock *pSeqLock, size_t uMaxSpinCount){
+	const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicksForCount(uMaxSpinCount);
+	uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+	for(;;){
+		const _MCFCRT_SeqLockToken uToken = __atomic_load_n(&(pSeqLock->__uSequence), __ATOMIC_ACQUIRE);
+		if(_MCFCRT_EXPECT(!(uToken & 1))){
+			return uToken;
+		}
+		if(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks){
+			__builtin_ia32_pause();
+			continue;
+		}
+		// The writer might have been preempted. Instead of burning CPU time, park on the sequence number until the write finishes.
+		// The queue of parked readers is kept in the parking lot, so readers don't write to the seq lock here, either.
+		__MCFCRT_ParkThreadIf((void *)&(pSeqLock->__uSequence), &IsWriteInProgress, (intptr_t)pSeqLock, _MCFCRT_NULLPTR);
+		u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+	}
+}
+void __MCFCRT_SeqLockWakeReaders(_MCFCRT_SeqLock *pSeqLock){
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	if(_MCFCRT_EXPECT_NOT(RtlDllShutdownInProgress())){
+		return;
+	}
+	__MCFCRT_UnparkAllThreads((void *)&(pSeqLock->__uSequence));
+}
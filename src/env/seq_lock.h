@@ -0,0 +1,84 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_SEQ_LOCK_H_
+#define __MCFCRT_ENV_SEQ_LOCK_H_
+
+#include "_crtdef.h"
+#include "mutex.h"
+
+#ifndef __MCFCRT_SEQ_LOCK_INLINE_OR_EXTERN
+#  define __MCFCRT_SEQ_LOCK_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// A seq lock protects data that is read frequently and written rarely. Writers are serialized by the embedded mutex and bump the sequence number
+// both before and after writing, so the sequence number is odd while a write is in progress. Readers never write to the seq lock. Instead, a reader
+// takes a token before reading, then validates it afterwards and retries if the data might have been modified in between.
+// A reader that finds a write in progress for too long parks on the sequence number in the parking lot, and the writer wakes all such readers when it finishes.
+// Because readers may observe data that are being modified, protected data must be accessed using atomic operations (relaxed ones suffice),
+// and anything read before the token is validated must not be relied upon (for example, pointers must not be dereferenced).
+// In the case of static initialization, please initialize it with { 0 }.
+typedef struct __MCFCRT_tagSeqLock {
+	_MCFCRT_STD uintptr_t __uSequence;
+	_MCFCRT_Mutex __vMutex;
+} _MCFCRT_SeqLock;
+
+typedef _MCFCRT_STD uintptr_t _MCFCRT_SeqLockToken;
+
+#define _MCFCRT_SEQ_LOCK_SUGGESTED_SPIN_COUNT   100u
+
+__MCFCRT_SEQ_LOCK_INLINE_OR_EXTERN void _MCFCRT_InitializeSeqLock(_MCFCRT_SeqLock *__pSeqLock) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pSeqLock->__uSequence), 0, __ATOMIC_RELAXED);
+	_MCFCRT_InitializeMutex(&(__pSeqLock->__vMutex));
+}
+
+extern _MCFCRT_SeqLockToken __MCFCRT_ReallyBeginReadingSeqLock(_MCFCRT_SeqLock *__pSeqLock, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+
+// If a write is in progress, this function spins for at most `__uMaxSpinCount` units of time, as defined for mutexes, then parks until the write finishes.
+__MCFCRT_SEQ_LOCK_INLINE_OR_EXTERN _MCFCRT_SeqLockToken _MCFCRT_BeginReadingSeqLock(_MCFCRT_SeqLock *__pSeqLock, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_SeqLockToken __uToken = __atomic_load_n(&(__pSeqLock->__uSequence), __ATOMIC_ACQUIRE);
+	if(__builtin_expect(!(__uToken & 1), true)){
+		return __uToken;
+	}
+	return __MCFCRT_ReallyBeginReadingSeqLock(__pSeqLock, __uMaxSpinCount);
+}
+// Returns `true` if no write has happened since the token was taken, in which case everything read in between is consistent.
+// The acquire fence keeps loads of protected data from being reordered after the load of the sequence number.
+__MCFCRT_SEQ_LOCK_INLINE_OR_EXTERN bool _MCFCRT_ValidateReadingSeqLock(_MCFCRT_SeqLock *__pSeqLock, _MCFCRT_SeqLockToken __uToken) _MCFCRT_NOEXCEPT {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __builtin_expect(__atomic_load_n(&(__pSeqLock->__uSequence), __ATOMIC_RELAXED) == __uToken, true);
+}
+
+// The release fence keeps stores to protected data from being reordered before the sequence number becomes odd.
+__MCFCRT_SEQ_LOCK_INLINE_OR_EXTERN void __MCFCRT_SeqLockBeginWriting(_MCFCRT_SeqLock *__pSeqLock) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uintptr_t __uSequence = __atomic_load_n(&(__pSeqLock->__uSequence), __ATOMIC_RELAXED);
+	__atomic_store_n(&(__pSeqLock->__uSequence), __uSequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+__MCFCRT_SEQ_LOCK_INLINE_OR_EXTERN bool _MCFCRT_WaitForSeqLock(_MCFCRT_SeqLock *__pSeqLock, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	if(!_MCFCRT_WaitForMutex(&(__pSeqLock->__vMutex), __uMaxSpinCount, __u64UntilFastMonoClock)){
+		return false;
+	}
+	__MCFCRT_SeqLockBeginWriting(__pSeqLock);
+	return true;
+}
+__MCFCRT_SEQ_LOCK_INLINE_OR_EXTERN void _MCFCRT_WaitForSeqLockForever(_MCFCRT_SeqLock *__pSeqLock, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	_MCFCRT_WaitForMutexForever(&(__pSeqLock->__vMutex), __uMaxSpinCount);
+	__MCFCRT_SeqLockBeginWriting(__pSeqLock);
+}
+extern void __MCFCRT_SeqLockWakeReaders(_MCFCRT_SeqLock *__pSeqLock) _MCFCRT_NOEXCEPT;
+
+__MCFCRT_SEQ_LOCK_INLINE_OR_EXTERN void _MCFCRT_SignalSeqLock(_MCFCRT_SeqLock *__pSeqLock) _MCFCRT_NOEXCEPT {
+	const _MCFCRT_STD uintptr_t __uSequence = __atomic_load_n(&(__pSeqLock->__uSequence), __ATOMIC_RELAXED);
+	__atomic_store_n(&(__pSeqLock->__uSequence), __uSequence + 1, __ATOMIC_RELEASE);
+	__MCFCRT_SeqLockWakeReaders(__pSeqLock);
+	_MCFCRT_SignalMutex(&(__pSeqLock->__vMutex));
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
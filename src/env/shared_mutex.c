@@ -0,0 +1,422 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN     extern inline
+#include "shared_mutex.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "_spin_budget.h"
+#include "clocks.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+#define MASK_LOCKED_EXCLUSIVE   ((uint64_t)0x0000000000000001)
+#define MASK_UPGRADE_PENDING    ((uint64_t)0x0000000000000002)
+#define MASK_UPGRADER_TRAPPED   ((uint64_t)0x0000000000000004)
+#define MASK_SHARED_OWNERS      ((uint64_t)0x000000000FFFFF00)
+#define MASK_SHARED_TRAPPED     ((uint64_t)0x00003FFFF0000000)
+#define MASK_EXCLUSIVE_TRAPPED  ((uint64_t)0xFFFFC00000000000)
+
+#define SHARED_OWNERS_ONE       ((uint64_t)(MASK_SHARED_OWNERS & -MASK_SHARED_OWNERS))
+#define SHARED_OWNERS_MAX       ((uint64_t)(MASK_SHARED_OWNERS / SHARED_OWNERS_ONE))
+
+#define SHARED_TRAPPED_ONE      ((uint64_t)(MASK_SHARED_TRAPPED & -MASK_SHARED_TRAPPED))
+#define SHARED_TRAPPED_MAX      ((uint64_t)(MASK_SHARED_TRAPPED / SHARED_TRAPPED_ONE))
+
+#define EXCLUSIVE_TRAPPED_ONE   ((uint64_t)(MASK_EXCLUSIVE_TRAPPED & -MASK_EXCLUSIVE_TRAPPED))
+#define EXCLUSIVE_TRAPPED_MAX   ((uint64_t)(MASK_EXCLUSIVE_TRAPPED / EXCLUSIVE_TRAPPED_ONE))
+
+static_assert(MASK_LOCKED_EXCLUSIVE == 1, "The inline functions in the header rely on this.");
+
+// New readers are blocked if any of these bits are set. This gives writers preference over new readers.
+#define MASK_BLOCKS_READERS     (MASK_LOCKED_EXCLUSIVE | MASK_UPGRADE_PENDING | MASK_EXCLUSIVE_TRAPPED)
+
+// Three kinds of threads are trapped on three distinct keys. All of them are within the control word itself and are even.
+static inline void *GetExclusiveKey(volatile uint64_t *puControl){
+	return (void *)puControl;
+}
+static inline void *GetSharedKey(volatile uint64_t *puControl){
+	return (void *)((char *)puControl + 2);
+}
+static inline void *GetUpgraderKey(volatile uint64_t *puControl){
+	return (void *)((char *)puControl + 4);
+}
+
+static inline void UnparkThreads(void *pKey, uint64_t u64CountToSignal){
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	// Unparking threads that will never park leaves stale wakeups behind. Don't do that.
+	if(_MCFCRT_EXPECT_NOT((u64CountToSignal > 0) && !RtlDllShutdownInProgress())){
+		NTSTATUS lStatus = __MCFCRT_UnparkThreads(pKey, (size_t)u64CountToSignal);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_UnparkThreads() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+}
+
+// Trapped readers are handed ownership directly, so they need not compete with new readers once woken up.
+// This is done every time a writer releases the lock, which prevents writers from starving readers.
+static inline uint64_t HandOffToTrappedReaders(uint64_t uOld, uint64_t *pu64CountToSignal){
+	const uint64_t u64ThreadsTrapped = (uOld & MASK_SHARED_TRAPPED) / SHARED_TRAPPED_ONE;
+	*pu64CountToSignal = u64ThreadsTrapped;
+	return uOld - u64ThreadsTrapped * SHARED_TRAPPED_ONE + u64ThreadsTrapped * SHARED_OWNERS_ONE;
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForSharedMutexShared(volatile uint64_t *puControl, size_t uMaxSpinCount, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	bool bTaken;
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			bTaken = !(uOld & MASK_BLOCKS_READERS);
+			if(!bTaken){
+				break;
+			}
+			_MCFCRT_ASSERT_MSG((uOld & MASK_SHARED_OWNERS) != MASK_SHARED_OWNERS, L"Too many threads share this shared mutex.");
+			uNew = uOld + SHARED_OWNERS_ONE;
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+	}
+	if(_MCFCRT_EXPECT(bTaken)){
+		return true;
+	}
+	const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicksForCount(uMaxSpinCount);
+	const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+	while(_MCFCRT_EXPECT(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks)){
+		__builtin_ia32_pause();
+		// Readers only perform a read here, which doesn't bounce the cache line.
+		uint64_t uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		if(uOld & MASK_BLOCKS_READERS){
+			continue;
+		}
+		_MCFCRT_ASSERT_MSG((uOld & MASK_SHARED_OWNERS) != MASK_SHARED_OWNERS, L"Too many threads share this shared mutex.");
+		if(_MCFCRT_EXPECT(__atomic_compare_exchange_n(puControl, &uOld, uOld + SHARED_OWNERS_ONE, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))){
+			return true;
+		}
+	}
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			bTaken = !(uOld & MASK_BLOCKS_READERS);
+			if(!bTaken){
+				_MCFCRT_ASSERT_MSG((uOld & MASK_SHARED_TRAPPED) != MASK_SHARED_TRAPPED, L"Too many threads are waiting for this shared mutex.");
+				uNew = uOld + SHARED_TRAPPED_ONE;
+			} else {
+				uNew = uOld + SHARED_OWNERS_ONE;
+			}
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+	}
+	if(_MCFCRT_EXPECT(bTaken)){
+		return true;
+	}
+	// Trapped readers are always woken up with ownership handed off to them. See `HandOffToTrappedReaders()`.
+	if(bMayTimeOut){
+		LARGE_INTEGER liTimeout;
+		__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+		NTSTATUS lStatus = __MCFCRT_ParkThread(GetSharedKey(puControl), &liTimeout);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
+			bool bDecremented;
+			{
+				uint64_t uOld, uNew;
+				uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+				do {
+					const uint64_t u64ThreadsTrapped = (uOld & MASK_SHARED_TRAPPED) / SHARED_TRAPPED_ONE;
+					bDecremented = u64ThreadsTrapped != 0;
+					if(!bDecremented){
+						break;
+					}
+					uNew = uOld - SHARED_TRAPPED_ONE;
+				} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+			}
+			if(bDecremented){
+				return false;
+			}
+			liTimeout.QuadPart = 0;
+			lStatus = __MCFCRT_ParkThread(GetSharedKey(puControl), &liTimeout);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		}
+	} else {
+		NTSTATUS lStatus = __MCFCRT_ParkThread(GetSharedKey(puControl), _MCFCRT_NULLPTR);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return true;
+}
+__attribute__((__always_inline__))
+static inline void ReallySignalSharedMutexShared(volatile uint64_t *puControl){
+	bool bSignalWriter, bSignalUpgrader;
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			_MCFCRT_ASSERT_MSG(!(uOld & MASK_LOCKED_EXCLUSIVE), L"This shared mutex is locked exclusively.");
+			_MCFCRT_ASSERT_MSG(uOld & MASK_SHARED_OWNERS, L"This shared mutex isn't shared by any thread.");
+			uNew = uOld - SHARED_OWNERS_ONE;
+			const uint64_t u64OwnersRemaining = (uNew & MASK_SHARED_OWNERS) / SHARED_OWNERS_ONE;
+			// If there is a thread upgrading, the only remaining owner must be that thread.
+			bSignalUpgrader = (u64OwnersRemaining == 1) && (uNew & MASK_UPGRADER_TRAPPED);
+			bSignalWriter = !bSignalUpgrader && (u64OwnersRemaining == 0) && (uNew & MASK_EXCLUSIVE_TRAPPED);
+			if(bSignalUpgrader){
+				// Hand ownership off to the upgrading thread.
+				uNew = (uNew & ~(MASK_UPGRADE_PENDING | MASK_UPGRADER_TRAPPED)) - SHARED_OWNERS_ONE + MASK_LOCKED_EXCLUSIVE;
+			} else if(bSignalWriter){
+				uNew = uNew - EXCLUSIVE_TRAPPED_ONE;
+			}
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)));
+	}
+	if(bSignalUpgrader){
+		UnparkThreads(GetUpgraderKey(puControl), 1);
+	} else if(bSignalWriter){
+		UnparkThreads(GetExclusiveKey(puControl), 1);
+	}
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForSharedMutexExclusive(volatile uint64_t *puControl, size_t uMaxSpinCount, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	for(;;){
+		bool bTaken;
+		{
+			uint64_t uOld, uNew;
+			uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+			do {
+				bTaken = !(uOld & (MASK_LOCKED_EXCLUSIVE | MASK_SHARED_OWNERS));
+				if(!bTaken){
+					break;
+				}
+				uNew = uOld + MASK_LOCKED_EXCLUSIVE;
+			} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+		}
+		if(_MCFCRT_EXPECT(bTaken)){
+			return true;
+		}
+		const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicksForCount(uMaxSpinCount);
+		const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+		while(_MCFCRT_EXPECT(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks)){
+			__builtin_ia32_pause();
+			uint64_t uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+			if(uOld & (MASK_LOCKED_EXCLUSIVE | MASK_SHARED_OWNERS)){
+				continue;
+			}
+			if(_MCFCRT_EXPECT(__atomic_compare_exchange_n(puControl, &uOld, uOld + MASK_LOCKED_EXCLUSIVE, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))){
+				return true;
+			}
+		}
+		{
+			uint64_t uOld, uNew;
+			uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+			do {
+				bTaken = !(uOld & (MASK_LOCKED_EXCLUSIVE | MASK_SHARED_OWNERS));
+				if(!bTaken){
+					_MCFCRT_ASSERT_MSG((uOld & MASK_EXCLUSIVE_TRAPPED) != MASK_EXCLUSIVE_TRAPPED, L"Too many threads are waiting for this shared mutex.");
+					uNew = uOld + EXCLUSIVE_TRAPPED_ONE;
+				} else {
+					uNew = uOld + MASK_LOCKED_EXCLUSIVE;
+				}
+			} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+		}
+		if(_MCFCRT_EXPECT(bTaken)){
+			return true;
+		}
+		if(bMayTimeOut){
+			LARGE_INTEGER liTimeout;
+			__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+			NTSTATUS lStatus = __MCFCRT_ParkThread(GetExclusiveKey(puControl), &liTimeout);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+			while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
+				bool bDecremented;
+				uint64_t u64CountToSignal = 0;
+				{
+					uint64_t uOld, uNew;
+					uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+					do {
+						const uint64_t u64ThreadsTrapped = (uOld & MASK_EXCLUSIVE_TRAPPED) / EXCLUSIVE_TRAPPED_ONE;
+						bDecremented = u64ThreadsTrapped != 0;
+						if(!bDecremented){
+							break;
+						}
+						uNew = uOld - EXCLUSIVE_TRAPPED_ONE;
+						// If we were the last writer blocking readers, nobody else would wake them up.
+						u64CountToSignal = 0;
+						if(!(uNew & MASK_BLOCKS_READERS)){
+							uNew = HandOffToTrappedReaders(uNew, &u64CountToSignal);
+						}
+					} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+				}
+				if(bDecremented){
+					UnparkThreads(GetSharedKey(puControl), u64CountToSignal);
+					return false;
+				}
+				liTimeout.QuadPart = 0;
+				lStatus = __MCFCRT_ParkThread(GetExclusiveKey(puControl), &liTimeout);
+				_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+			}
+		} else {
+			NTSTATUS lStatus = __MCFCRT_ParkThread(GetExclusiveKey(puControl), _MCFCRT_NULLPTR);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+			_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+		}
+	}
+}
+__attribute__((__always_inline__))
+static inline void ReallySignalSharedMutexExclusive(volatile uint64_t *puControl){
+	uint64_t u64ReadersToSignal;
+	bool bSignalWriter;
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			_MCFCRT_ASSERT_MSG(uOld & MASK_LOCKED_EXCLUSIVE, L"This shared mutex isn't locked exclusively by any thread.");
+			_MCFCRT_ASSERT(!(uOld & MASK_SHARED_OWNERS));
+			uNew = uOld & ~MASK_LOCKED_EXCLUSIVE;
+			// Prefer trapped readers to trapped writers, as new readers are blocked by trapped writers.
+			uNew = HandOffToTrappedReaders(uNew, &u64ReadersToSignal);
+			bSignalWriter = (u64ReadersToSignal == 0) && (uNew & MASK_EXCLUSIVE_TRAPPED);
+			if(bSignalWriter){
+				uNew = uNew - EXCLUSIVE_TRAPPED_ONE;
+			}
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)));
+	}
+	if(u64ReadersToSignal != 0){
+		UnparkThreads(GetSharedKey(puControl), u64ReadersToSignal);
+	} else if(bSignalWriter){
+		UnparkThreads(GetExclusiveKey(puControl), 1);
+	}
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForSharedMutexUpgrade(volatile uint64_t *puControl, size_t uMaxSpinCount, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	bool bTaken, bConflicting;
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			_MCFCRT_ASSERT_MSG(!(uOld & MASK_LOCKED_EXCLUSIVE), L"This shared mutex is locked exclusively.");
+			_MCFCRT_ASSERT_MSG(uOld & MASK_SHARED_OWNERS, L"This shared mutex isn't shared by any thread.");
+			bConflicting = !!(uOld & MASK_UPGRADE_PENDING);
+			if(bConflicting){
+				break;
+			}
+			const uint64_t u64Owners = (uOld & MASK_SHARED_OWNERS) / SHARED_OWNERS_ONE;
+			bTaken = u64Owners == 1;
+			if(bTaken){
+				uNew = uOld - SHARED_OWNERS_ONE + MASK_LOCKED_EXCLUSIVE;
+			} else {
+				uNew = uOld | MASK_UPGRADE_PENDING;
+			}
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+	}
+	if(_MCFCRT_EXPECT_NOT(bConflicting)){
+		return false;
+	}
+	if(_MCFCRT_EXPECT(bTaken)){
+		return true;
+	}
+	// New readers are blocked from now on, so we are simply waiting for existent readers to release the lock.
+	const uint64_t u64SpinTicks = __MCFCRT_SpinBudgetGetTicksForCount(uMaxSpinCount);
+	const uint64_t u64SpinBegin = _MCFCRT_ReadTimeStampCounter64();
+	while(_MCFCRT_EXPECT(_MCFCRT_ReadTimeStampCounter64() - u64SpinBegin < u64SpinTicks)){
+		__builtin_ia32_pause();
+		uint64_t uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		if(((uOld & MASK_SHARED_OWNERS) / SHARED_OWNERS_ONE) != 1){
+			continue;
+		}
+		if(_MCFCRT_EXPECT(__atomic_compare_exchange_n(puControl, &uOld, (uOld & ~MASK_UPGRADE_PENDING) - SHARED_OWNERS_ONE + MASK_LOCKED_EXCLUSIVE, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))){
+			return true;
+		}
+	}
+	{
+		uint64_t uOld, uNew;
+		uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+		do {
+			const uint64_t u64Owners = (uOld & MASK_SHARED_OWNERS) / SHARED_OWNERS_ONE;
+			bTaken = u64Owners == 1;
+			if(!bTaken){
+				uNew = uOld | MASK_UPGRADER_TRAPPED;
+			} else {
+				uNew = (uOld & ~MASK_UPGRADE_PENDING) - SHARED_OWNERS_ONE + MASK_LOCKED_EXCLUSIVE;
+			}
+		} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+	}
+	if(_MCFCRT_EXPECT(bTaken)){
+		return true;
+	}
+	// The last reader other than us will hand ownership off to us. See `ReallySignalSharedMutexShared()`.
+	if(bMayTimeOut){
+		LARGE_INTEGER liTimeout;
+		__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+		NTSTATUS lStatus = __MCFCRT_ParkThread(GetUpgraderKey(puControl), &liTimeout);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		while(_MCFCRT_EXPECT(lStatus == STATUS_TIMEOUT)){
+			bool bCancelled;
+			uint64_t u64CountToSignal = 0;
+			{
+				uint64_t uOld, uNew;
+				uOld = __atomic_load_n(puControl, __ATOMIC_RELAXED);
+				do {
+					bCancelled = !!(uOld & MASK_UPGRADER_TRAPPED);
+					if(!bCancelled){
+						break;
+					}
+					uNew = uOld & ~(MASK_UPGRADE_PENDING | MASK_UPGRADER_TRAPPED);
+					// Readers that have been blocked by us must be released now.
+					u64CountToSignal = 0;
+					if(!(uNew & MASK_BLOCKS_READERS)){
+						uNew = HandOffToTrappedReaders(uNew, &u64CountToSignal);
+					}
+				} while(_MCFCRT_EXPECT_NOT(!__atomic_compare_exchange_n(puControl, &uOld, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+			}
+			if(bCancelled){
+				UnparkThreads(GetSharedKey(puControl), u64CountToSignal);
+				return false;
+			}
+			liTimeout.QuadPart = 0;
+			lStatus = __MCFCRT_ParkThread(GetUpgraderKey(puControl), &liTimeout);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		}
+	} else {
+		NTSTATUS lStatus = __MCFCRT_ParkThread(GetUpgraderKey(puControl), _MCFCRT_NULLPTR);
+		_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"__MCFCRT_ParkThread() failed.");
+		_MCFCRT_ASSERT(lStatus != STATUS_TIMEOUT);
+	}
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return true;
+}
+
+bool __MCFCRT_ReallyWaitForSharedMutexShared(_MCFCRT_SharedMutex *pSharedMutex, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+	const bool bLocked = ReallyWaitForSharedMutexShared(&(pSharedMutex->__u), uMaxSpinCount, true, u64UntilFastMonoClock);
+	return bLocked;
+}
+void __MCFCRT_ReallyWaitForSharedMutexSharedForever(_MCFCRT_SharedMutex *pSharedMutex, size_t uMaxSpinCount){
+	const bool bLocked = ReallyWaitForSharedMutexShared(&(pSharedMutex->__u), uMaxSpinCount, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bLocked);
+}
+void __MCFCRT_ReallySignalSharedMutexShared(_MCFCRT_SharedMutex *pSharedMutex){
+	ReallySignalSharedMutexShared(&(pSharedMutex->__u));
+}
+
+bool __MCFCRT_ReallyWaitForSharedMutexExclusive(_MCFCRT_SharedMutex *pSharedMutex, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+	const bool bLocked = ReallyWaitForSharedMutexExclusive(&(pSharedMutex->__u), uMaxSpinCount, true, u64UntilFastMonoClock);
+	return bLocked;
+}
+void __MCFCRT_ReallyWaitForSharedMutexExclusiveForever(_MCFCRT_SharedMutex *pSharedMutex, size_t uMaxSpinCount){
+	const bool bLocked = ReallyWaitForSharedMutexExclusive(&(pSharedMutex->__u), uMaxSpinCount, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bLocked);
+}
+void __MCFCRT_ReallySignalSharedMutexExclusive(_MCFCRT_SharedMutex *pSharedMutex){
+	ReallySignalSharedMutexExclusive(&(pSharedMutex->__u));
+}
+
+bool __MCFCRT_ReallyWaitForSharedMutexUpgrade(_MCFCRT_SharedMutex *pSharedMutex, size_t uMaxSpinCount, uint64_t u64UntilFastMonoClock){
+	const bool bUpgraded = ReallyWaitForSharedMutexUpgrade(&(pSharedMutex->__u), uMaxSpinCount, true, u64UntilFastMonoClock);
+	return bUpgraded;
+}
+bool __MCFCRT_ReallyWaitForSharedMutexUpgradeForever(_MCFCRT_SharedMutex *pSharedMutex, size_t uMaxSpinCount){
+	const bool bUpgraded = ReallyWaitForSharedMutexUpgrade(&(pSharedMutex->__u), uMaxSpinCount, false, UINT64_MAX);
+	return bUpgraded;
+}
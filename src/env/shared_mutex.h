@@ -0,0 +1,93 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_SHARED_MUTEX_H_
+#define __MCFCRT_ENV_SHARED_MUTEX_H_
+
+#include "_crtdef.h"
+
+#ifndef __MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN
+#  define __MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// In the case of static initialization, please initialize it with { 0 }.
+// The control word is 64-bit wide even on x86, otherwise there wouldn't be enough room for all counters.
+typedef struct __MCFCRT_tagSharedMutex {
+	__attribute__((__aligned__(8))) _MCFCRT_STD uint64_t __u;
+} _MCFCRT_SharedMutex;
+
+#define _MCFCRT_SHARED_MUTEX_SUGGESTED_SPIN_COUNT   100u
+
+__MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN void _MCFCRT_InitializeSharedMutex(_MCFCRT_SharedMutex *__pSharedMutex) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pSharedMutex->__u), 0, __ATOMIC_RELEASE);
+}
+
+extern bool __MCFCRT_ReallyWaitForSharedMutexShared(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForSharedMutexSharedForever(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallySignalSharedMutexShared(_MCFCRT_SharedMutex *__pSharedMutex) _MCFCRT_NOEXCEPT;
+
+extern bool __MCFCRT_ReallyWaitForSharedMutexExclusive(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForSharedMutexExclusiveForever(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallySignalSharedMutexExclusive(_MCFCRT_SharedMutex *__pSharedMutex) _MCFCRT_NOEXCEPT;
+
+extern bool __MCFCRT_ReallyWaitForSharedMutexUpgrade(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern bool __MCFCRT_ReallyWaitForSharedMutexUpgradeForever(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT;
+
+// Shared (reader) ownership.
+__MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_WaitForSharedMutexShared(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallyWaitForSharedMutexShared(__pSharedMutex, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN void _MCFCRT_WaitForSharedMutexSharedForever(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallyWaitForSharedMutexSharedForever(__pSharedMutex, __uMaxSpinCount);
+}
+__MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN void _MCFCRT_SignalSharedMutexShared(_MCFCRT_SharedMutex *__pSharedMutex) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallySignalSharedMutexShared(__pSharedMutex);
+}
+
+// Exclusive (writer) ownership.
+// The lowest bit of the control word is the exclusive lock bit. A shared mutex that is free and has no waiters has a control word of zero.
+__MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_WaitForSharedMutexExclusive(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD uint64_t __uOld = 0;
+	if(__builtin_expect(__atomic_compare_exchange_n(&(__pSharedMutex->__u), &__uOld, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED), true)){
+		return true;
+	}
+	return __MCFCRT_ReallyWaitForSharedMutexExclusive(__pSharedMutex, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN void _MCFCRT_WaitForSharedMutexExclusiveForever(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	_MCFCRT_STD uint64_t __uOld = 0;
+	if(__builtin_expect(__atomic_compare_exchange_n(&(__pSharedMutex->__u), &__uOld, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED), true)){
+		return;
+	}
+	__MCFCRT_ReallyWaitForSharedMutexExclusiveForever(__pSharedMutex, __uMaxSpinCount);
+}
+__MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN void _MCFCRT_SignalSharedMutexExclusive(_MCFCRT_SharedMutex *__pSharedMutex) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallySignalSharedMutexExclusive(__pSharedMutex);
+}
+
+// Upgrades shared ownership held by the calling thread to exclusive ownership.
+// If these functions return `true`, the calling thread owns the shared mutex exclusively and no longer shares it.
+// If they return `false`, either the operation has timed out or another thread is upgrading (in which case waiting would deadlock).
+// The calling thread shares the shared mutex as before in both cases.
+__MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_WaitForSharedMutexUpgrade(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallyWaitForSharedMutexUpgrade(__pSharedMutex, __uMaxSpinCount, __u64UntilFastMonoClock);
+}
+__MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN bool _MCFCRT_WaitForSharedMutexUpgradeForever(_MCFCRT_SharedMutex *__pSharedMutex, _MCFCRT_STD size_t __uMaxSpinCount) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallyWaitForSharedMutexUpgradeForever(__pSharedMutex, __uMaxSpinCount);
+}
+
+// Releases whatever ownership the calling thread has.
+__MCFCRT_SHARED_MUTEX_INLINE_OR_EXTERN void _MCFCRT_SignalSharedMutex(_MCFCRT_SharedMutex *__pSharedMutex) _MCFCRT_NOEXCEPT {
+	// The exclusive lock bit can only be changed by its owner, so reading it without synchronization is safe.
+	if(__atomic_load_n(&(__pSharedMutex->__u), __ATOMIC_RELAXED) & 1){
+		__MCFCRT_ReallySignalSharedMutexExclusive(__pSharedMutex);
+	} else {
+		__MCFCRT_ReallySignalSharedMutexShared(__pSharedMutex);
+	}
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
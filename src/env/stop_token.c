@@ -0,0 +1,96 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_STOP_TOKEN_INLINE_OR_EXTERN     extern inline
+#include "stop_token.h"
+#include "address_wait.h"
+#include "thread.h"
+#include "xassert.h"
+#include "expect.h"
+
+// The byte mutex protects the list of callbacks. It is unlocked while a callback is being called, which is recorded in `__pRunning`,
+// so a thread that unregisters that callback can wait for it to return on that address.
+static inline void Unlink(_MCFCRT_StopToken *pStopToken, _MCFCRT_StopCallback *pCallback){
+	if(pCallback->__pPrev){
+		pCallback->__pPrev->__pNext = pCallback->__pNext;
+	} else {
+		pStopToken->__pFirst = pCallback->__pNext;
+	}
+	if(pCallback->__pNext){
+		pCallback->__pNext->__pPrev = pCallback->__pPrev;
+	}
+	pCallback->__bRegistered = false;
+}
+
+bool _MCFCRT_RequestStop(_MCFCRT_StopToken *pStopToken){
+	if(_MCFCRT_IsStopRequested(pStopToken)){
+		return false;
+	}
+	_MCFCRT_WaitForByteMutexForever(&(pStopToken->__vMutex), _MCFCRT_BYTE_MUTEX_SUGGESTED_SPIN_COUNT);
+	if(__atomic_load_n(&(pStopToken->__uStopRequested), __ATOMIC_RELAXED) != 0){
+		_MCFCRT_SignalByteMutex(&(pStopToken->__vMutex));
+		return false;
+	}
+	__atomic_store_n(&(pStopToken->__uStopRequested), 1, __ATOMIC_RELEASE);
+	pStopToken->__uRequester = _MCFCRT_GetCurrentThreadId();
+	// No callback can be registered from now on, so this loop terminates.
+	_MCFCRT_StopCallback *pCallback;
+	while((pCallback = pStopToken->__pFirst) != _MCFCRT_NULLPTR){
+		Unlink(pStopToken, pCallback);
+		const _MCFCRT_StopCallbackProc pfnProc = pCallback->__pfnProc;
+		const intptr_t nContext = pCallback->__nContext;
+		__atomic_store_n(&(pStopToken->__pRunning), pCallback, __ATOMIC_RELAXED);
+		_MCFCRT_SignalByteMutex(&(pStopToken->__vMutex));
+		// The callback may have been destroyed when this returns, if it has unregistered itself.
+		(*pfnProc)(nContext);
+		__atomic_store_n(&(pStopToken->__pRunning), _MCFCRT_NULLPTR, __ATOMIC_RELEASE);
+		_MCFCRT_WakeAddress(&(pStopToken->__pRunning), SIZE_MAX);
+		_MCFCRT_WaitForByteMutexForever(&(pStopToken->__vMutex), _MCFCRT_BYTE_MUTEX_SUGGESTED_SPIN_COUNT);
+	}
+	_MCFCRT_SignalByteMutex(&(pStopToken->__vMutex));
+	return true;
+}
+bool _MCFCRT_RegisterStopCallback(_MCFCRT_StopToken *pStopToken, _MCFCRT_StopCallback *pCallback, _MCFCRT_StopCallbackProc pfnProc, intptr_t nContext){
+	pCallback->__pfnProc = pfnProc;
+	pCallback->__nContext = nContext;
+	pCallback->__bRegistered = false;
+	if(_MCFCRT_IsStopRequested(pStopToken)){
+		return false;
+	}
+	_MCFCRT_WaitForByteMutexForever(&(pStopToken->__vMutex), _MCFCRT_BYTE_MUTEX_SUGGESTED_SPIN_COUNT);
+	const bool bRegistered = __atomic_load_n(&(pStopToken->__uStopRequested), __ATOMIC_RELAXED) == 0;
+	if(bRegistered){
+		pCallback->__pPrev = _MCFCRT_NULLPTR;
+		pCallback->__pNext = pStopToken->__pFirst;
+		if(pCallback->__pNext){
+			pCallback->__pNext->__pPrev = pCallback;
+		}
+		pStopToken->__pFirst = pCallback;
+		pCallback->__bRegistered = true;
+	}
+	_MCFCRT_SignalByteMutex(&(pStopToken->__vMutex));
+	return bRegistered;
+}
+void _MCFCRT_UnregisterStopCallback(_MCFCRT_StopToken *pStopToken, _MCFCRT_StopCallback *pCallback){
+	bool bWait = false;
+	_MCFCRT_WaitForByteMutexForever(&(pStopToken->__vMutex), _MCFCRT_BYTE_MUTEX_SUGGESTED_SPIN_COUNT);
+	if(pCallback->__bRegistered){
+		Unlink(pStopToken, pCallback);
+	} else if(__atomic_load_n(&(pStopToken->__pRunning), __ATOMIC_RELAXED) == pCallback){
+		// If the callback is unregistering itself, waiting for it would deadlock.
+		bWait = pStopToken->__uRequester != _MCFCRT_GetCurrentThreadId();
+	}
+	_MCFCRT_SignalByteMutex(&(pStopToken->__vMutex));
+	if(!bWait){
+		return;
+	}
+	// An unlinked callback is never called again, so once `__pRunning` has changed, it has returned.
+	for(;;){
+		_MCFCRT_StopCallback *const pRunning = __atomic_load_n(&(pStopToken->__pRunning), __ATOMIC_ACQUIRE);
+		if(pRunning != pCallback){
+			break;
+		}
+		_MCFCRT_WaitOnAddressForever(&(pStopToken->__pRunning), &pRunning, sizeof(pRunning));
+	}
+}
@@ -0,0 +1,65 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_STOP_TOKEN_H_
+#define __MCFCRT_ENV_STOP_TOKEN_H_
+
+#include "_crtdef.h"
+#include "byte_mutex.h"
+
+#ifndef __MCFCRT_STOP_TOKEN_INLINE_OR_EXTERN
+#  define __MCFCRT_STOP_TOKEN_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// A stop token is the shared state behind `std::stop_source` and `std::stop_token`. A stop can be requested only once.
+// Callbacks that have been registered are called by the thread that requests the stop, which is how threads blocking in the `OrStop` functions
+// of mutexes, condition variables and threads are woken up.
+// In the case of static initialization, please initialize it with { 0 }.
+typedef struct __MCFCRT_tagStopToken {
+	_MCFCRT_STD uintptr_t __uStopRequested;
+	_MCFCRT_ByteMutex __vMutex;
+	struct __MCFCRT_tagStopCallback *__pFirst;
+	// These are the callback that is being called, and the ID of the thread calling it, which is the one that has requested the stop.
+	struct __MCFCRT_tagStopCallback *volatile __pRunning;
+	_MCFCRT_STD uintptr_t __uRequester;
+} _MCFCRT_StopToken;
+
+typedef void (*_MCFCRT_StopCallbackProc)(_MCFCRT_STD intptr_t __nContext);
+
+// A registered callback must not be moved or go out of scope before it is unregistered.
+typedef struct __MCFCRT_tagStopCallback {
+	_MCFCRT_StopCallbackProc __pfnProc;
+	_MCFCRT_STD intptr_t __nContext;
+	struct __MCFCRT_tagStopCallback *__pPrev;
+	struct __MCFCRT_tagStopCallback *__pNext;
+	bool __bRegistered;
+} _MCFCRT_StopCallback;
+
+__MCFCRT_STOP_TOKEN_INLINE_OR_EXTERN void _MCFCRT_InitializeStopToken(_MCFCRT_StopToken *__pStopToken) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pStopToken->__uStopRequested), 0, __ATOMIC_RELAXED);
+	__pStopToken->__pFirst = _MCFCRT_NULLPTR;
+	__pStopToken->__pRunning = _MCFCRT_NULLPTR;
+	__pStopToken->__uRequester = 0;
+	_MCFCRT_InitializeByteMutex(&(__pStopToken->__vMutex));
+}
+
+__MCFCRT_STOP_TOKEN_INLINE_OR_EXTERN bool _MCFCRT_IsStopRequested(const _MCFCRT_StopToken *__pStopToken) _MCFCRT_NOEXCEPT {
+	return __builtin_expect(__atomic_load_n(&(__pStopToken->__uStopRequested), __ATOMIC_ACQUIRE) != 0, false);
+}
+
+// Returns `true` if this call has requested the stop, and `false` if a stop had been requested before.
+// Callbacks are called in the calling thread one by one, with the mutex in the stop token unlocked, so they may unregister themselves.
+extern bool _MCFCRT_RequestStop(_MCFCRT_StopToken *__pStopToken) _MCFCRT_NOEXCEPT;
+// If a stop has been requested, the callback is not registered and `false` is returned. The caller may call the callback itself, as `std::stop_callback` does.
+extern bool _MCFCRT_RegisterStopCallback(_MCFCRT_StopToken *__pStopToken, _MCFCRT_StopCallback *__pCallback, _MCFCRT_StopCallbackProc __pfnProc, _MCFCRT_STD intptr_t __nContext) _MCFCRT_NOEXCEPT;
+// If the callback is being called by another thread, this function waits for it to return. If it is being called by the calling thread,
+// i.e. the callback is unregistering itself, this function returns immediately, after which the callback may be destroyed.
+// This function may be called on a callback that has been called already, or one that failed to register.
+extern void _MCFCRT_UnregisterStopCallback(_MCFCRT_StopToken *__pStopToken, _MCFCRT_StopCallback *__pCallback) _MCFCRT_NOEXCEPT;
+
+_MCFCRT_EXTERN_C_END
+
+#endif
@@ -0,0 +1,91 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#define __MCFCRT_TAGGED_CONDITION_VARIABLE_INLINE_OR_EXTERN     extern inline
+#include "tagged_condition_variable.h"
+#include "_nt_timeout.h"
+#include "_park.h"
+#include "xassert.h"
+#include "expect.h"
+#include <ntdef.h>
+
+__attribute__((__dllimport__, __stdcall__, __const__))
+extern BOOLEAN RtlDllShutdownInProgress(void);
+
+#define MASK_WAITERS            ((uint64_t)0x00000000FFFFFFFF)
+#define MASK_EPOCH              ((uint64_t)0xFFFFFFFF00000000)
+
+#define WAITERS_ONE             ((uint64_t)(MASK_WAITERS & -MASK_WAITERS))
+#define EPOCH_ONE               ((uint64_t)(MASK_EPOCH & -MASK_EPOCH))
+
+static_assert(MASK_WAITERS == __MCFCRT_TAGGED_CONDITION_VARIABLE_MASK_WAITERS, "The inline functions in the header rely on this.");
+
+typedef struct tagWaitContext {
+	volatile uint64_t *puControl;
+	uint64_t uEpoch;
+} WaitContext;
+
+// This callback is called with the bucket locked, which serializes it with the signaling thread.
+static bool ValidateParking(intptr_t nContext){
+	const WaitContext *const pContext = (const WaitContext *)nContext;
+	return (__atomic_load_n(pContext->puControl, __ATOMIC_ACQUIRE) & MASK_EPOCH) == pContext->uEpoch;
+}
+
+static bool FilterByTag(intptr_t nContext, intptr_t nTag){
+	return nTag == nContext;
+}
+static bool FilterNone(intptr_t nContext, intptr_t nTag){
+	(void)nContext, (void)nTag;
+
+	return true;
+}
+
+__attribute__((__always_inline__))
+static inline bool ReallyWaitForTaggedConditionVariable(volatile uint64_t *puControl, intptr_t nTag, _MCFCRT_ConditionVariableUnlockCallback pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback pfnRelockCallback, intptr_t nContext, bool bMayTimeOut, uint64_t u64UntilFastMonoClock){
+	// This has to be sequentially consistent, so either the predicate is checked after the signal, or the signaling thread sees this thread.
+	const uint64_t uOld = __atomic_fetch_add(puControl, WAITERS_ONE, __ATOMIC_SEQ_CST);
+	_MCFCRT_ASSERT_MSG((uOld & MASK_WAITERS) != MASK_WAITERS, L"Too many threads are waiting on this tagged condition variable.");
+	const WaitContext vContext = { puControl, uOld & MASK_EPOCH };
+	const intptr_t nUnlocked = (*pfnUnlockCallback)(nContext);
+	// If the condition variable is signaled after the lock is released and before we park, the epoch will have changed, and we return immediately.
+	__MCFCRT_ParkResult eResult;
+	if(bMayTimeOut){
+		LARGE_INTEGER liTimeout;
+		__MCFCRT_InitializeNtTimeout(&liTimeout, u64UntilFastMonoClock);
+		eResult = __MCFCRT_ParkTaggedThreadIf((void *)puControl, nTag, &ValidateParking, (intptr_t)&vContext, &liTimeout);
+	} else {
+		eResult = __MCFCRT_ParkTaggedThreadIf((void *)puControl, nTag, &ValidateParking, (intptr_t)&vContext, _MCFCRT_NULLPTR);
+	}
+	__atomic_fetch_sub(puControl, WAITERS_ONE, __ATOMIC_RELAXED);
+	(*pfnRelockCallback)(nContext, nUnlocked);
+	return eResult != __MCFCRT_kParkResultTimedOut;
+}
+__attribute__((__always_inline__))
+static inline size_t ReallySignalTaggedConditionVariable(volatile uint64_t *puControl, _MCFCRT_TaggedConditionVariableFilterCallback pfnFilterCallback, intptr_t nFilterContext, size_t uMaxCountToSignal){
+	// Threads that have not parked yet see the new epoch and will not park. Their tags can't be checked, so they get spurious wakeups.
+	__atomic_fetch_add(puControl, EPOCH_ONE, __ATOMIC_SEQ_CST);
+	// If `RtlDllShutdownInProgress()` is `true`, other threads will have been terminated.
+	if(_MCFCRT_EXPECT_NOT(RtlDllShutdownInProgress())){
+		return 0;
+	}
+	return __MCFCRT_UnparkTaggedThreads((void *)puControl, pfnFilterCallback, nFilterContext, uMaxCountToSignal);
+}
+
+bool __MCFCRT_ReallyWaitForTaggedConditionVariable(_MCFCRT_TaggedConditionVariable *pConditionVariable, intptr_t nTag, _MCFCRT_ConditionVariableUnlockCallback pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback pfnRelockCallback, intptr_t nContext, uint64_t u64UntilFastMonoClock){
+	const bool bSignaled = ReallyWaitForTaggedConditionVariable(&(pConditionVariable->__u), nTag, pfnUnlockCallback, pfnRelockCallback, nContext, true, u64UntilFastMonoClock);
+	return bSignaled;
+}
+void __MCFCRT_ReallyWaitForTaggedConditionVariableForever(_MCFCRT_TaggedConditionVariable *pConditionVariable, intptr_t nTag, _MCFCRT_ConditionVariableUnlockCallback pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback pfnRelockCallback, intptr_t nContext){
+	const bool bSignaled = ReallyWaitForTaggedConditionVariable(&(pConditionVariable->__u), nTag, pfnUnlockCallback, pfnRelockCallback, nContext, false, UINT64_MAX);
+	_MCFCRT_ASSERT(bSignaled);
+}
+size_t __MCFCRT_ReallySignalTaggedConditionVariable(_MCFCRT_TaggedConditionVariable *pConditionVariable, intptr_t nTag, size_t uMaxCountToSignal){
+	return ReallySignalTaggedConditionVariable(&(pConditionVariable->__u), &FilterByTag, nTag, uMaxCountToSignal);
+}
+size_t __MCFCRT_ReallySignalTaggedConditionVariableIf(_MCFCRT_TaggedConditionVariable *pConditionVariable, _MCFCRT_TaggedConditionVariableFilterCallback pfnFilterCallback, intptr_t nFilterContext, size_t uMaxCountToSignal){
+	return ReallySignalTaggedConditionVariable(&(pConditionVariable->__u), pfnFilterCallback, nFilterContext, uMaxCountToSignal);
+}
+size_t __MCFCRT_ReallyBroadcastTaggedConditionVariable(_MCFCRT_TaggedConditionVariable *pConditionVariable){
+	return ReallySignalTaggedConditionVariable(&(pConditionVariable->__u), &FilterNone, 0, SIZE_MAX);
+}
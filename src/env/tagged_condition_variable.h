@@ -0,0 +1,79 @@
+// This file is part of MCFCRT.
+// See MCFLicense.txt for licensing information.
+// Copyleft 2013 - 2018, LH_Mouse. All wrongs reserved.
+
+#ifndef __MCFCRT_ENV_TAGGED_CONDITION_VARIABLE_H_
+#define __MCFCRT_ENV_TAGGED_CONDITION_VARIABLE_H_
+
+#include "_crtdef.h"
+#include "condition_variable.h"
+
+#ifndef __MCFCRT_TAGGED_CONDITION_VARIABLE_INLINE_OR_EXTERN
+#  define __MCFCRT_TAGGED_CONDITION_VARIABLE_INLINE_OR_EXTERN     __attribute__((__gnu_inline__)) extern inline
+#endif
+
+_MCFCRT_EXTERN_C_BEGIN
+
+// A tagged condition variable is a condition variable whose waiting threads have tags, typically telling what they are waiting for,
+// such as a key, or a pointer to a structure holding a predicate. When it is signaled, only threads whose tags are equal to the given one,
+// or are accepted by the given filter callback, are woken up, so threads that are waiting for something else are not woken up only to sleep again.
+// Threads that are just about to sleep when it is signaled are woken up regardless of their tags, which is a spurious wakeup.
+// Waiting threads are kept in the parking lot, and there is no spinning, which wouldn't be targeted.
+// In the case of static initialization, please initialize it with { 0 }.
+typedef struct __MCFCRT_tagTaggedConditionVariable {
+	__attribute__((__aligned__(8))) _MCFCRT_STD uint64_t __u;
+} _MCFCRT_TaggedConditionVariable;
+
+// The filter callback is called with a lock in the parking lot held, after which the thread having the tag is woken up if it returns `true`.
+// It may be called more than once for each tag, and it must not block or wait for other threads, or call functions of this tagged condition variable.
+// It is usually called by a thread that has the lock protecting the predicates locked, so it may read shared data under that lock.
+typedef bool (*_MCFCRT_TaggedConditionVariableFilterCallback)(_MCFCRT_STD intptr_t __nContext, _MCFCRT_STD intptr_t __nTag);
+
+// The lower half of the control word is the number of waiting threads. The upper half is the epoch.
+#define __MCFCRT_TAGGED_CONDITION_VARIABLE_MASK_WAITERS   ((_MCFCRT_STD uint64_t)0x00000000FFFFFFFF)
+
+__MCFCRT_TAGGED_CONDITION_VARIABLE_INLINE_OR_EXTERN void _MCFCRT_InitializeTaggedConditionVariable(_MCFCRT_TaggedConditionVariable *__pConditionVariable) _MCFCRT_NOEXCEPT {
+	__atomic_store_n(&(__pConditionVariable->__u), 0, __ATOMIC_RELEASE);
+}
+
+extern bool __MCFCRT_ReallyWaitForTaggedConditionVariable(_MCFCRT_TaggedConditionVariable *__pConditionVariable, _MCFCRT_STD intptr_t __nTag, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT;
+extern void __MCFCRT_ReallyWaitForTaggedConditionVariableForever(_MCFCRT_TaggedConditionVariable *__pConditionVariable, _MCFCRT_STD intptr_t __nTag, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext) _MCFCRT_NOEXCEPT;
+extern _MCFCRT_STD size_t __MCFCRT_ReallySignalTaggedConditionVariable(_MCFCRT_TaggedConditionVariable *__pConditionVariable, _MCFCRT_STD intptr_t __nTag, _MCFCRT_STD size_t __uMaxCountToSignal) _MCFCRT_NOEXCEPT;
+extern _MCFCRT_STD size_t __MCFCRT_ReallySignalTaggedConditionVariableIf(_MCFCRT_TaggedConditionVariable *__pConditionVariable, _MCFCRT_TaggedConditionVariableFilterCallback __pfnFilterCallback, _MCFCRT_STD intptr_t __nFilterContext, _MCFCRT_STD size_t __uMaxCountToSignal) _MCFCRT_NOEXCEPT;
+extern _MCFCRT_STD size_t __MCFCRT_ReallyBroadcastTaggedConditionVariable(_MCFCRT_TaggedConditionVariable *__pConditionVariable) _MCFCRT_NOEXCEPT;
+
+// These functions are the same as `_MCFCRT_WaitForConditionVariable()` and `_MCFCRT_WaitForConditionVariableForever()`, except that the calling thread waits with `__nTag`.
+__MCFCRT_TAGGED_CONDITION_VARIABLE_INLINE_OR_EXTERN bool _MCFCRT_WaitForTaggedConditionVariable(_MCFCRT_TaggedConditionVariable *__pConditionVariable, _MCFCRT_STD intptr_t __nTag, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext, _MCFCRT_STD uint64_t __u64UntilFastMonoClock) _MCFCRT_NOEXCEPT {
+	return __MCFCRT_ReallyWaitForTaggedConditionVariable(__pConditionVariable, __nTag, __pfnUnlockCallback, __pfnRelockCallback, __nContext, __u64UntilFastMonoClock);
+}
+__MCFCRT_TAGGED_CONDITION_VARIABLE_INLINE_OR_EXTERN void _MCFCRT_WaitForTaggedConditionVariableForever(_MCFCRT_TaggedConditionVariable *__pConditionVariable, _MCFCRT_STD intptr_t __nTag, _MCFCRT_ConditionVariableUnlockCallback __pfnUnlockCallback, _MCFCRT_ConditionVariableRelockCallback __pfnRelockCallback, _MCFCRT_STD intptr_t __nContext) _MCFCRT_NOEXCEPT {
+	__MCFCRT_ReallyWaitForTaggedConditionVariableForever(__pConditionVariable, __nTag, __pfnUnlockCallback, __pfnRelockCallback, __nContext);
+}
+// These functions return the number of threads that have been woken up. If no thread is waiting, they only perform a fence and a load.
+// `_MCFCRT_SignalTaggedConditionVariable()` wakes up threads waiting with `__nTag`, and `_MCFCRT_SignalTaggedConditionVariableIf()` wakes up threads whose tags are accepted by the filter.
+__MCFCRT_TAGGED_CONDITION_VARIABLE_INLINE_OR_EXTERN _MCFCRT_STD size_t _MCFCRT_SignalTaggedConditionVariable(_MCFCRT_TaggedConditionVariable *__pConditionVariable, _MCFCRT_STD intptr_t __nTag, _MCFCRT_STD size_t __uMaxCountToSignal) _MCFCRT_NOEXCEPT {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__builtin_expect(!(__atomic_load_n(&(__pConditionVariable->__u), __ATOMIC_RELAXED) & __MCFCRT_TAGGED_CONDITION_VARIABLE_MASK_WAITERS), true)){
+		return 0;
+	}
+	return __MCFCRT_ReallySignalTaggedConditionVariable(__pConditionVariable, __nTag, __uMaxCountToSignal);
+}
+__MCFCRT_TAGGED_CONDITION_VARIABLE_INLINE_OR_EXTERN _MCFCRT_STD size_t _MCFCRT_SignalTaggedConditionVariableIf(_MCFCRT_TaggedConditionVariable *__pConditionVariable, _MCFCRT_TaggedConditionVariableFilterCallback __pfnFilterCallback, _MCFCRT_STD intptr_t __nFilterContext, _MCFCRT_STD size_t __uMaxCountToSignal) _MCFCRT_NOEXCEPT {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__builtin_expect(!(__atomic_load_n(&(__pConditionVariable->__u), __ATOMIC_RELAXED) & __MCFCRT_TAGGED_CONDITION_VARIABLE_MASK_WAITERS), true)){
+		return 0;
+	}
+	return __MCFCRT_ReallySignalTaggedConditionVariableIf(__pConditionVariable, __pfnFilterCallback, __nFilterContext, __uMaxCountToSignal);
+}
+// This function wakes up all threads regardless of their tags.
+__MCFCRT_TAGGED_CONDITION_VARIABLE_INLINE_OR_EXTERN _MCFCRT_STD size_t _MCFCRT_BroadcastTaggedConditionVariable(_MCFCRT_TaggedConditionVariable *__pConditionVariable) _MCFCRT_NOEXCEPT {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__builtin_expect(!(__atomic_load_n(&(__pConditionVariable->__u), __ATOMIC_RELAXED) & __MCFCRT_TAGGED_CONDITION_VARIABLE_MASK_WAITERS), true)){
+		return 0;
+	}
+	return __MCFCRT_ReallyBroadcastTaggedConditionVariable(__pConditionVariable);
+}
+
+_MCFCRT_EXTERN_C_END
+
+#endif
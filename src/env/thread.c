@@ -22,9 +22,21 @@ typedef struct _CLIENT_ID {
 } CLIENT_ID;
 
 __attribute__((__dllimport__, __stdcall__))
-NTSTATUS RtlCreateUserThread(HANDLE hProcess, const SECURITY_DESCRIPTOR *pSecurityDescriptor, BOOLEAN bSuspended, ULONG ulStackZeroBits, ULONG *pulStackReserved, ULONG *pulStackCommitted, PTHREAD_START_ROUTINE pfnThreadProc, void *pParam, HANDLE *pHandle, CLIENT_ID *pClientId);
+NTSTATUS RtlCreateUserThread(HANDLE hProcess, const SECURITY_DESCRIPTOR *pSecurityDescriptor, BOOLEAN bSuspended, ULONG ulStackZeroBits, SIZE_T uStackReserved, SIZE_T uStackCommitted, PTHREAD_START_ROUTINE pfnThreadProc, void *pParam, HANDLE *pHandle, CLIENT_ID *pClientId);
 __attribute__((__dllimport__, __stdcall__))
 NTSTATUS NtClose(HANDLE hObject);
+__attribute__((__dllimport__, __stdcall__))
+NTSTATUS NtTerminateThread(HANDLE hThread, NTSTATUS lExitStatus);
+
+// https://docs.microsoft.com/en-us/windows-hardware/drivers/ddi/content/ntddk/ne-ntddk-_thrdinfoclass
+typedef enum _THREADINFOCLASS {
+	ThreadBasePriority      =  3,
+	ThreadGroupInformation  = 30,
+	ThreadIdealProcessorEx  = 33,
+} THREADINFOCLASS;
+
+__attribute__((__dllimport__, __stdcall__))
+NTSTATUS NtSetInformationThread(HANDLE hThread, THREADINFOCLASS eInformationClass, const void *pInformation, ULONG ulInformationLength);
 
 __attribute__((__dllimport__, __stdcall__))
 NTSTATUS NtWaitForSingleObject(HANDLE hObject, BOOLEAN bAlertable, const LARGE_INTEGER *pliTimeout);
@@ -42,12 +54,79 @@ __attribute__((__dllimport__, __stdcall__))
 extern NTSTATUS NtResumeThread(HANDLE hThread, LONG *plPrevCount);
 
 _MCFCRT_ThreadHandle _MCFCRT_CreateNativeThread(_MCFCRT_NativeThreadProc pfnThreadProc, void *pParam, bool bSuspended, uintptr_t *restrict puThreadId){
+	return _MCFCRT_CreateNativeThreadWithAttributes(pfnThreadProc, pParam, bSuspended, _MCFCRT_NULLPTR, puThreadId);
+}
+
+static bool ApplyThreadAttributes(NTSTATUS *plStatus, HANDLE hThread, const _MCFCRT_ThreadAttributes *pAttributes){
+	NTSTATUS lStatus;
+	if(pAttributes->uAffinityMask != 0){
+		GROUP_AFFINITY vAffinity = { 0 };
+		vAffinity.Mask  = (KAFFINITY)pAttributes->uAffinityMask;
+		vAffinity.Group = pAttributes->ushAffinityGroup;
+		lStatus = NtSetInformationThread(hThread, ThreadGroupInformation, &vAffinity, sizeof(vAffinity));
+		if(!NT_SUCCESS(lStatus)){
+			*plStatus = lStatus;
+			return false;
+		}
+	}
+	if(pAttributes->bHasIdealProcessor){
+		PROCESSOR_NUMBER vIdealProcessor = { 0 };
+		vIdealProcessor.Group  = pAttributes->ushIdealProcessorGroup;
+		vIdealProcessor.Number = pAttributes->byIdealProcessorNumber;
+		lStatus = NtSetInformationThread(hThread, ThreadIdealProcessorEx, &vIdealProcessor, sizeof(vIdealProcessor));
+		if(!NT_SUCCESS(lStatus)){
+			*plStatus = lStatus;
+			return false;
+		}
+	}
+	if(pAttributes->bHasPriority){
+		// This is what `SetThreadPriority()` does. `THREAD_PRIORITY_IDLE` and `THREAD_PRIORITY_TIME_CRITICAL` are passed as values out of range,
+		// which saturate the priority to the bottom and the top of the priority class respectively.
+		LONG lBasePriority = pAttributes->nPriority;
+		if(lBasePriority == THREAD_PRIORITY_IDLE){
+			lBasePriority = THREAD_BASE_PRIORITY_IDLE - 1;
+		} else if(lBasePriority == THREAD_PRIORITY_TIME_CRITICAL){
+			lBasePriority = THREAD_BASE_PRIORITY_LOWRT + 1;
+		}
+		lStatus = NtSetInformationThread(hThread, ThreadBasePriority, &lBasePriority, sizeof(lBasePriority));
+		if(!NT_SUCCESS(lStatus)){
+			*plStatus = lStatus;
+			return false;
+		}
+	}
+	return true;
+}
+
+_MCFCRT_ThreadHandle _MCFCRT_CreateNativeThreadWithAttributes(_MCFCRT_NativeThreadProc pfnThreadProc, void *pParam, bool bSuspended, const _MCFCRT_ThreadAttributes *pAttributes, uintptr_t *restrict puThreadId){
 	HANDLE hThread;
 	CLIENT_ID vClientId;
-	const NTSTATUS lStatus = RtlCreateUserThread(GetCurrentProcess(), _MCFCRT_NULLPTR, bSuspended, 0, _MCFCRT_NULLPTR, _MCFCRT_NULLPTR, pfnThreadProc, pParam, &hThread, &vClientId);
-	if(!NT_SUCCESS(lStatus)){
-		SetLastError(RtlNtStatusToDosError(lStatus));
-		return _MCFCRT_NULLPTR;
+	NTSTATUS lStatus;
+	if(!pAttributes){
+		lStatus = RtlCreateUserThread(GetCurrentProcess(), _MCFCRT_NULLPTR, bSuspended, 0, 0, 0, pfnThreadProc, pParam, &hThread, &vClientId);
+		if(!NT_SUCCESS(lStatus)){
+			SetLastError(RtlNtStatusToDosError(lStatus));
+			return _MCFCRT_NULLPTR;
+		}
+	} else {
+		// The thread is always created suspended, so the attributes take effect before it runs any code.
+		lStatus = RtlCreateUserThread(GetCurrentProcess(), _MCFCRT_NULLPTR, true, 0, pAttributes->uStackReserve, pAttributes->uStackCommit, pfnThreadProc, pParam, &hThread, &vClientId);
+		if(!NT_SUCCESS(lStatus)){
+			SetLastError(RtlNtStatusToDosError(lStatus));
+			return _MCFCRT_NULLPTR;
+		}
+		if(!ApplyThreadAttributes(&lStatus, hThread, pAttributes)){
+			// The thread hasn't run any code, so it is safe to terminate it.
+			NTSTATUS lTermStatus = NtTerminateThread(hThread, lStatus);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lTermStatus), L"NtTerminateThread() failed.");
+			lTermStatus = NtClose(hThread);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lTermStatus), L"NtClose() failed.");
+			SetLastError(RtlNtStatusToDosError(lStatus));
+			return _MCFCRT_NULLPTR;
+		}
+		if(!bSuspended){
+			lStatus = NtResumeThread(hThread, _MCFCRT_NULLPTR);
+			_MCFCRT_ASSERT_MSG(NT_SUCCESS(lStatus), L"NtResumeThread() failed.");
+		}
 	}
 	if(puThreadId){
 		*puThreadId = (uintptr_t)vClientId.UniqueThread;
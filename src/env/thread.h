@@ -14,6 +14,28 @@ typedef unsigned long (__attribute__((__stdcall__)) *_MCFCRT_NativeThreadProc)(v
 typedef struct __MCFCRT_tagThreadHandle { int __n; } *_MCFCRT_ThreadHandle;
 
 extern _MCFCRT_ThreadHandle _MCFCRT_CreateNativeThread(_MCFCRT_NativeThreadProc __pfnThreadProc, void *__pParam, bool __bSuspended, _MCFCRT_STD uintptr_t *_MCFCRT_RESTRICT __puThreadId) _MCFCRT_NOEXCEPT;
+
+// These attributes are applied to a new thread before it starts running. Members that are zero or `false` leave the defaults untouched,
+// so please initialize it with { 0 } and then set the members that you need.
+typedef struct __MCFCRT_tagThreadAttributes {
+	// These are the sizes of the stack to reserve and to commit, in bytes. The defaults come from the header of the executable image.
+	_MCFCRT_STD size_t uStackReserve;
+	_MCFCRT_STD size_t uStackCommit;
+	// If `uAffinityMask` is non-zero, the thread may only run on these processors in the processor group `ushAffinityGroup`.
+	_MCFCRT_STD uintptr_t uAffinityMask;
+	unsigned short ushAffinityGroup;
+	// If `bHasIdealProcessor` is `true`, the scheduler prefers to run the thread on processor `byIdealProcessorNumber` in group `ushIdealProcessorGroup`.
+	bool bHasIdealProcessor;
+	unsigned short ushIdealProcessorGroup;
+	unsigned char byIdealProcessorNumber;
+	// If `bHasPriority` is `true`, the priority of the thread is set to `nPriority`, which is one of the `THREAD_PRIORITY_*` constants.
+	bool bHasPriority;
+	int nPriority;
+} _MCFCRT_ThreadAttributes;
+
+// If `__pAttributes` is a null pointer, this function is the same as `_MCFCRT_CreateNativeThread()`.
+// If any attribute can't be applied, no thread is created, and the last error is set.
+extern _MCFCRT_ThreadHandle _MCFCRT_CreateNativeThreadWithAttributes(_MCFCRT_NativeThreadProc __pfnThreadProc, void *__pParam, bool __bSuspended, const _MCFCRT_ThreadAttributes *__pAttributes, _MCFCRT_STD uintptr_t *_MCFCRT_RESTRICT __puThreadId) _MCFCRT_NOEXCEPT;
 extern void _MCFCRT_CloseThread(_MCFCRT_ThreadHandle __hThread) _MCFCRT_NOEXCEPT;
 
 typedef unsigned long (*_MCFCRT_WrappedThreadProc)(void *__pParam);
@@ -5,6 +5,9 @@
 #include "mcfcrt.h"
 #include "env/xassert.h"
 #include "env/_mopthread.h"
+#include "env/_park.h"
+#include "env/_spin_budget.h"
+#include "env/_topology.h"
 #include "env/tls.h"
 #include "env/crt_module.h"
 
@@ -13,11 +16,30 @@ static ptrdiff_t g_nCounter = 0;
 bool __MCFCRT_InitRecursive(void){
 	ptrdiff_t nCounter = g_nCounter;
 	if(nCounter == 0){
+		// This must precede anything that may park threads.
+		if(!__MCFCRT_ParkInit()){
+			return false;
+		}
 		if(!__MCFCRT_TlsInit()){
+			__MCFCRT_ParkUninit();
 			return false;
 		}
 		if(!__MCFCRT_MopthreadInit()){
 			__MCFCRT_TlsUninit();
+			__MCFCRT_ParkUninit();
+			return false;
+		}
+		if(!__MCFCRT_SpinBudgetInit()){
+			__MCFCRT_MopthreadUninit();
+			__MCFCRT_TlsUninit();
+			__MCFCRT_ParkUninit();
+			return false;
+		}
+		if(!__MCFCRT_TopologyInit()){
+			__MCFCRT_SpinBudgetUninit();
+			__MCFCRT_MopthreadUninit();
+			__MCFCRT_TlsUninit();
+			__MCFCRT_ParkUninit();
 			return false;
 		}
 		// Add more initialization...
@@ -33,8 +55,11 @@ void __MCFCRT_UninitRecursive(void){
 	g_nCounter = nCounter;
 	if(nCounter == 0){
 		// Add more uninitialization...
+		__MCFCRT_TopologyUninit();
+		__MCFCRT_SpinBudgetUninit();
 		__MCFCRT_MopthreadUninit();
 		__MCFCRT_TlsUninit();
+		__MCFCRT_ParkUninit();
 		__MCFCRT_DiscardCrtModuleQuickExitCallbacks();
 	}
 }
@@ -9,18 +9,33 @@
 
 #ifndef __MCFCRT_NO_GENERAL_INCLUDES
 // ------------------------------ env ------------------------------
+#  include "env/address_wait.h"
 #  include "env/avl_tree.h"
 #  include "env/bail.h"
+#  include "env/barrier.h"
+#  include "env/byte_mutex.h"
+#  include "env/byte_once.h"
 #  include "env/clocks.h"
+#  include "env/cohort_mutex.h"
 #  include "env/condition_variable.h"
 #  include "env/xassert.h"
 #  include "env/crt_module.h"
+#  include "env/event.h"
+#  include "env/event_count.h"
 #  include "env/expect.h"
 #  include "env/heap.h"
 #  include "env/inline_mem.h"
+#  include "env/latch.h"
+#  include "env/lock_stats.h"
 #  include "env/mutex.h"
 #  include "env/once_flag.h"
 #  include "env/pp.h"
+#  include "env/queue_mutex.h"
+#  include "env/semaphore.h"
+#  include "env/seq_lock.h"
+#  include "env/shared_mutex.h"
+#  include "env/stop_token.h"
+#  include "env/tagged_condition_variable.h"
 #  include "env/thread.h"
 #  include "env/tls.h"
 // ------------------------------ ext ------------------------------
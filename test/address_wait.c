@@ -0,0 +1,80 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/address_wait.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark measures the round trip time of two threads handing a token to each other with `_MCFCRT_WaitOnAddress()`,
+// which is how `std::atomic<T>::wait()` and `notify_one()` would be used.
+
+#define ROUND_TRIPS            100000ul
+#define WAITER_COUNT           8ul
+
+volatile uint32_t turn = 0;
+volatile uint64_t gate = 0;
+
+void *pong_proc(void *param){
+	(void)param;
+	for(unsigned long i = 0; i < ROUND_TRIPS; ++i){
+		uint32_t expected = 0;
+		while(__atomic_load_n(&turn, __ATOMIC_ACQUIRE) == expected){
+			_MCFCRT_WaitOnAddressForever(&turn, &expected, sizeof(expected));
+		}
+		__atomic_store_n(&turn, 0, __ATOMIC_RELEASE);
+		_MCFCRT_WakeAddress(&turn, 1);
+	}
+	return 0;
+}
+
+void *gate_proc(void *param){
+	(void)param;
+	uint64_t expected = 0;
+	while(__atomic_load_n(&gate, __ATOMIC_ACQUIRE) == expected){
+		_MCFCRT_WaitOnAddressForever(&gate, &expected, sizeof(expected));
+	}
+	return 0;
+}
+
+int main(){
+	int err;
+	// A wait on a value that differs from the expected one returns immediately, and so does one that times out.
+	uint32_t expected = 1;
+	assert(_MCFCRT_WaitOnAddress(&turn, &expected, sizeof(expected), 0));
+	expected = 0;
+	assert(!_MCFCRT_WaitOnAddress(&turn, &expected, sizeof(expected), _MCFCRT_GetFastMonoClock() + 10));
+	assert(_MCFCRT_WakeAddress(&turn, SIZE_MAX) == 0);
+
+	__gthread_t thread;
+	err = __gthread_create(&thread, &pong_proc, 0);
+	assert(err == 0);
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < ROUND_TRIPS; ++i){
+		__atomic_store_n(&turn, 1, __ATOMIC_RELEASE);
+		_MCFCRT_WakeAddress(&turn, 1);
+		expected = 1;
+		while(__atomic_load_n(&turn, __ATOMIC_ACQUIRE) == expected){
+			_MCFCRT_WaitOnAddressForever(&turn, &expected, sizeof(expected));
+		}
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	err = __gthread_join(thread, 0);
+	assert(err == 0);
+	printf("round trip: %.3f us\n", (t2 - t1) * 1000 / ROUND_TRIPS);
+
+	__gthread_t waiters[WAITER_COUNT];
+	for(unsigned long i = 0; i < WAITER_COUNT; ++i){
+		err = __gthread_create(&waiters[i], &gate_proc, 0);
+		assert(err == 0);
+	}
+	__atomic_store_n(&gate, 1, __ATOMIC_RELEASE);
+	_MCFCRT_WakeAddress(&gate, SIZE_MAX);
+	for(unsigned long i = 0; i < WAITER_COUNT; ++i){
+		err = __gthread_join(waiters[i], 0);
+		assert(err == 0);
+	}
+}
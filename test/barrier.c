@@ -0,0 +1,93 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/barrier.h"
+#include "../src/env/latch.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark measures how many phases per millisecond increasing numbers of threads can complete,
+// using `_MCFCRT_Barrier` and a barrier built on a mutex and a condition variable.
+
+#define MAX_THREAD_COUNT       128ul
+#define PHASES                 2000ul
+
+_MCFCRT_Barrier barrier;
+_MCFCRT_Latch start_latch;
+volatile unsigned long completed;
+
+__gthread_mutex_t mutex = __GTHREAD_MUTEX_INIT;
+__gthread_cond_t cond = __GTHREAD_COND_INIT;
+unsigned long cv_expected, cv_arrived, cv_generation;
+
+void completion_proc(intptr_t context){
+	assert(context == 12345);
+	++completed;
+}
+
+void cv_arrive_and_wait(void){
+	__gthread_mutex_lock(&mutex);
+	const unsigned long my_generation = cv_generation;
+	if(++cv_arrived == cv_expected){
+		cv_arrived = 0;
+		++cv_generation;
+		++completed;
+		__gthread_cond_broadcast(&cond);
+	} else {
+		do {
+			__gthread_cond_wait(&cond, &mutex);
+		} while(cv_generation == my_generation);
+	}
+	__gthread_mutex_unlock(&mutex);
+}
+
+void *thread_proc(void *param){
+	const bool use_cv = !!param;
+	_MCFCRT_ArriveAtLatchAndWaitForever(&start_latch, 1, _MCFCRT_LATCH_SUGGESTED_SPIN_COUNT);
+	for(unsigned long i = 0; i < PHASES; ++i){
+		if(use_cv){
+			cv_arrive_and_wait();
+		} else {
+			_MCFCRT_ArriveAtBarrierAndWaitForever(&barrier, _MCFCRT_BARRIER_SUGGESTED_SPIN_COUNT);
+		}
+	}
+	return 0;
+}
+
+double run(unsigned long thread_count, bool use_cv){
+	int err;
+	__gthread_t threads[MAX_THREAD_COUNT];
+	_MCFCRT_InitializeBarrier(&barrier, (uint32_t)thread_count, &completion_proc, 12345);
+	_MCFCRT_InitializeLatch(&start_latch, (uint32_t)thread_count + 1);
+	cv_expected = thread_count;
+	cv_arrived = 0;
+	completed = 0;
+	for(unsigned long i = 0; i < thread_count; ++i){
+		err = __gthread_create(&threads[i], &thread_proc, (void *)(uintptr_t)use_cv);
+		assert(err == 0);
+	}
+	// Start timing when all threads are ready.
+	_MCFCRT_ArriveAtLatchAndWaitForever(&start_latch, 1, _MCFCRT_LATCH_SUGGESTED_SPIN_COUNT);
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < thread_count; ++i){
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	assert(completed == PHASES);
+	// The result is in phases per millisecond.
+	return PHASES / (t2 - t1);
+}
+
+int main(){
+	printf("%8s %20s %20s\n", "threads", "_MCFCRT_Barrier", "mutex + cond");
+	for(unsigned long thread_count = 2; thread_count <= MAX_THREAD_COUNT; thread_count *= 2){
+		const double tree = run(thread_count, false);
+		const double cv = run(thread_count, true);
+		printf("%8lu %20.3f %20.3f\n", thread_count, tree, cv);
+	}
+}
@@ -0,0 +1,87 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <windows.h>
+
+// This benchmark measures how long a producer spends in `__gthread_cond_broadcast()` when increasing numbers of threads are sleeping,
+// as well as how long it takes for all of them to wake up.
+
+#define MAX_THREAD_COUNT       128ul
+#define ROUNDS                 50ul
+
+__gthread_mutex_t mutex = __GTHREAD_MUTEX_INIT;
+__gthread_cond_t cond = __GTHREAD_COND_INIT;
+unsigned long generation = 0;
+unsigned long waiting = 0;
+volatile unsigned long woken = 0;
+volatile bool stopping = false;
+
+void *waiter_proc(void *param){
+	(void)param;
+	__gthread_mutex_lock(&mutex);
+	while(!stopping){
+		const unsigned long my_generation = generation;
+		++waiting;
+		do {
+			__gthread_cond_wait(&cond, &mutex);
+		} while(generation == my_generation);
+		__atomic_fetch_add(&woken, 1, __ATOMIC_RELAXED);
+	}
+	__gthread_mutex_unlock(&mutex);
+	return 0;
+}
+
+int main(){
+	int err;
+	__gthread_t threads[MAX_THREAD_COUNT];
+	printf("%8s %20s %20s\n", "threads", "broadcast (us)", "all woken (us)");
+	for(unsigned long thread_count = 2; thread_count <= MAX_THREAD_COUNT; thread_count *= 2){
+		generation = 0;
+		waiting = 0;
+		stopping = false;
+		for(unsigned long i = 0; i < thread_count; ++i){
+			err = __gthread_create(&threads[i], &waiter_proc, 0);
+			assert(err == 0);
+		}
+		double broadcast_total = 0, woken_total = 0;
+		for(unsigned long round = 0; round <= ROUNDS; ++round){
+			for(;;){
+				__gthread_mutex_lock(&mutex);
+				const bool ready = waiting == thread_count;
+				__gthread_mutex_unlock(&mutex);
+				if(ready){
+					break;
+				}
+				Sleep(1);
+			}
+			// Make sure they have gone to sleep rather than spinning.
+			Sleep(10);
+			__gthread_mutex_lock(&mutex);
+			waiting = 0;
+			woken = 0;
+			++generation;
+			stopping = round == ROUNDS;
+			__gthread_mutex_unlock(&mutex);
+			const double t1 = _MCFCRT_GetHiResMonoClock();
+			__gthread_cond_broadcast(&cond);
+			const double t2 = _MCFCRT_GetHiResMonoClock();
+			while(__atomic_load_n(&woken, __ATOMIC_RELAXED) != thread_count){
+				__builtin_ia32_pause();
+			}
+			const double t3 = _MCFCRT_GetHiResMonoClock();
+			broadcast_total += t2 - t1;
+			woken_total += t3 - t1;
+		}
+		for(unsigned long i = 0; i < thread_count; ++i){
+			err = __gthread_join(threads[i], 0);
+			assert(err == 0);
+		}
+		printf("%8lu %20.3f %20.3f\n", thread_count, broadcast_total * 1000 / (ROUNDS + 1), woken_total * 1000 / (ROUNDS + 1));
+	}
+}
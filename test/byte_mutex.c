@@ -0,0 +1,92 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/mutex.h"
+#include "../src/env/byte_mutex.h"
+#include "../src/env/byte_once.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark compares `_MCFCRT_ByteMutex` with `_MCFCRT_Mutex` in size and in uncontended speed,
+// then checks that both the byte mutex and the byte once flag work under contention.
+
+#define OBJECT_COUNT           1000000ul
+#define THREAD_COUNT           16ul
+#define LOCKS_PER_THREAD       100000ul
+
+typedef struct object_mutex {
+	_MCFCRT_Mutex mutex;
+	unsigned char value;
+} object_mutex;
+
+typedef struct object_byte_mutex {
+	_MCFCRT_ByteMutex mutex;
+	unsigned char value;
+} object_byte_mutex;
+
+_MCFCRT_ByteMutex contended_mutex = { 0 };
+unsigned long contended_counter = 0;
+_MCFCRT_ByteOnce once = { 0 };
+volatile unsigned long initialized = 0;
+
+void *thread_proc(void *param){
+	(void)param;
+	for(unsigned long i = 0; i < LOCKS_PER_THREAD; ++i){
+		_MCFCRT_WaitForByteMutexForever(&contended_mutex, _MCFCRT_BYTE_MUTEX_SUGGESTED_SPIN_COUNT);
+		++contended_counter;
+		_MCFCRT_SignalByteMutex(&contended_mutex);
+	}
+	if(_MCFCRT_WaitForByteOnceForever(&once) == _MCFCRT_kOnceResultInitial){
+		__atomic_fetch_add(&initialized, 1, __ATOMIC_RELAXED);
+		_MCFCRT_SignalByteOnceAsFinished(&once);
+	}
+	assert(initialized == 1);
+	return 0;
+}
+
+int main(){
+	printf("sizeof(object_mutex)      = %u\n", (unsigned)sizeof(object_mutex));
+	printf("sizeof(object_byte_mutex) = %u\n", (unsigned)sizeof(object_byte_mutex));
+
+	object_mutex *const objects = calloc(OBJECT_COUNT, sizeof(object_mutex));
+	object_byte_mutex *const byte_objects = calloc(OBJECT_COUNT, sizeof(object_byte_mutex));
+	assert(objects && byte_objects);
+	double t1, t2;
+	t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < OBJECT_COUNT; ++i){
+		_MCFCRT_WaitForMutexForever(&(objects[i].mutex), _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+		++objects[i].value;
+		_MCFCRT_SignalMutex(&(objects[i].mutex));
+	}
+	t2 = _MCFCRT_GetHiResMonoClock();
+	printf("uncontended _MCFCRT_Mutex:     %.3f ns\n", (t2 - t1) * 1000000 / OBJECT_COUNT);
+	t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < OBJECT_COUNT; ++i){
+		_MCFCRT_WaitForByteMutexForever(&(byte_objects[i].mutex), _MCFCRT_BYTE_MUTEX_SUGGESTED_SPIN_COUNT);
+		++byte_objects[i].value;
+		_MCFCRT_SignalByteMutex(&(byte_objects[i].mutex));
+	}
+	t2 = _MCFCRT_GetHiResMonoClock();
+	printf("uncontended _MCFCRT_ByteMutex: %.3f ns\n", (t2 - t1) * 1000000 / OBJECT_COUNT);
+	free(objects);
+	free(byte_objects);
+
+	int err;
+	__gthread_t threads[THREAD_COUNT];
+	t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		err = __gthread_create(&threads[i], &thread_proc, 0);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+	t2 = _MCFCRT_GetHiResMonoClock();
+	assert(contended_counter == THREAD_COUNT * LOCKS_PER_THREAD);
+	printf("contended _MCFCRT_ByteMutex:   %.3f locks per ms\n", contended_counter / (t2 - t1));
+}
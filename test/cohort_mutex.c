@@ -0,0 +1,83 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/mutex.h"
+#include "../src/env/cohort_mutex.h"
+#include "../src/env/_topology.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark measures throughput of a short critical section with increasing numbers of threads,
+// comparing `_MCFCRT_Mutex` with `_MCFCRT_CohortMutex`. Every critical section also checks mutual exclusion,
+// and some threads use `_MCFCRT_TryWaitForCohortMutex()`, so the cohort mutex is checked on single-node hosts too.
+
+#define MAX_THREAD_COUNT       64ul
+#define LOCKS_PER_THREAD       200000ul
+
+_MCFCRT_Mutex mutex = { 0 };
+_MCFCRT_CohortMutex cohort_mutex = _MCFCRT_COHORT_MUTEX_INIT;
+volatile unsigned long counter = 0;
+volatile unsigned long owners = 0;
+volatile bool use_cohort_mutex = false;
+
+void critical_section(void){
+	const unsigned long old = __atomic_fetch_add(&owners, 1, __ATOMIC_RELAXED);
+	assert(old == 0);
+	++counter;
+	__atomic_fetch_sub(&owners, 1, __ATOMIC_RELAXED);
+}
+
+void *thread_proc(void *param){
+	const bool try_first = (uintptr_t)param % 2 != 0;
+	for(unsigned long i = 0; i < LOCKS_PER_THREAD; ++i){
+		if(use_cohort_mutex){
+			if(!try_first || !_MCFCRT_TryWaitForCohortMutex(&cohort_mutex)){
+				_MCFCRT_WaitForCohortMutexForever(&cohort_mutex, _MCFCRT_COHORT_MUTEX_SUGGESTED_SPIN_COUNT);
+			}
+			critical_section();
+			_MCFCRT_SignalCohortMutex(&cohort_mutex);
+		} else {
+			_MCFCRT_WaitForMutexForever(&mutex, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+			critical_section();
+			_MCFCRT_SignalMutex(&mutex);
+		}
+	}
+	return 0;
+}
+
+double run(unsigned long thread_count, bool cohort){
+	int err;
+	__gthread_t threads[MAX_THREAD_COUNT];
+	counter = 0;
+	use_cohort_mutex = cohort;
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < thread_count; ++i){
+		err = __gthread_create(&threads[i], &thread_proc, (void *)(uintptr_t)i);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < thread_count; ++i){
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	assert(counter == thread_count * LOCKS_PER_THREAD);
+	return t2 - t1;
+}
+
+int main(){
+	printf("NUMA nodes: %u\n", (unsigned)__MCFCRT_GetNumaNodeCount());
+	printf("%8s %16s %16s\n", "threads", "mutex (ms)", "cohort (ms)");
+	for(unsigned long thread_count = 1; thread_count <= MAX_THREAD_COUNT; thread_count *= 2){
+		const double plain = run(thread_count, false);
+		const double cohort = run(thread_count, true);
+		printf("%8lu %16.3f %16.3f\n", thread_count, plain, cohort);
+	}
+	// Nothing may be left locked.
+	const bool taken = _MCFCRT_TryWaitForCohortMutex(&cohort_mutex);
+	assert(taken);
+	_MCFCRT_SignalCohortMutex(&cohort_mutex);
+}
@@ -0,0 +1,114 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/clocks.h"
+#include "../src/env/thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This test broadcasts a condition variable over and over while its mutex is contended, which makes most of the waiters be moved onto the mutex
+// rather than woken up, and races such moves against the mutex being unlocked. It checks that every waiter is woken up in every round.
+// A lost wakeup leaves a waiter parked forever, which is reported once a round has taken too long.
+
+#define WAITER_COUNT           32ul
+#define NOISE_COUNT            2ul
+#define ROUNDS                 2000ul
+#define ROUND_TIMEOUT_MS       10000ul
+
+__gthread_mutex_t mutex = __GTHREAD_MUTEX_INIT;
+__gthread_cond_t cond = __GTHREAD_COND_INIT;
+unsigned long generation = 0;
+unsigned long arrived = 0;
+unsigned long acked = 0;
+bool stopping = false;
+volatile bool noise_stopping = false;
+
+void *waiter_proc(void *param){
+	(void)param;
+	__gthread_mutex_lock(&mutex);
+	for(;;){
+		const unsigned long my_generation = generation;
+		++arrived;
+		do {
+			__gthread_cond_wait(&cond, &mutex);
+		} while(generation == my_generation);
+		++acked;
+		if(stopping){
+			break;
+		}
+	}
+	__gthread_mutex_unlock(&mutex);
+	return 0;
+}
+
+void *noise_proc(void *param){
+	(void)param;
+	// Keep the mutex locked for most of the time, so woken waiters are likely to be moved onto it.
+	while(!__atomic_load_n(&noise_stopping, __ATOMIC_RELAXED)){
+		__gthread_mutex_lock(&mutex);
+		for(unsigned i = 0; i < 100; ++i){
+			__builtin_ia32_pause();
+		}
+		__gthread_mutex_unlock(&mutex);
+	}
+	return 0;
+}
+
+int main(){
+	int err;
+	__gthread_t waiters[WAITER_COUNT];
+	__gthread_t noises[NOISE_COUNT];
+	for(unsigned long i = 0; i < WAITER_COUNT; ++i){
+		err = __gthread_create(&waiters[i], &waiter_proc, 0);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < NOISE_COUNT; ++i){
+		err = __gthread_create(&noises[i], &noise_proc, 0);
+		assert(err == 0);
+	}
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long round = 0; round < ROUNDS; ++round){
+		const uint64_t round_deadline = _MCFCRT_GetFastMonoClock() + ROUND_TIMEOUT_MS;
+		// A waiter arrives only after it has been woken up in the previous round, so this also checks that none was lost.
+		for(;;){
+			__gthread_mutex_lock(&mutex);
+			if(arrived == WAITER_COUNT){
+				break;
+			}
+			const unsigned long arrived_now = arrived;
+			__gthread_mutex_unlock(&mutex);
+			if(_MCFCRT_GetFastMonoClock() > round_deadline){
+				printf("round %lu: only %lu of %lu waiters have been woken up\n", round, arrived_now, WAITER_COUNT);
+				abort();
+			}
+			_MCFCRT_YieldThread();
+		}
+		assert(acked == round * WAITER_COUNT);
+		arrived = 0;
+		++generation;
+		stopping = round == ROUNDS - 1;
+		// Broadcasting with the mutex locked moves all waiters onto it. Otherwise they race with the noise threads and each other.
+		if(round % 2 == 0){
+			__gthread_cond_broadcast(&cond);
+			__gthread_mutex_unlock(&mutex);
+		} else {
+			__gthread_mutex_unlock(&mutex);
+			__gthread_cond_broadcast(&cond);
+		}
+	}
+	for(unsigned long i = 0; i < WAITER_COUNT; ++i){
+		err = __gthread_join(waiters[i], 0);
+		assert(err == 0);
+	}
+	__atomic_store_n(&noise_stopping, true, __ATOMIC_RELAXED);
+	for(unsigned long i = 0; i < NOISE_COUNT; ++i){
+		err = __gthread_join(noises[i], 0);
+		assert(err == 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	assert(acked == ROUNDS * WAITER_COUNT);
+	printf("%lu broadcasts to %lu waiters: OK (%.3f ms)\n", ROUNDS, WAITER_COUNT, t2 - t1);
+}
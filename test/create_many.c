@@ -0,0 +1,62 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/latch.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark measures how long it takes to start a pool of threads until all of them are running,
+// creating them one by one with `__gthread_create()` and at once with `__gthread_create_many()`.
+
+#define THREAD_COUNT           128ul
+#define ROUNDS                 20ul
+
+_MCFCRT_Latch started;
+
+void *thread_proc(void *param){
+	_MCFCRT_CountDownLatch(&started, 1);
+	return param;
+}
+
+double run(bool many){
+	int err;
+	__gthread_t threads[THREAD_COUNT];
+	void *params[THREAD_COUNT];
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		params[i] = (void *)(uintptr_t)i;
+	}
+	_MCFCRT_InitializeLatch(&started, THREAD_COUNT);
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	if(many){
+		err = __gthread_create_many(threads, THREAD_COUNT, &thread_proc, params, 0);
+		assert(err == 0);
+	} else {
+		for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+			err = __gthread_create(&threads[i], &thread_proc, params[i]);
+			assert(err == 0);
+		}
+	}
+	_MCFCRT_WaitForLatchForever(&started, _MCFCRT_LATCH_SUGGESTED_SPIN_COUNT);
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		void *ret;
+		err = __gthread_join(threads[i], &ret);
+		assert(err == 0);
+		assert(ret == params[i]);
+	}
+	return t2 - t1;
+}
+
+int main(){
+	double one_by_one = 0, many = 0;
+	for(unsigned long round = 0; round < ROUNDS; ++round){
+		one_by_one += run(false);
+		many += run(true);
+	}
+	printf("__gthread_create():      %.3f ms per pool\n", one_by_one / ROUNDS);
+	printf("__gthread_create_many(): %.3f ms per pool\n", many / ROUNDS);
+}
@@ -0,0 +1,98 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/event.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <windows.h>
+
+// This benchmark compares `_MCFCRT_Event` with Win32 event handles, in the cost of setting an event that nobody waits for,
+// as well as the round trip time of two threads signaling each other with auto-reset events.
+
+#define SET_COUNT              1000000ul
+#define ROUND_TRIPS            100000ul
+
+_MCFCRT_Event ping_event = { 0 }, pong_event = { 0 };
+HANDLE ping_handle, pong_handle;
+
+void *pong_proc(void *param){
+	if(param){
+		for(unsigned long i = 0; i < ROUND_TRIPS; ++i){
+			WaitForSingleObject(ping_handle, INFINITE);
+			SetEvent(pong_handle);
+		}
+	} else {
+		for(unsigned long i = 0; i < ROUND_TRIPS; ++i){
+			_MCFCRT_WaitForEventForever(&ping_event, _MCFCRT_EVENT_SUGGESTED_SPIN_COUNT);
+			_MCFCRT_SetEvent(&pong_event);
+		}
+	}
+	return 0;
+}
+
+double measure_round_trip(bool native){
+	int err;
+	__gthread_t thread;
+	err = __gthread_create(&thread, &pong_proc, (void *)(uintptr_t)native);
+	assert(err == 0);
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	if(native){
+		for(unsigned long i = 0; i < ROUND_TRIPS; ++i){
+			SetEvent(ping_handle);
+			WaitForSingleObject(pong_handle, INFINITE);
+		}
+	} else {
+		for(unsigned long i = 0; i < ROUND_TRIPS; ++i){
+			_MCFCRT_SetEvent(&ping_event);
+			_MCFCRT_WaitForEventForever(&pong_event, _MCFCRT_EVENT_SUGGESTED_SPIN_COUNT);
+		}
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	err = __gthread_join(thread, 0);
+	assert(err == 0);
+	// The result is in microseconds.
+	return (t2 - t1) * 1000 / ROUND_TRIPS;
+}
+
+int main(){
+	ping_handle = CreateEventW(0, false, false, 0);
+	assert(ping_handle);
+	pong_handle = CreateEventW(0, false, false, 0);
+	assert(pong_handle);
+
+	_MCFCRT_Event manual;
+	_MCFCRT_InitializeEvent(&manual, true, false);
+	assert(!_MCFCRT_WaitForEvent(&manual, 0, 0));
+	_MCFCRT_SetEvent(&manual);
+	assert(_MCFCRT_WaitForEvent(&manual, 0, 0));
+	assert(_MCFCRT_WaitForEvent(&manual, 0, 0));
+	_MCFCRT_ResetEvent(&manual);
+	assert(!_MCFCRT_TryWaitForEvent(&manual));
+
+	double t1, t2;
+	t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < SET_COUNT; ++i){
+		_MCFCRT_SetEvent(&ping_event);
+	}
+	t2 = _MCFCRT_GetHiResMonoClock();
+	assert(_MCFCRT_TryWaitForEvent(&ping_event));
+	assert(!_MCFCRT_TryWaitForEvent(&ping_event));
+	printf("uncontended _MCFCRT_SetEvent(): %.3f ns\n", (t2 - t1) * 1000000 / SET_COUNT);
+	t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < SET_COUNT; ++i){
+		SetEvent(ping_handle);
+	}
+	t2 = _MCFCRT_GetHiResMonoClock();
+	ResetEvent(ping_handle);
+	printf("uncontended SetEvent():         %.3f ns\n", (t2 - t1) * 1000000 / SET_COUNT);
+
+	printf("round trip with _MCFCRT_Event:  %.3f us\n", measure_round_trip(false));
+	printf("round trip with HANDLE:         %.3f us\n", measure_round_trip(true));
+
+	CloseHandle(ping_handle);
+	CloseHandle(pong_handle);
+}
@@ -0,0 +1,101 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/event_count.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This test has consumers block on a lock-free counter of items with `_MCFCRT_EventCount`, while producers add items to it.
+// It checks that no item is lost and measures how long it takes, as well as the cost of a notification that finds no waiting thread.
+
+#define PRODUCER_COUNT         4ul
+#define CONSUMER_COUNT         4ul
+#define ITEMS_PER_PRODUCER     200000ul
+#define NOTIFY_COUNT           10000000ul
+
+_MCFCRT_EventCount event_count = { 0 };
+volatile unsigned long items = 0;
+volatile unsigned long consumed = 0;
+
+bool try_pop(void){
+	unsigned long old = __atomic_load_n(&items, __ATOMIC_RELAXED);
+	do {
+		if(old == 0){
+			return false;
+		}
+	} while(!__atomic_compare_exchange_n(&items, &old, old - 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+	return true;
+}
+
+void *producer_proc(void *param){
+	(void)param;
+	for(unsigned long i = 0; i < ITEMS_PER_PRODUCER; ++i){
+		__atomic_fetch_add(&items, 1, __ATOMIC_RELEASE);
+		_MCFCRT_SignalEventCount(&event_count);
+	}
+	return 0;
+}
+
+void *consumer_proc(void *param){
+	(void)param;
+	for(unsigned long i = 0; i < PRODUCER_COUNT * ITEMS_PER_PRODUCER / CONSUMER_COUNT; ++i){
+		for(;;){
+			if(try_pop()){
+				break;
+			}
+			const _MCFCRT_EventCountKey key = _MCFCRT_PrepareWaitForEventCount(&event_count);
+			if(try_pop()){
+				_MCFCRT_CancelWaitForEventCount(&event_count);
+				break;
+			}
+			_MCFCRT_CommitWaitForEventCountForever(&event_count, key, _MCFCRT_EVENT_COUNT_SUGGESTED_SPIN_COUNT);
+		}
+		__atomic_fetch_add(&consumed, 1, __ATOMIC_RELAXED);
+	}
+	return 0;
+}
+
+int main(){
+	int err;
+	double t1, t2;
+	t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < NOTIFY_COUNT; ++i){
+		_MCFCRT_SignalEventCount(&event_count);
+	}
+	t2 = _MCFCRT_GetHiResMonoClock();
+	printf("notification without waiters: %.3f ns\n", (t2 - t1) * 1000000 / NOTIFY_COUNT);
+
+	// A wait that has been notified after preparation returns immediately.
+	_MCFCRT_EventCountKey key = _MCFCRT_PrepareWaitForEventCount(&event_count);
+	_MCFCRT_BroadcastEventCount(&event_count);
+	assert(_MCFCRT_CommitWaitForEventCount(&event_count, key, 0, 0));
+	key = _MCFCRT_PrepareWaitForEventCount(&event_count);
+	assert(!_MCFCRT_CommitWaitForEventCount(&event_count, key, 0, _MCFCRT_GetFastMonoClock() + 10));
+
+	__gthread_t producers[PRODUCER_COUNT], consumers[CONSUMER_COUNT];
+	t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < CONSUMER_COUNT; ++i){
+		err = __gthread_create(&consumers[i], &consumer_proc, 0);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < PRODUCER_COUNT; ++i){
+		err = __gthread_create(&producers[i], &producer_proc, 0);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < PRODUCER_COUNT; ++i){
+		err = __gthread_join(producers[i], 0);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < CONSUMER_COUNT; ++i){
+		err = __gthread_join(consumers[i], 0);
+		assert(err == 0);
+	}
+	t2 = _MCFCRT_GetHiResMonoClock();
+	assert(consumed == PRODUCER_COUNT * ITEMS_PER_PRODUCER);
+	assert(items == 0);
+	printf("items per ms: %.3f\n", consumed / (t2 - t1));
+}
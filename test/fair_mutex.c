@@ -0,0 +1,132 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/mutex.h"
+#include "../src/env/clocks.h"
+#include "../src/env/thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This test checks that `_MCFCRT_FairMutex` hands itself over to a starving waiter, so a thread contending with others that keep barging in
+// is not locked out for much longer than the starvation threshold, which is a millisecond.
+// It then checks that a timed waiter that has requested a handoff can give up, and that the mutex is released normally after that.
+
+#define HOG_COUNT              4ul
+#define HOG_HOLD_MS            0.05
+#define VICTIM_LOCKS           200ul
+#define MAX_VICTIM_WAIT_MS     100.0
+
+_MCFCRT_FairMutex mutex = { 0 };
+volatile bool stopped = false;
+volatile unsigned long owners = 0;
+
+void enter(void){
+	const unsigned long old = __atomic_fetch_add(&owners, 1, __ATOMIC_RELAXED);
+	assert(old == 0);
+}
+void leave(void){
+	const unsigned long old = __atomic_fetch_sub(&owners, 1, __ATOMIC_RELAXED);
+	assert(old == 1);
+}
+
+void *hog_proc(void *param){
+	(void)param;
+	// Relock immediately after unlocking, which is what starves the victim of a plain mutex.
+	while(!__atomic_load_n(&stopped, __ATOMIC_RELAXED)){
+		_MCFCRT_WaitForFairMutexForever(&mutex, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+		enter();
+		const double t1 = _MCFCRT_GetHiResMonoClock();
+		while(_MCFCRT_GetHiResMonoClock() - t1 < HOG_HOLD_MS){
+			__builtin_ia32_pause();
+		}
+		leave();
+		_MCFCRT_SignalFairMutex(&mutex);
+	}
+	return 0;
+}
+
+void check_handoff(void){
+	int err;
+	__gthread_t hogs[HOG_COUNT];
+	for(unsigned long i = 0; i < HOG_COUNT; ++i){
+		err = __gthread_create(&hogs[i], &hog_proc, 0);
+		assert(err == 0);
+	}
+	double max_wait = 0;
+	for(unsigned long i = 0; i < VICTIM_LOCKS; ++i){
+		const double t1 = _MCFCRT_GetHiResMonoClock();
+		_MCFCRT_WaitForFairMutexForever(&mutex, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+		const double t2 = _MCFCRT_GetHiResMonoClock();
+		enter();
+		if(max_wait < t2 - t1){
+			max_wait = t2 - t1;
+		}
+		leave();
+		_MCFCRT_SignalFairMutex(&mutex);
+		_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 1);
+	}
+	__atomic_store_n(&stopped, true, __ATOMIC_RELAXED);
+	for(unsigned long i = 0; i < HOG_COUNT; ++i){
+		err = __gthread_join(hogs[i], 0);
+		assert(err == 0);
+	}
+	printf("handoff: max victim wait = %.3f ms\n", max_wait);
+	assert(max_wait < MAX_VICTIM_WAIT_MS);
+}
+
+volatile int timed_result = -1;
+
+void *timed_waiter_proc(void *param){
+	(void)param;
+	// Don't spin, so the waiter gets parked right away.
+	const bool taken = _MCFCRT_WaitForFairMutex(&mutex, 0, _MCFCRT_GetFastMonoClock() + 100);
+	if(taken){
+		_MCFCRT_SignalFairMutex(&mutex);
+	}
+	__atomic_store_n(&timed_result, taken, __ATOMIC_RELEASE);
+	return 0;
+}
+
+// Returns `false` if the waiter won the race against the main thread relocking the mutex, in which case no handoff was requested.
+bool try_cancel_handoff(void){
+	int err;
+	__gthread_t waiter;
+	timed_result = -1;
+	_MCFCRT_WaitForFairMutexForever(&mutex, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	err = __gthread_create(&waiter, &timed_waiter_proc, 0);
+	assert(err == 0);
+	// Let the waiter wait for longer than the starvation threshold, then wake it up and barge in before it gets the mutex.
+	// Finding the mutex locked again, it requests a handoff and waits with `MASK_HANDOFF_PENDING` set, until it times out.
+	_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 5);
+	_MCFCRT_SignalFairMutex(&mutex);
+	_MCFCRT_WaitForFairMutexForever(&mutex, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+	_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 200);
+	err = __gthread_join(waiter, 0);
+	assert(err == 0);
+	const bool timed_out = __atomic_load_n(&timed_result, __ATOMIC_ACQUIRE) == 0;
+	// If the cancellation left the handoff request behind, this would keep the mutex locked for a thread that is gone.
+	_MCFCRT_SignalFairMutex(&mutex);
+	const bool taken = _MCFCRT_WaitForFairMutex(&mutex, 0, 0);
+	assert(taken);
+	_MCFCRT_SignalFairMutex(&mutex);
+	return timed_out;
+}
+
+void check_cancelled_handoff(void){
+	for(unsigned i = 0; i < 10; ++i){
+		if(try_cancel_handoff()){
+			printf("cancelled handoff: OK\n");
+			return;
+		}
+	}
+	printf("cancelled handoff: the waiter kept winning the race\n");
+	abort();
+}
+
+int main(){
+	check_handoff();
+	check_cancelled_handoff();
+}
@@ -0,0 +1,166 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/latch.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <assert.h>
+
+// This benchmark measures how long it takes to join a pool of threads that have been started together,
+// joining them one by one with `__gthread_join()` and at once with `__gthread_join_all()`,
+// then checks that `__gthread_timedjoin_any()` and `__gthread_timedjoin_all()` give up running threads on timeout.
+// The checks are repeated with the thread cache enabled, where joined threads are recycled right away.
+
+#define THREAD_COUNT           128ul
+#define ROUNDS                 20ul
+
+_MCFCRT_Latch gates[THREAD_COUNT];
+
+void *thread_proc(void *param){
+	const unsigned long index = (unsigned long)(uintptr_t)param;
+	_MCFCRT_WaitForLatchForever(&gates[index], _MCFCRT_LATCH_SUGGESTED_SPIN_COUNT);
+	return param;
+}
+
+void create_pool(__gthread_t *threads){
+	int err;
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		_MCFCRT_InitializeLatch(&gates[i], 1);
+		err = __gthread_create(&threads[i], &thread_proc, (void *)(uintptr_t)i);
+		assert(err == 0);
+	}
+}
+void open_gate(unsigned long index){
+	_MCFCRT_CountDownLatch(&gates[index], 1);
+}
+
+__gthread_time_t timeout_after(unsigned ms){
+	const uint64_t utc_ms = _MCFCRT_GetUtcClock() + ms;
+	__gthread_time_t timeout;
+	timeout.tv_sec = (time_t)(utc_ms / 1000);
+	timeout.tv_nsec = (long)(utc_ms % 1000) * 1000000;
+	return timeout;
+}
+
+double run(bool all){
+	int err;
+	__gthread_t threads[THREAD_COUNT];
+	void *rets[THREAD_COUNT];
+	create_pool(threads);
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		open_gate(i);
+	}
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	if(all){
+		err = __gthread_join_all(threads, THREAD_COUNT, rets);
+		assert(err == 0);
+	} else {
+		for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+			err = __gthread_join(threads[i], &rets[i]);
+			assert(err == 0);
+			threads[i] = 0;
+		}
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		assert(threads[i] == 0);
+		assert(rets[i] == (void *)(uintptr_t)i);
+	}
+	return t2 - t1;
+}
+
+void check_timeouts(void){
+	int err;
+	__gthread_t threads[THREAD_COUNT];
+	__gthread_time_t timeout;
+	size_t index;
+	void *ret;
+	create_pool(threads);
+
+	// No thread has terminated, so all of them remain joinable.
+	timeout = timeout_after(50);
+	err = __gthread_timedjoin_any(threads, THREAD_COUNT, &index, &ret, &timeout);
+	assert(err == ETIMEDOUT);
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		assert(threads[i] != 0);
+	}
+
+	// Only the thread whose gate has been opened is joined.
+	open_gate(THREAD_COUNT / 2);
+	err = __gthread_join_any(threads, THREAD_COUNT, &index, &ret);
+	assert(err == 0);
+	assert(index == THREAD_COUNT / 2);
+	assert(ret == (void *)(uintptr_t)index);
+	assert(threads[index] == 0);
+
+	// The first half is joined and the second half times out.
+	for(unsigned long i = 0; i < THREAD_COUNT / 2; ++i){
+		open_gate(i);
+	}
+	timeout = timeout_after(200);
+	err = __gthread_timedjoin_all(threads, THREAD_COUNT, 0, &timeout);
+	assert(err == ETIMEDOUT);
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		assert((threads[i] == 0) == (i <= THREAD_COUNT / 2));
+	}
+
+	for(unsigned long i = THREAD_COUNT / 2 + 1; i < THREAD_COUNT; ++i){
+		open_gate(i);
+	}
+	err = __gthread_join_all(threads, THREAD_COUNT, 0);
+	assert(err == 0);
+
+	// Nothing is left to join.
+	err = __gthread_join_any(threads, THREAD_COUNT, &index, &ret);
+	assert(err == ESRCH);
+}
+
+void check_join_any_racing(void){
+	int err;
+	__gthread_t threads[THREAD_COUNT];
+	size_t index;
+	void *ret;
+	create_pool(threads);
+
+	// All threads terminate at about the same time, so some of them terminate while the others are being given up.
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		open_gate(i);
+	}
+	for(;;){
+		err = __gthread_join_any(threads, THREAD_COUNT, &index, &ret);
+		if(err == ESRCH){
+			break;
+		}
+		assert(err == 0);
+		assert(ret == (void *)(uintptr_t)index);
+		assert(threads[index] == 0);
+	}
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		assert(threads[i] == 0);
+	}
+}
+
+int main(){
+	double one_by_one = 0, all = 0;
+	for(unsigned long round = 0; round < ROUNDS; ++round){
+		one_by_one += run(false);
+		all += run(true);
+	}
+	printf("__gthread_join():     %.3f ms per pool\n", one_by_one / ROUNDS);
+	printf("__gthread_join_all(): %.3f ms per pool\n", all / ROUNDS);
+	check_timeouts();
+	for(unsigned long round = 0; round < ROUNDS; ++round){
+		check_join_any_racing();
+	}
+
+	__gthread_set_thread_cache_capacity(THREAD_COUNT);
+	check_timeouts();
+	for(unsigned long round = 0; round < ROUNDS; ++round){
+		check_join_any_racing();
+	}
+	__gthread_set_thread_cache_capacity(0);
+}
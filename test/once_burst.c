@@ -0,0 +1,101 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/c11thread.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark measures how long it takes for a burst of threads to get past a lazy initialization that takes a few microseconds,
+// using `__gthread_once()` and `call_once()`.
+
+#define THREAD_COUNT           64ul
+#define ROUNDS                 100ul
+
+__gthread_once_t gthread_flags[ROUNDS];
+once_flag c11_flags[ROUNDS];
+volatile double init_duration_ms;
+volatile unsigned long initialized;
+volatile unsigned long ready;
+volatile unsigned long round_started;
+volatile bool use_call_once;
+
+void init_proc(void){
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	while(_MCFCRT_GetHiResMonoClock() - t1 < init_duration_ms){
+		__builtin_ia32_pause();
+	}
+	__atomic_fetch_add(&initialized, 1, __ATOMIC_RELAXED);
+}
+
+void *thread_proc(void *param){
+	(void)param;
+	for(unsigned long round = 0; round < ROUNDS; ++round){
+		__atomic_fetch_add(&ready, 1, __ATOMIC_RELAXED);
+		while(__atomic_load_n(&round_started, __ATOMIC_ACQUIRE) <= round){
+			__builtin_ia32_pause();
+		}
+		if(use_call_once){
+			call_once(&c11_flags[round], &init_proc);
+		} else {
+			int err = __gthread_once(&gthread_flags[round], &init_proc);
+			assert(err == 0);
+		}
+	}
+	return 0;
+}
+
+double run(double duration_us, bool c11){
+	int err;
+	__gthread_t threads[THREAD_COUNT];
+	for(unsigned long round = 0; round < ROUNDS; ++round){
+		gthread_flags[round] = (__gthread_once_t)__GTHREAD_ONCE_INIT;
+		c11_flags[round] = (once_flag){ { 0 } };
+	}
+	init_duration_ms = duration_us / 1000;
+	initialized = 0;
+	ready = 0;
+	round_started = 0;
+	use_call_once = c11;
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		err = __gthread_create(&threads[i], &thread_proc, 0);
+		assert(err == 0);
+	}
+	double total = 0;
+	for(unsigned long round = 0; round < ROUNDS; ++round){
+		// Wait for all threads to arrive at the start line, then release them together.
+		while(__atomic_load_n(&ready, __ATOMIC_RELAXED) != (round + 1) * THREAD_COUNT){
+			__builtin_ia32_pause();
+		}
+		const double t1 = _MCFCRT_GetHiResMonoClock();
+		__atomic_store_n(&round_started, round + 1, __ATOMIC_RELEASE);
+		// A round ends when all threads have arrived at the next start line, so the last round is not measured.
+		if(round + 1 < ROUNDS){
+			while(__atomic_load_n(&ready, __ATOMIC_RELAXED) != (round + 2) * THREAD_COUNT){
+				__builtin_ia32_pause();
+			}
+			const double t2 = _MCFCRT_GetHiResMonoClock();
+			total += t2 - t1;
+		}
+	}
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+	assert(initialized == ROUNDS);
+	// The result is the average time of a round in microseconds.
+	return total * 1000 / (ROUNDS - 1);
+}
+
+int main(){
+	printf("%12s %20s %20s\n", "init (us)", "__gthread_once (us)", "call_once (us)");
+	static const double durations[] = { 1, 5, 20, 100 };
+	for(unsigned i = 0; i < sizeof(durations) / sizeof(durations[0]); ++i){
+		const double gthread = run(durations[i], false);
+		const double c11 = run(durations[i], true);
+		printf("%12.0f %20.3f %20.3f\n", durations[i], gthread, c11);
+	}
+}
@@ -0,0 +1,134 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/_park.h"
+#include "../src/env/mutex.h"
+#include "../src/env/clocks.h"
+#include "../src/env/thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark measures wake latency and throughput of the park backend that has been selected at startup.
+// Run it once as is and once with the environment variable `MCFGTHREAD_PARK_BACKEND` set to `KeyedEvent` to compare both backends.
+// It also checks that wakeups saved for many keys before anyone parks are not lost, even after buckets have run out of records for them,
+// in which case the unparking threads wait for the parking thread.
+
+#define ROUND_TRIPS            100000ul
+#define MAX_THREAD_COUNT       64ul
+#define LOCKS_PER_THREAD       20000ul
+#define PENDING_KEY_COUNT      4096ul
+#define UNPARKER_COUNT         16ul
+
+// Keys must be even.
+__attribute__((__aligned__(8))) volatile char ping_key, pong_key;
+
+void *pong_proc(void *param){
+	(void)param;
+	for(unsigned long i = 0; i < ROUND_TRIPS; ++i){
+		__MCFCRT_ParkThread((void *)&ping_key, 0);
+		__MCFCRT_UnparkThread((void *)&pong_key);
+	}
+	return 0;
+}
+
+double measure_latency(void){
+	int err;
+	__gthread_t thread;
+	err = __gthread_create(&thread, &pong_proc, 0);
+	assert(err == 0);
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < ROUND_TRIPS; ++i){
+		__MCFCRT_UnparkThread((void *)&ping_key);
+		__MCFCRT_ParkThread((void *)&pong_key, 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	err = __gthread_join(thread, 0);
+	assert(err == 0);
+	// Each round trip consists of two wakeups. The result is in microseconds.
+	return (t2 - t1) * 1000 / (ROUND_TRIPS * 2);
+}
+
+_MCFCRT_Mutex mutex = { 0 };
+volatile unsigned long counter = 0;
+
+void *lock_proc(void *param){
+	(void)param;
+	for(unsigned long i = 0; i < LOCKS_PER_THREAD; ++i){
+		// Don't spin, so every contended lock parks.
+		_MCFCRT_WaitForMutexForever(&mutex, 0);
+		++counter;
+		_MCFCRT_SignalMutex(&mutex);
+	}
+	return 0;
+}
+
+double measure_throughput(unsigned long thread_count){
+	int err;
+	__gthread_t threads[MAX_THREAD_COUNT];
+	counter = 0;
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < thread_count; ++i){
+		err = __gthread_create(&threads[i], &lock_proc, 0);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < thread_count; ++i){
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	assert(counter == thread_count * LOCKS_PER_THREAD);
+	// The result is in locks per millisecond.
+	return counter / (t2 - t1);
+}
+
+// Every bucket gets many more keys than it has records for saved wakeups.
+__attribute__((__aligned__(8))) volatile short pending_keys[PENDING_KEY_COUNT];
+
+void *unparker_proc(void *param){
+	// Keys are unparked in the order they are parked, so an unparking thread that waits for its wakeups to be consumed always gets woken up.
+	for(unsigned long i = (uintptr_t)param; i < PENDING_KEY_COUNT; i += UNPARKER_COUNT){
+		__MCFCRT_UnparkThreads((void *)&pending_keys[i], i % 3 + 1);
+	}
+	return 0;
+}
+
+void check_pending_wakeups(void){
+	int err;
+	__gthread_t threads[UNPARKER_COUNT];
+	for(unsigned long i = 0; i < UNPARKER_COUNT; ++i){
+		err = __gthread_create(&threads[i], &unparker_proc, (void *)(uintptr_t)i);
+		assert(err == 0);
+	}
+	// Let the unparking threads get ahead of us.
+	_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 100);
+	LARGE_INTEGER no_wait;
+	no_wait.QuadPart = 0;
+	for(unsigned long i = 0; i < PENDING_KEY_COUNT; ++i){
+		for(unsigned long j = 0; j < i % 3 + 1; ++j){
+			const NTSTATUS status = __MCFCRT_ParkThread((void *)&pending_keys[i], 0);
+			assert(status == STATUS_WAIT_0);
+		}
+	}
+	for(unsigned long i = 0; i < UNPARKER_COUNT; ++i){
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < PENDING_KEY_COUNT; ++i){
+		const NTSTATUS status = __MCFCRT_ParkThread((void *)&pending_keys[i], &no_wait);
+		assert(status == STATUS_TIMEOUT);
+	}
+}
+
+int main(){
+	const __MCFCRT_ParkBackend backend = __MCFCRT_GetParkBackend();
+	printf("backend: %s\n", (backend == __MCFCRT_kParkBackendWaitOnAddress) ? "WaitOnAddress" : "KeyedEvent");
+	check_pending_wakeups();
+	printf("wake latency: %.3f us\n", measure_latency());
+	printf("%8s %16s\n", "threads", "locks per ms");
+	for(unsigned long thread_count = 2; thread_count <= MAX_THREAD_COUNT; thread_count *= 2){
+		printf("%8lu %16.3f\n", thread_count, measure_throughput(thread_count));
+	}
+}
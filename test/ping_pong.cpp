@@ -42,6 +42,25 @@
 #	define COND_SIGNAL(cv)   __gthread_cond_signal(cv)
 #endif
 
+#if defined(TEST_SEMAPHORE) && (TEST_SEMAPHORE)
+class semaphore {
+private:
+	__gthread_sem_t x_s;
+
+public:
+	explicit semaphore(std::size_t n_init = 0){
+		__gthread_sem_init(&x_s, static_cast<unsigned>(n_init));
+	}
+
+public:
+	void p(){
+		__gthread_sem_wait(&x_s);
+	}
+	void v(){
+		__gthread_sem_post(&x_s, 1);
+	}
+};
+#else
 class semaphore {
 private:
 	MUTEX_T x_m;
@@ -73,6 +92,7 @@ public:
 		MUTEX_UNLOCK(&x_m);
 	}
 };
+#endif
 
 int main(){
 	constexpr std::size_t n_threads = 4;
@@ -0,0 +1,100 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/mutex.h"
+#include "../src/env/queue_mutex.h"
+#include "../src/env/clocks.h"
+#include "../src/env/thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark measures throughput of a short critical section with increasing numbers of threads,
+// comparing `_MCFCRT_Mutex` with `_MCFCRT_QueueMutex`. Timed waits are checked beforehand.
+
+#define MAX_THREAD_COUNT       128ul
+#define LOCKS_PER_THREAD       200000ul
+
+_MCFCRT_Mutex mutex = { 0 };
+_MCFCRT_QueueMutex queue_mutex = { 0 };
+volatile unsigned long counter = 0;
+volatile bool use_queue_mutex = false;
+
+void *thread_proc(void *param){
+	(void)param;
+	for(unsigned long i = 0; i < LOCKS_PER_THREAD; ++i){
+		if(use_queue_mutex){
+			_MCFCRT_WaitForQueueMutexForever(&queue_mutex, _MCFCRT_QUEUE_MUTEX_SUGGESTED_SPIN_COUNT);
+			++counter;
+			_MCFCRT_SignalQueueMutex(&queue_mutex);
+		} else {
+			_MCFCRT_WaitForMutexForever(&mutex, _MCFCRT_MUTEX_SUGGESTED_SPIN_COUNT);
+			++counter;
+			_MCFCRT_SignalMutex(&mutex);
+		}
+	}
+	return 0;
+}
+
+void *timed_holder_proc(void *param){
+	(void)param;
+	_MCFCRT_WaitForQueueMutexForever(&queue_mutex, _MCFCRT_QUEUE_MUTEX_SUGGESTED_SPIN_COUNT);
+	_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 200);
+	_MCFCRT_SignalQueueMutex(&queue_mutex);
+	return 0;
+}
+
+void check_timed_wait(void){
+	int err;
+	__gthread_t holder;
+	_MCFCRT_WaitForQueueMutexForever(&queue_mutex, _MCFCRT_QUEUE_MUTEX_SUGGESTED_SPIN_COUNT);
+	// The mutex is held by this thread, so a timed wait from another thread must time out.
+	err = __gthread_create(&holder, &timed_holder_proc, 0);
+	assert(err == 0);
+	_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 50);
+	_MCFCRT_SignalQueueMutex(&queue_mutex);
+	// The holder thread has the mutex for 200 ms now.
+	_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 50);
+	bool taken = _MCFCRT_WaitForQueueMutex(&queue_mutex, _MCFCRT_QUEUE_MUTEX_SUGGESTED_SPIN_COUNT, _MCFCRT_GetFastMonoClock() + 20);
+	assert(!taken);
+	// A timed waiter must be woken up when the mutex is unlocked, well before its timeout expires.
+	const uint64_t t1 = _MCFCRT_GetFastMonoClock();
+	taken = _MCFCRT_WaitForQueueMutex(&queue_mutex, _MCFCRT_QUEUE_MUTEX_SUGGESTED_SPIN_COUNT, t1 + 5000);
+	assert(taken);
+	assert(_MCFCRT_GetFastMonoClock() - t1 < 1000);
+	_MCFCRT_SignalQueueMutex(&queue_mutex);
+	err = __gthread_join(holder, 0);
+	assert(err == 0);
+	printf("timed wait: OK\n");
+}
+
+double run(unsigned long thread_count, bool queue){
+	int err;
+	__gthread_t threads[MAX_THREAD_COUNT];
+	counter = 0;
+	use_queue_mutex = queue;
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < thread_count; ++i){
+		err = __gthread_create(&threads[i], &thread_proc, 0);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < thread_count; ++i){
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	assert(counter == thread_count * LOCKS_PER_THREAD);
+	return t2 - t1;
+}
+
+int main(){
+	check_timed_wait();
+	printf("%8s %16s %16s\n", "threads", "mutex (ms)", "queue (ms)");
+	for(unsigned long thread_count = 1; thread_count <= MAX_THREAD_COUNT; thread_count *= 2){
+		const double plain = run(thread_count, false);
+		const double queue = run(thread_count, true);
+		printf("%8lu %16.3f %16.3f\n", thread_count, plain, queue);
+	}
+}
@@ -0,0 +1,148 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/clocks.h"
+#include "../src/env/thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark measures how many snapshots per millisecond increasing numbers of readers can take while a writer updates the snapshot from time to time,
+// using `__gthread_seqlock_t` and `__gthread_mutex_t`. Readers check that every snapshot they take is consistent.
+// It then checks that readers which have parked behind a long write are woken up once the write finishes.
+
+#define MAX_READER_COUNT       32ul
+#define READS_PER_THREAD       1000000ul
+
+typedef struct snapshot {
+	volatile uint64_t bid, ask, sequence;
+} snapshot;
+
+__gthread_seqlock_t seqlock = __GTHREAD_SEQLOCK_INIT;
+__gthread_mutex_t mutex = __GTHREAD_MUTEX_INIT;
+snapshot shared;
+volatile bool stop;
+
+void write_snapshot(uint64_t n){
+	__atomic_store_n(&shared.bid, n, __ATOMIC_RELAXED);
+	__atomic_store_n(&shared.ask, n + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&shared.sequence, ~n, __ATOMIC_RELAXED);
+}
+void read_snapshot(snapshot *out){
+	out->bid = __atomic_load_n(&shared.bid, __ATOMIC_RELAXED);
+	out->ask = __atomic_load_n(&shared.ask, __ATOMIC_RELAXED);
+	out->sequence = __atomic_load_n(&shared.sequence, __ATOMIC_RELAXED);
+}
+void check_snapshot(const snapshot *s){
+	assert(s->ask == s->bid + 1);
+	assert(s->sequence == ~s->bid);
+}
+
+void *writer_proc(void *param){
+	const bool use_mutex = !!param;
+	uint64_t n = 0;
+	while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)){
+		++n;
+		if(use_mutex){
+			__gthread_mutex_lock(&mutex);
+			write_snapshot(n);
+			__gthread_mutex_unlock(&mutex);
+		} else {
+			__gthread_seqlock_wrlock(&seqlock);
+			write_snapshot(n);
+			__gthread_seqlock_wrunlock(&seqlock);
+		}
+		for(unsigned i = 0; i < 10000; ++i){
+			__builtin_ia32_pause();
+		}
+	}
+	return 0;
+}
+
+void *reader_proc(void *param){
+	const bool use_mutex = !!param;
+	snapshot s;
+	for(unsigned long i = 0; i < READS_PER_THREAD; ++i){
+		if(use_mutex){
+			__gthread_mutex_lock(&mutex);
+			read_snapshot(&s);
+			__gthread_mutex_unlock(&mutex);
+		} else {
+			__gthread_seqlock_token_t token;
+			do {
+				__gthread_seqlock_read_begin(&seqlock, &token);
+				read_snapshot(&s);
+			} while(__gthread_seqlock_read_validate(&seqlock, token) != 0);
+		}
+		check_snapshot(&s);
+	}
+	return 0;
+}
+
+double run(unsigned long reader_count, bool use_mutex){
+	int err;
+	__gthread_t writer, readers[MAX_READER_COUNT];
+	write_snapshot(0);
+	stop = false;
+	err = __gthread_create(&writer, &writer_proc, (void *)(uintptr_t)use_mutex);
+	assert(err == 0);
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < reader_count; ++i){
+		err = __gthread_create(&readers[i], &reader_proc, (void *)(uintptr_t)use_mutex);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < reader_count; ++i){
+		err = __gthread_join(readers[i], 0);
+		assert(err == 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	__atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+	err = __gthread_join(writer, 0);
+	assert(err == 0);
+	// The result is in snapshots per millisecond.
+	return reader_count * READS_PER_THREAD / (t2 - t1);
+}
+
+void *parked_reader_proc(void *param){
+	(void)param;
+	snapshot s;
+	__gthread_seqlock_token_t token;
+	do {
+		__gthread_seqlock_read_begin(&seqlock, &token);
+		read_snapshot(&s);
+	} while(__gthread_seqlock_read_validate(&seqlock, token) != 0);
+	check_snapshot(&s);
+	assert(s.bid == 42);
+	return 0;
+}
+
+void check_parked_readers(void){
+	int err;
+	__gthread_t readers[MAX_READER_COUNT];
+	__gthread_seqlock_wrlock(&seqlock);
+	for(unsigned long i = 0; i < MAX_READER_COUNT; ++i){
+		err = __gthread_create(&readers[i], &parked_reader_proc, 0);
+		assert(err == 0);
+	}
+	// Hold the write for much longer than readers spin, so they all park.
+	_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 100);
+	write_snapshot(42);
+	__gthread_seqlock_wrunlock(&seqlock);
+	for(unsigned long i = 0; i < MAX_READER_COUNT; ++i){
+		err = __gthread_join(readers[i], 0);
+		assert(err == 0);
+	}
+	printf("parked readers: OK\n");
+}
+
+int main(){
+	printf("%8s %20s %20s\n", "readers", "__gthread_seqlock_t", "__gthread_mutex_t");
+	for(unsigned long reader_count = 1; reader_count <= MAX_READER_COUNT; reader_count *= 2){
+		const double seq = run(reader_count, false);
+		const double mtx = run(reader_count, true);
+		printf("%8lu %20.3f %20.3f\n", reader_count, seq, mtx);
+	}
+	check_parked_readers();
+}
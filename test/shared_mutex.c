@@ -0,0 +1,64 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+__gthread_rwlock_t rwlock = __GTHREAD_RWLOCK_INIT;
+volatile unsigned long counter_a = 0, counter_b = 0;
+
+#define LOOPS_PER_THREAD       100000ul
+#define READER_COUNT           8ul
+#define WRITER_COUNT           2ul
+
+void *reader_proc(void *param){
+	(void)param;
+	for(unsigned long i = 0; i < LOOPS_PER_THREAD; ++i){
+		__gthread_rwlock_rdlock(&rwlock);
+		unsigned long a = counter_a;
+		unsigned long b = counter_b;
+		assert(a == b);
+		if((i % 1000 == 0) && (__gthread_rwlock_upgrade(&rwlock) == 0)){
+			// We own the lock exclusively now.
+			++counter_a;
+			++counter_b;
+		}
+		__gthread_rwlock_unlock(&rwlock);
+	}
+	return 0;
+}
+void *writer_proc(void *param){
+	(void)param;
+	for(unsigned long i = 0; i < LOOPS_PER_THREAD; ++i){
+		__gthread_rwlock_wrlock(&rwlock);
+		unsigned long a = counter_a;
+		++a;
+		counter_a = a;
+		unsigned long b = counter_b;
+		++b;
+		counter_b = b;
+		__gthread_rwlock_unlock(&rwlock);
+	}
+	return 0;
+}
+
+int main(){
+	int err;
+	__gthread_t threads[READER_COUNT + WRITER_COUNT];
+	for(unsigned i = 0; i < READER_COUNT + WRITER_COUNT; ++i){
+		err = __gthread_create(&threads[i], (i < READER_COUNT) ? &reader_proc : &writer_proc, (void *)(intptr_t)i);
+		assert(err == 0);
+	}
+	for(unsigned i = 0; i < READER_COUNT + WRITER_COUNT; ++i){
+		printf("waiting for thread %u\n", i);
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+	printf("counter_a = %lu, counter_b = %lu\n", counter_a, counter_b);
+
+	assert(counter_a == counter_b);
+	assert(counter_a >= LOOPS_PER_THREAD * WRITER_COUNT);
+}
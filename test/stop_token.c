@@ -0,0 +1,158 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This test blocks threads on a mutex, a condition variable and a join with a stop token, then requests a stop.
+// Every one of them must return `ECANCELED` promptly, while a thread waiting on the same condition variable without the stop token must keep waiting.
+// Then it checks that callbacks may unregister themselves, and that other threads are blocked only when they unregister the callback that is running.
+
+#define THREAD_COUNT           8ul
+
+__gthread_stop_token_t stop = __GTHREAD_STOP_TOKEN_INIT;
+__gthread_mutex_t mutex = __GTHREAD_MUTEX_INIT;
+__gthread_mutex_t held_mutex = __GTHREAD_MUTEX_INIT;
+__gthread_cond_t cond = __GTHREAD_COND_INIT;
+__gthread_t sleeper;
+volatile bool released = false;
+volatile unsigned long cancelled = 0;
+
+void *sleeper_proc(void *param){
+	(void)param;
+	__gthread_mutex_lock(&mutex);
+	while(!released){
+		__gthread_cond_wait(&cond, &mutex);
+	}
+	__gthread_mutex_unlock(&mutex);
+	return 0;
+}
+
+void *thread_proc(void *param){
+	int err;
+	switch((uintptr_t)param % 3){
+	case 0:
+		err = __gthread_mutex_lock_or_stop(&held_mutex, &stop);
+		break;
+	case 1:
+		__gthread_mutex_lock(&mutex);
+		do {
+			err = __gthread_cond_wait_or_stop(&cond, &mutex, &stop);
+		} while(err == 0);
+		__gthread_mutex_unlock(&mutex);
+		break;
+	default:
+		err = __gthread_join_or_stop(sleeper, 0, &stop);
+		break;
+	}
+	assert(err == ECANCELED);
+	__atomic_fetch_add(&cancelled, 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+__gthread_stop_token_t callback_stop = __GTHREAD_STOP_TOKEN_INIT;
+__gthread_stop_callback_t self_callbacks[THREAD_COUNT], slow_callback, victim_callback;
+volatile unsigned long self_called = 0;
+volatile bool slow_entered = false, slow_returned = false, victim_called = false;
+
+// This is what the destructor of a `std::stop_callback` does when it is destroyed by its own callback.
+void unregister_self(intptr_t context){
+	__gthread_stop_callback_unregister(&callback_stop, &self_callbacks[context]);
+	__atomic_fetch_add(&self_called, 1, __ATOMIC_RELAXED);
+}
+void slow_proc(intptr_t context){
+	(void)context;
+	__atomic_store_n(&slow_entered, true, __ATOMIC_RELAXED);
+	_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 200);
+	__atomic_store_n(&slow_returned, true, __ATOMIC_RELEASE);
+}
+void victim_proc(intptr_t context){
+	(void)context;
+	victim_called = true;
+}
+
+void *unregisterer_proc(void *param){
+	(void)param;
+	while(!__atomic_load_n(&slow_entered, __ATOMIC_RELAXED)){
+		__gthread_yield();
+	}
+	// This callback has not been called, so it is unregistered without waiting for the one that is running.
+	__gthread_stop_callback_unregister(&callback_stop, &victim_callback);
+	assert(!__atomic_load_n(&slow_returned, __ATOMIC_RELAXED));
+	// This one is running in another thread, so we have to wait for it.
+	__gthread_stop_callback_unregister(&callback_stop, &slow_callback);
+	assert(__atomic_load_n(&slow_returned, __ATOMIC_ACQUIRE));
+	return 0;
+}
+
+void check_callbacks(void){
+	int err;
+	__gthread_t unregisterer;
+	// Callbacks are called in the reverse order of registration.
+	err = __gthread_stop_callback_register(&callback_stop, &victim_callback, &victim_proc, 0);
+	assert(err == 0);
+	err = __gthread_stop_callback_register(&callback_stop, &slow_callback, &slow_proc, 0);
+	assert(err == 0);
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		err = __gthread_stop_callback_register(&callback_stop, &self_callbacks[i], &unregister_self, (intptr_t)i);
+		assert(err == 0);
+	}
+	err = __gthread_create(&unregisterer, &unregisterer_proc, 0);
+	assert(err == 0);
+	err = __gthread_stop_token_request_stop(&callback_stop);
+	assert(err != 0);
+	err = __gthread_join(unregisterer, 0);
+	assert(err == 0);
+	assert(self_called == THREAD_COUNT);
+	assert(slow_returned);
+	assert(!victim_called);
+}
+
+int main(){
+	int err;
+	__gthread_t threads[THREAD_COUNT];
+	err = __gthread_create(&sleeper, &sleeper_proc, 0);
+	assert(err == 0);
+	__gthread_mutex_lock(&held_mutex);
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		err = __gthread_create(&threads[i], &thread_proc, (void *)(uintptr_t)i);
+		assert(err == 0);
+	}
+	// Give them some time to block.
+	_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 200);
+	assert(cancelled == 0);
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	err = __gthread_stop_token_request_stop(&stop);
+	assert(err != 0);
+	err = __gthread_stop_token_request_stop(&stop);
+	assert(err == 0);
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	assert(cancelled == THREAD_COUNT);
+	printf("all threads stopped in %.3f ms\n", t2 - t1);
+	__gthread_mutex_unlock(&held_mutex);
+
+	// Waits with a stop token that has been stopped fail immediately.
+	err = __gthread_mutex_lock_or_stop(&held_mutex, &stop);
+	assert(err == 0);
+	err = __gthread_cond_wait_or_stop(&cond, &held_mutex, &stop);
+	assert(err == ECANCELED);
+	__gthread_mutex_unlock(&held_mutex);
+
+	// The sleeper has not been woken up and is still joinable.
+	__gthread_mutex_lock(&mutex);
+	released = true;
+	__gthread_cond_broadcast(&cond);
+	__gthread_mutex_unlock(&mutex);
+	err = __gthread_join(sleeper, 0);
+	assert(err == 0);
+
+	check_callbacks();
+}
@@ -0,0 +1,95 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/tagged_condition_variable.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark simulates a request router, where each consumer waits for messages addressed to itself.
+// It compares `_MCFCRT_TaggedConditionVariable` with a plain condition variable, which has to be broadcast,
+// and counts wakeups that find no message, which are wasted.
+
+#define CONSUMER_COUNT         32ul
+#define MESSAGE_COUNT          200000ul
+
+__gthread_mutex_t mutex = __GTHREAD_MUTEX_INIT;
+__gthread_cond_t cond = __GTHREAD_COND_INIT;
+_MCFCRT_TaggedConditionVariable tagged_cond = { 0 };
+bool use_tagged;
+unsigned long mailboxes[CONSUMER_COUNT];
+bool quit;
+unsigned long received, wasted_wakeups;
+
+void *thread_proc(void *param){
+	const uintptr_t index = (uintptr_t)param;
+	__gthread_mutex_lock(&mutex);
+	for(;;){
+		while(mailboxes[index] != 0){
+			--mailboxes[index];
+			++received;
+		}
+		if(quit){
+			break;
+		}
+		if(use_tagged){
+			_MCFCRT_WaitForTaggedConditionVariableForever(&tagged_cond, (intptr_t)index, &__MCFCRT_gthread_unlock_callback_mutex, &__MCFCRT_gthread_relock_callback_mutex, (intptr_t)&mutex);
+		} else {
+			__gthread_cond_wait(&cond, &mutex);
+		}
+		if((mailboxes[index] == 0) && !quit){
+			++wasted_wakeups;
+		}
+	}
+	__gthread_mutex_unlock(&mutex);
+	return 0;
+}
+
+void run(bool tagged){
+	int err;
+	__gthread_t threads[CONSUMER_COUNT];
+	use_tagged = tagged;
+	quit = false;
+	received = 0;
+	wasted_wakeups = 0;
+	for(unsigned long i = 0; i < CONSUMER_COUNT; ++i){
+		err = __gthread_create(&threads[i], &thread_proc, (void *)(uintptr_t)i);
+		assert(err == 0);
+	}
+	srand(1);
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < MESSAGE_COUNT; ++i){
+		const uintptr_t index = (unsigned)rand() % CONSUMER_COUNT;
+		__gthread_mutex_lock(&mutex);
+		++mailboxes[index];
+		if(use_tagged){
+			_MCFCRT_SignalTaggedConditionVariable(&tagged_cond, (intptr_t)index, 1);
+		} else {
+			__gthread_cond_broadcast(&cond);
+		}
+		__gthread_mutex_unlock(&mutex);
+	}
+	__gthread_mutex_lock(&mutex);
+	quit = true;
+	if(use_tagged){
+		_MCFCRT_BroadcastTaggedConditionVariable(&tagged_cond);
+	} else {
+		__gthread_cond_broadcast(&cond);
+	}
+	__gthread_mutex_unlock(&mutex);
+	for(unsigned long i = 0; i < CONSUMER_COUNT; ++i){
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	assert(received == MESSAGE_COUNT);
+	printf("%-32s %12.3f messages per ms, %10lu wasted wakeups\n", tagged ? "_MCFCRT_TaggedConditionVariable" : "__gthread_cond_t", MESSAGE_COUNT / (t2 - t1), wasted_wakeups);
+}
+
+int main(){
+	run(false);
+	run(true);
+}
@@ -0,0 +1,141 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/latch.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <windows.h>
+
+// This test creates a large number of threads with small stacks, which must all be alive at the same time,
+// then checks that the priority, the affinity and the ideal processor of a thread have been applied before it starts running.
+// With the thread cache enabled, a reused thread must not inherit the ones that the previous procedure has changed.
+
+#define THREAD_COUNT           20000ul
+#define STACK_SIZE             65536ul
+
+_MCFCRT_Latch latch;
+
+void *sleeper_proc(void *param){
+	(void)param;
+	_MCFCRT_WaitForLatchForever(&latch, _MCFCRT_LATCH_SUGGESTED_SPIN_COUNT);
+	return 0;
+}
+
+void *checker_proc(void *param){
+	const __gthread_attr_t *const attr = param;
+	assert(GetThreadPriority(GetCurrentThread()) == attr->nPriority);
+	GROUP_AFFINITY affinity;
+	BOOL succeeded = GetThreadGroupAffinity(GetCurrentThread(), &affinity);
+	assert(succeeded);
+	assert(affinity.Group == attr->ushAffinityGroup);
+	assert(affinity.Mask == attr->uAffinityMask);
+	PROCESSOR_NUMBER ideal;
+	succeeded = GetThreadIdealProcessorEx(GetCurrentThread(), &ideal);
+	assert(succeeded);
+	assert(ideal.Group == attr->ushIdealProcessorGroup);
+	assert(ideal.Number == attr->byIdealProcessorNumber);
+	return 0;
+}
+
+typedef struct snapshot {
+	DWORD tid;
+	int priority;
+	GROUP_AFFINITY affinity;
+	PROCESSOR_NUMBER ideal;
+} snapshot;
+
+void take_snapshot(snapshot *snap){
+	snap->tid = GetCurrentThreadId();
+	snap->priority = GetThreadPriority(GetCurrentThread());
+	BOOL succeeded = GetThreadGroupAffinity(GetCurrentThread(), &snap->affinity);
+	assert(succeeded);
+	succeeded = GetThreadIdealProcessorEx(GetCurrentThread(), &snap->ideal);
+	assert(succeeded);
+}
+
+void *changer_proc(void *param){
+	snapshot *const snap = param;
+	take_snapshot(snap);
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+	GROUP_AFFINITY affinity = snap->affinity;
+	affinity.Mask &= -affinity.Mask;
+	SetThreadGroupAffinity(GetCurrentThread(), &affinity, 0);
+	PROCESSOR_NUMBER ideal = snap->ideal;
+	ideal.Number = (unsigned char)(ideal.Number ^ 1);
+	SetThreadIdealProcessorEx(GetCurrentThread(), &ideal, 0);
+	return 0;
+}
+void *reused_proc(void *param){
+	take_snapshot(param);
+	return 0;
+}
+
+void check_cached(void){
+	int err;
+	__gthread_t thread;
+	snapshot before, after;
+	__gthread_set_thread_cache_capacity(1);
+	err = __gthread_create(&thread, &changer_proc, &before);
+	assert(err == 0);
+	err = __gthread_join(thread, 0);
+	assert(err == 0);
+	// Give the thread some time to get cached.
+	_MCFCRT_Sleep(_MCFCRT_GetFastMonoClock() + 100);
+	err = __gthread_create(&thread, &reused_proc, &after);
+	assert(err == 0);
+	err = __gthread_join(thread, 0);
+	assert(err == 0);
+	__gthread_set_thread_cache_capacity(0);
+	if(after.tid != before.tid){
+		printf("the thread has not been reused\n");
+		return;
+	}
+	assert(after.priority == before.priority);
+	assert(after.affinity.Group == before.affinity.Group);
+	assert(after.affinity.Mask == before.affinity.Mask);
+	assert(after.ideal.Group == before.ideal.Group);
+	assert(after.ideal.Number == before.ideal.Number);
+	printf("attributes restored in a reused thread\n");
+}
+
+int main(){
+	int err;
+	static __gthread_t threads[THREAD_COUNT];
+	__gthread_attr_t attr = { 0 };
+	attr.uStackReserve = STACK_SIZE;
+	attr.uStackCommit = 4096;
+	_MCFCRT_InitializeLatch(&latch, 1);
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		err = __gthread_create_with_attributes(&threads[i], &sleeper_proc, 0, &attr);
+		assert(err == 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	printf("created %lu threads with %lu KiB stacks in %.3f ms\n", THREAD_COUNT, STACK_SIZE / 1024, t2 - t1);
+	_MCFCRT_CountDownLatch(&latch, 1);
+	for(unsigned long i = 0; i < THREAD_COUNT; ++i){
+		err = __gthread_join(threads[i], 0);
+		assert(err == 0);
+	}
+
+	__gthread_attr_t check_attr = { 0 };
+	check_attr.uAffinityMask = 1;
+	check_attr.ushAffinityGroup = 0;
+	check_attr.bHasIdealProcessor = true;
+	check_attr.ushIdealProcessorGroup = 0;
+	check_attr.byIdealProcessorNumber = 0;
+	check_attr.bHasPriority = true;
+	check_attr.nPriority = THREAD_PRIORITY_BELOW_NORMAL;
+	__gthread_t checker;
+	err = __gthread_create_with_attributes(&checker, &checker_proc, &check_attr, &check_attr);
+	assert(err == 0);
+	err = __gthread_join(checker, 0);
+	assert(err == 0);
+	printf("attributes applied\n");
+
+	check_cached();
+}
@@ -0,0 +1,93 @@
+// This file is put into the Public Domain.
+
+#include "../src/gthread.h"
+#include "../src/env/clocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+// This benchmark measures how many short-lived threads per millisecond can be created and joined (or detached)
+// by increasing numbers of spawning threads at the same time, without and with the thread cache.
+// It also checks that thread-specific data are destroyed before a cached thread is joined.
+
+#define MAX_SPAWNER_COUNT      16ul
+#define THREADS_PER_SPAWNER    2000ul
+#define CACHE_CAPACITY         64ul
+
+__gthread_key_t key;
+volatile unsigned long finished;
+
+// The value is a pointer to a flag, which is set when it is destroyed.
+void key_destructor(void *value){
+	__atomic_store_n((volatile bool *)value, true, __ATOMIC_RELAXED);
+}
+
+void *worker_proc(void *param){
+	static volatile bool dummy_flag;
+	assert(__gthread_getspecific(key) == 0);
+	__gthread_setspecific(key, param ? param : (void *)&dummy_flag);
+	__atomic_fetch_add(&finished, 1, __ATOMIC_RELAXED);
+	return param;
+}
+
+void *spawner_proc(void *param){
+	(void)param;
+	int err;
+	for(unsigned long i = 0; i < THREADS_PER_SPAWNER; ++i){
+		__gthread_t worker;
+		if(i % 2 == 0){
+			volatile bool destroyed = false;
+			err = __gthread_create(&worker, &worker_proc, (void *)&destroyed);
+			assert(err == 0);
+			void *ret;
+			err = __gthread_join(worker, &ret);
+			assert(err == 0);
+			assert(ret == (void *)&destroyed);
+			assert(destroyed);
+		} else {
+			err = __gthread_create(&worker, &worker_proc, 0);
+			assert(err == 0);
+			err = __gthread_detach(worker);
+			assert(err == 0);
+		}
+	}
+	return 0;
+}
+
+double run(unsigned long spawner_count, size_t cache_capacity){
+	int err;
+	__gthread_set_thread_cache_capacity(cache_capacity);
+	__gthread_t spawners[MAX_SPAWNER_COUNT];
+	finished = 0;
+	const double t1 = _MCFCRT_GetHiResMonoClock();
+	for(unsigned long i = 0; i < spawner_count; ++i){
+		err = __gthread_create(&spawners[i], &spawner_proc, 0);
+		assert(err == 0);
+	}
+	for(unsigned long i = 0; i < spawner_count; ++i){
+		err = __gthread_join(spawners[i], 0);
+		assert(err == 0);
+	}
+	const double t2 = _MCFCRT_GetHiResMonoClock();
+	// Detached threads might still be running.
+	while(__atomic_load_n(&finished, __ATOMIC_RELAXED) < spawner_count * THREADS_PER_SPAWNER){
+		__gthread_yield();
+	}
+	// Let cached threads exit.
+	__gthread_set_thread_cache_capacity(0);
+	// The result is in threads per millisecond.
+	return spawner_count * THREADS_PER_SPAWNER / (t2 - t1);
+}
+
+int main(){
+	int err = __gthread_key_create(&key, &key_destructor);
+	assert(err == 0);
+	printf("%8s %20s %20s\n", "spawners", "no cache", "cache");
+	for(unsigned long spawner_count = 1; spawner_count <= MAX_SPAWNER_COUNT; spawner_count *= 2){
+		const double uncached = run(spawner_count, 0);
+		const double cached = run(spawner_count, CACHE_CAPACITY);
+		printf("%8lu %20.3f %20.3f\n", spawner_count, uncached, cached);
+	}
+}